@@ -0,0 +1,1102 @@
+/**
+ * @brief Http server loopback benchmark
+ * @file http_server_bench.cpp
+ * @copyright Licensed under the Apache License, Version 2.0
+ * @note the server and a keep-alive load generator run in one process over loopback. Every combination of
+ * handler, server thread count, connection count and payload size is run for a fixed duration after a warmup,
+ * the RPS and latency percentiles are printed and written to a json report. With --connect new every request
+ * opens a connection, which measures the accept loop. With --tls 1 the server terminates TLS with a self-signed
+ * cert, a new or resumed connection per request measures the handshakes per second. With --transport unix the
+ * server listens on an abstract Unix socket instead of TCP loopback.
+ */
+
+#include <httpserver/http_server.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <boost/asio.hpp>
+#include <boost/asio/local/stream_protocol.hpp>
+#include <boost/beast.hpp>
+#include <boost/optional.hpp>
+#include <nlohmann/json.hpp>
+#include <spdlog/fmt/bundled/core.h>
+#ifdef HTTP_SERVER_TLS
+#include <boost/asio/ssl.hpp>
+#include <boost/beast/ssl.hpp>
+#include "http_tls.h"
+#endif
+
+using namespace http::server;
+namespace beast = boost::beast;
+namespace net = boost::asio;
+using tcp = boost::asio::ip::tcp;
+using local = boost::asio::local::stream_protocol;
+
+namespace
+{
+const char* kTlsCertFile = "httpserver_bench.crt";
+const char* kTlsKeyFile = "httpserver_bench.key";
+const char* kUnixSocketName = "httpserver_bench";  // in the abstract namespace, no file is left behind
+
+enum class ConnectMode
+{
+    KeepAlive,  ///< every request on the same connection
+    New,        ///< a new connection per request, measures the connections or full TLS handshakes per second
+    Resume,     ///< a new TLS connection per request resuming the session of the last one
+};
+
+struct BenchOptions
+{
+    std::vector<std::string> handlers_{"hello", "gzip", "async"};
+    std::vector<uint32_t> thread_nums_{1, 4};
+    std::vector<uint32_t> connection_nums_{1, 16, 64};
+    std::vector<uint32_t> payload_sizes_{0, 1024, 16384};
+    uint32_t client_thread_num_{1};
+    uint32_t warmup_{1};    // uint:seconds
+    uint32_t duration_{3};  // uint:seconds
+    uint16_t port_{18080};
+    bool fast_request_parser_{false};
+    IoBackend io_backend_{IoBackend::Epoll};
+    bool unix_socket_{false};
+    bool tls_{false};
+    ConnectMode connect_mode_{ConnectMode::KeepAlive};
+    uint32_t accept_num_{1};
+    uint32_t accept_batch_size_{1};
+    int listen_backlog_{1024};
+    uint64_t defer_accept_time_out_{0};
+    std::string output_{"httpserver_bench.json"};
+};
+
+struct BenchResult
+{
+    std::string handler_;
+    uint32_t thread_num_{0};
+    uint32_t connection_num_{0};
+    uint32_t payload_size_{0};
+    uint64_t request_cnt_{0};
+    uint64_t error_cnt_{0};
+    uint64_t resumed_cnt_{0};
+    double rps_{0};
+    double mb_s_{0};  // request and response bodies
+    double mean_us_{0};
+    uint32_t p50_us_{0};
+    uint32_t p99_us_{0};
+    uint32_t p999_us_{0};
+    uint32_t max_us_{0};
+};
+
+/**
+ * @brief same as the demo HelloHandler, echoes the request back as text
+ */
+class HelloHandler : public APIHandler
+{
+public:
+    HelloHandler() = default;
+    virtual ~HelloHandler() = default;
+
+    virtual void handle(HttpRequest&& request, HttpResponseWriter&& response_writer) noexcept
+    {
+        std::stringstream ss;
+        ss << "receive method: " << static_cast<int>(request.method()) << std::endl;
+        ss << "receive body: " << request.body() << std::endl;
+        for (const auto& p : request.params())
+        {
+            ss << "receive param: " << p.first << ":" << p.second << std::endl;
+        }
+        for (const auto& h : request.headers())
+        {
+            ss << "receive header: " << h.first << ":" << h.second << std::endl;
+        }
+        response_writer.send(HttpResponse(StatusType::OK, ss.str(), "text/plain"));
+    }
+};
+
+/**
+ * @brief returns a compressible text body of the request body size, always gzipped
+ */
+class GzipHandler : public APIHandler
+{
+public:
+    GzipHandler() = default;
+    virtual ~GzipHandler() = default;
+
+    virtual void handle(HttpRequest&& request, HttpResponseWriter&& response_writer) noexcept
+    {
+        std::string body;
+        body.reserve(request.body().size());
+        while (body.size() < request.body().size())
+        {
+            body.append("hello httpserver ");
+        }
+        body.resize(request.body().size());
+        auto rsp = HttpResponse(StatusType::OK, std::move(body), "text/plain");
+        rsp.forceGzip();
+        response_writer.send(std::move(rsp));
+    }
+};
+
+/**
+ * @brief the same small json response with a few fixed headers, built per request or from a template
+ */
+class StaticHandler : public APIHandler
+{
+public:
+    explicit StaticHandler(bool use_template)
+        : use_template_(use_template)
+        , response_template_(StatusType::OK,
+                             "application/json",
+                             {{"Cache-Control", "no-store"}, {"X-Content-Type-Options", "nosniff"}, {"Vary", "Accept"}})
+    {
+    }
+    virtual ~StaticHandler() = default;
+
+    virtual void handle(HttpRequest&& request, HttpResponseWriter&& response_writer) noexcept
+    {
+        if (use_template_)
+        {
+            response_writer.send(HttpResponse(response_template_, "{\"status\":\"ok\"}"));
+            return;
+        }
+
+        auto rsp = HttpResponse(StatusType::OK, "{\"status\":\"ok\"}", "application/json");
+        rsp.header("Cache-Control", "no-store").header("X-Content-Type-Options", "nosniff").header("Vary", "Accept");
+        response_writer.send(std::move(rsp));
+    }
+
+private:
+    bool use_template_;
+    HttpResponseTemplate response_template_;
+};
+
+/**
+ * @brief echoes the request body from a worker thread
+ */
+class AsyncHandler : public APIHandler
+{
+public:
+    AsyncHandler()
+        : stop_flag_(false)
+        , worker_([this] { this->work(); })
+    {
+    }
+
+    virtual ~AsyncHandler()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_flag_ = true;
+        }
+        cv_.notify_one();
+        worker_.join();
+    }
+
+    virtual void handle(HttpRequest&& request, HttpResponseWriter&& response_writer) noexcept
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            incoming_.emplace_back(std::move(request), std::move(response_writer));
+        }
+        cv_.notify_one();
+    }
+
+private:
+    void work()
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (true)
+        {
+            cv_.wait(lock, [this] { return stop_flag_ || !incoming_.empty(); });
+            if (incoming_.empty())
+            {
+                return;
+            }
+
+            auto rq = std::move(incoming_.front());
+            incoming_.pop_front();
+            lock.unlock();
+            std::string body = rq.first.body();
+            rq.second.send(HttpResponse(StatusType::OK, std::move(body), "text/plain"));
+            lock.lock();
+        }
+    }
+
+private:
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    bool stop_flag_;
+    std::list<std::pair<HttpRequest, HttpResponseWriter>> incoming_;
+    std::thread worker_;
+};
+
+/**
+ * @brief load generator state shared by the connections of one run
+ */
+struct BenchClientState
+{
+    std::atomic<bool> recording_{false};  // latencies are only recorded after the warmup
+    std::atomic<bool> stop_{false};
+    std::atomic<uint64_t> error_cnt_{0};
+    std::atomic<uint64_t> byte_cnt_{0};
+    std::atomic<uint64_t> resumed_cnt_{0};
+};
+
+void setNoDelay(tcp::socket& socket)
+{
+    beast::error_code ec;
+    socket.set_option(tcp::no_delay(true), ec);
+}
+
+void setNoDelay(local::socket&)
+{
+}
+
+/**
+ * @brief one client connection over TCP or a Unix socket, sends the next request as soon as the response is read
+ * @note with ConnectMode::New it reconnects for every request, the latency covers the connect
+ */
+template <class Protocol>
+class BenchConnection : public std::enable_shared_from_this<BenchConnection<Protocol>>
+{
+public:
+    BenchConnection(net::io_context& ioc,
+                    const typename Protocol::endpoint& endpoint,
+                    const beast::http::request<beast::http::string_body>& request,
+                    ConnectMode connect_mode,
+                    BenchClientState& state)
+        : stream_(net::make_strand(ioc))
+        , endpoint_(endpoint)
+        , request_(request)
+        , connect_mode_(connect_mode)
+        , state_(state)
+    {
+        latencies_.reserve(1 << 16);
+    }
+
+    void run()
+    {
+        doConnect();
+    }
+
+    const std::vector<uint32_t>& latencies() const
+    {
+        return latencies_;
+    }
+
+private:
+    void doConnect()
+    {
+        start_time_ = std::chrono::steady_clock::now();
+        buffer_.clear();
+        stream_.async_connect(endpoint_,
+                              beast::bind_front_handler(&BenchConnection::onConnect, this->shared_from_this()));
+    }
+
+    void onConnect(beast::error_code ec)
+    {
+        if (ec)
+        {
+            ++state_.error_cnt_;
+            return;
+        }
+        setNoDelay(stream_.socket());
+        doWrite();
+    }
+
+    void doWrite()
+    {
+        if (connect_mode_ == ConnectMode::KeepAlive)
+        {
+            start_time_ = std::chrono::steady_clock::now();
+        }
+        beast::http::async_write(stream_,
+                                 request_,
+                                 beast::bind_front_handler(&BenchConnection::onWrite, this->shared_from_this()));
+    }
+
+    void onWrite(beast::error_code ec, std::size_t)
+    {
+        if (ec)
+        {
+            ++state_.error_cnt_;
+            return;
+        }
+
+        response_ = {};
+        beast::http::async_read(stream_,
+                                buffer_,
+                                response_,
+                                beast::bind_front_handler(&BenchConnection::onRead, this->shared_from_this()));
+    }
+
+    void onRead(beast::error_code ec, std::size_t)
+    {
+        if (ec)
+        {
+            ++state_.error_cnt_;
+            return;
+        }
+
+        if (state_.stop_.load(std::memory_order_relaxed))
+        {
+            beast::error_code ignored;
+            stream_.socket().shutdown(net::socket_base::shutdown_both, ignored);
+            return;
+        }
+
+        if (state_.recording_.load(std::memory_order_relaxed))
+        {
+            if (response_.result() != beast::http::status::ok)
+            {
+                ++state_.error_cnt_;
+            }
+            auto latency = std::chrono::steady_clock::now() - start_time_;
+            latencies_.push_back(
+                static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::microseconds>(latency).count()));
+            state_.byte_cnt_.fetch_add(request_.body().size() + response_.body().size(), std::memory_order_relaxed);
+        }
+
+        if (connect_mode_ == ConnectMode::KeepAlive)
+        {
+            doWrite();
+            return;
+        }
+
+        beast::error_code ignored;
+        stream_.socket().shutdown(net::socket_base::shutdown_both, ignored);
+        stream_.close();
+        doConnect();
+    }
+
+private:
+    beast::basic_stream<Protocol> stream_;
+    typename Protocol::endpoint endpoint_;
+    const beast::http::request<beast::http::string_body>& request_;
+    ConnectMode connect_mode_;
+    BenchClientState& state_;
+    beast::flat_buffer buffer_;
+    beast::http::response<beast::http::string_body> response_;
+    std::chrono::steady_clock::time_point start_time_;
+    std::vector<uint32_t> latencies_;
+};
+
+#ifdef HTTP_SERVER_TLS
+/**
+ * @brief one TLS client connection, a keep-alive one or a new connection per request
+ * @note the latency of a new or resumed connection covers connect, handshake and the request
+ */
+template <class Protocol>
+class BenchTlsConnection : public std::enable_shared_from_this<BenchTlsConnection<Protocol>>
+{
+public:
+    BenchTlsConnection(net::io_context& ioc,
+                       net::ssl::context& ssl_context,
+                       const typename Protocol::endpoint& endpoint,
+                       const beast::http::request<beast::http::string_body>& request,
+                       ConnectMode connect_mode,
+                       BenchClientState& state)
+        : strand_(net::make_strand(ioc))
+        , ssl_context_(ssl_context)
+        , stream_()
+        , session_(nullptr)
+        , endpoint_(endpoint)
+        , request_(request)
+        , connect_mode_(connect_mode)
+        , state_(state)
+    {
+        latencies_.reserve(1 << 16);
+    }
+
+    ~BenchTlsConnection()
+    {
+        if (session_ != nullptr)
+        {
+            SSL_SESSION_free(session_);
+        }
+    }
+
+    void run()
+    {
+        doConnect();
+    }
+
+    const std::vector<uint32_t>& latencies() const
+    {
+        return latencies_;
+    }
+
+private:
+    void doConnect()
+    {
+        start_time_ = std::chrono::steady_clock::now();
+        buffer_.clear();
+        stream_.emplace(strand_, ssl_context_);
+        if (session_ != nullptr)
+        {
+            SSL_set_session(stream_->native_handle(), session_);
+        }
+        beast::get_lowest_layer(*stream_).async_connect(
+            endpoint_,
+            beast::bind_front_handler(&BenchTlsConnection::onConnect, this->shared_from_this()));
+    }
+
+    void onConnect(beast::error_code ec)
+    {
+        if (ec)
+        {
+            ++state_.error_cnt_;
+            return;
+        }
+        setNoDelay(beast::get_lowest_layer(*stream_).socket());
+        stream_->async_handshake(net::ssl::stream_base::client,
+                                 beast::bind_front_handler(&BenchTlsConnection::onHandshake, this->shared_from_this()));
+    }
+
+    void onHandshake(beast::error_code ec)
+    {
+        if (ec)
+        {
+            ++state_.error_cnt_;
+            return;
+        }
+        if (SSL_session_reused(stream_->native_handle()) == 1 && state_.recording_.load(std::memory_order_relaxed))
+        {
+            ++state_.resumed_cnt_;
+        }
+        doWrite();
+    }
+
+    void doWrite()
+    {
+        if (connect_mode_ == ConnectMode::KeepAlive)
+        {
+            start_time_ = std::chrono::steady_clock::now();
+        }
+        beast::http::async_write(*stream_,
+                                 request_,
+                                 beast::bind_front_handler(&BenchTlsConnection::onWrite, this->shared_from_this()));
+    }
+
+    void onWrite(beast::error_code ec, std::size_t)
+    {
+        if (ec)
+        {
+            ++state_.error_cnt_;
+            return;
+        }
+
+        response_ = {};
+        beast::http::async_read(*stream_,
+                                buffer_,
+                                response_,
+                                beast::bind_front_handler(&BenchTlsConnection::onRead, this->shared_from_this()));
+    }
+
+    void onRead(beast::error_code ec, std::size_t)
+    {
+        if (ec)
+        {
+            ++state_.error_cnt_;
+            return;
+        }
+
+        if (state_.recording_.load(std::memory_order_relaxed) && !state_.stop_.load(std::memory_order_relaxed))
+        {
+            if (response_.result() != beast::http::status::ok)
+            {
+                ++state_.error_cnt_;
+            }
+            auto latency = std::chrono::steady_clock::now() - start_time_;
+            latencies_.push_back(
+                static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::microseconds>(latency).count()));
+            state_.byte_cnt_.fetch_add(request_.body().size() + response_.body().size(), std::memory_order_relaxed);
+        }
+
+        if (connect_mode_ == ConnectMode::KeepAlive && !state_.stop_.load(std::memory_order_relaxed))
+        {
+            doWrite();
+            return;
+        }
+
+        if (connect_mode_ == ConnectMode::Resume)
+        {
+            if (session_ != nullptr)
+            {
+                SSL_SESSION_free(session_);
+            }
+            session_ = SSL_get1_session(stream_->native_handle());
+        }
+
+        // close without waiting for the close_notify of the server, marking it sent keeps the session resumable
+        SSL_set_shutdown(stream_->native_handle(), SSL_SENT_SHUTDOWN);
+        beast::error_code ignored;
+        beast::get_lowest_layer(*stream_).socket().shutdown(net::socket_base::shutdown_both, ignored);
+        beast::get_lowest_layer(*stream_).close();
+        if (!state_.stop_.load(std::memory_order_relaxed))
+        {
+            doConnect();
+        }
+    }
+
+private:
+    net::strand<net::io_context::executor_type> strand_;
+    net::ssl::context& ssl_context_;
+    boost::optional<beast::ssl_stream<beast::basic_stream<Protocol>>> stream_;  // one per connection
+    SSL_SESSION* session_;  // of the last connection, offered in the next handshake
+    typename Protocol::endpoint endpoint_;
+    const beast::http::request<beast::http::string_body>& request_;
+    ConnectMode connect_mode_;
+    BenchClientState& state_;
+    beast::flat_buffer buffer_;
+    beast::http::response<beast::http::string_body> response_;
+    std::chrono::steady_clock::time_point start_time_;
+    std::vector<uint32_t> latencies_;
+};
+#endif
+
+std::vector<uint32_t> parseList(const std::string& value)
+{
+    std::vector<uint32_t> result;
+    std::stringstream ss(value);
+    std::string item;
+    while (std::getline(ss, item, ','))
+    {
+        result.push_back(static_cast<uint32_t>(std::stoul(item)));
+    }
+    return result;
+}
+
+std::vector<std::string> parseNames(const std::string& value)
+{
+    std::vector<std::string> result;
+    std::stringstream ss(value);
+    std::string item;
+    while (std::getline(ss, item, ','))
+    {
+        result.push_back(item);
+    }
+    return result;
+}
+
+void printUsage()
+{
+    std::cout << "usage: httpserver_bench [options]\n"
+                 "  --handlers hello,gzip,async   handlers to run, also headers,template\n"
+                 "  --threads 1,4                 server thread counts\n"
+                 "  --connections 1,16,64         client connection counts\n"
+                 "  --payloads 0,1024,16384       request body sizes in bytes\n"
+                 "  --client-threads 1            load generator thread count\n"
+                 "  --warmup 1                    warmup seconds per run\n"
+                 "  --duration 3                  measured seconds per run\n"
+                 "  --port 18080                  loopback port\n"
+                 "  --fast-parser 0               1 parses requests with HttpFastParser\n"
+                 "  --io-backend epoll            connection io backend, epoll or io_uring\n"
+                 "  --transport tcp               tcp loopback or unix, an abstract unix socket\n"
+                 "  --tls 0                       1 terminates TLS with a self-signed cert\n"
+                 "  --connect keepalive           keepalive, new or resume (tls only) connection per request\n"
+                 "  --accept-num 1                accepts outstanding per listening socket\n"
+                 "  --accept-batch 1              connections accepted per wakeup\n"
+                 "  --backlog 1024                listen backlog\n"
+                 "  --defer-accept 0              TCP_DEFER_ACCEPT seconds, 0 means disable\n"
+                 "  --output httpserver_bench.json  json report path\n";
+}
+
+bool parseOptions(int argc, char** argv, BenchOptions& opts)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string name = argv[i];
+        if (name == "--help" || name == "-h" || i + 1 >= argc)
+        {
+            return false;
+        }
+
+        std::string value = argv[++i];
+        if (name == "--handlers")
+        {
+            opts.handlers_ = parseNames(value);
+        }
+        else if (name == "--threads")
+        {
+            opts.thread_nums_ = parseList(value);
+        }
+        else if (name == "--connections")
+        {
+            opts.connection_nums_ = parseList(value);
+        }
+        else if (name == "--payloads")
+        {
+            opts.payload_sizes_ = parseList(value);
+        }
+        else if (name == "--client-threads")
+        {
+            opts.client_thread_num_ = std::max<uint32_t>(1, static_cast<uint32_t>(std::stoul(value)));
+        }
+        else if (name == "--warmup")
+        {
+            opts.warmup_ = static_cast<uint32_t>(std::stoul(value));
+        }
+        else if (name == "--duration")
+        {
+            opts.duration_ = std::max<uint32_t>(1, static_cast<uint32_t>(std::stoul(value)));
+        }
+        else if (name == "--port")
+        {
+            opts.port_ = static_cast<uint16_t>(std::stoul(value));
+        }
+        else if (name == "--fast-parser")
+        {
+            opts.fast_request_parser_ = std::stoul(value) != 0;
+        }
+        else if (name == "--io-backend")
+        {
+            if (value != "epoll" && value != "io_uring")
+            {
+                return false;
+            }
+            opts.io_backend_ = value == "io_uring" ? IoBackend::IoUring : IoBackend::Epoll;
+        }
+        else if (name == "--transport")
+        {
+            if (value != "tcp" && value != "unix")
+            {
+                return false;
+            }
+            opts.unix_socket_ = value == "unix";
+        }
+        else if (name == "--tls")
+        {
+            opts.tls_ = std::stoul(value) != 0;
+        }
+        else if (name == "--accept-num")
+        {
+            opts.accept_num_ = std::max<uint32_t>(1, static_cast<uint32_t>(std::stoul(value)));
+        }
+        else if (name == "--accept-batch")
+        {
+            opts.accept_batch_size_ = std::max<uint32_t>(1, static_cast<uint32_t>(std::stoul(value)));
+        }
+        else if (name == "--backlog")
+        {
+            opts.listen_backlog_ = std::max(1, std::stoi(value));
+        }
+        else if (name == "--defer-accept")
+        {
+            opts.defer_accept_time_out_ = std::stoul(value);
+        }
+        else if (name == "--connect")
+        {
+            if (value == "keepalive")
+            {
+                opts.connect_mode_ = ConnectMode::KeepAlive;
+            }
+            else if (value == "new")
+            {
+                opts.connect_mode_ = ConnectMode::New;
+            }
+            else if (value == "resume")
+            {
+                opts.connect_mode_ = ConnectMode::Resume;
+            }
+            else
+            {
+                return false;
+            }
+        }
+        else if (name == "--output")
+        {
+            opts.output_ = value;
+        }
+        else
+        {
+            return false;
+        }
+    }
+#ifndef HTTP_SERVER_TLS
+    if (opts.tls_)
+    {
+        std::cerr << "tls isn't built in, OpenSSL wasn't found" << std::endl;
+        return false;
+    }
+#endif
+    if (opts.connect_mode_ == ConnectMode::Resume && !opts.tls_)
+    {
+        std::cerr << "--connect resume needs --tls 1" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void removeTlsFiles(const BenchOptions& opts)
+{
+    if (opts.tls_)
+    {
+        std::remove(kTlsCertFile);
+        std::remove(kTlsKeyFile);
+    }
+}
+
+const char* connectModeName(ConnectMode connect_mode)
+{
+    switch (connect_mode)
+    {
+        case ConnectMode::KeepAlive:
+            return "keepalive";
+        case ConnectMode::New:
+            return "new";
+        case ConnectMode::Resume:
+            return "resume";
+    }
+    return "";
+}
+
+template <class Protocol>
+bool waitServerReady(const typename Protocol::endpoint& endpoint)
+{
+    net::io_context ioc;
+    for (auto i = 0; i < 500; ++i)
+    {
+        typename Protocol::socket socket(ioc);
+        beast::error_code ec;
+        socket.connect(endpoint, ec);
+        if (!ec)
+        {
+            return true;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return false;
+}
+
+uint32_t percentile(const std::vector<uint32_t>& sorted, double p)
+{
+    if (sorted.empty())
+    {
+        return 0;
+    }
+    auto index = std::min(sorted.size() - 1, static_cast<std::size_t>(p * static_cast<double>(sorted.size())));
+    return sorted[index];
+}
+
+/**
+ * @brief run the connections of one measurement, return the latencies recorded after the warmup
+ */
+template <class Protocol>
+std::vector<uint32_t> runClients(const BenchOptions& opts,
+                                 const typename Protocol::endpoint& endpoint,
+                                 const beast::http::request<beast::http::string_body>& request,
+                                 uint32_t connection_num,
+                                 BenchClientState& state,
+                                 std::chrono::steady_clock::duration& elapsed)
+{
+    net::io_context client_ioc(static_cast<int>(opts.client_thread_num_));
+    std::vector<std::shared_ptr<BenchConnection<Protocol>>> connections;
+#ifdef HTTP_SERVER_TLS
+    net::ssl::context ssl_context(net::ssl::context::tls_client);
+    ssl_context.set_verify_mode(net::ssl::verify_none);
+    std::vector<std::shared_ptr<BenchTlsConnection<Protocol>>> tls_connections;
+#endif
+    for (uint32_t i = 0; i < connection_num; ++i)
+    {
+#ifdef HTTP_SERVER_TLS
+        if (opts.tls_)
+        {
+            tls_connections.push_back(std::make_shared<BenchTlsConnection<Protocol>>(
+                client_ioc, ssl_context, endpoint, request, opts.connect_mode_, state));
+            tls_connections.back()->run();
+            continue;
+        }
+#endif
+        connections.push_back(
+            std::make_shared<BenchConnection<Protocol>>(client_ioc, endpoint, request, opts.connect_mode_, state));
+        connections.back()->run();
+    }
+
+    std::vector<std::thread> client_threads;
+    for (uint32_t i = 0; i < opts.client_thread_num_; ++i)
+    {
+        client_threads.emplace_back([&client_ioc] { client_ioc.run(); });
+    }
+
+    std::this_thread::sleep_for(std::chrono::seconds(opts.warmup_));
+    state.error_cnt_.store(0);
+    state.recording_.store(true);
+    auto start_time = std::chrono::steady_clock::now();
+    std::this_thread::sleep_for(std::chrono::seconds(opts.duration_));
+    state.stop_.store(true);
+    elapsed = std::chrono::steady_clock::now() - start_time;
+
+    // every connection exits after its in-flight response
+    for (auto& t : client_threads)
+    {
+        t.join();
+    }
+
+    std::vector<uint32_t> latencies;
+    for (auto& connection : connections)
+    {
+        latencies.insert(latencies.end(), connection->latencies().begin(), connection->latencies().end());
+    }
+#ifdef HTTP_SERVER_TLS
+    for (auto& connection : tls_connections)
+    {
+        latencies.insert(latencies.end(), connection->latencies().begin(), connection->latencies().end());
+    }
+#endif
+    return latencies;
+}
+
+BenchResult runOnce(const BenchOptions& opts,
+                    const std::string& handler,
+                    uint32_t thread_num,
+                    uint32_t connection_num,
+                    uint32_t payload_size)
+{
+    BenchResult result;
+    result.handler_ = handler;
+    result.thread_num_ = thread_num;
+    result.connection_num_ = connection_num;
+    result.payload_size_ = payload_size;
+
+    auto server_opts = HttpServerOptions();
+    server_opts.addr_ = "127.0.0.1";
+    server_opts.port_ = opts.port_;
+    server_opts.thread_num_ = thread_num;
+    server_opts.fast_request_parser_ = opts.fast_request_parser_;
+    server_opts.io_backend_ = opts.io_backend_;
+    server_opts.accept_num_ = opts.accept_num_;
+    server_opts.accept_batch_size_ = opts.accept_batch_size_;
+    server_opts.listen_backlog_ = opts.listen_backlog_;
+    server_opts.defer_accept_time_out_ = opts.defer_accept_time_out_;
+    if (opts.unix_socket_)
+    {
+        server_opts.listen_addresses_ = {std::string("unix:@") + kUnixSocketName};
+    }
+    if (opts.tls_)
+    {
+        server_opts.tls_cert_file_ = kTlsCertFile;
+        server_opts.tls_key_file_ = kTlsKeyFile;
+    }
+
+    HelloHandler hello_handler;
+    GzipHandler gzip_handler;
+    AsyncHandler async_handler;
+    StaticHandler headers_handler(false);
+    StaticHandler template_handler(true);
+    HttpServer server(server_opts);
+    server.registerHandler("/hello", &hello_handler);
+    server.registerHandler("/gzip", &gzip_handler);
+    server.registerHandler("/async", &async_handler);
+    server.registerHandler("/headers", &headers_handler);
+    server.registerHandler("/template", &template_handler);
+    std::exception_ptr server_error;
+    std::thread server_thread(
+        [&server, &server_error]
+        {
+            try
+            {
+                server.run();
+            }
+            catch (...)
+            {
+                server_error = std::current_exception();
+            }
+        });
+
+    auto tcp_endpoint = tcp::endpoint(net::ip::make_address(server_opts.addr_), server_opts.port_);
+    auto unix_path = std::string(1, '\0') + kUnixSocketName;
+    if (opts.unix_socket_ ? !waitServerReady<local>(local::endpoint(unix_path)) : !waitServerReady<tcp>(tcp_endpoint))
+    {
+        server.stop();
+        server_thread.join();
+        if (server_error)
+        {
+            std::rethrow_exception(server_error);
+        }
+        throw std::runtime_error(opts.unix_socket_ ? fmt::format("server is not ready on unix:@{}", kUnixSocketName)
+                                                   : fmt::format("server is not ready on port {}", opts.port_));
+    }
+
+    beast::http::request<beast::http::string_body> request{beast::http::verb::post, "/" + handler, 11};
+    request.set(beast::http::field::host, server_opts.addr_);
+    request.set(beast::http::field::content_type, "text/plain");
+    request.set(beast::http::field::accept_encoding, "gzip");
+    request.keep_alive(true);
+    request.body() = std::string(payload_size, 'a');
+    request.prepare_payload();
+
+    BenchClientState state;
+    std::chrono::steady_clock::duration elapsed;
+    auto latencies = opts.unix_socket_
+                         ? runClients<local>(opts, local::endpoint(unix_path), request, connection_num, state, elapsed)
+                         : runClients<tcp>(opts, tcp_endpoint, request, connection_num, state, elapsed);
+    server.stop();
+    server_thread.join();
+
+    std::sort(latencies.begin(), latencies.end());
+
+    uint64_t latency_sum = 0;
+    for (auto latency : latencies)
+    {
+        latency_sum += latency;
+    }
+
+    result.request_cnt_ = latencies.size();
+    result.error_cnt_ = state.error_cnt_.load();
+    result.resumed_cnt_ = state.resumed_cnt_.load();
+    result.rps_ = static_cast<double>(latencies.size()) / std::chrono::duration<double>(elapsed).count();
+    result.mb_s_ = static_cast<double>(state.byte_cnt_.load()) / (1024.0 * 1024.0) /
+                   std::chrono::duration<double>(elapsed).count();
+    result.mean_us_ = latencies.empty() ? 0 : static_cast<double>(latency_sum) / static_cast<double>(latencies.size());
+    result.p50_us_ = percentile(latencies, 0.5);
+    result.p99_us_ = percentile(latencies, 0.99);
+    result.p999_us_ = percentile(latencies, 0.999);
+    result.max_us_ = latencies.empty() ? 0 : latencies.back();
+    return result;
+}
+
+nlohmann::json toJson(const BenchOptions& opts, const std::vector<BenchResult>& results)
+{
+    nlohmann::json report;
+    report["revision"] = HTTP_SERVER_BENCH_REVISION;
+    report["hardware_concurrency"] = std::thread::hardware_concurrency();
+    report["client_thread_num"] = opts.client_thread_num_;
+    report["warmup_s"] = opts.warmup_;
+    report["duration_s"] = opts.duration_;
+    report["fast_request_parser"] = opts.fast_request_parser_;
+    report["io_backend"] = opts.io_backend_ == IoBackend::IoUring ? "io_uring" : "epoll";
+    report["transport"] = opts.unix_socket_ ? "unix" : "tcp";
+    report["tls"] = opts.tls_;
+    report["connect"] = connectModeName(opts.connect_mode_);
+    report["accept_num"] = opts.accept_num_;
+    report["accept_batch_size"] = opts.accept_batch_size_;
+    report["listen_backlog"] = opts.listen_backlog_;
+    report["defer_accept_time_out_s"] = opts.defer_accept_time_out_;
+
+    auto& items = report["results"];
+    items = nlohmann::json::array();
+    for (const auto& r : results)
+    {
+        nlohmann::json item;
+        item["handler"] = r.handler_;
+        item["thread_num"] = r.thread_num_;
+        item["connection_num"] = r.connection_num_;
+        item["payload_size"] = r.payload_size_;
+        item["request_cnt"] = r.request_cnt_;
+        item["error_cnt"] = r.error_cnt_;
+        item["resumed_cnt"] = r.resumed_cnt_;
+        item["rps"] = r.rps_;
+        item["mb_s"] = r.mb_s_;
+        item["mean_us"] = r.mean_us_;
+        item["p50_us"] = r.p50_us_;
+        item["p99_us"] = r.p99_us_;
+        item["p999_us"] = r.p999_us_;
+        item["max_us"] = r.max_us_;
+        items.push_back(std::move(item));
+    }
+    return report;
+}
+}  // namespace
+
+int main(int argc, char** argv)
+{
+    BenchOptions opts;
+    if (!parseOptions(argc, argv, opts))
+    {
+        printUsage();
+        return 1;
+    }
+
+    setLogLevel(LogLevel::Warn);
+
+#ifdef HTTP_SERVER_TLS
+    if (opts.tls_)
+    {
+        try
+        {
+            HttpTlsContext::writeSelfSigned(kTlsCertFile, kTlsKeyFile, "localhost");
+        }
+        catch (const std::exception& e)
+        {
+            std::cerr << "bench fail: " << e.what() << std::endl;
+            return 1;
+        }
+    }
+#endif
+
+    std::cout << fmt::format("{:<8}{:>8}{:>8}{:>10}{:>12}{:>10}{:>10}{:>10}{:>10}{:>10}{:>8}\n",
+                             "handler",
+                             "threads",
+                             "conns",
+                             "payload",
+                             "rps",
+                             "MB/s",
+                             "mean_us",
+                             "p50_us",
+                             "p99_us",
+                             "p999_us",
+                             "errors");
+
+    std::vector<BenchResult> results;
+    for (const auto& handler : opts.handlers_)
+    {
+        for (auto thread_num : opts.thread_nums_)
+        {
+            for (auto connection_num : opts.connection_nums_)
+            {
+                for (auto payload_size : opts.payload_sizes_)
+                {
+                    BenchResult r;
+                    try
+                    {
+                        r = runOnce(opts, handler, thread_num, connection_num, payload_size);
+                    }
+                    catch (const std::exception& e)
+                    {
+                        std::cerr << "bench fail: " << e.what() << std::endl;
+                        removeTlsFiles(opts);
+                        return 1;
+                    }
+                    std::cout << fmt::format("{:<8}{:>8}{:>8}{:>10}{:>12.0f}{:>10.1f}{:>10.0f}{:>10}{:>10}{:>10}{:>8}\n",
+                                             r.handler_,
+                                             r.thread_num_,
+                                             r.connection_num_,
+                                             r.payload_size_,
+                                             r.rps_,
+                                             r.mb_s_,
+                                             r.mean_us_,
+                                             r.p50_us_,
+                                             r.p99_us_,
+                                             r.p999_us_,
+                                             r.error_cnt_);
+                    results.push_back(std::move(r));
+                }
+            }
+        }
+    }
+
+    removeTlsFiles(opts);
+
+    std::ofstream output(opts.output_);
+    if (!output)
+    {
+        std::cerr << "open " << opts.output_ << " fail" << std::endl;
+        return 1;
+    }
+    output << toJson(opts, results).dump(2) << std::endl;
+    std::cout << "json report: " << opts.output_ << std::endl;
+    return 0;
+}
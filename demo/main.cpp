@@ -1,4 +1,5 @@
 #include <httpserver/http_server.h>
+#include <memory>
 #include <sstream>
 #include <string>
 #include "httpserver/detail/http_types.h"
@@ -52,6 +53,6 @@ int main()
     server_opts.thread_num_ = 8;
 
     auto server = HttpServer(server_opts);
-    server.registerHandler("/hello", new HelloHandler());
+    server.updateRoutes(HttpRouteUpdate().add("/hello", std::make_shared<HelloHandler>()));
     server.run();
 }
\ No newline at end of file
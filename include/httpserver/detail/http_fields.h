@@ -0,0 +1,169 @@
+/**
+ * @brief Http request fields Define
+ * @file http_fields.h
+ * @copyright Licensed under the Apache License, Version 2.0
+ */
+
+#pragma once
+#include <cstddef>
+#include <list>
+#include <map>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace http
+{
+namespace server
+{
+// forward declaration
+class HttpSession;
+class HttpArena;
+
+/**
+ * @brief non-owning view of request text, valid as long as the HttpRequest or a copy of its fields is alive
+ * @note views of the request are NUL-terminated, so c_str() can be passed to C functions
+ */
+class HttpStringView
+{
+public:
+    HttpStringView() noexcept = default;
+    HttpStringView(const char* data, std::size_t size) noexcept;
+    HttpStringView(const char* data) noexcept;
+    HttpStringView(const std::string& data) noexcept;
+
+    const char* data() const noexcept;
+    const char* c_str() const noexcept;
+    std::size_t size() const noexcept;
+    bool empty() const noexcept;
+    const char* begin() const noexcept;
+    const char* end() const noexcept;
+    char operator[](std::size_t index) const noexcept;
+
+    /**
+     * @brief copy to a std::string
+     */
+    std::string toString() const;
+    operator std::string() const;
+
+    /**
+     * @brief same as std::string::compare
+     */
+    int compare(HttpStringView other) const noexcept;
+
+    /**
+     * @brief ascii case-insensitive equality
+     */
+    bool iequals(HttpStringView other) const noexcept;
+
+private:
+    const char* data_{nullptr};
+    std::size_t size_{0};
+};
+
+bool operator==(HttpStringView lhs, HttpStringView rhs) noexcept;
+bool operator!=(HttpStringView lhs, HttpStringView rhs) noexcept;
+bool operator<(HttpStringView lhs, HttpStringView rhs) noexcept;
+std::string operator+(HttpStringView lhs, HttpStringView rhs);
+std::ostream& operator<<(std::ostream& os, HttpStringView view);
+
+/**
+ * @brief read-only name value pairs of a request, such as headers or url parameters
+ * @note the text is stored in the arena of the request and the entries in a vector sorted by name, so
+ * building the fields takes a few allocations whatever their count, and find() is a binary search.
+ * A name given more than once keeps its last value. Header names are compared case-insensitively.
+ * Copies share the arena. Decoded url parameter values are decoded when first read through find(), at(),
+ * iteration or the std::map conversion, so one copy shouldn't be read by several threads at once, while
+ * separate copies of one request can be read on separate threads.
+ */
+class HttpFields
+{
+public:
+    using value_type = std::pair<HttpStringView, HttpStringView>;
+    using const_iterator = std::vector<value_type>::const_iterator;
+    using iterator = const_iterator;
+
+    explicit HttpFields(bool ignore_case = false);
+
+    const_iterator begin() const;
+    const_iterator end() const noexcept;
+    std::size_t size() const noexcept;
+    bool empty() const noexcept;
+
+    /**
+     * @brief return the entry of the name, end() if not found
+     */
+    const_iterator find(HttpStringView name) const;
+
+    /**
+     * @brief return 1 if the name is present, otherwise 0
+     */
+    std::size_t count(HttpStringView name) const noexcept;
+
+    /**
+     * @brief return the value of the name, throw std::out_of_range if not found
+     */
+    HttpStringView at(HttpStringView name) const;
+
+    /**
+     * @brief copy to a std::map, for code written against the former std::map accessors
+     */
+    operator std::map<std::string, std::string>() const;
+
+private:
+    friend class HttpSession;
+
+    void reset(const std::shared_ptr<HttpArena>& arena, std::size_t entry_cnt);
+    void add(const char* name, std::size_t name_size, const char* value, std::size_t value_size);
+    void addQuery(const char* query, std::size_t size, bool decode);
+    void finish();
+    const_iterator lookup(HttpStringView name) const noexcept;
+    void decodeValue(value_type& entry) const;
+    void decodeAll() const;
+    bool less(HttpStringView lhs, HttpStringView rhs) const noexcept;
+
+    bool ignore_case_;
+    bool lazy_;  // values are stored behind a byte telling whether they still need decoding
+    mutable std::size_t encoded_cnt_;  // values not decoded yet
+    std::shared_ptr<HttpArena> arena_;
+    mutable std::vector<value_type> entries_;
+};
+
+/**
+ * @brief read-only url path segments of a request in order, stored in the arena of the request like HttpFields
+ */
+class HttpSegments
+{
+public:
+    using value_type = HttpStringView;
+    using const_iterator = std::vector<value_type>::const_iterator;
+    using iterator = const_iterator;
+
+    HttpSegments() = default;
+
+    const_iterator begin() const noexcept;
+    const_iterator end() const noexcept;
+    std::size_t size() const noexcept;
+    bool empty() const noexcept;
+    HttpStringView operator[](std::size_t index) const noexcept;
+    HttpStringView front() const noexcept;
+    HttpStringView back() const noexcept;
+
+    /**
+     * @brief copy to a std::list, for code written against the former std::list accessor
+     */
+    operator std::list<std::string>() const;
+
+private:
+    friend class HttpSession;
+
+    void reset(const std::shared_ptr<HttpArena>& arena, std::size_t segment_cnt);
+    void add(const char* segment, std::size_t size);
+
+    std::shared_ptr<HttpArena> arena_;
+    std::vector<value_type> segments_;
+};
+}  // namespace server
+}  // namespace http
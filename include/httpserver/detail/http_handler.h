@@ -7,6 +7,12 @@
 #pragma once
 #include "httpserver/detail/http_request.h"
 #include "httpserver/detail/http_response.h"
+#include "httpserver/detail/http_websocket.h"
+
+#if defined(HTTP_SERVER_COROUTINE)
+#include <utility>  // asio 1.74 awaitable.hpp uses std::exchange without it
+#include <boost/asio/awaitable.hpp>
+#endif
 
 namespace http
 {
@@ -27,5 +33,51 @@ public:
      */
     virtual void handle(HttpRequest&& request, HttpResponseWriter&& response_writer) noexcept = 0;
 };
+
+/**
+ * @brief WebSocket handler interface
+ * @note the callbacks of a connection are called in order on its IO thread, and like handle() they should not
+ * block. onClose() is called once for every connection onOpen() was called for, unless the server
+ * is stopped first.
+ */
+class WebSocketHandler
+{
+public:
+    virtual ~WebSocketHandler();
+
+    /**
+     * @brief the connection is upgraded, request is the upgrade request without body
+     */
+    virtual void onOpen(const WebSocketConnection& connection, HttpRequest&& request) noexcept = 0;
+
+    /**
+     * @brief a complete message is received
+     */
+    virtual void onMessage(const WebSocketConnection& connection, WebSocketMessage&& message) noexcept = 0;
+
+    /**
+     * @brief the connection is closed, by either side or because of an error
+     */
+    virtual void onClose(const WebSocketConnection& connection) noexcept = 0;
+};
+
+#if defined(HTTP_SERVER_COROUTINE)
+/**
+ * @brief HTTP coroutine handler interface, only in a C++20 build (HTTP_SERVER_CXX_STANDARD=20)
+ * @note handle() runs on the strand of the connection, co_await boost::asio::this_coro::executor returns it, so
+ * timers and outbound sockets made on it complete on the same thread without locks. The arguments are taken by
+ * value because the frame outlives the call. An exception escaping handle() is logged and answered with 500.
+ */
+class CoroutineHandler
+{
+public:
+    virtual ~CoroutineHandler();
+
+    /**
+     * @brief handler interface, must not block the IO thread between co_awaits
+     */
+    virtual boost::asio::awaitable<void> handle(HttpRequest request, HttpResponseWriter response_writer) = 0;
+};
+#endif
 }  // namespace server
 }  // namespace http
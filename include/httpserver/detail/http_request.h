@@ -5,10 +5,11 @@
  */
 
 #pragma once
-#include <list>
-#include <map>
+#include <atomic>
+#include <memory>
 #include <string>
 #include <chrono>
+#include "httpserver/detail/http_fields.h"
 #include "httpserver/detail/http_types.h"
 
 namespace http
@@ -40,14 +41,14 @@ public:
     uint64_t requestId();
 
     /**
-     * @brief return request headers, no exception thrown
+     * @brief return request headers, names are case-insensitive, no exception thrown
      */
-    const std::map<std::string, std::string>& headers();
+    const HttpFields& headers();
 
     /**
      * @brief return request parameters, no exception thrown
      */
-    const std::map<std::string, std::string>& params();
+    const HttpFields& params();
 
     /**
      * @brief return request body, no exception thrown
@@ -59,10 +60,23 @@ public:
      */
     const std::chrono::time_point<std::chrono::steady_clock>& startTime();
 
+    /**
+     * @brief return the time the handler must send the response before, time_point::max() means no deadline,
+     * no exception thrown
+     */
+    const std::chrono::time_point<std::chrono::steady_clock>& deadline();
+
+    /**
+     * @brief return whether the server has given up on the request, such as the deadline expired and the client
+     * got a 503, a long running handler can check it and stop early, its response will be dropped. threadsafe,
+     * no exception thrown
+     */
+    bool isCancelled();
+
     /**
      * @brief return a list of request ulr path segment in order, no exception thrown
      */
-    const std::list<std::string>& segments();
+    const HttpSegments& segments();
 
 private:
     friend class HttpSession;
@@ -71,10 +85,12 @@ private:
     uint64_t session_id_;
     uint64_t request_id_;
     std::string body_;
-    std::list<std::string> segments_;
-    std::map<std::string, std::string> headers_;
-    std::map<std::string, std::string> params_;
+    HttpSegments segments_;  // headers, params and segments share one arena
+    HttpFields headers_;
+    HttpFields params_;
     std::chrono::time_point<std::chrono::steady_clock> request_start_time_;
+    std::chrono::time_point<std::chrono::steady_clock> deadline_;
+    std::shared_ptr<std::atomic<bool>> cancelled_;  // shared with the session
 };
 }  // namespace server
 }  // namespace http
\ No newline at end of file
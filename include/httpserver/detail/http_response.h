@@ -15,7 +15,44 @@ namespace http
 namespace server
 {
 // forward declaration class;
+class APIHandler;
 class HttpSession;
+class HttpCoroutineAdapter;
+class HttpResponseCache;
+class HttpSharedBody;
+struct HttpEventStreamState;
+struct HttpResponseFlight;
+
+/**
+ * @brief status, content type and headers shared by many responses, such as every response of an endpoint
+ * @note the status line and header block are serialized once when the template is built, a response created
+ * from it only has Date, Content-Length and the connection headers appended. Build it once, for example as a
+ * member of the handler, copies are cheap and share the serialized block.
+ */
+class HttpResponseTemplate
+{
+public:
+    /**
+     * @param [in] status: http status
+     * @param [in] content_type: http content type
+     * @param [in] headers: other http headers, throw std::runtime_error if a name or value contains CR or LF
+     */
+    HttpResponseTemplate(StatusType status,
+                         const std::string& content_type,
+                         const std::map<std::string, std::string>& headers = std::map<std::string, std::string>());
+    ~HttpResponseTemplate();
+
+    /**
+     * @brief return the template status, no exception thrown
+     */
+    StatusType status() const;
+
+private:
+    friend class HttpResponse;
+
+    StatusType status_;
+    std::shared_ptr<const std::string> header_block_;  // status line and headers, each line ends with CRLF
+};
 
 /**
  * @brief HTTP HttpResponse class
@@ -24,7 +61,17 @@ class HttpResponse
 {
 public:
     HttpResponse(StatusType status, std::string&& body, std::string&& content_type);
+
+    /**
+     * @brief response with the status, content type and headers of the template
+     * @note headers set by header() are appended to the ones of the template, gzip and keep alive work as usual
+     */
+    HttpResponse(const HttpResponseTemplate& response_template, std::string&& body);
     ~HttpResponse();
+    HttpResponse(const HttpResponse&) = default;
+    HttpResponse(HttpResponse&&) = default;
+    HttpResponse& operator=(const HttpResponse&) = default;
+    HttpResponse& operator=(HttpResponse&&) = default;
 
     /**
      * @brief set http response header
@@ -50,6 +97,7 @@ public:
 
 private:
     friend class HttpSession;
+    friend class HttpResponseCache;
 
     bool force_gzip_;
     bool force_disable_keep_alive_;
@@ -58,6 +106,50 @@ private:
     CompressionLevel compression_level_;
     std::string body_;
     std::map<std::string, std::string> headers_;
+    std::shared_ptr<const std::string> header_block_;  // set when created from a HttpResponseTemplate
+    std::shared_ptr<HttpSharedBody> shared_body_;  // set when the response answers coalesced requests, body_ is empty then
+};
+
+/**
+ * @brief Server-Sent Events stream answering a request, copies refer to the same stream
+ * @note events are buffered, the session writes everything buffered since its last write at once, so a burst of
+ * events costs one write. A comment is sent when the stream is idle for event_stream_keep_alive_time_out_.
+ */
+class HttpEventStream
+{
+public:
+    /**
+     * @brief a closed stream
+     */
+    HttpEventStream();
+    ~HttpEventStream();
+
+    /**
+     * @brief queue an event, threadsafe, no exception thrown
+     * @param [in] data: event data, each line becomes a "data:" field
+     * @param [in] event: event type, empty means the default "message" type
+     * @param [in] id: event id, empty means no id
+     * @return false if the stream is closed, such as by the client, or event or id contains CR or LF
+     * @note the stream is closed when more than event_stream_max_queue_size_ bytes wait to be written
+     */
+    bool send(const std::string& data, const std::string& event = "", const std::string& id = "");
+
+    /**
+     * @brief close the connection once the queued events are written, threadsafe, no exception thrown
+     */
+    void close();
+
+    /**
+     * @brief return whether events can be sent, threadsafe, no exception thrown
+     */
+    bool isOpen() const;
+
+private:
+    friend class HttpResponseWriter;
+
+    explicit HttpEventStream(const std::shared_ptr<HttpEventStreamState>& state);
+
+    std::shared_ptr<HttpEventStreamState> state_;
 };
 
 /**
@@ -66,17 +158,40 @@ private:
 class HttpResponseWriter
 {
 public:
-    explicit HttpResponseWriter(const std::shared_ptr<HttpSession>& session);
+    HttpResponseWriter(const std::shared_ptr<HttpSession>& session, uint64_t request_id);
     ~HttpResponseWriter();
 
     /**
      * @brief send the http response, threadsafe, no exception thrown
+     * @note the response is dropped if the request has been cancelled, see HttpRequest::isCancelled(). On a
+     * cached route it answers every request waiting for the same key
      * @param [in] rsp: http response
      */
     void send(HttpResponse&& rsp);
 
+    /**
+     * @brief answer the request with a Server-Sent Events stream instead of a response, threadsafe, no exception
+     * thrown
+     * @note the stream is closed at once if the request has been cancelled or is a HTTP/2 stream. The connection
+     * carries nothing else and is closed when the stream ends, don't call send() afterwards. A cached route
+     * can't answer with a stream, the stream is closed at once.
+     */
+    HttpEventStream startEventStream();
+
 private:
+    friend class HttpCoroutineAdapter;
+    friend class HttpResponseCache;
+    friend class HttpSession;
+
+    HttpResponseWriter(const std::shared_ptr<HttpSession>& session,
+                       uint64_t request_id,
+                       const std::shared_ptr<APIHandler>& handler,
+                       const std::shared_ptr<HttpResponseFlight>& flight = nullptr);
+
     std::shared_ptr<HttpSession> session_;
+    uint64_t request_id_;
+    std::shared_ptr<APIHandler> handler_;  // the handler of the route, its route may be removed before send()
+    std::shared_ptr<HttpResponseFlight> flight_;  // set for the handler call of a cache miss, it takes the response
 };
 
 }  // namespace server
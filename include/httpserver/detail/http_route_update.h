@@ -0,0 +1,87 @@
+/**
+ * @brief Http route update Define
+ * @file http_route_update.h
+ * @copyright Licensed under the Apache License, Version 2.0
+ */
+
+#pragma once
+#include <memory>
+#include <string>
+#include <vector>
+#include "httpserver/detail/http_handler.h"
+#include "httpserver/detail/http_types.h"
+
+namespace http
+{
+namespace server
+{
+// forward declaration
+class HttpServerImpl;
+
+/**
+ * @brief a set of route changes applied at once by HttpServer::updateRoutes()
+ * @note the server shares the ownership of the handlers, a handler is released with the last route table
+ * referring to it. Paths are checked when the update is applied.
+ */
+class HttpRouteUpdate
+{
+public:
+    HttpRouteUpdate();
+    ~HttpRouteUpdate();
+
+    /**
+     * @brief route the path to the api handler, replacing the api handler of the path
+     * @throw std::exception if handler is empty
+     */
+    HttpRouteUpdate& add(const std::string& path, std::shared_ptr<APIHandler> handler);
+
+    /**
+     * @brief route the path to the api handler behind a response cache, see HttpCacheOptions
+     * @throw std::exception if handler is empty
+     */
+    HttpRouteUpdate& add(const std::string& path,
+                         std::shared_ptr<APIHandler> handler,
+                         const HttpCacheOptions& cache_opts);
+
+    /**
+     * @brief route WebSocket upgrade requests to the path to the handler, replacing the WebSocket handler of the path
+     * @throw std::exception if handler is empty
+     */
+    HttpRouteUpdate& add(const std::string& path, std::shared_ptr<WebSocketHandler> handler);
+
+#if defined(HTTP_SERVER_COROUTINE)
+    /**
+     * @brief route the path to the coroutine handler, replacing the api handler of the path
+     * @throw std::exception if handler is empty
+     */
+    HttpRouteUpdate& add(const std::string& path, std::shared_ptr<CoroutineHandler> handler);
+#endif
+
+    /**
+     * @brief remove the api and WebSocket handler of the path, nothing is done if the path has none
+     */
+    HttpRouteUpdate& remove(const std::string& path);
+
+    /**
+     * @brief start from an empty table, the routes and the changes added before are dropped
+     */
+    HttpRouteUpdate& clear();
+
+private:
+    friend class HttpServerImpl;
+
+    struct Change
+    {
+        std::string path_;
+        std::shared_ptr<APIHandler> handler_;  // coroutine handlers are already adapted
+        std::shared_ptr<WebSocketHandler> websocket_handler_;
+        bool cached_;
+        HttpCacheOptions cache_opts_;
+    };  // no handler means remove
+
+    bool clear_;
+    std::vector<Change> changes_;
+};
+
+}  // namespace server
+}  // namespace http
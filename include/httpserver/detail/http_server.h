@@ -8,6 +8,7 @@
 #include <string>
 #include <memory>
 #include <httpserver/detail/http_handler.h>
+#include <httpserver/detail/http_route_update.h>
 #include <httpserver/detail/http_types.h>
 
 namespace http
@@ -39,6 +40,18 @@ public:
      */
     void stop();
 
+    /**
+     * @brief gracefully stop the http server, threadsafe, this method will block until all sessions are
+     * closed or time_out expired, then the server is stopped
+     * @param [in] time_out: max time to wait for in-flight requests, uint:seconds
+     * @return true if all sessions were closed before time_out expired
+     * @throw std::exception if any error occurred
+     * @note new connections are refused, idle keep-alive connections are closed at once and the others get
+     * "Connection: close" on their next response. HttpStatistics::draining_ is true meanwhile, session_cnt_
+     * and working_handler_cnt_ show the progress.
+     */
+    bool drain(uint64_t time_out);
+
     /**
      * @brief get http statistics, threadsafe, no exception thrown
      * @return HttpStatistics
@@ -46,18 +59,116 @@ public:
     HttpStatistics getHttpStatistics();
 
     /**
-     * @brief register api handler, not threadsafe, should be called before run() function
+     * @brief add a listener with its own options and handlers, not threadsafe, should be called before run() function
+     * @param [in] opts: options of the listener, such as its addresses, timeouts, max_request_size_, gzip policy,
+     * rate limit and TLS certificate
+     * @return the listener id to register its handlers with, the listener of the constructor options is 0
+     * @note all listeners share the io threads, so thread_num_, io_backend_, io_uring_buffer_num_,
+     * io_uring_buffer_size_, max_session_num_, max_working_handler_num_ and adaptive_concurrency_limit_ are the
+     * ones of the constructor options, the sessions of a listener see its options with those fields replaced.
+     * The statistics are of the whole server.
+     */
+    uint32_t addListener(HttpServerOptions opts);
+
+    /**
+     * @brief register api handler, threadsafe, same as updateRoutes() adding the handler alone
      * @param [in] path: http uri path
      * @param [in] handler: http request handler
      * @throw std::exception if path is invalid
      * @note  path should start with "/" and not exist relative path such as "../../test",<br>
      * The longest matching algorithm is used for path search, and same path handler will be overwrite.<br>
      * The '/' at the end of path will be ignored, so the "/test/" and "/test" will be treat as same path<br>
-     * http server doesn't hold handler life cycle, user should keep handler alive until the server stop.
+     * http server doesn't hold handler life cycle, user should keep handler alive until the server is destroyed,
+     * even after its route is removed or replaced, the io threads may still call it until the retired route
+     * table is freed. Use updateRoutes() with a std::shared_ptr to hand it over, and for any handler which
+     * may be removed while the server runs.
      */
-
     void registerHandler(const std::string& path, APIHandler* handler);
 
+    /**
+     * @brief register api handler of a listener, same as registerHandler(path, handler) for the listener 0
+     * @throw std::exception if path is invalid or the listener isn't added
+     */
+    void registerHandler(uint32_t listener_id, const std::string& path, APIHandler* handler);
+
+    /**
+     * @brief register api handler behind a response cache, threadsafe
+     * @param [in] path: http uri path, matched as for registerHandler(path, handler)
+     * @param [in] handler: http request handler, it's only called on a cache miss or to refresh a stale response
+     * @param [in] cache_opts: ttl, stale-while-revalidate time, vary headers and size of the cache
+     * @throw std::exception if path is invalid
+     * @note GET and HEAD requests are keyed by method, path, parameters sorted by name and the vary headers,
+     * requests of other methods go to the handler uncached. Concurrent misses of a key wait for one handler
+     * call, they all get copies of its response sharing one body, gzipped at most once. With ttl_ and
+     * stale_while_revalidate_ 0 nothing is stored, identical requests in flight still share one handler call
+     * (single-flight). A stored response gets a weak ETag of its body unless it has one, and a request whose If-None-Match
+     * names it gets a 304. Responses with Set-Cookie or "Cache-Control: no-store" or "private" aren't stored.
+     * The handler should answer with send() and ignore If-None-Match, its response may answer other requests.
+     * The user keeps the handler alive until the server is destroyed, as for registerHandler(path, handler).
+     */
+    void registerHandler(const std::string& path, APIHandler* handler, const HttpCacheOptions& cache_opts);
+
+    /**
+     * @brief register api handler of a listener behind a response cache
+     * @throw std::exception if path is invalid or the listener isn't added
+     */
+    void registerHandler(uint32_t listener_id,
+                         const std::string& path,
+                         APIHandler* handler,
+                         const HttpCacheOptions& cache_opts);
+
+    /**
+     * @brief register WebSocket handler, threadsafe
+     * @param [in] path: http uri path, matched as for APIHandler
+     * @param [in] handler: WebSocket handler
+     * @throw std::exception if path is invalid
+     * @note a WebSocket upgrade request to the path is upgraded in place, other requests to it go to the
+     * APIHandler of the path. The user keeps the handler alive until the server is destroyed, as for
+     * registerHandler(path, handler).
+     */
+    void registerHandler(const std::string& path, WebSocketHandler* handler);
+
+    /**
+     * @brief register WebSocket handler of a listener
+     * @throw std::exception if path is invalid or the listener isn't added
+     */
+    void registerHandler(uint32_t listener_id, const std::string& path, WebSocketHandler* handler);
+
+#if defined(HTTP_SERVER_COROUTINE)
+    /**
+     * @brief register coroutine handler, threadsafe
+     * @param [in] path: http uri path, matched as for APIHandler
+     * @param [in] handler: coroutine request handler
+     * @throw std::exception if path is invalid
+     * @note it replaces the APIHandler of the same path. The user keeps the handler alive until the server is
+     * destroyed, as for registerHandler(path, handler).
+     */
+    void registerHandler(const std::string& path, CoroutineHandler* handler);
+
+    /**
+     * @brief register coroutine handler of a listener
+     * @throw std::exception if path is invalid or the listener isn't added
+     */
+    void registerHandler(uint32_t listener_id, const std::string& path, CoroutineHandler* handler);
+#endif
+
+    /**
+     * @brief apply the route changes at once, threadsafe, before run() function or while the server runs
+     * @param [in] update: handlers to add and paths to remove, matched as for registerHandler(path, handler)
+     * @throw std::exception if a path is invalid, no change is applied then
+     * @note the io threads read the route table without locks, a request is routed by the table before or
+     * after the update, never by a mix. The table being replaced is freed once the io threads which may still
+     * read it are past their current callback, along with the handlers no other table or HttpResponseWriter
+     * refers to, a handler answering after handle() returns stays alive until its writer is dropped.
+     */
+    void updateRoutes(const HttpRouteUpdate& update);
+
+    /**
+     * @brief apply the route changes of a listener at once
+     * @throw std::exception if a path is invalid or the listener isn't added
+     */
+    void updateRoutes(uint32_t listener_id, const HttpRouteUpdate& update);
+
 private:
     std::shared_ptr<HttpServerImpl> server_impl_;
 };
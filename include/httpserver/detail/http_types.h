@@ -7,11 +7,21 @@
 #pragma once
 #include <string>
 #include <cstdint>
+#include <vector>
 
 namespace http
 {
 namespace server
 {
+/**
+ * @brief socket io backend of the connections
+ */
+enum class IoBackend
+{
+    Epoll = 0,    ///< the epoll reactor of Asio
+    IoUring = 1,  ///< io_uring with multishot recv into a shared provided buffer ring, linux 6.0 or later
+};
+
 /**
  * @brief HTTP server options
  */
@@ -19,12 +29,59 @@ struct HttpServerOptions
 {
     std::string addr_{"0.0.0.0"};  ///< http server ipv4 addr
     uint16_t port_{6000};          ///< http server ipv4 addr port, default 6000
+    std::vector<std::string> listen_addresses_{};  ///< listen on these instead of addr_ and port_, "ip:port", "[ipv6]:port", "unix:path" or "unix:@name" for the linux abstract namespace, all share the handlers and io threads
+    int listen_fd_{-1};  ///< adopt an already listening TCP or Unix socket instead of binding addr_ and port_, such as one inherited from the previous process for a zero-downtime restart, -1 means disable
+    int listen_backlog_{1024};  ///< pending connection queue length of the sockets bound by the server, capped by net.core.somaxconn
+    uint32_t accept_num_{1};  ///< accept operations kept outstanding per listening socket, more of them take a reconnect storm faster
+    uint32_t accept_batch_size_{1};  ///< connections taken per accept wakeup, the ones already pending are accepted without waiting again
+    uint64_t defer_accept_time_out_{0};  ///< TCP_DEFER_ACCEPT of the TCP sockets bound by the server, a connection is only accepted once request bytes arrive or this passes, uint:seconds, 0 means disable
     uint32_t thread_num_{1};       ///< http server work thread number, default 1
+    IoBackend io_backend_{IoBackend::Epoll};  ///< connection io backend, IoUring falls back to Epoll when the kernel or the build lacks it
+    uint32_t io_uring_buffer_num_{1024};  ///< io_uring receive buffers shared by all connections, split over as many rings as io threads, which the connections are sharded over round-robin, each share rounded up to a power of 2, at most 32768
+    uint32_t io_uring_buffer_size_{16384};  ///< io_uring receive buffer size, default 16KB
+    std::string tls_cert_file_{""};  ///< PEM certificate chain, every connection speaks TLS when set, TLS connections use the epoll backend, empty means plaintext
+    std::string tls_key_file_{""};  ///< PEM private key of tls_cert_file_
+    uint32_t tls_session_cache_size_{20480};  ///< TLS sessions kept for resumption by session id, shared by all connections, 0 means disable
+    uint64_t tls_session_time_out_{7200};  ///< lifetime of a cached TLS session or a session ticket, uint:seconds, default 2h
+    bool tls_session_tickets_{true};  ///< issue session tickets, a client resumes with one without server side state
+    bool enable_ktls_{true};  ///< let the kernel encrypt the records (kTLS) when the kernel and OpenSSL support the negotiated cipher
     uint64_t read_time_out_{60};  ///< read req timeout, uint:seconds, default 60s, 0 means not timeout
     uint64_t write_time_out_{60};  ///< write rsp timeout, uint:seconds, default 60s, 0 means not timeout
+    uint64_t handle_time_out_{60};  ///< handler deadline from the request being read to send() being called, the client gets a 503 when it expires and the connection stays open for the next request, uint:seconds, default 60s, 0 means not timeout
+    uint64_t keep_alive_time_out_{60};  ///< keep-alive connection idle timeout between requests, uint:seconds, default 60s, 0 means not timeout
+    uint64_t max_keep_alive_requests_{0};  ///< max request count per connection, the last response carries "Connection: close", 0 means unlimited
     uint64_t max_request_size_{2097152};  ///< http request max length, if it overflow, will close the connection, default 2MB
     bool auto_gzip_{true};  ///< when the accept_encoding of request is set and auto_gzip_ is true, server automatically gzip the response body
     bool auto_decode_url_parameters_{true};  ///< whether decode url parameters automatically.
+    bool fast_request_parser_{false};  ///< parse simple requests with the SIMD tokenizer chosen by cpu features, others still go to the beast parser
+    bool enable_http2_{false};  ///< serve cleartext HTTP/2 to clients sending the connection preface or "Upgrade: h2c", every stream is a request of the handlers
+    uint32_t http2_max_concurrent_streams_{100};  ///< streams a HTTP/2 client can open at once, excess streams are refused, default 100
+    uint64_t event_stream_keep_alive_time_out_{15};  ///< idle time after which a Server-Sent Events stream gets a comment, so proxies keep the connection, uint:seconds, default 15s, 0 means disable
+    uint64_t event_stream_max_queue_size_{1048576};  ///< event bytes a Server-Sent Events stream can have waiting to be written, a slower client is closed, default 1MB, 0 means unlimited
+    uint64_t websocket_max_queue_size_{1048576};  ///< payload bytes a WebSocket connection can have waiting to be written, a slower client is closed, default 1MB, 0 means unlimited
+    uint32_t max_session_num_{0};  ///< max concurrent session count, excess connections get a 503 and are closed, 0 means unlimited
+    uint32_t session_pool_size_{256};  ///< closed sessions kept for reuse by new connections, 0 means disable
+    uint64_t session_pool_buffer_size_{65536};  ///< read buffer capacity a pooled session keeps, larger buffers are freed, default 64KB
+    uint32_t max_working_handler_num_{0};  ///< max in-flight handler count, excess requests get a 503, 0 means unlimited
+    bool adaptive_concurrency_limit_{false};  ///< adapt the in-flight handler limit to the observed handler latency, max_working_handler_num_ is the upper bound
+    uint32_t rate_limit_qps_{0};  ///< per client request rate, excess requests get a 429 without routing, 0 means disable
+    uint32_t rate_limit_burst_{0};  ///< per client burst request count, 0 means same as rate_limit_qps_
+    std::string rate_limit_key_header_{""};  ///< header used as client key such as an api key, only read from rate_limit_trusted_proxies_, empty or missing header means remote ip
+    std::vector<std::string> rate_limit_trusted_proxies_{};  ///< ip addresses of the proxies which set rate_limit_key_header_ for their clients, the header of other peers is ignored, default empty means never trusted
+    uint32_t rate_limit_table_size_{65536};  ///< rate limit client slot count, fixed 16 bytes per slot, least recently used client is evicted when full
+};
+
+/**
+ * @brief response cache of a route, see HttpServer::registerHandler()
+ */
+struct HttpCacheOptions
+{
+    uint64_t ttl_{60};  ///< time a stored response is fresh, uint:seconds, default 60s, 0 with stale_while_revalidate_ 0 means nothing is stored, identical requests in flight still share one handler call (single-flight)
+    uint64_t stale_while_revalidate_{0};  ///< time after ttl_ a stored response is still served while one handler call refreshes it, uint:seconds, 0 means disable
+    std::vector<std::string> vary_headers_{};  ///< request headers selecting different responses, such as Accept-Language, part of the key with the method, path and parameters
+    uint32_t max_entry_num_{10000};  ///< responses kept by the route, the least recently used is evicted when full
+    uint64_t max_body_size_{1048576};  ///< larger responses are passed on without being stored, default 1MB
+    uint32_t shard_num_{16};  ///< the entries are spread over this many locks, so io threads rarely wait for each other
 };
 
 /**
@@ -36,11 +93,29 @@ struct HttpStatistics
     uint64_t read_timeout_cnt_{0};  ///< http server read time timeout count
     uint64_t read_success_cnt_{0};  ///< http server read request success count
     uint64_t read_fail_cnt_{0};  ///< http server read request fail count, not include timeout fail
-    uint64_t write_timeout_cnt_{0};  ///< http server timeout count, include write time and handle request time
+    uint64_t write_timeout_cnt_{0};  ///< http server write response timeout count
     uint64_t write_success_cnt_{0};  ///< http server write response success count
     uint64_t write_fail_cnt_{0};  ///< http server write response fail count, not include timeout fail
+    uint64_t handle_timeout_cnt_{0};  ///< http server handler timeout count, the handler didn't send the response before handle_time_out_
     uint64_t handler_request_cnt_{0};  ///< http server handle request count
-    uint64_t working_handler_cnt_{0};  ///< http server current is working handler count
+    uint64_t working_handler_cnt_{0};  ///< http server current is working handler count, include async handlers which haven't sent the response
+    uint64_t rejected_session_cnt_{0};  ///< http server rejected connection count, because of max_session_num_
+    uint64_t rejected_request_cnt_{0};  ///< http server rejected request count, because of the in-flight handler limit
+    uint32_t concurrency_limit_{0};  ///< http server current in-flight handler limit, 0 means unlimited
+    uint64_t rate_limited_cnt_{0};  ///< http server rejected request count, because of the per client rate limit
+    bool draining_{false};  ///< http server is draining, see HttpServer::drain()
+    uint64_t session_pool_hit_cnt_{0};  ///< http server connection count served by a pooled session
+    uint64_t session_pool_miss_cnt_{0};  ///< http server connection count which needed a new session
+    uint32_t websocket_session_cnt_{0};  ///< http server current upgraded WebSocket connection count, included in session_cnt_
+    uint64_t websocket_slow_consumer_cnt_{0};  ///< http server WebSocket connections closed because of websocket_max_queue_size_
+    uint32_t event_stream_cnt_{0};  ///< http server current open Server-Sent Events stream count, see HttpResponseWriter::startEventStream()
+    uint64_t tls_handshake_cnt_{0};  ///< http server completed TLS handshake count, include resumptions
+    uint64_t tls_resumed_cnt_{0};  ///< http server TLS handshake count which resumed a session by ticket or session id
+    uint64_t tls_handshake_fail_cnt_{0};  ///< http server failed or timed out TLS handshake count
+    uint64_t ktls_cnt_{0};  ///< http server TLS connection count whose records are encrypted by the kernel
+    uint64_t cache_hit_cnt_{0};  ///< http server request count answered from a response cache, include stale and 304 answers
+    uint64_t cache_miss_cnt_{0};  ///< http server request count whose response cache miss called the handler
+    uint64_t coalesced_request_cnt_{0};  ///< http server request count parked on the handler call of an identical request
 };
 
 /**
@@ -49,7 +124,9 @@ struct HttpStatistics
 enum class StatusType
 {
     OK = 200,           ///< http 200, the request succeeded.
+    Not_Modified = 304,  ///< http 304, the representation the client has, named by If-None-Match, is still current.
     Bad_Request = 400,  ///< http 400, the server cannot or will not process the request due to something that is perceived to be a client error
+    Too_Many_Requests = 429,  ///< http 429, the client has sent too many requests in a given amount of time.
     Internal_Server_Error = 500,  ///< http 500, the server has encountered a situation it does not know how to handle.
     Service_Temporary_Unavailable = 503  /// http 503, the server is temporarily unable to process client requests due to overloading or system maintenance.
 };
@@ -0,0 +1,132 @@
+/**
+ * @brief Http WebSocket Define
+ * @file http_websocket.h
+ * @copyright Licensed under the Apache License, Version 2.0
+ */
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace http
+{
+namespace server
+{
+// forward declaration
+class HttpSession;
+
+/**
+ * @brief WebSocket message
+ * @note the payload is immutable and shared by the copies, so one message sent to thousands of connections
+ * is held once, each connection only queues a reference to it
+ */
+class WebSocketMessage
+{
+public:
+    /**
+     * @param [in] payload: message payload, must be valid UTF-8 for a text message
+     * @param [in] binary: send as a binary message instead of a text message
+     */
+    explicit WebSocketMessage(std::string&& payload, bool binary = false);
+    ~WebSocketMessage();
+
+    /**
+     * @brief return the message payload, no exception thrown
+     */
+    const std::string& payload() const;
+
+    /**
+     * @brief return whether it is a binary message, no exception thrown
+     */
+    bool binary() const;
+
+private:
+    friend class HttpSession;
+
+    std::shared_ptr<const std::string> payload_;
+    bool binary_;
+};
+
+/**
+ * @brief handle of an upgraded WebSocket connection, copies refer to the same connection
+ * @note it doesn't keep the connection open, sending to a closed connection does nothing
+ */
+class WebSocketConnection
+{
+public:
+    WebSocketConnection(const std::shared_ptr<HttpSession>& session, uint64_t session_id);
+    ~WebSocketConnection();
+
+    /**
+     * @brief return the session id of the connection, same as HttpRequest::sessionId() of the upgrade request,
+     * no exception thrown
+     */
+    uint64_t sessionId() const;
+
+    /**
+     * @brief queue the message, threadsafe, no exception thrown
+     * @note a connection whose queue grows over HttpServerOptions::websocket_max_queue_size_ is closed as a slow
+     * consumer
+     */
+    void send(const WebSocketMessage& message) const;
+
+    /**
+     * @brief start the close handshake once the queued messages are written, threadsafe, no exception thrown
+     */
+    void close() const;
+
+    /**
+     * @brief return whether the connection is still open, it turns false shortly after
+     * WebSocketHandler::onClose(), threadsafe, no exception thrown
+     */
+    bool isOpen() const;
+
+private:
+    std::weak_ptr<HttpSession> session_;
+    uint64_t session_id_;
+};
+
+/**
+ * @brief a set of WebSocket connections, such as the subscribers of a topic, threadsafe
+ */
+class WebSocketGroup
+{
+public:
+    WebSocketGroup();
+    ~WebSocketGroup();
+
+    WebSocketGroup(const WebSocketGroup&) = delete;
+    WebSocketGroup& operator=(const WebSocketGroup&) = delete;
+
+    /**
+     * @brief add the connection, no exception thrown if it's already added
+     */
+    void add(const WebSocketConnection& connection);
+
+    /**
+     * @brief remove the connection, such as from WebSocketHandler::onClose()
+     */
+    void remove(const WebSocketConnection& connection);
+
+    /**
+     * @brief return the connection count, closed connections are counted until the next broadcast()
+     */
+    std::size_t size();
+
+    /**
+     * @brief send the message to every connection, the payload is shared and never copied per connection
+     * @return the count of connections the message was queued to, closed connections are removed
+     */
+    std::size_t broadcast(const WebSocketMessage& message);
+
+private:
+    std::mutex mutex_;
+    std::unordered_map<uint64_t, WebSocketConnection> connections_;  // by session id
+};
+
+}  // namespace server
+}  // namespace http
@@ -8,6 +8,9 @@
 #include <httpserver/detail/http_types.h>
 #include <httpserver/detail/http_server.h>
 #include <httpserver/detail/http_handler.h>
+#include <httpserver/detail/http_fields.h>
 #include <httpserver/detail/http_request.h>
 #include <httpserver/detail/http_response.h>
+#include <httpserver/detail/http_route_update.h>
+#include <httpserver/detail/http_websocket.h>
 #include <httpserver/detail/http_log.h>
\ No newline at end of file
@@ -0,0 +1,905 @@
+#include <algorithm>
+#include <cstring>
+#include "http2_connection.h"
+
+namespace http
+{
+namespace server
+{
+namespace
+{
+const char kPreface[] = "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n";
+const std::size_t kFrameHeaderSize = 9;
+const std::size_t kMaxFrameSize = 16384;  // SETTINGS_MAX_FRAME_SIZE of the server, the protocol default
+const std::size_t kMaxHeaderListSize = 16384;  // SETTINGS_MAX_HEADER_LIST_SIZE of the server
+const std::size_t kMaxHeaderBlockSize = 4 * kMaxHeaderListSize;  // encoded header block limit, Huffman may expand
+const int64_t kDefaultWindowSize = 65535;  // initial window of the protocol
+const int64_t kInitialWindowSize = 1 << 20;  // stream and connection windows announced by the server
+const int64_t kMaxWindowSize = 0x7fffffff;
+
+const uint8_t kFlagEndStream = 0x1;
+const uint8_t kFlagAck = 0x1;
+const uint8_t kFlagEndHeaders = 0x4;
+const uint8_t kFlagPadded = 0x8;
+const uint8_t kFlagPriority = 0x20;
+
+const uint16_t kSettingsEnablePush = 0x2;
+const uint16_t kSettingsMaxConcurrentStreams = 0x3;
+const uint16_t kSettingsInitialWindowSize = 0x4;
+const uint16_t kSettingsMaxFrameSize = 0x5;
+const uint16_t kSettingsMaxHeaderListSize = 0x6;
+
+uint32_t readUint32(const uint8_t* p)
+{
+    return (static_cast<uint32_t>(p[0]) << 24) | (static_cast<uint32_t>(p[1]) << 16) |
+           (static_cast<uint32_t>(p[2]) << 8) | static_cast<uint32_t>(p[3]);
+}
+
+void appendUint32(uint32_t value, std::string& out)
+{
+    out.push_back(static_cast<char>(value >> 24));
+    out.push_back(static_cast<char>(value >> 16));
+    out.push_back(static_cast<char>(value >> 8));
+    out.push_back(static_cast<char>(value));
+}
+
+void appendSetting(uint16_t id, uint32_t value, std::string& out)
+{
+    out.push_back(static_cast<char>(id >> 8));
+    out.push_back(static_cast<char>(id));
+    appendUint32(value, out);
+}
+
+int base64UrlValue(char c)
+{
+    if (c >= 'A' && c <= 'Z')
+    {
+        return c - 'A';
+    }
+    if (c >= 'a' && c <= 'z')
+    {
+        return c - 'a' + 26;
+    }
+    if (c >= '0' && c <= '9')
+    {
+        return c - '0' + 52;
+    }
+    if (c == '-' || c == '+')
+    {
+        return 62;
+    }
+    if (c == '_' || c == '/')
+    {
+        return 63;
+    }
+    return -1;
+}
+
+bool isConnectionField(const std::string& name)
+{
+    return name == "connection" || name == "keep-alive" || name == "proxy-connection" ||
+           name == "transfer-encoding" || name == "upgrade";
+}
+}  // namespace
+
+constexpr std::size_t Http2Connection::kPrefaceSize;
+
+Http2Connection::Http2Connection(uint32_t max_concurrent_streams, std::size_t max_request_size)
+    : max_concurrent_streams_(max_concurrent_streams)
+    , max_request_size_(max_request_size)
+    , decoder_()
+    , streams_()
+    , requests_()
+    , resets_()
+    , output_()
+    , header_block_()
+    , fields_()
+    , header_stream_id_(0)
+    , header_end_stream_(false)
+    , last_stream_id_(0)
+    , send_window_(kDefaultWindowSize)
+    , recv_window_(kInitialWindowSize)
+    , peer_initial_window_(kDefaultWindowSize)
+    , peer_max_frame_size_(kMaxFrameSize)
+    , preface_received_(false)
+    , settings_received_(false)
+    , going_away_(false)
+    , peer_going_away_(false)
+    , error_(false)
+{
+    // the server preface, then the connection window raised from the protocol default
+    writeFrameHeader(3 * 6, FrameType::Settings, 0, 0);
+    appendSetting(kSettingsMaxConcurrentStreams, max_concurrent_streams_, output_);
+    appendSetting(kSettingsInitialWindowSize, static_cast<uint32_t>(kInitialWindowSize), output_);
+    appendSetting(kSettingsMaxHeaderListSize, static_cast<uint32_t>(kMaxHeaderListSize), output_);
+    writeWindowUpdate(0, static_cast<uint32_t>(kInitialWindowSize - kDefaultWindowSize));
+}
+
+bool Http2Connection::matchPreface(const char* data, std::size_t size)
+{
+    return std::memcmp(data, kPreface, std::min(size, kPrefaceSize)) == 0;
+}
+
+bool Http2Connection::upgrade(const std::string& http2_settings, Request&& request)
+{
+    // the header is the SETTINGS payload in base64url, the 101 response acknowledges it
+    std::string settings;
+    uint32_t bits = 0;
+    int bit_cnt = 0;
+    for (auto c : http2_settings)
+    {
+        if (c == '=')
+        {
+            break;
+        }
+        auto value = base64UrlValue(c);
+        if (value < 0)
+        {
+            return false;
+        }
+        bits = (bits << 6) | static_cast<uint32_t>(value);
+        bit_cnt += 6;
+        if (bit_cnt >= 8)
+        {
+            bit_cnt -= 8;
+            settings.push_back(static_cast<char>(bits >> bit_cnt));
+            bits &= (1u << bit_cnt) - 1;
+        }
+    }
+    if (settings.size() % 6 != 0 ||
+        !applySettings(reinterpret_cast<const uint8_t*>(settings.data()), settings.size()))
+    {
+        return false;
+    }
+
+    // the request is complete, the client only waits for the response on stream 1
+    last_stream_id_ = 1;
+    request.stream_id_ = 1;
+    auto& stream = streams_[1];
+    stream.send_window_ = peer_initial_window_;
+    stream.recv_window_ = kInitialWindowSize;
+    stream.remote_closed_ = true;
+    stream.responding_ = false;
+    stream.body_offset_ = 0;
+    requests_.push_back(std::move(request));
+    return true;
+}
+
+std::size_t Http2Connection::receive(const char* data, std::size_t size)
+{
+    if (error_)
+    {
+        return size;
+    }
+
+    auto begin = reinterpret_cast<const uint8_t*>(data);
+    auto p = begin;
+    auto end = begin + size;
+    if (!preface_received_)
+    {
+        if (!matchPreface(data, size))
+        {
+            connectionError(ErrorCode::ProtocolError);
+            return size;
+        }
+        if (size < kPrefaceSize)
+        {
+            return 0;
+        }
+        preface_received_ = true;
+        p += kPrefaceSize;
+    }
+
+    while (!error_ && static_cast<std::size_t>(end - p) >= kFrameHeaderSize)
+    {
+        auto frame_size = (static_cast<std::size_t>(p[0]) << 16) | (static_cast<std::size_t>(p[1]) << 8) | p[2];
+        if (frame_size > kMaxFrameSize)
+        {
+            connectionError(ErrorCode::FrameSizeError);
+            break;
+        }
+        if (static_cast<std::size_t>(end - p) < kFrameHeaderSize + frame_size)
+        {
+            break;
+        }
+
+        auto type = static_cast<FrameType>(p[3]);
+        auto flags = p[4];
+        auto stream_id = readUint32(p + 5) & 0x7fffffff;
+        onFrame(type, flags, stream_id, p + kFrameHeaderSize, frame_size);
+        p += kFrameHeaderSize + frame_size;
+    }
+
+    // the buffered data is acknowledged once half of the connection window is used
+    if (!error_ && recv_window_ < kInitialWindowSize / 2)
+    {
+        writeWindowUpdate(0, static_cast<uint32_t>(kInitialWindowSize - recv_window_));
+        recv_window_ = kInitialWindowSize;
+    }
+    return error_ ? size : static_cast<std::size_t>(p - begin);
+}
+
+bool Http2Connection::popRequest(Request& request)
+{
+    if (requests_.empty())
+    {
+        return false;
+    }
+    request = std::move(requests_.front());
+    requests_.pop_front();
+    return true;
+}
+
+bool Http2Connection::popReset(uint32_t& stream_id)
+{
+    if (resets_.empty())
+    {
+        return false;
+    }
+    stream_id = resets_.front();
+    resets_.pop_front();
+    return true;
+}
+
+bool Http2Connection::respond(uint32_t stream_id,
+                              unsigned int status,
+                              const std::vector<std::pair<std::string, std::string>>& fields,
+                              std::string&& body)
+{
+    return queueResponse(stream_id, status, fields, std::move(body), nullptr);
+}
+
+bool Http2Connection::respond(uint32_t stream_id,
+                              unsigned int status,
+                              const std::vector<std::pair<std::string, std::string>>& fields,
+                              const std::shared_ptr<const std::string>& body)
+{
+    return queueResponse(stream_id, status, fields, std::string(), body);
+}
+
+bool Http2Connection::queueResponse(uint32_t stream_id,
+                                    unsigned int status,
+                                    const std::vector<std::pair<std::string, std::string>>& fields,
+                                    std::string&& body,
+                                    const std::shared_ptr<const std::string>& shared_body)
+{
+    auto iter = streams_.find(stream_id);
+    if (error_ || iter == streams_.end() || iter->second.responding_)
+    {
+        return false;
+    }
+
+    std::string block;
+    HttpHpackEncoder::encodeStatus(status, block);
+    for (const auto& field : fields)
+    {
+        HttpHpackEncoder::encode(field.first, field.second, block);
+    }
+
+    // a block larger than a frame continues in CONTINUATION frames
+    auto empty = shared_body ? shared_body->empty() : body.empty();
+    auto end_stream = empty ? kFlagEndStream : 0;
+    auto type = FrameType::Headers;
+    std::size_t offset = 0;
+    do
+    {
+        auto fragment_size = std::min(block.size() - offset, peer_max_frame_size_);
+        auto last = offset + fragment_size == block.size();
+        auto flags = static_cast<uint8_t>((type == FrameType::Headers ? end_stream : 0) | (last ? kFlagEndHeaders : 0));
+        writeFrameHeader(fragment_size, type, flags, stream_id);
+        output_.append(block, offset, fragment_size);
+        offset += fragment_size;
+        type = FrameType::Continuation;
+    } while (offset < block.size());
+
+    if (empty)
+    {
+        streams_.erase(iter);
+        return true;
+    }
+
+    iter->second.responding_ = true;
+    iter->second.body_ = std::move(body);
+    iter->second.shared_body_ = shared_body;
+    iter->second.body_offset_ = 0;
+    flush();
+    return true;
+}
+
+void Http2Connection::goAway()
+{
+    if (going_away_ || error_)
+    {
+        return;
+    }
+
+    going_away_ = true;
+    writeFrameHeader(8, FrameType::GoAway, 0, 0);
+    appendUint32(last_stream_id_, output_);
+    appendUint32(static_cast<uint32_t>(ErrorCode::NoError), output_);
+}
+
+void Http2Connection::takeOutput(std::string& output)
+{
+    if (output.empty())
+    {
+        output.swap(output_);
+    }
+    else
+    {
+        output.append(output_);
+        output_.clear();
+    }
+}
+
+void Http2Connection::onFrame(FrameType type, uint8_t flags, uint32_t stream_id, const uint8_t* payload, std::size_t size)
+{
+    if (header_stream_id_ != 0 && (type != FrameType::Continuation || stream_id != header_stream_id_))
+    {
+        // a header block can't be interleaved with other frames
+        return connectionError(ErrorCode::ProtocolError);
+    }
+    if (!settings_received_ && type != FrameType::Settings)
+    {
+        // the client preface ends with a SETTINGS frame
+        return connectionError(ErrorCode::ProtocolError);
+    }
+
+    switch (type)
+    {
+        case FrameType::Data:
+            return onData(flags, stream_id, payload, size);
+        case FrameType::Headers:
+            return onHeaders(flags, stream_id, payload, size);
+        case FrameType::Priority:
+            if (stream_id == 0)
+            {
+                return connectionError(ErrorCode::ProtocolError);
+            }
+            if (size != 5)
+            {
+                return resetStream(stream_id, ErrorCode::FrameSizeError);
+            }
+            return;
+        case FrameType::RstStream:
+            return onRstStream(stream_id, payload, size);
+        case FrameType::Settings:
+            return onSettings(flags, stream_id, payload, size);
+        case FrameType::PushPromise:
+            return connectionError(ErrorCode::ProtocolError);
+        case FrameType::Ping:
+            return onPing(flags, stream_id, payload, size);
+        case FrameType::GoAway:
+            return onGoAway(stream_id, size);
+        case FrameType::WindowUpdate:
+            return onWindowUpdate(stream_id, payload, size);
+        case FrameType::Continuation:
+            return onContinuation(flags, stream_id, payload, size);
+        default:
+            // unknown frame types are ignored
+            return;
+    }
+}
+
+void Http2Connection::onData(uint8_t flags, uint32_t stream_id, const uint8_t* payload, std::size_t size)
+{
+    if (stream_id == 0)
+    {
+        return connectionError(ErrorCode::ProtocolError);
+    }
+
+    // flow control counts the whole payload, padding included
+    if (static_cast<int64_t>(size) > recv_window_)
+    {
+        return connectionError(ErrorCode::FlowControlError);
+    }
+    recv_window_ -= static_cast<int64_t>(size);
+
+    auto data = payload;
+    auto data_size = size;
+    if ((flags & kFlagPadded) != 0)
+    {
+        if (size == 0 || payload[0] >= size)
+        {
+            return connectionError(ErrorCode::ProtocolError);
+        }
+        data = payload + 1;
+        data_size = size - 1 - payload[0];
+    }
+
+    auto iter = streams_.find(stream_id);
+    if (iter == streams_.end())
+    {
+        if (stream_id > last_stream_id_)
+        {
+            return connectionError(ErrorCode::ProtocolError);
+        }
+        return resetStream(stream_id, ErrorCode::StreamClosed);
+    }
+
+    auto& stream = iter->second;
+    if (stream.remote_closed_)
+    {
+        return resetStream(stream_id, ErrorCode::StreamClosed);
+    }
+    if (static_cast<int64_t>(size) > stream.recv_window_)
+    {
+        return resetStream(stream_id, ErrorCode::FlowControlError);
+    }
+    stream.recv_window_ -= static_cast<int64_t>(size);
+    if (stream.request_.body_.size() + data_size > max_request_size_)
+    {
+        return resetStream(stream_id, ErrorCode::Cancel);
+    }
+    stream.request_.body_.append(reinterpret_cast<const char*>(data), data_size);
+
+    if ((flags & kFlagEndStream) != 0)
+    {
+        return completeRequest(stream_id, stream);
+    }
+    if (stream.recv_window_ < kInitialWindowSize / 2)
+    {
+        writeWindowUpdate(stream_id, static_cast<uint32_t>(kInitialWindowSize - stream.recv_window_));
+        stream.recv_window_ = kInitialWindowSize;
+    }
+}
+
+void Http2Connection::onHeaders(uint8_t flags, uint32_t stream_id, const uint8_t* payload, std::size_t size)
+{
+    if (stream_id == 0)
+    {
+        return connectionError(ErrorCode::ProtocolError);
+    }
+
+    std::size_t begin = 0;
+    std::size_t padding = 0;
+    if ((flags & kFlagPadded) != 0)
+    {
+        if (size == 0)
+        {
+            return connectionError(ErrorCode::ProtocolError);
+        }
+        padding = payload[0];
+        begin = 1;
+    }
+    if ((flags & kFlagPriority) != 0)
+    {
+        // stream dependency and weight, priorities are not used
+        begin += 5;
+    }
+    if (begin + padding > size)
+    {
+        return connectionError(ErrorCode::ProtocolError);
+    }
+
+    header_block_.assign(reinterpret_cast<const char*>(payload + begin), size - begin - padding);
+    header_end_stream_ = (flags & kFlagEndStream) != 0;
+    header_stream_id_ = stream_id;
+    if ((flags & kFlagEndHeaders) != 0)
+    {
+        onHeaderBlock();
+    }
+}
+
+void Http2Connection::onContinuation(uint8_t flags, uint32_t stream_id, const uint8_t* payload, std::size_t size)
+{
+    if (header_stream_id_ == 0 || stream_id != header_stream_id_)
+    {
+        return connectionError(ErrorCode::ProtocolError);
+    }
+    if (header_block_.size() + size > kMaxHeaderBlockSize)
+    {
+        // the block can't be skipped without breaking the decoder state, so the connection goes
+        return connectionError(ErrorCode::CompressionError);
+    }
+
+    header_block_.append(reinterpret_cast<const char*>(payload), size);
+    if ((flags & kFlagEndHeaders) != 0)
+    {
+        onHeaderBlock();
+    }
+}
+
+void Http2Connection::onHeaderBlock()
+{
+    auto stream_id = header_stream_id_;
+    header_stream_id_ = 0;
+
+    // every block is decoded, even of a refused stream, to keep the dynamic table in step with the client
+    fields_.clear();
+    auto result = decoder_.decode(reinterpret_cast<const uint8_t*>(header_block_.data()),
+                                  header_block_.size(),
+                                  kMaxHeaderListSize,
+                                  fields_);
+    if (result == HttpHpackDecoder::Result::CompressionError)
+    {
+        return connectionError(ErrorCode::CompressionError);
+    }
+
+    auto iter = streams_.find(stream_id);
+    if (iter != streams_.end())
+    {
+        // trailers, they end the stream and are dropped
+        if (iter->second.remote_closed_)
+        {
+            return resetStream(stream_id, ErrorCode::StreamClosed);
+        }
+        if (!header_end_stream_)
+        {
+            return resetStream(stream_id, ErrorCode::ProtocolError);
+        }
+        return completeRequest(stream_id, iter->second);
+    }
+
+    if (stream_id % 2 == 0 || stream_id <= last_stream_id_)
+    {
+        return connectionError(ErrorCode::ProtocolError);
+    }
+    last_stream_id_ = stream_id;
+
+    if (going_away_ || peer_going_away_ || streams_.size() >= max_concurrent_streams_)
+    {
+        return resetStream(stream_id, ErrorCode::RefusedStream);
+    }
+    if (result == HttpHpackDecoder::Result::HeaderListTooLarge)
+    {
+        return resetStream(stream_id, ErrorCode::Cancel);
+    }
+
+    Request request;
+    if (!makeRequest(stream_id, fields_, request))
+    {
+        // malformed request
+        return resetStream(stream_id, ErrorCode::ProtocolError);
+    }
+
+    auto& stream = streams_[stream_id];
+    stream.send_window_ = peer_initial_window_;
+    stream.recv_window_ = kInitialWindowSize;
+    stream.remote_closed_ = false;
+    stream.responding_ = false;
+    stream.request_ = std::move(request);
+    stream.body_offset_ = 0;
+    if (header_end_stream_)
+    {
+        completeRequest(stream_id, stream);
+    }
+}
+
+void Http2Connection::onRstStream(uint32_t stream_id, const uint8_t* /*payload*/, std::size_t size)
+{
+    if (stream_id == 0)
+    {
+        return connectionError(ErrorCode::ProtocolError);
+    }
+    if (size != 4)
+    {
+        return connectionError(ErrorCode::FrameSizeError);
+    }
+
+    auto iter = streams_.find(stream_id);
+    if (iter == streams_.end())
+    {
+        if (stream_id > last_stream_id_)
+        {
+            return connectionError(ErrorCode::ProtocolError);
+        }
+        return;
+    }
+
+    if (iter->second.remote_closed_)
+    {
+        // the request was taken, the session cancels it
+        resets_.push_back(stream_id);
+    }
+    streams_.erase(iter);
+}
+
+void Http2Connection::onSettings(uint8_t flags, uint32_t stream_id, const uint8_t* payload, std::size_t size)
+{
+    if (stream_id != 0)
+    {
+        return connectionError(ErrorCode::ProtocolError);
+    }
+    if ((flags & kFlagAck) != 0)
+    {
+        if (size != 0)
+        {
+            return connectionError(ErrorCode::FrameSizeError);
+        }
+        return;
+    }
+    if (size % 6 != 0)
+    {
+        return connectionError(ErrorCode::FrameSizeError);
+    }
+    if (!applySettings(payload, size))
+    {
+        return;
+    }
+
+    settings_received_ = true;
+    writeFrameHeader(0, FrameType::Settings, kFlagAck, 0);
+
+    // a larger initial window may let the pending bodies go on
+    flush();
+}
+
+bool Http2Connection::applySettings(const uint8_t* payload, std::size_t size)
+{
+    for (std::size_t offset = 0; offset + 6 <= size; offset += 6)
+    {
+        auto id = static_cast<uint16_t>((payload[offset] << 8) | payload[offset + 1]);
+        auto value = readUint32(payload + offset + 2);
+        switch (id)
+        {
+            case kSettingsEnablePush:
+                if (value > 1)
+                {
+                    connectionError(ErrorCode::ProtocolError);
+                    return false;
+                }
+                break;
+            case kSettingsInitialWindowSize:
+            {
+                if (value > kMaxWindowSize)
+                {
+                    connectionError(ErrorCode::FlowControlError);
+                    return false;
+                }
+
+                // the change applies to the windows of the open streams
+                auto delta = static_cast<int64_t>(value) - peer_initial_window_;
+                for (auto& stream : streams_)
+                {
+                    stream.second.send_window_ += delta;
+                    if (stream.second.send_window_ > kMaxWindowSize)
+                    {
+                        connectionError(ErrorCode::FlowControlError);
+                        return false;
+                    }
+                }
+                peer_initial_window_ = value;
+                break;
+            }
+            case kSettingsMaxFrameSize:
+                if (value < kMaxFrameSize || value > 0xffffff)
+                {
+                    connectionError(ErrorCode::ProtocolError);
+                    return false;
+                }
+                peer_max_frame_size_ = value;
+                break;
+            default:
+                // the header table size is unused by the encoder, which never indexes
+                break;
+        }
+    }
+    return true;
+}
+
+void Http2Connection::onPing(uint8_t flags, uint32_t stream_id, const uint8_t* payload, std::size_t size)
+{
+    if (stream_id != 0)
+    {
+        return connectionError(ErrorCode::ProtocolError);
+    }
+    if (size != 8)
+    {
+        return connectionError(ErrorCode::FrameSizeError);
+    }
+    if ((flags & kFlagAck) == 0)
+    {
+        writeFrameHeader(8, FrameType::Ping, kFlagAck, 0);
+        output_.append(reinterpret_cast<const char*>(payload), 8);
+    }
+}
+
+void Http2Connection::onGoAway(uint32_t stream_id, std::size_t size)
+{
+    if (stream_id != 0)
+    {
+        return connectionError(ErrorCode::ProtocolError);
+    }
+    if (size < 8)
+    {
+        return connectionError(ErrorCode::FrameSizeError);
+    }
+
+    // the streams already opened are still answered
+    peer_going_away_ = true;
+}
+
+void Http2Connection::onWindowUpdate(uint32_t stream_id, const uint8_t* payload, std::size_t size)
+{
+    if (size != 4)
+    {
+        return connectionError(ErrorCode::FrameSizeError);
+    }
+
+    auto increment = static_cast<int64_t>(readUint32(payload) & 0x7fffffff);
+    if (stream_id == 0)
+    {
+        if (increment == 0 || send_window_ + increment > kMaxWindowSize)
+        {
+            return connectionError(increment == 0 ? ErrorCode::ProtocolError : ErrorCode::FlowControlError);
+        }
+        send_window_ += increment;
+        return flush();
+    }
+
+    auto iter = streams_.find(stream_id);
+    if (iter == streams_.end())
+    {
+        if (stream_id > last_stream_id_)
+        {
+            return connectionError(ErrorCode::ProtocolError);
+        }
+        return;
+    }
+    if (increment == 0 || iter->second.send_window_ + increment > kMaxWindowSize)
+    {
+        return resetStream(stream_id, increment == 0 ? ErrorCode::ProtocolError : ErrorCode::FlowControlError);
+    }
+    iter->second.send_window_ += increment;
+    flush();
+}
+
+bool Http2Connection::makeRequest(uint32_t stream_id, std::vector<HttpHpackDecoder::Field>& fields, Request& request)
+{
+    request.stream_id_ = stream_id;
+    std::string scheme;
+    std::string authority;
+    bool has_host = false;
+    bool regular_seen = false;
+    for (auto& field : fields)
+    {
+        if (!field.name_.empty() && field.name_[0] == ':')
+        {
+            // pseudo-header fields come first, once each
+            std::string* target = nullptr;
+            if (field.name_ == ":method")
+            {
+                target = &request.method_;
+            }
+            else if (field.name_ == ":path")
+            {
+                target = &request.target_;
+            }
+            else if (field.name_ == ":scheme")
+            {
+                target = &scheme;
+            }
+            else if (field.name_ == ":authority")
+            {
+                target = &authority;
+            }
+            if (regular_seen || target == nullptr || !target->empty() || field.value_.empty())
+            {
+                return false;
+            }
+            *target = std::move(field.value_);
+            continue;
+        }
+
+        regular_seen = true;
+        if (field.name_.empty() ||
+            std::any_of(field.name_.begin(), field.name_.end(), [](char c) { return c >= 'A' && c <= 'Z'; }) ||
+            isConnectionField(field.name_) || (field.name_ == "te" && field.value_ != "trailers"))
+        {
+            return false;
+        }
+        has_host = has_host || field.name_ == "host";
+        request.headers_.push_back(std::move(field));
+    }
+
+    if (request.method_.empty() || request.target_.empty() || scheme.empty())
+    {
+        return false;
+    }
+    if (!has_host && !authority.empty())
+    {
+        request.headers_.push_back(HttpHpackDecoder::Field{"host", std::move(authority)});
+    }
+    return true;
+}
+
+void Http2Connection::completeRequest(uint32_t stream_id, Stream& stream)
+{
+    stream.remote_closed_ = true;
+    stream.request_.stream_id_ = stream_id;
+    requests_.push_back(std::move(stream.request_));
+    stream.request_ = Request();
+}
+
+void Http2Connection::flush()
+{
+    // bodies go out in stream order while the connection window lasts
+    for (auto iter = streams_.begin(); iter != streams_.end() && send_window_ > 0;)
+    {
+        auto& stream = iter->second;
+        if (!stream.responding_)
+        {
+            ++iter;
+            continue;
+        }
+
+        const auto& body = stream.body();
+        while (send_window_ > 0 && stream.send_window_ > 0 && stream.body_offset_ < body.size())
+        {
+            auto size = std::min(body.size() - stream.body_offset_, peer_max_frame_size_);
+            size = static_cast<std::size_t>(std::min<int64_t>(static_cast<int64_t>(size), std::min(send_window_, stream.send_window_)));
+            auto last = stream.body_offset_ + size == body.size();
+            writeFrameHeader(size, FrameType::Data, last ? kFlagEndStream : 0, iter->first);
+            output_.append(body, stream.body_offset_, size);
+            stream.body_offset_ += size;
+            send_window_ -= static_cast<int64_t>(size);
+            stream.send_window_ -= static_cast<int64_t>(size);
+        }
+
+        if (stream.body_offset_ == body.size())
+        {
+            iter = streams_.erase(iter);
+        }
+        else
+        {
+            ++iter;
+        }
+    }
+}
+
+void Http2Connection::resetStream(uint32_t stream_id, ErrorCode error_code)
+{
+    writeFrameHeader(4, FrameType::RstStream, 0, stream_id);
+    appendUint32(static_cast<uint32_t>(error_code), output_);
+
+    auto iter = streams_.find(stream_id);
+    if (iter != streams_.end())
+    {
+        if (iter->second.remote_closed_)
+        {
+            resets_.push_back(stream_id);
+        }
+        streams_.erase(iter);
+    }
+}
+
+void Http2Connection::connectionError(ErrorCode error_code)
+{
+    if (error_)
+    {
+        return;
+    }
+
+    error_ = true;
+    writeFrameHeader(8, FrameType::GoAway, 0, 0);
+    appendUint32(last_stream_id_, output_);
+    appendUint32(static_cast<uint32_t>(error_code), output_);
+    for (const auto& stream : streams_)
+    {
+        if (stream.second.remote_closed_)
+        {
+            resets_.push_back(stream.first);
+        }
+    }
+    streams_.clear();
+}
+
+void Http2Connection::writeFrameHeader(std::size_t size, FrameType type, uint8_t flags, uint32_t stream_id)
+{
+    output_.push_back(static_cast<char>(size >> 16));
+    output_.push_back(static_cast<char>(size >> 8));
+    output_.push_back(static_cast<char>(size));
+    output_.push_back(static_cast<char>(type));
+    output_.push_back(static_cast<char>(flags));
+    appendUint32(stream_id, output_);
+}
+
+void Http2Connection::writeWindowUpdate(uint32_t stream_id, uint32_t increment)
+{
+    writeFrameHeader(4, FrameType::WindowUpdate, 0, stream_id);
+    appendUint32(increment, output_);
+}
+
+}  // namespace server
+}  // namespace http
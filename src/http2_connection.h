@@ -0,0 +1,228 @@
+/**
+ * @brief Http HTTP/2 connection Define
+ * @file http2_connection.h
+ * @copyright Licensed under the Apache License, Version 2.0
+ */
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+#include "http_hpack.h"
+
+namespace http
+{
+namespace server
+{
+
+/**
+ * @brief the framing layer of a cleartext HTTP/2 (RFC 9113) connection on the server side, without io
+ * @note the session feeds the received bytes with receive(), takes the complete requests with popRequest()
+ * and hands each response to respond(), the frames to send collect in an output buffer. A stream lives from
+ * its HEADERS until its response is sent or it is reset, requests are only complete once the client ends
+ * the stream. Received data is acknowledged with WINDOW_UPDATE as soon as it is buffered, response bodies
+ * wait for the windows of the peer.
+ */
+class Http2Connection
+{
+public:
+    struct Request
+    {
+        uint32_t stream_id_{0};
+        std::string method_;
+        std::string target_;  // :path
+        std::vector<HttpHpackDecoder::Field> headers_;  // the regular fields, with host from :authority
+        std::string body_;
+    };
+
+    /**
+     * @param [in] max_concurrent_streams: streams a client can open at once, more are refused
+     * @param [in] max_request_size: request body limit, a stream sending more is reset
+     */
+    Http2Connection(uint32_t max_concurrent_streams, std::size_t max_request_size);
+
+    Http2Connection(const Http2Connection&) = delete;
+    Http2Connection& operator=(const Http2Connection&) = delete;
+
+    static constexpr std::size_t kPrefaceSize = 24;
+
+    /**
+     * @brief return whether data matches the client connection preface so far, a match of kPrefaceSize bytes
+     * or more is a HTTP/2 client
+     */
+    static bool matchPreface(const char* data, std::size_t size);
+
+    /**
+     * @brief start as the upgrade of an HTTP/1.1 request, which becomes stream 1
+     * @param [in] http2_settings: the HTTP2-Settings header of the request
+     * @return false if the settings are malformed, nothing is changed then
+     */
+    bool upgrade(const std::string& http2_settings, Request&& request);
+
+    /**
+     * @brief process the complete frames at the start of data
+     * @return the bytes consumed, the rest is an incomplete frame to be passed again with more data
+     */
+    std::size_t receive(const char* data, std::size_t size);
+
+    /**
+     * @brief take the next complete request
+     */
+    bool popRequest(Request& request);
+
+    /**
+     * @brief take the next stream reset after its request was taken, its response would be dropped
+     */
+    bool popReset(uint32_t& stream_id);
+
+    /**
+     * @brief queue the response of a stream, the body follows as the flow control windows allow
+     * @return false if the stream is gone, such as reset by the client
+     */
+    bool respond(uint32_t stream_id,
+                 unsigned int status,
+                 const std::vector<std::pair<std::string, std::string>>& fields,
+                 std::string&& body);
+
+    /**
+     * @brief queue the response of a stream with a body shared by other responses, it's held until it is sent
+     * @return false if the stream is gone, such as reset by the client
+     */
+    bool respond(uint32_t stream_id,
+                 unsigned int status,
+                 const std::vector<std::pair<std::string, std::string>>& fields,
+                 const std::shared_ptr<const std::string>& body);
+
+    /**
+     * @brief send GOAWAY, new streams are refused and the connection is closed once the open ones finish
+     */
+    void goAway();
+
+    /**
+     * @brief append the frames to send to output
+     */
+    void takeOutput(std::string& output);
+
+    /**
+     * @brief return whether nothing but the output is left to do, after GOAWAY or a connection error
+     */
+    bool closed() const
+    {
+        return error_ || ((going_away_ || peer_going_away_) && streams_.empty());
+    }
+
+    /**
+     * @brief return whether the connection failed with a protocol error
+     */
+    bool failed() const
+    {
+        return error_;
+    }
+
+    /**
+     * @brief return the open streams, including the ones waiting for their response
+     */
+    std::size_t streamCount() const
+    {
+        return streams_.size();
+    }
+
+private:
+    enum class FrameType : uint8_t
+    {
+        Data = 0x0,
+        Headers = 0x1,
+        Priority = 0x2,
+        RstStream = 0x3,
+        Settings = 0x4,
+        PushPromise = 0x5,
+        Ping = 0x6,
+        GoAway = 0x7,
+        WindowUpdate = 0x8,
+        Continuation = 0x9,
+    };
+
+    enum class ErrorCode : uint32_t
+    {
+        NoError = 0x0,
+        ProtocolError = 0x1,
+        InternalError = 0x2,
+        FlowControlError = 0x3,
+        StreamClosed = 0x5,
+        FrameSizeError = 0x6,
+        RefusedStream = 0x7,
+        Cancel = 0x8,
+        CompressionError = 0x9,
+    };
+
+    struct Stream
+    {
+        int64_t send_window_;
+        int64_t recv_window_;
+        bool remote_closed_;  // the client ended the stream, the request is complete
+        bool responding_;  // the response header is sent, body_ is being sent
+        Request request_;
+        std::string body_;  // response body
+        std::shared_ptr<const std::string> shared_body_;  // response body shared by other responses, instead of body_
+        std::size_t body_offset_;  // sent bytes of the body
+
+        const std::string& body() const
+        {
+            return shared_body_ ? *shared_body_ : body_;
+        }
+    };
+
+    void onFrame(FrameType type, uint8_t flags, uint32_t stream_id, const uint8_t* payload, std::size_t size);
+    void onData(uint8_t flags, uint32_t stream_id, const uint8_t* payload, std::size_t size);
+    void onHeaders(uint8_t flags, uint32_t stream_id, const uint8_t* payload, std::size_t size);
+    void onContinuation(uint8_t flags, uint32_t stream_id, const uint8_t* payload, std::size_t size);
+    void onHeaderBlock();
+    void onRstStream(uint32_t stream_id, const uint8_t* payload, std::size_t size);
+    void onSettings(uint8_t flags, uint32_t stream_id, const uint8_t* payload, std::size_t size);
+    void onPing(uint8_t flags, uint32_t stream_id, const uint8_t* payload, std::size_t size);
+    void onGoAway(uint32_t stream_id, std::size_t size);
+    void onWindowUpdate(uint32_t stream_id, const uint8_t* payload, std::size_t size);
+    bool applySettings(const uint8_t* payload, std::size_t size);
+    bool makeRequest(uint32_t stream_id, std::vector<HttpHpackDecoder::Field>& fields, Request& request);
+    void completeRequest(uint32_t stream_id, Stream& stream);
+    bool queueResponse(uint32_t stream_id,
+                       unsigned int status,
+                       const std::vector<std::pair<std::string, std::string>>& fields,
+                       std::string&& body,
+                       const std::shared_ptr<const std::string>& shared_body);
+    void flush();
+    void resetStream(uint32_t stream_id, ErrorCode error_code);
+    void connectionError(ErrorCode error_code);
+    void writeFrameHeader(std::size_t size, FrameType type, uint8_t flags, uint32_t stream_id);
+    void writeWindowUpdate(uint32_t stream_id, uint32_t increment);
+
+    uint32_t max_concurrent_streams_;
+    std::size_t max_request_size_;
+    HttpHpackDecoder decoder_;
+    std::map<uint32_t, Stream> streams_;  // by id, also the order response bodies are sent in
+    std::deque<Request> requests_;  // complete requests not taken yet
+    std::deque<uint32_t> resets_;  // streams reset after their request was taken, by the client or an error
+    std::string output_;
+    std::string header_block_;  // fragments of the header block being received
+    std::vector<HttpHpackDecoder::Field> fields_;  // decoded fields of the last header block
+    uint32_t header_stream_id_;  // stream of header_block_, 0 when no CONTINUATION is expected
+    bool header_end_stream_;  // the HEADERS of header_block_ ended the stream
+    uint32_t last_stream_id_;  // the highest stream id opened by the client
+    int64_t send_window_;  // connection flow control window of the peer
+    int64_t recv_window_;  // connection flow control window announced to the peer
+    int64_t peer_initial_window_;  // SETTINGS_INITIAL_WINDOW_SIZE of the peer
+    std::size_t peer_max_frame_size_;  // SETTINGS_MAX_FRAME_SIZE of the peer
+    bool preface_received_;
+    bool settings_received_;
+    bool going_away_;  // GOAWAY sent
+    bool peer_going_away_;  // GOAWAY received
+    bool error_;  // a connection error was sent, nothing more is received
+};
+
+}  // namespace server
+}  // namespace http
@@ -0,0 +1,70 @@
+#include <algorithm>
+#include <cstring>
+#include "http_arena.h"
+#include "http_recycling_allocator.h"
+
+namespace http
+{
+namespace server
+{
+namespace
+{
+const std::size_t kMinBlockSize = 256;
+}  // namespace
+
+HttpArena::HttpArena(std::size_t first_block_size)
+    : blocks_()
+    , cursor_(nullptr)
+    , remaining_(0)
+    , next_block_size_(std::max(first_block_size, kMinBlockSize))
+    , mutex_()
+{
+}
+
+HttpArena::~HttpArena()
+{
+    for (auto& block : blocks_)
+    {
+        HttpRecyclingPool::deallocate(block.data_, block.size_);
+    }
+}
+
+const char* HttpArena::copy(const char* data, std::size_t size)
+{
+    if (size == 0)
+    {
+        return "";
+    }
+
+    auto target = allocate(size + 1);
+    std::memcpy(target, data, size);
+    target[size] = '\0';
+    return target;
+}
+
+char* HttpArena::allocate(std::size_t size)
+{
+    if (size > remaining_)
+    {
+        auto block_size = std::max(next_block_size_, size);
+        blocks_.reserve(blocks_.size() + 1);
+        blocks_.push_back(Block{static_cast<char*>(HttpRecyclingPool::allocate(block_size)), block_size});
+        cursor_ = blocks_.back().data_;
+        remaining_ = block_size;
+        next_block_size_ = block_size * 2;
+    }
+
+    auto result = cursor_;
+    cursor_ += size;
+    remaining_ -= size;
+    return result;
+}
+
+char* HttpArena::allocateShared(std::size_t size)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return allocate(size);
+}
+
+}  // namespace server
+}  // namespace http
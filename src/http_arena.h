@@ -0,0 +1,62 @@
+/**
+ * @brief Http arena Define
+ * @file http_arena.h
+ * @copyright Licensed under the Apache License, Version 2.0
+ */
+
+#pragma once
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+namespace http
+{
+namespace server
+{
+
+/**
+ * @brief monotonic byte arena of one request, memory is only released when the arena is destroyed
+ * @note blocks come from HttpRecyclingPool, the first one is sized by the caller's estimate and later
+ * ones double, so a request whose estimate is right needs a single block.
+ */
+class HttpArena
+{
+public:
+    explicit HttpArena(std::size_t first_block_size);
+    ~HttpArena();
+
+    HttpArena(const HttpArena&) = delete;
+    HttpArena& operator=(const HttpArena&) = delete;
+
+    /**
+     * @brief copy size bytes into the arena followed by a NUL, return the copy
+     */
+    const char* copy(const char* data, std::size_t size);
+
+    /**
+     * @brief return size uninitialized bytes, without alignment
+     */
+    char* allocate(std::size_t size);
+
+    /**
+     * @brief same as allocate, but may be called by several threads at once once the request is built,
+     * as when copies of one request decode their parameters on different threads
+     */
+    char* allocateShared(std::size_t size);
+
+private:
+    struct Block
+    {
+        char* data_;
+        std::size_t size_;
+    };
+
+    std::vector<Block> blocks_;
+    char* cursor_;
+    std::size_t remaining_;
+    std::size_t next_block_size_;
+    std::mutex mutex_;
+};
+
+}  // namespace server
+}  // namespace http
@@ -0,0 +1,64 @@
+/**
+ * @brief Http canned response Define
+ * @file http_canned_response.h
+ * @copyright Licensed under the Apache License, Version 2.0
+ */
+
+#pragma once
+#include "http_common.h"
+
+namespace http
+{
+namespace server
+{
+
+/**
+ * @brief pre-serialized responses for the load shedding and rate limit fast paths, they are written
+ * straight to the socket without routing, HttpResponse construction or allocation.
+ */
+class HttpCannedResponse
+{
+public:
+    /**
+     * @brief 503 response, keep_alive false adds "Connection: close"
+     */
+    static net::const_buffer serviceUnavailable(bool keep_alive)
+    {
+        static const char keep_alive_rsp[] =
+            "HTTP/1.1 503 Service Unavailable\r\n"
+            "Retry-After: 1\r\n"
+            "Content-Length: 0\r\n"
+            "\r\n";
+        static const char close_rsp[] =
+            "HTTP/1.1 503 Service Unavailable\r\n"
+            "Connection: close\r\n"
+            "Retry-After: 1\r\n"
+            "Content-Length: 0\r\n"
+            "\r\n";
+        return keep_alive ? net::buffer(keep_alive_rsp, sizeof(keep_alive_rsp) - 1)
+                          : net::buffer(close_rsp, sizeof(close_rsp) - 1);
+    }
+
+    /**
+     * @brief 429 response, keep_alive false adds "Connection: close"
+     */
+    static net::const_buffer tooManyRequests(bool keep_alive)
+    {
+        static const char keep_alive_rsp[] =
+            "HTTP/1.1 429 Too Many Requests\r\n"
+            "Retry-After: 1\r\n"
+            "Content-Length: 0\r\n"
+            "\r\n";
+        static const char close_rsp[] =
+            "HTTP/1.1 429 Too Many Requests\r\n"
+            "Connection: close\r\n"
+            "Retry-After: 1\r\n"
+            "Content-Length: 0\r\n"
+            "\r\n";
+        return keep_alive ? net::buffer(keep_alive_rsp, sizeof(keep_alive_rsp) - 1)
+                          : net::buffer(close_rsp, sizeof(close_rsp) - 1);
+    }
+};
+
+}  // namespace server
+}  // namespace http
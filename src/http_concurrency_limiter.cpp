@@ -0,0 +1,102 @@
+#include <algorithm>
+#include <cmath>
+#include "http_concurrency_limiter.h"
+
+namespace http
+{
+namespace server
+{
+namespace
+{
+const uint64_t kWindowSampleCnt = 100;    // samples per limit recalculation
+const double kLongLatencySmoothing = 0.05;  // ema factor of the long-term latency
+const double kLimitSmoothing = 0.2;         // ema factor of the estimated limit
+const double kMinGradient = 0.5;            // limit can shrink by half per window at most
+}  // namespace
+
+HttpConcurrencyLimiter::HttpConcurrencyLimiter(uint32_t initial_limit, uint32_t min_limit, uint32_t max_limit)
+    : initial_limit_(std::min(std::max(initial_limit, min_limit), max_limit))
+    , min_limit_(min_limit)
+    , max_limit_(max_limit)
+    , limit_(initial_limit_)
+    , estimated_limit_(initial_limit_)
+{
+}
+
+uint32_t HttpConcurrencyLimiter::limit() const
+{
+    return limit_.load(std::memory_order_relaxed);
+}
+
+void HttpConcurrencyLimiter::onSample(std::chrono::microseconds latency, uint64_t in_flight)
+{
+    sample_sum_us_.fetch_add(static_cast<uint64_t>(std::max<int64_t>(latency.count(), 0)), std::memory_order_relaxed);
+
+    auto max_in_flight = max_in_flight_.load(std::memory_order_relaxed);
+    while (in_flight > max_in_flight &&
+           !max_in_flight_.compare_exchange_weak(max_in_flight, in_flight, std::memory_order_relaxed))
+    {
+    }
+
+    if (sample_cnt_.fetch_add(1, std::memory_order_relaxed) + 1 < kWindowSampleCnt)
+    {
+        return;
+    }
+
+    // only one thread recalculates the limit, the others keep serving
+    std::unique_lock<std::mutex> lock(update_mutex_, std::try_to_lock);
+    if (!lock.owns_lock())
+    {
+        return;
+    }
+
+    auto sample_cnt = sample_cnt_.exchange(0, std::memory_order_relaxed);
+    if (sample_cnt == 0)
+    {
+        return;
+    }
+
+    update(sample_cnt,
+           sample_sum_us_.exchange(0, std::memory_order_relaxed),
+           max_in_flight_.exchange(0, std::memory_order_relaxed));
+}
+
+void HttpConcurrencyLimiter::reset()
+{
+    sample_cnt_.store(0);
+    sample_sum_us_.store(0);
+    max_in_flight_.store(0);
+    long_latency_us_ = 0;
+    estimated_limit_ = initial_limit_;
+    limit_.store(initial_limit_);
+}
+
+void HttpConcurrencyLimiter::update(uint64_t sample_cnt, uint64_t sample_sum_us, uint64_t max_in_flight)
+{
+    auto short_latency_us = std::max(1.0, static_cast<double>(sample_sum_us) / static_cast<double>(sample_cnt));
+    if (long_latency_us_ == 0)
+    {
+        long_latency_us_ = short_latency_us;
+    }
+    else
+    {
+        long_latency_us_ = long_latency_us_ * (1 - kLongLatencySmoothing) + short_latency_us * kLongLatencySmoothing;
+    }
+
+    auto gradient = std::max(kMinGradient, std::min(1.0, long_latency_us_ / short_latency_us));
+
+    // the handlers were not using the current limit, growing it would not be backed by any latency evidence
+    if (gradient >= 1.0 && static_cast<double>(max_in_flight) < estimated_limit_ / 2)
+    {
+        return;
+    }
+
+    auto queue_size = std::sqrt(estimated_limit_);
+    auto new_limit = estimated_limit_ * gradient + queue_size;
+    estimated_limit_ = estimated_limit_ * (1 - kLimitSmoothing) + new_limit * kLimitSmoothing;
+    estimated_limit_ = std::max<double>(min_limit_, std::min<double>(max_limit_, estimated_limit_));
+    limit_.store(static_cast<uint32_t>(std::lround(estimated_limit_)), std::memory_order_relaxed);
+}
+
+}  // namespace server
+}  // namespace http
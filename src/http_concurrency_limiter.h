@@ -0,0 +1,67 @@
+/**
+ * @brief Http concurrency limiter Define
+ * @file http_concurrency_limiter.h
+ * @copyright Licensed under the Apache License, Version 2.0
+ */
+
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+
+namespace http
+{
+namespace server
+{
+
+/**
+ * @brief adaptive in-flight handler limit based on the gradient of the handler latency
+ * @note the limit shrinks when the short-term latency rises above the long-term latency and
+ * grows by a small queue allowance while the latency stays flat, samples are collected lock free
+ * and the limit is recalculated once per window by whichever thread closes it.
+ */
+class HttpConcurrencyLimiter
+{
+public:
+    HttpConcurrencyLimiter(uint32_t initial_limit, uint32_t min_limit, uint32_t max_limit);
+    ~HttpConcurrencyLimiter() = default;
+
+    HttpConcurrencyLimiter(const HttpConcurrencyLimiter&) = delete;
+    HttpConcurrencyLimiter& operator=(const HttpConcurrencyLimiter&) = delete;
+
+    /**
+     * @brief current in-flight handler limit, threadsafe
+     */
+    uint32_t limit() const;
+
+    /**
+     * @brief record one finished handler, threadsafe
+     * @param [in] latency: time from dispatching the request to the handler sending the response
+     * @param [in] in_flight: in-flight handler count when the sample was taken
+     */
+    void onSample(std::chrono::microseconds latency, uint64_t in_flight);
+
+    /**
+     * @brief reset limiter to the initial limit, not threadsafe
+     */
+    void reset();
+
+private:
+    void update(uint64_t sample_cnt, uint64_t sample_sum_us, uint64_t max_in_flight);
+
+private:
+    const uint32_t initial_limit_;
+    const uint32_t min_limit_;
+    const uint32_t max_limit_;
+    std::atomic<uint32_t> limit_;
+    std::atomic<uint64_t> sample_cnt_{0};
+    std::atomic<uint64_t> sample_sum_us_{0};
+    std::atomic<uint64_t> max_in_flight_{0};
+    std::mutex update_mutex_;
+    double long_latency_us_{0};
+    double estimated_limit_;
+};
+
+}  // namespace server
+}  // namespace http
@@ -0,0 +1,65 @@
+#include "http_coroutine_adapter.h"
+
+#if defined(HTTP_SERVER_COROUTINE)
+#include <exception>
+#include <stdexcept>
+#include "httpserver/detail/http_log.h"
+#include "http_session.h"
+
+namespace http
+{
+namespace server
+{
+HttpCoroutineAdapter::HttpCoroutineAdapter(std::shared_ptr<CoroutineHandler> handler)
+    : handler_(std::move(handler))
+{
+}
+
+HttpCoroutineAdapter::~HttpCoroutineAdapter()
+{
+}
+
+void HttpCoroutineAdapter::handle(HttpRequest&& request, HttpResponseWriter&& response_writer) noexcept
+{
+    auto executor = response_writer.session_->executor();
+    // the completion holds the handler, the frame runs on its object until then
+    auto on_done = [response_writer, handler = handler_](std::exception_ptr exception) mutable
+    {
+        if (!exception)
+        {
+            return;
+        }
+
+        try
+        {
+            std::rethrow_exception(exception);
+        }
+        catch (const std::exception& e)
+        {
+            LOG_LOGGER_ERROR(fmt::format("coroutine handler fail: {}", e.what()));
+        }
+        catch (...)
+        {
+            LOG_LOGGER_ERROR("coroutine handler fail: unknown exception");
+        }
+        // ignored if the handler already answered the request
+        response_writer.send(HttpResponse(StatusType::Internal_Server_Error, "internal server error", "text/plain"));
+    };
+
+    try
+    {
+        // the frame starts suspended and is first resumed by a post to the strand, after processRequest returns
+        net::co_spawn(executor,
+                      handler_->handle(std::move(request), response_writer),
+                      makeAllocHandler(std::move(on_done)));
+    }
+    catch (const std::exception& e)
+    {
+        LOG_LOGGER_ERROR(fmt::format("spawn coroutine handler fail: {}", e.what()));
+        response_writer.send(HttpResponse(StatusType::Internal_Server_Error, "internal server error", "text/plain"));
+    }
+}
+
+}  // namespace server
+}  // namespace http
+#endif
@@ -0,0 +1,35 @@
+/**
+ * @brief Http coroutine handler adapter Define
+ * @file http_coroutine_adapter.h
+ * @copyright Licensed under the Apache License, Version 2.0
+ */
+
+#pragma once
+#include <memory>
+#include <httpserver/http_server.h>
+
+#if defined(HTTP_SERVER_COROUTINE)
+namespace http
+{
+namespace server
+{
+
+/**
+ * @brief routes requests to a CoroutineHandler, each call spawns the coroutine on the strand of the connection
+ * @note a running coroutine keeps the handler alive, so a route removed meanwhile doesn't free it under the frame
+ */
+class HttpCoroutineAdapter final : public APIHandler
+{
+public:
+    explicit HttpCoroutineAdapter(std::shared_ptr<CoroutineHandler> handler);
+    ~HttpCoroutineAdapter();
+
+    void handle(HttpRequest&& request, HttpResponseWriter&& response_writer) noexcept override;
+
+private:
+    std::shared_ptr<CoroutineHandler> handler_;
+};
+
+}  // namespace server
+}  // namespace http
+#endif
@@ -0,0 +1,48 @@
+#include <cstdio>
+#include "http_date.h"
+
+namespace http
+{
+namespace server
+{
+namespace
+{
+const char* const kWeekDays[] = {"Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat"};
+const char* const kMonths[] = {"Jan", "Feb", "Mar", "Apr", "May", "Jun", "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"};
+}  // namespace
+
+const std::string& HttpDate::now()
+{
+    thread_local std::time_t t_cached_time = -1;
+    thread_local std::string t_cached_date;
+
+    auto time = std::time(nullptr);
+    if (time != t_cached_time)
+    {
+        t_cached_time = time;
+        t_cached_date = format(time);
+    }
+    return t_cached_date;
+}
+
+std::string HttpDate::format(std::time_t time)
+{
+    std::tm tm{};
+    gmtime_r(&time, &tm);
+
+    char buffer[32];
+    auto size = std::snprintf(buffer,
+                              sizeof(buffer),
+                              "%s, %02d %s %04d %02d:%02d:%02d GMT",
+                              kWeekDays[tm.tm_wday],
+                              tm.tm_mday,
+                              kMonths[tm.tm_mon],
+                              tm.tm_year + 1900,
+                              tm.tm_hour,
+                              tm.tm_min,
+                              tm.tm_sec);
+    return std::string(buffer, static_cast<std::size_t>(size));
+}
+
+}  // namespace server
+}  // namespace http
@@ -0,0 +1,34 @@
+/**
+ * @brief Http date Define
+ * @file http_date.h
+ * @copyright Licensed under the Apache License, Version 2.0
+ */
+
+#pragma once
+#include <ctime>
+#include <string>
+
+namespace http
+{
+namespace server
+{
+
+/**
+ * @brief IMF-fixdate value of the Date header, such as "Sun, 06 Nov 1994 08:49:37 GMT"
+ */
+class HttpDate
+{
+public:
+    /**
+     * @brief current date, cached per thread and formatted again only when the second changes
+     */
+    static const std::string& now();
+
+    /**
+     * @brief format the time, independent of the locale
+     */
+    static std::string format(std::time_t time);
+};
+
+}  // namespace server
+}  // namespace http
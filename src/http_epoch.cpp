@@ -0,0 +1,116 @@
+#include <algorithm>
+#include <limits>
+#include "http_epoch.h"
+
+namespace http
+{
+namespace server
+{
+namespace
+{
+std::atomic<uint64_t> s_domain_id{0};
+}  // namespace
+
+HttpEpochDomain::Guard::Guard(HttpEpochDomain& domain)
+    : epoch_(&domain.threadSlot())
+{
+    if (epoch_->load(std::memory_order_relaxed) != 0)
+    {
+        epoch_ = nullptr;
+        return;
+    }
+
+    // seq_cst orders the store before the loads of the published data, a writer bumping the epoch after
+    // this point either sees the slot or published before the data is loaded
+    epoch_->store(domain.epoch_.load(std::memory_order_seq_cst), std::memory_order_seq_cst);
+}
+
+HttpEpochDomain::Guard::~Guard()
+{
+    if (epoch_ != nullptr)
+    {
+        epoch_->store(0, std::memory_order_release);
+    }
+}
+
+HttpEpochDomain::Guard::Guard(Guard&& other) noexcept
+    : epoch_(other.epoch_)
+{
+    other.epoch_ = nullptr;
+}
+
+HttpEpochDomain::HttpEpochDomain()
+    : id_(++s_domain_id)
+    , epoch_(1)
+    , mutex_()
+    , slots_()
+    , retired_()
+{
+}
+
+HttpEpochDomain::~HttpEpochDomain()
+{
+}
+
+void HttpEpochDomain::retire(std::shared_ptr<const void> object)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    // readers entering from now on are past the unpublish, the object waits for the ones before
+    auto epoch = epoch_.fetch_add(1, std::memory_order_seq_cst) + 1;
+    retired_.emplace_back(epoch, std::move(object));
+}
+
+std::size_t HttpEpochDomain::reclaim()
+{
+    std::vector<std::pair<uint64_t, std::shared_ptr<const void>>> freed;  // destroyed without the lock
+    std::size_t waiting_cnt = 0;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (retired_.empty())
+        {
+            return 0;
+        }
+
+        auto oldest = std::numeric_limits<uint64_t>::max();
+        for (const auto& slot : slots_)
+        {
+            auto epoch = slot->epoch_.load(std::memory_order_seq_cst);
+            if (epoch != 0)
+            {
+                oldest = std::min(oldest, epoch);
+            }
+        }
+
+        // a reader of epoch e entered after every object retired at e or before was unpublished
+        auto end = std::find_if(retired_.begin(),
+                                retired_.end(),
+                                [oldest](const std::pair<uint64_t, std::shared_ptr<const void>>& retired)
+                                { return retired.first > oldest; });
+        freed.assign(std::make_move_iterator(retired_.begin()), std::make_move_iterator(end));
+        retired_.erase(retired_.begin(), end);
+        waiting_cnt = retired_.size();
+    }
+    return waiting_cnt;
+}
+
+std::atomic<uint64_t>& HttpEpochDomain::threadSlot()
+{
+    // a thread reads few domains, found by id, a slot is registered once per thread and domain
+    thread_local std::vector<std::pair<uint64_t, Slot*>> thread_slots;
+    for (const auto& thread_slot : thread_slots)
+    {
+        if (thread_slot.first == id_)
+        {
+            return thread_slot.second->epoch_;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    slots_.emplace_back(new Slot());
+    thread_slots.emplace_back(id_, slots_.back().get());
+    return slots_.back()->epoch_;
+}
+
+}  // namespace server
+}  // namespace http
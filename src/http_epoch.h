@@ -0,0 +1,90 @@
+/**
+ * @brief Http epoch based reclamation Define
+ * @file http_epoch.h
+ * @copyright Licensed under the Apache License, Version 2.0
+ */
+
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace http
+{
+namespace server
+{
+
+/**
+ * @brief frees data read by the io threads without locks once no reader can still see it, read-copy-update style
+ * @note a reader marks its thread with the current epoch for the time it uses the data. A writer publishes a new
+ * version, then retires the old one, which bumps the epoch. reclaim() frees a retired version once every thread
+ * which was reading before the bump has left its read section. A reader only stores to a slot of its own thread
+ * and never waits, the writer never waits for the readers either, it leaves the version to a later reclaim().
+ */
+class HttpEpochDomain
+{
+public:
+    /**
+     * @brief read section of the current thread, nested sections are part of the outer one
+     */
+    class Guard
+    {
+    public:
+        explicit Guard(HttpEpochDomain& domain);
+        ~Guard();
+        Guard(Guard&& other) noexcept;
+
+        Guard(const Guard&) = delete;
+        Guard& operator=(const Guard&) = delete;
+        Guard& operator=(Guard&&) = delete;
+
+    private:
+        std::atomic<uint64_t>* epoch_;  // the slot of the thread, nullptr if the section is nested
+    };
+
+    HttpEpochDomain();
+
+    /**
+     * @brief free the retired objects, no thread may be reading
+     */
+    ~HttpEpochDomain();
+
+    HttpEpochDomain(const HttpEpochDomain&) = delete;
+    HttpEpochDomain& operator=(const HttpEpochDomain&) = delete;
+
+    /**
+     * @brief free the object once the readers which may have seen it are gone, threadsafe
+     * @note call it after the object is unpublished, so readers starting later can't reach it
+     */
+    void retire(std::shared_ptr<const void> object);
+
+    /**
+     * @brief free the retired objects no reader can see anymore, threadsafe
+     * @return the count of retired objects still waiting
+     */
+    std::size_t reclaim();
+
+private:
+    struct Slot
+    {
+        std::atomic<uint64_t> epoch_{0};  // epoch of the read section, 0 means the thread isn't reading
+        char padding_[64 - sizeof(std::atomic<uint64_t>)];  // keep the slots of the threads apart
+    };
+
+    std::atomic<uint64_t>& threadSlot();
+
+private:
+    const uint64_t id_;  // a later domain may reuse the address, the slots of a thread are found by id
+    std::atomic<uint64_t> epoch_;
+    std::mutex mutex_;  // guards slots_ and retired_
+    std::deque<std::unique_ptr<Slot>> slots_;  // one per thread which ever read
+    std::vector<std::pair<uint64_t, std::shared_ptr<const void>>> retired_;  // by epoch of retirement, ascending
+};
+
+}  // namespace server
+}  // namespace http
@@ -0,0 +1,145 @@
+#include "http_event_stream.h"
+#include "http_session.h"
+#include <httpserver/detail/http_response.h>
+
+namespace http
+{
+namespace server
+{
+HttpEventStreamState::HttpEventStreamState(const std::shared_ptr<HttpSession>& session, std::size_t max_pending_size)
+    : mutex_()
+    , session_(session)
+    , max_pending_size_(max_pending_size)
+    , pending_()
+    , flush_posted_(false)
+    , closed_(false)
+    , dropped_(false)
+{
+}
+
+void HttpEventStreamState::formatEvent(const std::string& data,
+                                       const std::string& event,
+                                       const std::string& id,
+                                       std::string& out)
+{
+    if (!event.empty())
+    {
+        out.append("event: ").append(event).append("\n");
+    }
+    if (!id.empty())
+    {
+        out.append("id: ").append(id).append("\n");
+    }
+
+    // CRLF, CR and LF all end a line of the event stream
+    std::size_t line_begin = 0;
+    while (true)
+    {
+        auto line_end = data.find_first_of("\r\n", line_begin);
+        auto line_size = line_end == std::string::npos ? std::string::npos : line_end - line_begin;
+        out.append("data: ").append(data, line_begin, line_size).append("\n");
+        if (line_end == std::string::npos)
+        {
+            break;
+        }
+        line_begin = line_end + (data.compare(line_end, 2, "\r\n") == 0 ? 2 : 1);
+    }
+    out.append("\n");
+}
+
+HttpEventStream::HttpEventStream()
+    : state_()
+{
+}
+
+HttpEventStream::HttpEventStream(const std::shared_ptr<HttpEventStreamState>& state)
+    : state_(state)
+{
+}
+
+HttpEventStream::~HttpEventStream()
+{
+}
+
+bool HttpEventStream::send(const std::string& data, const std::string& event, const std::string& id)
+{
+    if (!state_ || event.find_first_of("\r\n") != std::string::npos || id.find_first_of("\r\n") != std::string::npos)
+    {
+        return false;
+    }
+
+    std::shared_ptr<HttpSession> session;
+    bool dropped = false;
+    {
+        std::lock_guard<std::mutex> lock(state_->mutex_);
+        if (state_->closed_)
+        {
+            return false;
+        }
+
+        HttpEventStreamState::formatEvent(data, event, id, state_->pending_);
+        if (state_->max_pending_size_ != 0 && state_->pending_.size() > state_->max_pending_size_)
+        {
+            // the client reads slower than events are sent
+            state_->pending_.clear();
+            state_->closed_ = true;
+            state_->dropped_ = true;
+            dropped = true;
+        }
+        if (state_->flush_posted_)
+        {
+            return !dropped;
+        }
+        state_->flush_posted_ = true;
+        session = state_->session_.lock();
+    }
+
+    if (session)
+    {
+        session->flushEventStream();
+    }
+    return !dropped;
+}
+
+void HttpEventStream::close()
+{
+    if (!state_)
+    {
+        return;
+    }
+
+    std::shared_ptr<HttpSession> session;
+    {
+        std::lock_guard<std::mutex> lock(state_->mutex_);
+        if (state_->closed_)
+        {
+            return;
+        }
+        state_->closed_ = true;
+        if (state_->flush_posted_)
+        {
+            return;
+        }
+        state_->flush_posted_ = true;
+        session = state_->session_.lock();
+    }
+
+    if (session)
+    {
+        session->flushEventStream();
+    }
+}
+
+bool HttpEventStream::isOpen() const
+{
+    if (!state_)
+    {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(state_->mutex_);
+    return !state_->closed_;
+}
+
+}  // namespace server
+}  // namespace http
@@ -0,0 +1,45 @@
+/**
+ * @brief Http Server-Sent Events stream Define
+ * @file http_event_stream.h
+ * @copyright Licensed under the Apache License, Version 2.0
+ */
+
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace http
+{
+namespace server
+{
+
+class HttpSession;
+
+/**
+ * @brief state shared by the copies of a HttpEventStream and the session writing it
+ * @note producers append formatted events to pending_ under the lock, and only the first event after the session
+ * took pending_ posts a flush to the session strand. Events sent while the flush is queued or a write is in
+ * flight join the next write.
+ */
+struct HttpEventStreamState
+{
+    HttpEventStreamState(const std::shared_ptr<HttpSession>& session, std::size_t max_pending_size);
+
+    /**
+     * @brief append an event in the text/event-stream format, a data line is written for each line of data
+     */
+    static void formatEvent(const std::string& data, const std::string& event, const std::string& id, std::string& out);
+
+    std::mutex mutex_;
+    std::weak_ptr<HttpSession> session_;
+    std::size_t max_pending_size_;  // 0 means unlimited
+    std::string pending_;  // events not taken by the session yet
+    bool flush_posted_;  // the session will take pending_, no need to post another flush
+    bool closed_;  // no more events are accepted, the connection closes once pending_ is written
+    bool dropped_;  // closed because pending_ grew over max_pending_size_, pending_ is discarded
+};
+
+}  // namespace server
+}  // namespace http
@@ -0,0 +1,477 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include "http_fast_parser.h"
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define HTTP_FAST_PARSER_X86 1
+#include <immintrin.h>
+#endif
+
+namespace http
+{
+namespace server
+{
+namespace
+{
+// each scanner returns the first byte in [p, end) which doesn't belong to its class, or end
+using ScanFunction = const char* (*)(const char* p, const char* end);
+
+struct Scanners
+{
+    ScanFunction token_;   // tchar of RFC 7230, methods and header names
+    ScanFunction target_;  // visible ascii
+    ScanFunction value_;   // header value: HTAB, SP, visible ascii and obs-text
+};
+
+struct CharTables
+{
+    bool token_[256];
+    bool target_[256];
+    bool value_[256];
+
+    CharTables()
+    {
+        for (int c = 0; c < 256; ++c)
+        {
+            token_[c] = (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+                        (c != 0 && std::strchr("!#$%&'*+-.^_`|~", c) != nullptr);
+            target_[c] = c > 0x20 && c < 0x7f;
+            value_[c] = c == '\t' || (c >= 0x20 && c != 0x7f);
+        }
+    }
+};
+
+const CharTables kTables;
+
+const char* scanScalar(const bool* table, const char* p, const char* end)
+{
+    while (p != end && table[static_cast<unsigned char>(*p)])
+    {
+        ++p;
+    }
+    return p;
+}
+
+const char* scanTokenScalar(const char* p, const char* end)
+{
+    return scanScalar(kTables.token_, p, end);
+}
+
+const char* scanTargetScalar(const char* p, const char* end)
+{
+    return scanScalar(kTables.target_, p, end);
+}
+
+const char* scanValueScalar(const char* p, const char* end)
+{
+    return scanScalar(kTables.value_, p, end);
+}
+
+#ifdef HTTP_FAST_PARSER_X86
+/**
+ * @brief finds the first byte inside one of the ranges 16 bytes at a time, the ranges may be wider than
+ * the class to fit the 8 range limit of pcmpestri, so candidates are confirmed with the table
+ */
+template <int RangesSize>
+__attribute__((target("sse4.2"))) const char* scanSse42(const char (&ranges)[17],
+                                                        const bool* table,
+                                                        const char* p,
+                                                        const char* end)
+{
+    const auto ranges_vector = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ranges));
+    while (end - p >= 16)
+    {
+        auto chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        auto index = _mm_cmpestri(ranges_vector,
+                                  RangesSize,
+                                  chunk,
+                                  16,
+                                  _SIDD_LEAST_SIGNIFICANT | _SIDD_CMP_RANGES | _SIDD_UBYTE_OPS);
+        if (index == 16)
+        {
+            p += 16;
+            continue;
+        }
+
+        p += index;
+        if (!table[static_cast<unsigned char>(*p)])
+        {
+            return p;
+        }
+        ++p;
+    }
+    return scanScalar(table, p, end);
+}
+
+// padded to 16 bytes, the size template argument tells pcmpestri how many are used
+const char kTokenRanges[17] = "\x00 \"\"()" ",,//:@[]{\xff";
+const char kTargetRanges[17] = "\x00 \x7f\xff";
+const char kValueRanges[17] = "\x00\x08\x0a\x1f\x7f\x7f";
+
+__attribute__((target("sse4.2"))) const char* scanTokenSse42(const char* p, const char* end)
+{
+    return scanSse42<16>(kTokenRanges, kTables.token_, p, end);
+}
+
+__attribute__((target("sse4.2"))) const char* scanTargetSse42(const char* p, const char* end)
+{
+    return scanSse42<4>(kTargetRanges, kTables.target_, p, end);
+}
+
+__attribute__((target("sse4.2"))) const char* scanValueSse42(const char* p, const char* end)
+{
+    return scanSse42<6>(kValueRanges, kTables.value_, p, end);
+}
+
+__attribute__((target("avx2"))) inline const char* firstSet(const char* p, uint32_t mask)
+{
+    return p + __builtin_ctz(mask);
+}
+
+__attribute__((target("avx2"))) const char* scanTargetAvx2(const char* p, const char* end)
+{
+    // bytes >= 0x80 are negative as signed, so "less than 0x21" also catches them
+    const auto limit = _mm256_set1_epi8(0x21);
+    const auto del = _mm256_set1_epi8(0x7f);
+    while (end - p >= 32)
+    {
+        auto chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        auto invalid = _mm256_or_si256(_mm256_cmpgt_epi8(limit, chunk), _mm256_cmpeq_epi8(chunk, del));
+        auto mask = static_cast<uint32_t>(_mm256_movemask_epi8(invalid));
+        if (mask != 0)
+        {
+            return firstSet(p, mask);
+        }
+        p += 32;
+    }
+    return scanTargetSse42(p, end);
+}
+
+__attribute__((target("avx2"))) const char* scanValueAvx2(const char* p, const char* end)
+{
+    // control characters except HTAB, and DEL, obs-text is allowed
+    const auto space = _mm256_set1_epi8(0x20);
+    const auto minus_one = _mm256_set1_epi8(-1);
+    const auto tab = _mm256_set1_epi8('\t');
+    const auto del = _mm256_set1_epi8(0x7f);
+    while (end - p >= 32)
+    {
+        auto chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        auto control = _mm256_and_si256(_mm256_cmpgt_epi8(space, chunk), _mm256_cmpgt_epi8(chunk, minus_one));
+        control = _mm256_andnot_si256(_mm256_cmpeq_epi8(chunk, tab), control);
+        auto invalid = _mm256_or_si256(control, _mm256_cmpeq_epi8(chunk, del));
+        auto mask = static_cast<uint32_t>(_mm256_movemask_epi8(invalid));
+        if (mask != 0)
+        {
+            return firstSet(p, mask);
+        }
+        p += 32;
+    }
+    return scanValueSse42(p, end);
+}
+#endif
+
+const Scanners kScanners[] = {
+    {scanTokenScalar, scanTargetScalar, scanValueScalar},
+#ifdef HTTP_FAST_PARSER_X86
+    {scanTokenSse42, scanTargetSse42, scanValueSse42},
+    {scanTokenSse42, scanTargetAvx2, scanValueAvx2},
+#endif
+};
+
+HttpFastParser::Implementation detectBest()
+{
+#ifdef HTTP_FAST_PARSER_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+    {
+        return HttpFastParser::Implementation::Avx2;
+    }
+    if (__builtin_cpu_supports("sse4.2"))
+    {
+        return HttpFastParser::Implementation::Sse42;
+    }
+#endif
+    return HttpFastParser::Implementation::Scalar;
+}
+
+const HttpFastParser::Implementation kBest = detectBest();
+
+HttpFastParser::Result parseVersion(const char*& p, const char* end, unsigned& version)
+{
+    static const char kPrefix[] = "HTTP/1.";
+    const std::size_t prefix_size = sizeof(kPrefix) - 1;
+    auto available = static_cast<std::size_t>(end - p);
+    if (std::memcmp(p, kPrefix, std::min(available, prefix_size)) != 0)
+    {
+        return HttpFastParser::Result::Invalid;
+    }
+    if (available < prefix_size + 3)
+    {
+        return HttpFastParser::Result::Incomplete;
+    }
+
+    auto minor = p[prefix_size];
+    if ((minor != '0' && minor != '1') || p[prefix_size + 1] != '\r' || p[prefix_size + 2] != '\n')
+    {
+        return HttpFastParser::Result::Invalid;
+    }
+    version = minor == '1' ? 11 : 10;
+    p += prefix_size + 3;
+    return HttpFastParser::Result::Complete;
+}
+
+/**
+ * @brief the beast parser validates the value of the headers it interprets while parsing, these are only
+ * accepted when the fast path can't disagree with it: a Connection list of plain tokens, and no Upgrade
+ */
+bool acceptHeader(HttpStringView name, HttpStringView value)
+{
+    if (name.size() == 7 && name.iequals("Upgrade"))
+    {
+        return false;
+    }
+    if ((name.size() == 10 && name.iequals("Connection")) || (name.size() == 16 && name.iequals("Proxy-Connection")))
+    {
+        // comma separated tokens with optional whitespace around the commas
+        auto p = value.begin();
+        while (p != value.end())
+        {
+            while (p != value.end() && (*p == ' ' || *p == '\t'))
+            {
+                ++p;
+            }
+            while (p != value.end() && kTables.token_[static_cast<unsigned char>(*p)])
+            {
+                ++p;
+            }
+            while (p != value.end() && (*p == ' ' || *p == '\t'))
+            {
+                ++p;
+            }
+            if (p != value.end() && *p++ != ',')
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+HttpFastParser::Result parseWith(const Scanners& scanners,
+                                 const char* data,
+                                 std::size_t size,
+                                 HttpFastParser::Request& request)
+{
+    using Result = HttpFastParser::Result;
+    const char* p = data;
+    const char* end = data + size;
+    request.headers_.clear();
+
+    // request line
+    auto method_end = scanners.token_(p, end);
+    if (method_end == end)
+    {
+        return Result::Incomplete;
+    }
+    if (method_end == p || *method_end != ' ')
+    {
+        return Result::Invalid;
+    }
+    request.method_ = HttpStringView(p, static_cast<std::size_t>(method_end - p));
+    p = method_end + 1;
+
+    auto target_end = scanners.target_(p, end);
+    if (target_end == end)
+    {
+        return Result::Incomplete;
+    }
+    if (target_end == p || *target_end != ' ')
+    {
+        return Result::Invalid;
+    }
+    request.target_ = HttpStringView(p, static_cast<std::size_t>(target_end - p));
+    p = target_end + 1;
+
+    auto result = parseVersion(p, end, request.version_);
+    if (result != Result::Complete)
+    {
+        return result;
+    }
+
+    // headers, up to the empty line
+    while (true)
+    {
+        if (p == end)
+        {
+            return Result::Incomplete;
+        }
+        if (*p == '\r')
+        {
+            if (p + 1 == end)
+            {
+                return Result::Incomplete;
+            }
+            if (p[1] != '\n')
+            {
+                return Result::Invalid;
+            }
+            p += 2;
+            break;
+        }
+
+        // an obs-fold line starts with whitespace and ends up here as an empty name
+        auto name_end = scanners.token_(p, end);
+        if (name_end == end)
+        {
+            return Result::Incomplete;
+        }
+        if (name_end == p || *name_end != ':')
+        {
+            return Result::Invalid;
+        }
+
+        auto value = name_end + 1;
+        while (value != end && (*value == ' ' || *value == '\t'))
+        {
+            ++value;
+        }
+        auto value_end = scanners.value_(value, end);
+        if (value_end == end || value_end + 1 == end)
+        {
+            return Result::Incomplete;
+        }
+        if (value_end[0] != '\r' || value_end[1] != '\n')
+        {
+            return Result::Invalid;
+        }
+
+        auto trimmed_end = value_end;
+        while (trimmed_end != value && (trimmed_end[-1] == ' ' || trimmed_end[-1] == '\t'))
+        {
+            --trimmed_end;
+        }
+        HttpStringView name(p, static_cast<std::size_t>(name_end - p));
+        HttpStringView trimmed_value(value, static_cast<std::size_t>(trimmed_end - value));
+        if (!acceptHeader(name, trimmed_value))
+        {
+            return Result::Invalid;
+        }
+        request.headers_.push_back({name, trimmed_value});
+        p = value_end + 2;
+    }
+
+    request.header_size_ = static_cast<std::size_t>(p - data);
+    return Result::Complete;
+}
+}  // namespace
+
+HttpFastParser::Result HttpFastParser::parse(const char* data, std::size_t size, Request& request)
+{
+    return parseWith(kScanners[static_cast<int>(kBest)], data, size, request);
+}
+
+HttpFastParser::Result HttpFastParser::parse(const char* data,
+                                             std::size_t size,
+                                             Request& request,
+                                             Implementation implementation)
+{
+    return parseWith(kScanners[static_cast<int>(implementation)], data, size, request);
+}
+
+bool HttpFastParser::contentLength(const Request& request, uint64_t& content_length)
+{
+    auto found = false;
+    content_length = 0;
+    for (const auto& header : request.headers_)
+    {
+        if (header.name_.iequals("Transfer-Encoding"))
+        {
+            return false;
+        }
+        if (!header.name_.iequals("Content-Length"))
+        {
+            continue;
+        }
+
+        // one plain decimal value, small enough to never overflow
+        if (found || header.value_.empty() || header.value_.size() > 18)
+        {
+            return false;
+        }
+        for (auto c : header.value_)
+        {
+            if (c < '0' || c > '9')
+            {
+                return false;
+            }
+            content_length = content_length * 10 + static_cast<uint64_t>(c - '0');
+        }
+        found = true;
+    }
+    return true;
+}
+
+bool HttpFastParser::keepAlive(const Request& request)
+{
+    // same as beast: the first Connection header decides, HTTP/1.1 defaults to keep-alive
+    for (const auto& header : request.headers_)
+    {
+        if (!header.name_.iequals("Connection"))
+        {
+            continue;
+        }
+
+        auto token = request.version_ == 11 ? HttpStringView("close") : HttpStringView("keep-alive");
+        auto p = header.value_.begin();
+        auto end = header.value_.end();
+        while (p != end)
+        {
+            auto comma = std::find(p, end, ',');
+            auto first = p;
+            auto last = comma;
+            while (first != last && (*first == ' ' || *first == '\t'))
+            {
+                ++first;
+            }
+            while (last != first && (last[-1] == ' ' || last[-1] == '\t'))
+            {
+                --last;
+            }
+            if (HttpStringView(first, static_cast<std::size_t>(last - first)).iequals(token))
+            {
+                return request.version_ != 11;
+            }
+            p = comma == end ? end : comma + 1;
+        }
+        break;
+    }
+    return request.version_ == 11;
+}
+
+HttpFastParser::Implementation HttpFastParser::best()
+{
+    return kBest;
+}
+
+bool HttpFastParser::supported(Implementation implementation)
+{
+    return static_cast<int>(implementation) <= static_cast<int>(kBest);
+}
+
+const char* HttpFastParser::name(Implementation implementation)
+{
+    switch (implementation)
+    {
+        case Implementation::Sse42:
+            return "sse4.2";
+        case Implementation::Avx2:
+            return "avx2";
+        default:
+            return "scalar";
+    }
+}
+
+}  // namespace server
+}  // namespace http
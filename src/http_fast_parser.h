@@ -0,0 +1,94 @@
+/**
+ * @brief Http fast request parser Define
+ * @file http_fast_parser.h
+ * @copyright Licensed under the Apache License, Version 2.0
+ */
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <httpserver/detail/http_fields.h>
+
+namespace http
+{
+namespace server
+{
+
+/**
+ * @brief request line and header tokenizer for the common case, in the style of picohttpparser
+ * @note the text is scanned 16 (SSE4.2) or 32 (AVX2) bytes at a time, the implementation is chosen by
+ * the cpu features at runtime. The parser is deliberately stricter than the beast parser: anything it
+ * doesn't fully understand, such as obs-fold, bare LF line ends, versions other than HTTP/1.0 and
+ * HTTP/1.1, bytes outside of the ascii range in the target or an Upgrade header, is reported as Invalid, and the caller
+ * hands the bytes to the beast parser which accepts or rejects them. Complete implies the beast parser
+ * yields the same method, target, version and headers.
+ */
+class HttpFastParser
+{
+public:
+    enum class Implementation
+    {
+        Scalar = 0,
+        Sse42 = 1,
+        Avx2 = 2,
+    };
+
+    enum class Result
+    {
+        Complete = 0,    ///< the request line and headers are parsed
+        Incomplete = 1,  ///< more bytes are needed
+        Invalid = 2,     ///< not parseable by the fast path
+    };
+
+    struct Header
+    {
+        HttpStringView name_;
+        HttpStringView value_;  // without the surrounding whitespace
+    };
+
+    /**
+     * @brief views into the parsed bytes, valid as long as they are
+     */
+    struct Request
+    {
+        HttpStringView method_;
+        HttpStringView target_;
+        unsigned version_{11};  // 10 or 11
+        std::vector<Header> headers_;
+        std::size_t header_size_{0};  // request line and headers including the empty line
+    };
+
+    /**
+     * @brief parse with the best implementation of the cpu
+     */
+    static Result parse(const char* data, std::size_t size, Request& request);
+
+    /**
+     * @brief parse with the implementation, which must be supported
+     */
+    static Result parse(const char* data, std::size_t size, Request& request, Implementation implementation);
+
+    /**
+     * @brief body length of a request framed by at most one Content-Length and no Transfer-Encoding,
+     * the only framing the fast path reads
+     * @return false for any other framing
+     */
+    static bool contentLength(const Request& request, uint64_t& content_length);
+
+    /**
+     * @brief whether the client keeps the connection open, decided by the Connection header as beast does
+     */
+    static bool keepAlive(const Request& request);
+
+    /**
+     * @brief best implementation supported by the cpu
+     */
+    static Implementation best();
+
+    static bool supported(Implementation implementation);
+    static const char* name(Implementation implementation);
+};
+
+}  // namespace server
+}  // namespace http
@@ -0,0 +1,430 @@
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <httpserver/detail/http_fields.h>
+#include "http_arena.h"
+#include "http_url_decoder.h"
+
+namespace http
+{
+namespace server
+{
+namespace
+{
+inline char toLower(char c)
+{
+    return (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c;
+}
+
+int compareIgnoreCase(HttpStringView lhs, HttpStringView rhs)
+{
+    auto size = std::min(lhs.size(), rhs.size());
+    for (std::size_t i = 0; i < size; ++i)
+    {
+        auto l = static_cast<unsigned char>(toLower(lhs[i]));
+        auto r = static_cast<unsigned char>(toLower(rhs[i]));
+        if (l != r)
+        {
+            return l < r ? -1 : 1;
+        }
+    }
+    return lhs.size() == rhs.size() ? 0 : (lhs.size() < rhs.size() ? -1 : 1);
+}
+
+// first byte of a lazily decoded value, in front of the value
+const char kDecoded = 0;
+const char kEncoded = 1;
+
+/**
+ * @brief copy the value behind its state byte and followed by a NUL
+ */
+HttpStringView copyLazy(HttpArena& arena, char state, const char* data, std::size_t size)
+{
+    auto target = arena.allocate(size + 2);
+    target[0] = state;
+    std::memcpy(target + 1, data, size);
+    target[size + 1] = '\0';
+    return HttpStringView(target + 1, size);
+}
+}  // namespace
+
+HttpStringView::HttpStringView(const char* data, std::size_t size) noexcept
+    : data_(data)
+    , size_(size)
+{
+}
+
+HttpStringView::HttpStringView(const char* data) noexcept
+    : data_(data)
+    , size_(data != nullptr ? std::strlen(data) : 0)
+{
+}
+
+HttpStringView::HttpStringView(const std::string& data) noexcept
+    : data_(data.data())
+    , size_(data.size())
+{
+}
+
+const char* HttpStringView::data() const noexcept
+{
+    return data_;
+}
+
+const char* HttpStringView::c_str() const noexcept
+{
+    return data_;
+}
+
+std::size_t HttpStringView::size() const noexcept
+{
+    return size_;
+}
+
+bool HttpStringView::empty() const noexcept
+{
+    return size_ == 0;
+}
+
+const char* HttpStringView::begin() const noexcept
+{
+    return data_;
+}
+
+const char* HttpStringView::end() const noexcept
+{
+    return data_ + size_;
+}
+
+char HttpStringView::operator[](std::size_t index) const noexcept
+{
+    return data_[index];
+}
+
+std::string HttpStringView::toString() const
+{
+    return std::string(data_, size_);
+}
+
+HttpStringView::operator std::string() const
+{
+    return toString();
+}
+
+int HttpStringView::compare(HttpStringView other) const noexcept
+{
+    auto size = std::min(size_, other.size_);
+    auto result = size == 0 ? 0 : std::memcmp(data_, other.data_, size);
+    if (result != 0)
+    {
+        return result;
+    }
+    return size_ == other.size_ ? 0 : (size_ < other.size_ ? -1 : 1);
+}
+
+bool HttpStringView::iequals(HttpStringView other) const noexcept
+{
+    return size_ == other.size_ && compareIgnoreCase(*this, other) == 0;
+}
+
+bool operator==(HttpStringView lhs, HttpStringView rhs) noexcept
+{
+    return lhs.size() == rhs.size() && lhs.compare(rhs) == 0;
+}
+
+bool operator!=(HttpStringView lhs, HttpStringView rhs) noexcept
+{
+    return !(lhs == rhs);
+}
+
+bool operator<(HttpStringView lhs, HttpStringView rhs) noexcept
+{
+    return lhs.compare(rhs) < 0;
+}
+
+std::string operator+(HttpStringView lhs, HttpStringView rhs)
+{
+    std::string result;
+    result.reserve(lhs.size() + rhs.size());
+    result.append(lhs.data(), lhs.size());
+    result.append(rhs.data(), rhs.size());
+    return result;
+}
+
+std::ostream& operator<<(std::ostream& os, HttpStringView view)
+{
+    return os.write(view.data(), static_cast<std::streamsize>(view.size()));
+}
+
+HttpFields::HttpFields(bool ignore_case)
+    : ignore_case_(ignore_case)
+    , lazy_(false)
+    , encoded_cnt_(0)
+    , arena_()
+    , entries_()
+{
+}
+
+HttpFields::const_iterator HttpFields::begin() const
+{
+    decodeAll();
+    return entries_.begin();
+}
+
+HttpFields::const_iterator HttpFields::end() const noexcept
+{
+    return entries_.end();
+}
+
+std::size_t HttpFields::size() const noexcept
+{
+    return entries_.size();
+}
+
+bool HttpFields::empty() const noexcept
+{
+    return entries_.empty();
+}
+
+HttpFields::const_iterator HttpFields::find(HttpStringView name) const
+{
+    auto iter = lookup(name);
+    if (iter != entries_.end() && encoded_cnt_ != 0)
+    {
+        decodeValue(entries_[static_cast<std::size_t>(iter - entries_.begin())]);
+    }
+    return iter;
+}
+
+HttpFields::const_iterator HttpFields::lookup(HttpStringView name) const noexcept
+{
+    auto iter = std::lower_bound(entries_.begin(),
+                                 entries_.end(),
+                                 name,
+                                 [this](const value_type& entry, HttpStringView key) { return less(entry.first, key); });
+    if (iter == entries_.end() || less(name, iter->first))
+    {
+        return entries_.end();
+    }
+    return iter;
+}
+
+std::size_t HttpFields::count(HttpStringView name) const noexcept
+{
+    return lookup(name) != entries_.end() ? 1 : 0;
+}
+
+HttpStringView HttpFields::at(HttpStringView name) const
+{
+    auto iter = find(name);
+    if (iter == entries_.end())
+    {
+        throw std::out_of_range("http field not found: " + name.toString());
+    }
+    return iter->second;
+}
+
+HttpFields::operator std::map<std::string, std::string>() const
+{
+    decodeAll();
+    std::map<std::string, std::string> fields;
+    for (const auto& entry : entries_)
+    {
+        fields.emplace(entry.first.toString(), entry.second.toString());
+    }
+    return fields;
+}
+
+void HttpFields::reset(const std::shared_ptr<HttpArena>& arena, std::size_t entry_cnt)
+{
+    lazy_ = false;
+    encoded_cnt_ = 0;
+    arena_ = arena;
+    entries_.clear();
+    entries_.reserve(entry_cnt);
+}
+
+void HttpFields::add(const char* name, std::size_t name_size, const char* value, std::size_t value_size)
+{
+    entries_.emplace_back(HttpStringView(arena_->copy(name, name_size), name_size),
+                          HttpStringView(arena_->copy(value, value_size), value_size));
+}
+
+void HttpFields::addQuery(const char* query, std::size_t size, bool decode)
+{
+    lazy_ = decode;
+    auto end = query + size;
+    entries_.reserve(entries_.size() + 1 + static_cast<std::size_t>(std::count(query, end, '&')));
+
+    // a parameter without '=' has an empty value, empty parameters between '&' are kept as Boost.URL does
+    auto p = query;
+    while (true)
+    {
+        auto name = p;
+        const char* equal = nullptr;
+        auto name_encoded = false;
+        auto value_encoded = false;
+        while ((p = HttpUrlDecoder::find(p, end)) != end && *p != '&')
+        {
+            if (*p == '=' && equal == nullptr)
+            {
+                equal = p;
+            }
+            else if (*p != '=')
+            {
+                (equal == nullptr ? name_encoded : value_encoded) = true;
+            }
+            ++p;
+        }
+
+        auto name_end = equal != nullptr ? equal : p;
+        auto value = equal != nullptr ? equal + 1 : p;
+        auto name_size = static_cast<std::size_t>(name_end - name);
+        auto value_size = static_cast<std::size_t>(p - value);
+        if (!decode)
+        {
+            add(name, name_size, value, value_size);
+        }
+        else
+        {
+            // names are decoded now for the lookup, values when they are read
+            HttpStringView name_view;
+            if (name_encoded)
+            {
+                auto target = arena_->allocate(name_size + 1);
+                auto decoded_size = HttpUrlDecoder::decode(name, name_size, target);
+                target[decoded_size] = '\0';
+                name_view = HttpStringView(target, decoded_size);
+            }
+            else
+            {
+                name_view = HttpStringView(arena_->copy(name, name_size), name_size);
+            }
+            entries_.emplace_back(name_view, copyLazy(*arena_, value_encoded ? kEncoded : kDecoded, value, value_size));
+        }
+
+        if (p == end)
+        {
+            break;
+        }
+        ++p;
+    }
+}
+
+void HttpFields::finish()
+{
+    // stable, so the last of equal names is the last of its run and wins as with std::map assignment
+    std::stable_sort(entries_.begin(),
+                     entries_.end(),
+                     [this](const value_type& lhs, const value_type& rhs) { return less(lhs.first, rhs.first); });
+
+    auto out = entries_.begin();
+    for (auto iter = entries_.begin(); iter != entries_.end(); ++iter)
+    {
+        auto next = iter + 1;
+        if (next != entries_.end() && !less(iter->first, next->first))
+        {
+            continue;
+        }
+        *out++ = *iter;
+    }
+    entries_.erase(out, entries_.end());
+
+    encoded_cnt_ = 0;
+    if (lazy_)
+    {
+        for (const auto& entry : entries_)
+        {
+            encoded_cnt_ += entry.second.data()[-1] == kEncoded ? 1 : 0;
+        }
+    }
+}
+
+void HttpFields::decodeValue(value_type& entry) const
+{
+    // the encoded copy is left as is, copies of the fields sharing it decode on their own and maybe on other threads
+    if (entry.second.data()[-1] != kEncoded)
+    {
+        return;
+    }
+    auto size = entry.second.size();
+    auto target = arena_->allocateShared(size + 2);
+    target[0] = kDecoded;
+    auto decoded_size = HttpUrlDecoder::decode(entry.second.data(), size, target + 1);
+    target[decoded_size + 1] = '\0';
+    entry.second = HttpStringView(target + 1, decoded_size);
+    --encoded_cnt_;
+}
+
+void HttpFields::decodeAll() const
+{
+    for (auto iter = entries_.begin(); iter != entries_.end() && encoded_cnt_ != 0; ++iter)
+    {
+        decodeValue(*iter);
+    }
+}
+
+bool HttpFields::less(HttpStringView lhs, HttpStringView rhs) const noexcept
+{
+    return ignore_case_ ? compareIgnoreCase(lhs, rhs) < 0 : lhs.compare(rhs) < 0;
+}
+
+HttpSegments::const_iterator HttpSegments::begin() const noexcept
+{
+    return segments_.begin();
+}
+
+HttpSegments::const_iterator HttpSegments::end() const noexcept
+{
+    return segments_.end();
+}
+
+std::size_t HttpSegments::size() const noexcept
+{
+    return segments_.size();
+}
+
+bool HttpSegments::empty() const noexcept
+{
+    return segments_.empty();
+}
+
+HttpStringView HttpSegments::operator[](std::size_t index) const noexcept
+{
+    return segments_[index];
+}
+
+HttpStringView HttpSegments::front() const noexcept
+{
+    return segments_.front();
+}
+
+HttpStringView HttpSegments::back() const noexcept
+{
+    return segments_.back();
+}
+
+HttpSegments::operator std::list<std::string>() const
+{
+    std::list<std::string> segments;
+    for (const auto& segment : segments_)
+    {
+        segments.push_back(segment.toString());
+    }
+    return segments;
+}
+
+void HttpSegments::reset(const std::shared_ptr<HttpArena>& arena, std::size_t segment_cnt)
+{
+    arena_ = arena;
+    segments_.clear();
+    segments_.reserve(segment_cnt);
+}
+
+void HttpSegments::add(const char* segment, std::size_t size)
+{
+    segments_.emplace_back(arena_->copy(segment, size), size);
+}
+
+}  // namespace server
+}  // namespace http
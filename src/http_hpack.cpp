@@ -0,0 +1,466 @@
+#include <algorithm>
+#include <unordered_map>
+#include "http_hpack.h"
+
+namespace http
+{
+namespace server
+{
+namespace
+{
+const std::size_t kEntryOverhead = 32;  // added to the name and value size of every table entry
+
+struct StaticEntry
+{
+    const char* name_;
+    const char* value_;
+};
+
+// RFC 7541 appendix A, index 1 is the first entry
+const StaticEntry kStaticTable[] = {
+    {":authority", ""},
+    {":method", "GET"},
+    {":method", "POST"},
+    {":path", "/"},
+    {":path", "/index.html"},
+    {":scheme", "http"},
+    {":scheme", "https"},
+    {":status", "200"},
+    {":status", "204"},
+    {":status", "206"},
+    {":status", "304"},
+    {":status", "400"},
+    {":status", "404"},
+    {":status", "500"},
+    {"accept-charset", ""},
+    {"accept-encoding", "gzip, deflate"},
+    {"accept-language", ""},
+    {"accept-ranges", ""},
+    {"accept", ""},
+    {"access-control-allow-origin", ""},
+    {"age", ""},
+    {"allow", ""},
+    {"authorization", ""},
+    {"cache-control", ""},
+    {"content-disposition", ""},
+    {"content-encoding", ""},
+    {"content-language", ""},
+    {"content-length", ""},
+    {"content-location", ""},
+    {"content-range", ""},
+    {"content-type", ""},
+    {"cookie", ""},
+    {"date", ""},
+    {"etag", ""},
+    {"expect", ""},
+    {"expires", ""},
+    {"from", ""},
+    {"host", ""},
+    {"if-match", ""},
+    {"if-modified-since", ""},
+    {"if-none-match", ""},
+    {"if-range", ""},
+    {"if-unmodified-since", ""},
+    {"last-modified", ""},
+    {"link", ""},
+    {"location", ""},
+    {"max-forwards", ""},
+    {"proxy-authenticate", ""},
+    {"proxy-authorization", ""},
+    {"range", ""},
+    {"referer", ""},
+    {"refresh", ""},
+    {"retry-after", ""},
+    {"server", ""},
+    {"set-cookie", ""},
+    {"strict-transport-security", ""},
+    {"transfer-encoding", ""},
+    {"user-agent", ""},
+    {"vary", ""},
+    {"via", ""},
+    {"www-authenticate", ""},
+};
+
+const std::size_t kStaticTableSize = sizeof(kStaticTable) / sizeof(kStaticTable[0]);
+
+// code lengths of the RFC 7541 appendix B Huffman code for the symbols 0-255 and EOS. The code is canonical,
+// codes of one length are consecutive in symbol order, so the lengths are enough to rebuild it
+const uint8_t kHuffmanLengths[257] = {
+    13, 23, 28, 28, 28, 28, 28, 28, 28, 24, 30, 28, 28, 30, 28, 28,
+    28, 28, 28, 28, 28, 28, 30, 28, 28, 28, 28, 28, 28, 28, 28, 28,
+    6, 10, 10, 12, 13, 6, 8, 11, 10, 10, 8, 11, 8, 6, 6, 6,
+    5, 5, 5, 6, 6, 6, 6, 6, 6, 6, 7, 8, 15, 6, 12, 10,
+    13, 6, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
+    7, 7, 7, 7, 7, 7, 7, 7, 8, 7, 8, 13, 19, 13, 14, 6,
+    15, 5, 6, 5, 6, 5, 6, 6, 6, 5, 7, 7, 6, 6, 6, 5,
+    6, 7, 6, 5, 5, 6, 7, 7, 7, 7, 7, 15, 11, 14, 13, 28,
+    20, 22, 20, 20, 22, 22, 22, 23, 22, 23, 23, 23, 23, 23, 24, 23,
+    24, 24, 22, 23, 24, 23, 23, 23, 23, 21, 22, 23, 22, 23, 23, 24,
+    22, 21, 20, 22, 22, 23, 23, 21, 23, 22, 22, 24, 21, 22, 23, 23,
+    21, 21, 22, 21, 23, 22, 23, 23, 20, 22, 22, 22, 23, 22, 22, 23,
+    26, 26, 20, 19, 22, 23, 22, 25, 26, 26, 26, 27, 27, 26, 24, 25,
+    19, 21, 26, 27, 27, 26, 27, 24, 21, 21, 26, 26, 28, 27, 27, 27,
+    20, 24, 20, 21, 22, 21, 21, 23, 22, 22, 25, 25, 24, 24, 26, 23,
+    26, 27, 26, 26, 27, 27, 27, 27, 27, 28, 27, 27, 27, 27, 27, 26,
+    30,
+};
+
+const unsigned int kHuffmanMaxLength = 30;
+const uint16_t kHuffmanEos = 256;
+
+struct HuffmanTable
+{
+    uint32_t first_code_[kHuffmanMaxLength + 1];  // code of the first symbol of each length
+    uint16_t count_[kHuffmanMaxLength + 1];  // symbols of each length
+    uint16_t offset_[kHuffmanMaxLength + 1];  // index in symbols_ of the first symbol of each length
+    uint16_t symbols_[257];  // by length, then by symbol
+};
+
+HuffmanTable buildHuffmanTable()
+{
+    HuffmanTable table{};
+    uint16_t index = 0;
+    uint32_t code = 0;
+    for (unsigned int length = 1; length <= kHuffmanMaxLength; ++length)
+    {
+        table.first_code_[length] = code;
+        table.offset_[length] = index;
+        for (uint16_t symbol = 0; symbol < 257; ++symbol)
+        {
+            if (kHuffmanLengths[symbol] == length)
+            {
+                table.symbols_[index++] = symbol;
+                ++table.count_[length];
+            }
+        }
+        code = (code + table.count_[length]) << 1;
+    }
+    return table;
+}
+
+const HuffmanTable kHuffmanTable = buildHuffmanTable();
+
+bool huffmanDecode(const uint8_t* p, const uint8_t* end, std::string& out)
+{
+    uint32_t code = 0;
+    unsigned int length = 0;
+    for (; p != end; ++p)
+    {
+        for (int bit = 7; bit >= 0; --bit)
+        {
+            code = (code << 1) | ((*p >> bit) & 1u);
+            ++length;
+
+            // codes shorter than length are below first_code_, the subtraction wraps for them
+            auto rank = code - kHuffmanTable.first_code_[length];
+            if (rank < kHuffmanTable.count_[length])
+            {
+                auto symbol = kHuffmanTable.symbols_[kHuffmanTable.offset_[length] + rank];
+                if (symbol == kHuffmanEos)
+                {
+                    return false;
+                }
+                out.push_back(static_cast<char>(symbol));
+                code = 0;
+                length = 0;
+            }
+            else if (length == kHuffmanMaxLength)
+            {
+                return false;
+            }
+        }
+    }
+
+    // the padding is shorter than a byte and made of the most significant bits of EOS, all ones
+    return length <= 7 && code == (1u << length) - 1;
+}
+
+bool decodeInteger(const uint8_t*& p, const uint8_t* end, unsigned int prefix_bits, uint64_t& value)
+{
+    if (p == end)
+    {
+        return false;
+    }
+
+    uint64_t mask = (1u << prefix_bits) - 1;
+    value = *p++ & mask;
+    if (value < mask)
+    {
+        return true;
+    }
+
+    for (unsigned int shift = 0; p != end && shift <= 28; shift += 7)
+    {
+        auto byte = *p++;
+        value += static_cast<uint64_t>(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool decodeString(const uint8_t*& p, const uint8_t* end, std::string& out)
+{
+    if (p == end)
+    {
+        return false;
+    }
+
+    bool huffman = (*p & 0x80) != 0;
+    uint64_t size = 0;
+    if (!decodeInteger(p, end, 7, size) || size > static_cast<uint64_t>(end - p))
+    {
+        return false;
+    }
+
+    out.clear();
+    auto string_end = p + size;
+    if (huffman)
+    {
+        if (!huffmanDecode(p, string_end, out))
+        {
+            return false;
+        }
+    }
+    else
+    {
+        out.assign(reinterpret_cast<const char*>(p), static_cast<std::size_t>(size));
+    }
+    p = string_end;
+    return true;
+}
+
+void encodeString(const std::string& value, std::string& out)
+{
+    HttpHpackEncoder::encodeInteger(value.size(), 7, 0x00, out);
+    out.append(value);
+}
+
+uint8_t staticNameIndex(const std::string& name)
+{
+    static const std::unordered_map<std::string, uint8_t> indexes = []
+    {
+        std::unordered_map<std::string, uint8_t> result;
+        for (std::size_t i = kStaticTableSize; i > 0; --i)
+        {
+            // the first entry of a name wins
+            result[kStaticTable[i - 1].name_] = static_cast<uint8_t>(i);
+        }
+        return result;
+    }();
+
+    auto iter = indexes.find(name);
+    return iter == indexes.end() ? 0 : iter->second;
+}
+}  // namespace
+
+HttpHpackDecoder::HttpHpackDecoder(std::size_t max_table_size)
+    : table_()
+    , table_size_(0)
+    , table_capacity_(max_table_size)
+    , max_table_size_(max_table_size)
+{
+}
+
+HttpHpackDecoder::Result HttpHpackDecoder::decode(const uint8_t* data,
+                                                  std::size_t size,
+                                                  std::size_t max_header_list_size,
+                                                  std::vector<Field>& fields)
+{
+    auto p = data;
+    auto end = data + size;
+    std::size_t list_size = 0;
+    bool too_large = false;
+    bool field_seen = false;
+    std::string name;
+    std::string value;
+    while (p != end)
+    {
+        auto byte = *p;
+        uint64_t index = 0;
+        if ((byte & 0xe0) == 0x20)
+        {
+            // dynamic table size update, only at the start of a block
+            if (field_seen || !decodeInteger(p, end, 5, index) || index > max_table_size_)
+            {
+                return Result::CompressionError;
+            }
+            table_capacity_ = static_cast<std::size_t>(index);
+            evict(table_capacity_);
+            continue;
+        }
+
+        field_seen = true;
+        if ((byte & 0x80) != 0)
+        {
+            // indexed field
+            if (!decodeInteger(p, end, 7, index) || index == 0 || !lookup(index, name, &value))
+            {
+                return Result::CompressionError;
+            }
+        }
+        else
+        {
+            // literal with incremental indexing, without indexing or never indexed
+            bool indexing = (byte & 0xc0) == 0x40;
+            if (!decodeInteger(p, end, indexing ? 6 : 4, index))
+            {
+                return Result::CompressionError;
+            }
+            if (index != 0 ? !lookup(index, name, nullptr) : !decodeString(p, end, name))
+            {
+                return Result::CompressionError;
+            }
+            if (!decodeString(p, end, value))
+            {
+                return Result::CompressionError;
+            }
+            if (indexing)
+            {
+                insert(name, value);
+            }
+        }
+
+        // the rest of the block is still decoded to keep the dynamic table in step with the peer
+        list_size += name.size() + value.size() + kEntryOverhead;
+        too_large = too_large || list_size > max_header_list_size;
+        if (!too_large)
+        {
+            fields.push_back(Field{name, value});
+        }
+    }
+    return too_large ? Result::HeaderListTooLarge : Result::Ok;
+}
+
+bool HttpHpackDecoder::lookup(uint64_t index, std::string& name, std::string* value) const
+{
+    if (index <= kStaticTableSize)
+    {
+        const auto& entry = kStaticTable[index - 1];
+        name.assign(entry.name_);
+        if (value != nullptr)
+        {
+            value->assign(entry.value_);
+        }
+        return true;
+    }
+
+    index -= kStaticTableSize + 1;
+    if (index >= table_.size())
+    {
+        return false;
+    }
+    const auto& entry = table_[static_cast<std::size_t>(index)];
+    name = entry.name_;
+    if (value != nullptr)
+    {
+        *value = entry.value_;
+    }
+    return true;
+}
+
+void HttpHpackDecoder::insert(const std::string& name, const std::string& value)
+{
+    auto entry_size = name.size() + value.size() + kEntryOverhead;
+    if (entry_size > table_capacity_)
+    {
+        // an entry larger than the table empties it
+        evict(0);
+        return;
+    }
+    evict(table_capacity_ - entry_size);
+    table_.push_front(Field{name, value});
+    table_size_ += entry_size;
+}
+
+void HttpHpackDecoder::evict(std::size_t max_size)
+{
+    while (table_size_ > max_size)
+    {
+        const auto& entry = table_.back();
+        table_size_ -= entry.name_.size() + entry.value_.size() + kEntryOverhead;
+        table_.pop_back();
+    }
+}
+
+void HttpHpackEncoder::encodeStatus(unsigned int status, std::string& out)
+{
+    // the statuses of the static table, entries 8 to 14
+    uint8_t index = 0;
+    switch (status)
+    {
+        case 200:
+            index = 8;
+            break;
+        case 204:
+            index = 9;
+            break;
+        case 206:
+            index = 10;
+            break;
+        case 304:
+            index = 11;
+            break;
+        case 400:
+            index = 12;
+            break;
+        case 404:
+            index = 13;
+            break;
+        case 500:
+            index = 14;
+            break;
+        default:
+            break;
+    }
+    if (index != 0)
+    {
+        out.push_back(static_cast<char>(0x80 | index));
+        return;
+    }
+
+    // literal without indexing, the name is :status
+    encodeInteger(8, 4, 0x00, out);
+    encodeString(std::to_string(status), out);
+}
+
+void HttpHpackEncoder::encode(const std::string& name, const std::string& value, std::string& out)
+{
+    std::string lower_name(name);
+    std::transform(lower_name.begin(),
+                   lower_name.end(),
+                   lower_name.begin(),
+                   [](char c) { return c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c; });
+
+    auto index = staticNameIndex(lower_name);
+    encodeInteger(index, 4, 0x00, out);
+    if (index == 0)
+    {
+        encodeString(lower_name, out);
+    }
+    encodeString(value, out);
+}
+
+void HttpHpackEncoder::encodeInteger(uint64_t value, unsigned int prefix_bits, uint8_t first_byte, std::string& out)
+{
+    uint64_t mask = (1u << prefix_bits) - 1;
+    if (value < mask)
+    {
+        out.push_back(static_cast<char>(first_byte | value));
+        return;
+    }
+
+    out.push_back(static_cast<char>(first_byte | mask));
+    value -= mask;
+    while (value >= 0x80)
+    {
+        out.push_back(static_cast<char>((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+
+}  // namespace server
+}  // namespace http
@@ -0,0 +1,97 @@
+/**
+ * @brief Http HPACK header compression Define
+ * @file http_hpack.h
+ * @copyright Licensed under the Apache License, Version 2.0
+ */
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <vector>
+
+namespace http
+{
+namespace server
+{
+
+/**
+ * @brief HPACK (RFC 7541) decoder of the header blocks of one HTTP/2 connection
+ * @note the static table is shared by all connections, the dynamic table belongs to the connection and
+ * must see every header block in order, including the blocks of refused streams
+ */
+class HttpHpackDecoder
+{
+public:
+    struct Field
+    {
+        std::string name_;
+        std::string value_;
+    };
+
+    enum class Result
+    {
+        Ok = 0,                  ///< the fields are decoded
+        HeaderListTooLarge = 1,  ///< the block is valid but its fields are over the limit, fields is incomplete
+        CompressionError = 2,    ///< the block is malformed, the connection can't decode anything after it
+    };
+
+    /**
+     * @param [in] max_table_size: the SETTINGS_HEADER_TABLE_SIZE announced to the peer
+     */
+    explicit HttpHpackDecoder(std::size_t max_table_size = 4096);
+
+    /**
+     * @brief decode a complete header block, appending to fields
+     * @param [in] max_header_list_size: limit of the field sizes, each counted as name + value + 32 as in
+     * SETTINGS_MAX_HEADER_LIST_SIZE
+     */
+    Result decode(const uint8_t* data, std::size_t size, std::size_t max_header_list_size, std::vector<Field>& fields);
+
+    /**
+     * @brief return the size of the dynamic table, entries counted as name + value + 32
+     */
+    std::size_t tableSize() const
+    {
+        return table_size_;
+    }
+
+private:
+    bool lookup(uint64_t index, std::string& name, std::string* value) const;
+    void insert(const std::string& name, const std::string& value);
+    void evict(std::size_t max_size);
+
+    std::deque<Field> table_;  // the dynamic table, newest first
+    std::size_t table_size_;
+    std::size_t table_capacity_;  // set by dynamic table size updates of the peer
+    std::size_t max_table_size_;
+};
+
+/**
+ * @brief HPACK encoder of response header blocks
+ * @note fields are written as literals without indexing, names found in the static table are referenced by
+ * index and common statuses are fully indexed. Nothing is inserted into the dynamic table of the peer, so the
+ * encoder has no state and any SETTINGS_HEADER_TABLE_SIZE of the peer is fine.
+ */
+class HttpHpackEncoder
+{
+public:
+    /**
+     * @brief append the :status field
+     */
+    static void encodeStatus(unsigned int status, std::string& out);
+
+    /**
+     * @brief append a field, the name is lowercased as HTTP/2 requires
+     */
+    static void encode(const std::string& name, const std::string& value, std::string& out);
+
+    /**
+     * @brief append an HPACK integer with a prefix of prefix_bits, first_byte holds the bits above the prefix
+     */
+    static void encodeInteger(uint64_t value, unsigned int prefix_bits, uint8_t first_byte, std::string& out);
+};
+
+}  // namespace server
+}  // namespace http
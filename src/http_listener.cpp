@@ -0,0 +1,303 @@
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <stdexcept>
+#include "http_listener.h"
+
+namespace http
+{
+namespace server
+{
+namespace
+{
+const std::string kUnixPrefix = "unix:";
+}  // namespace
+
+HttpListener::HttpListener(net::io_context& io_context, const std::string& address)
+    : strand_(net::make_strand(io_context))
+    , tcp_acceptor_(strand_)
+    , local_acceptor_(strand_)
+    , local_(false)
+    , tcp_endpoint_()
+    , local_path_()
+    , listen_fd_(-1)
+{
+    if (address.compare(0, kUnixPrefix.size(), kUnixPrefix) == 0)
+    {
+        local_ = true;
+        local_path_ = address.substr(kUnixPrefix.size());
+        if (local_path_.empty() || local_path_ == "@")
+        {
+            throw std::runtime_error(fmt::format("listen address {} has no path", address));
+        }
+        if (local_path_[0] == '@')
+        {
+            local_path_[0] = '\0';
+        }
+        return;
+    }
+
+    auto colon = address.rfind(':');
+    if (colon == std::string::npos || colon == 0 || colon + 1 == address.size())
+    {
+        throw std::runtime_error(fmt::format("listen address {} should be ip:port", address));
+    }
+
+    auto host = address.substr(0, colon);
+    if (host.front() == '[' && host.back() == ']')
+    {
+        host = host.substr(1, host.size() - 2);
+    }
+
+    beast::error_code ec;
+    auto ip = net::ip::make_address(host, ec);
+    if (ec)
+    {
+        throw std::runtime_error(fmt::format("listen address {} has a bad ip: {}", address, ec.message()));
+    }
+
+    unsigned long port = 0;
+    try
+    {
+        std::size_t parsed_size = 0;
+        port = std::stoul(address.substr(colon + 1), &parsed_size);
+        if (parsed_size != address.size() - colon - 1)
+        {
+            port = 65536;
+        }
+    }
+    catch (const std::exception&)
+    {
+        port = 65536;
+    }
+    if (port > 65535)
+    {
+        throw std::runtime_error(fmt::format("listen address {} has a bad port", address));
+    }
+    tcp_endpoint_ = tcp::endpoint(ip, static_cast<uint16_t>(port));
+}
+
+HttpListener::HttpListener(net::io_context& io_context, int listen_fd)
+    : strand_(net::make_strand(io_context))
+    , tcp_acceptor_(strand_)
+    , local_acceptor_(strand_)
+    , local_(false)
+    , tcp_endpoint_()
+    , local_path_()
+    , listen_fd_(listen_fd)
+{
+}
+
+void HttpListener::open(int backlog, uint64_t defer_accept_time_out)
+{
+    beast::error_code ec;
+    if (listen_fd_ >= 0)
+    {
+        // the socket is already bound and listening, its family tells the protocol
+        sockaddr_storage address{};
+        auto size = static_cast<socklen_t>(sizeof(address));
+        if (getsockname(listen_fd_, reinterpret_cast<sockaddr*>(&address), &size) != 0)
+        {
+            throw std::runtime_error(fmt::format("listen fd {} is not a socket", listen_fd_));
+        }
+
+        local_ = address.ss_family == AF_UNIX;
+        if (local_)
+        {
+            local_acceptor_.assign(net::local::stream_protocol(), listen_fd_, ec);
+        }
+        else
+        {
+            tcp_acceptor_.assign(address.ss_family == AF_INET6 ? tcp::v6() : tcp::v4(), listen_fd_, ec);
+        }
+        if (ec)
+        {
+            throw std::runtime_error(ec.message());
+        }
+
+        // accept() drains the pending connections without blocking, the async accepts aren't affected
+        if (local_)
+        {
+            local_acceptor_.non_blocking(true, ec);
+        }
+        else
+        {
+            tcp_acceptor_.non_blocking(true, ec);
+        }
+        if (ec)
+        {
+            throw std::runtime_error(ec.message());
+        }
+        return;
+    }
+
+    if (local_)
+    {
+        if (local_path_[0] != '\0')
+        {
+            // a socket file left by a previous process makes bind fail
+            struct stat st;
+            if (::stat(local_path_.c_str(), &st) == 0 && S_ISSOCK(st.st_mode))
+            {
+                ::unlink(local_path_.c_str());
+            }
+        }
+
+        auto endpoint = net::local::stream_protocol::endpoint(local_path_);
+        local_acceptor_.open(endpoint.protocol(), ec);
+        if (!ec)
+        {
+            local_acceptor_.bind(endpoint, ec);
+        }
+        if (!ec)
+        {
+            local_acceptor_.listen(backlog, ec);
+        }
+        if (!ec)
+        {
+            local_acceptor_.non_blocking(true, ec);
+        }
+        if (ec)
+        {
+            throw std::runtime_error(fmt::format("listen on {} fail: {}", name(), ec.message()));
+        }
+        return;
+    }
+
+    tcp_acceptor_.open(tcp_endpoint_.protocol(), ec);
+    if (ec)
+    {
+        throw std::runtime_error(ec.message());
+    }
+
+    // address reuse
+    tcp_acceptor_.set_option(net::socket_base::reuse_address(true), ec);
+    if (ec)
+    {
+        throw std::runtime_error(ec.message());
+    }
+
+    tcp_acceptor_.set_option(net::socket_base::linger(false, 1), ec);
+    if (ec)
+    {
+        throw std::runtime_error(ec.message());
+    }
+
+    // bind to the server address
+    tcp_acceptor_.bind(tcp_endpoint_, ec);
+    if (ec)
+    {
+        throw std::runtime_error(fmt::format("bind {} fail: {}", name(), ec.message()));
+    }
+
+#ifdef TCP_DEFER_ACCEPT
+    if (defer_accept_time_out != 0)
+    {
+        // the connection is only reported once request bytes arrive, a connect-only client never costs a session
+        int seconds = static_cast<int>(std::min<uint64_t>(defer_accept_time_out, INT32_MAX));
+        if (setsockopt(tcp_acceptor_.native_handle(), IPPROTO_TCP, TCP_DEFER_ACCEPT, &seconds, sizeof(seconds)) != 0)
+        {
+            throw std::runtime_error(fmt::format("set TCP_DEFER_ACCEPT fail, errno: {}", errno));
+        }
+    }
+#endif
+
+    // start listening for connections
+    tcp_acceptor_.listen(backlog, ec);
+    if (ec)
+    {
+        throw std::runtime_error(ec.message());
+    }
+
+    tcp_acceptor_.non_blocking(true, ec);
+    if (ec)
+    {
+        throw std::runtime_error(ec.message());
+    }
+}
+
+tcp::socket HttpListener::accept(net::io_context& io_context, beast::error_code& ec)
+{
+    if (!local_)
+    {
+        tcp::socket socket(net::make_strand(io_context));
+        tcp_acceptor_.accept(socket, ec);
+        return socket;
+    }
+
+    net::local::stream_protocol::socket socket(net::make_strand(io_context));
+    local_acceptor_.accept(socket, ec);
+    if (ec)
+    {
+        return tcp::socket(socket.get_executor());
+    }
+    return toStream(socket, ec);
+}
+
+tcp::socket HttpListener::toStream(net::local::stream_protocol::socket& socket, beast::error_code& ec)
+{
+    tcp::socket stream(socket.get_executor());
+    auto fd = socket.release(ec);
+    if (!ec)
+    {
+        stream.assign(tcp::v4(), fd, ec);
+    }
+    return stream;
+}
+
+void HttpListener::close()
+{
+    beast::error_code ec;
+    tcp_acceptor_.close(ec);
+    local_acceptor_.close(ec);
+}
+
+bool HttpListener::isOpen() const
+{
+    return tcp_acceptor_.is_open() || local_acceptor_.is_open();
+}
+
+std::string HttpListener::name() const
+{
+    beast::error_code ec;
+    if (local_)
+    {
+        auto path = local_path_;
+        if (local_acceptor_.is_open())
+        {
+            auto endpoint = local_acceptor_.local_endpoint(ec);
+            if (!ec)
+            {
+                path = endpoint.path();
+            }
+        }
+        if (!path.empty() && path[0] == '\0')
+        {
+            path[0] = '@';
+        }
+        return kUnixPrefix + path;
+    }
+
+    auto endpoint = tcp_endpoint_;
+    if (tcp_acceptor_.is_open())
+    {
+        auto bound_endpoint = tcp_acceptor_.local_endpoint(ec);
+        if (!ec)
+        {
+            endpoint = bound_endpoint;
+        }
+    }
+    if (endpoint.address().is_v6())
+    {
+        return "[" + endpoint.address().to_string() + "]:" + std::to_string(endpoint.port());
+    }
+    return endpoint.address().to_string() + ":" + std::to_string(endpoint.port());
+}
+
+}  // namespace server
+}  // namespace http
@@ -0,0 +1,114 @@
+/**
+ * @brief Http Listener Define
+ * @file http_listener.h
+ * @copyright Licensed under the Apache License, Version 2.0
+ */
+
+#pragma once
+#include <string>
+#include <utility>
+#include <boost/asio/local/stream_protocol.hpp>
+#include "http_common.h"
+
+namespace http
+{
+namespace server
+{
+
+/**
+ * @brief one listening socket of the server, TCP over IPv4 or IPv6, or a Unix domain stream socket
+ * @note a connection accepted on a Unix socket is handed over as a tcp::socket holding its descriptor. The
+ * sessions only read and write the descriptor, so the same sessions and handlers serve every listener, the
+ * remote endpoint of such a connection is reported as unsupported.
+ */
+class HttpListener
+{
+public:
+    using executor_type = net::strand<net::io_context::executor_type>;
+
+    /**
+     * @param [in] address: "ip:port", "[ipv6]:port", "unix:path" or "unix:@name" for the linux abstract namespace
+     * @note throw std::runtime_error if the address is malformed
+     */
+    HttpListener(net::io_context& io_context, const std::string& address);
+
+    /**
+     * @brief adopt a socket which is already bound and listening, TCP or Unix
+     */
+    HttpListener(net::io_context& io_context, int listen_fd);
+
+    HttpListener(const HttpListener&) = delete;
+    HttpListener& operator=(const HttpListener&) = delete;
+
+    /**
+     * @brief bind and listen, an adopted socket is only registered
+     * @param [in] defer_accept_time_out: TCP_DEFER_ACCEPT of a bound TCP socket, uint:seconds, 0 means disable
+     * @note throw std::runtime_error if it fails. A stale socket file left at a Unix path is replaced, the file
+     * is kept on close, so a new process bound to the same path doesn't lose it.
+     */
+    void open(int backlog, uint64_t defer_accept_time_out = 0);
+
+    /**
+     * @brief close the socket, the pending accept completes with net::error::operation_aborted
+     */
+    void close();
+
+    bool isOpen() const;
+
+    /**
+     * @brief return the bound address in the format of the constructor, with the actual port
+     */
+    std::string name() const;
+
+    executor_type get_executor() const
+    {
+        return strand_;
+    }
+
+    /**
+     * @brief accept a connection on a new strand, the handler takes a beast::error_code and a tcp::socket
+     */
+    template <class AcceptHandler>
+    void asyncAccept(net::io_context& io_context, AcceptHandler&& handler)
+    {
+        if (!local_)
+        {
+            tcp_acceptor_.async_accept(net::make_strand(io_context), std::forward<AcceptHandler>(handler));
+            return;
+        }
+
+        local_acceptor_.async_accept(
+            net::make_strand(io_context),
+            [handler = std::forward<AcceptHandler>(handler)](beast::error_code ec,
+                                                              net::local::stream_protocol::socket socket) mutable
+            {
+                if (ec)
+                {
+                    handler(ec, tcp::socket(socket.get_executor()));
+                    return;
+                }
+                auto stream = toStream(socket, ec);
+                handler(ec, std::move(stream));
+            });
+    }
+
+    /**
+     * @brief take a connection which is already pending without waiting, on a new strand
+     * @note ec is net::error::would_block when there is none, call it on the strand of the listener
+     */
+    tcp::socket accept(net::io_context& io_context, beast::error_code& ec);
+
+private:
+    static tcp::socket toStream(net::local::stream_protocol::socket& socket, beast::error_code& ec);
+
+    executor_type strand_;
+    tcp::acceptor tcp_acceptor_;
+    net::local::stream_protocol::acceptor local_acceptor_;
+    bool local_;  // a Unix domain socket
+    tcp::endpoint tcp_endpoint_;
+    std::string local_path_;  // starts with '\0' in the abstract namespace
+    int listen_fd_;  // the adopted socket, -1 to bind
+};
+
+}  // namespace server
+}  // namespace http
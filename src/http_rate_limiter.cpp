@@ -0,0 +1,177 @@
+#include <algorithm>
+#include <limits>
+#include <new>
+#include "http_rate_limiter.h"
+
+namespace http
+{
+namespace server
+{
+namespace
+{
+const uint64_t kTokenUnit = 64;                      // one token in bucket units
+const uint64_t kTokenBits = 24;                      // low bits of the state word
+const uint64_t kTokenMask = (1ULL << kTokenBits) - 1;
+
+inline uint64_t packState(uint64_t time_ms, uint64_t tokens)
+{
+    return (time_ms << kTokenBits) | tokens;
+}
+
+inline uint64_t stateTime(uint64_t state)
+{
+    return state >> kTokenBits;
+}
+
+inline uint64_t stateTokens(uint64_t state)
+{
+    return state & kTokenMask;
+}
+}  // namespace
+
+HttpRateLimiter::HttpRateLimiter(uint32_t rate, uint32_t burst, uint32_t table_size)
+    : rate_(rate)
+    , capacity_(std::min<uint64_t>(static_cast<uint64_t>(burst != 0 ? burst : rate) * kTokenUnit, kTokenMask))
+    , fill_time_ms_(rate != 0 ? capacity_ * 1000 / (rate_ * kTokenUnit) + 1 : 0)
+    , epoch_(std::chrono::steady_clock::now())
+    , shard_mask_(0)
+    , storage_()
+    , shards_(nullptr)
+{
+    // power of two shard count, so the shard is picked with a mask
+    std::size_t shard_cnt = 1;
+    while (shard_cnt * kSlotsPerShard < table_size)
+    {
+        shard_cnt <<= 1;
+    }
+    shard_mask_ = shard_cnt - 1;
+
+    // one shard per cache line, so clients in different shards never share a line
+    auto size = shard_cnt * sizeof(Shard);
+    auto space = size + kShardAlignment;
+    storage_.reset(new char[space]);
+    void* ptr = storage_.get();
+    std::align(kShardAlignment, size, ptr, space);
+    shards_ = static_cast<Shard*>(ptr);
+    for (std::size_t i = 0; i < shard_cnt; ++i)
+    {
+        new (&shards_[i]) Shard();
+    }
+}
+
+bool HttpRateLimiter::allow(uint64_t key_hash)
+{
+    return allow(key_hash, std::chrono::steady_clock::now());
+}
+
+bool HttpRateLimiter::allow(uint64_t key_hash, std::chrono::steady_clock::time_point now)
+{
+    auto now_ms = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(now - epoch_).count());
+    if (key_hash == 0)
+    {
+        key_hash = 1;  // 0 marks an empty slot
+    }
+
+    auto& shard = shards_[key_hash & shard_mask_];
+    Slot* slot = nullptr;
+    for (auto attempt = 0; attempt < 2 && slot == nullptr; ++attempt)
+    {
+        Slot* victim = nullptr;
+        uint64_t victim_key = 0;
+        uint64_t victim_age = 0;
+        for (auto& s : shard.slots_)
+        {
+            auto key = s.key_.load(std::memory_order_acquire);
+            if (key == key_hash)
+            {
+                slot = &s;
+                break;
+            }
+
+            auto age = key == 0 ? std::numeric_limits<uint64_t>::max()
+                                : now_ms - std::min(now_ms, stateTime(s.state_.load(std::memory_order_relaxed)));
+            if (victim == nullptr || age > victim_age)
+            {
+                victim = &s;
+                victim_key = key;
+                victim_age = age;
+            }
+        }
+
+        if (slot != nullptr)
+        {
+            break;
+        }
+
+        // take over an empty slot or the least recently refilled one
+        if (victim->key_.compare_exchange_strong(victim_key, key_hash, std::memory_order_acq_rel))
+        {
+            victim->state_.store(packState(now_ms, capacity_ - std::min(capacity_, kTokenUnit)),
+                                 std::memory_order_release);
+            return capacity_ >= kTokenUnit;
+        }
+        if (victim_key == key_hash)
+        {
+            slot = victim;  // another request of the client took the slot first
+        }
+    }
+
+    if (slot == nullptr)
+    {
+        // the shard is churned by other keys, a client that can't get a bucket is denied, not let through
+        return false;
+    }
+
+    auto state = slot->state_.load(std::memory_order_relaxed);
+    while (true)
+    {
+        auto refilled = refill(state, now_ms);
+        auto allowed = stateTokens(refilled) >= kTokenUnit;
+        auto next = allowed ? refilled - kTokenUnit : refilled;
+        if (next == state ||
+            slot->state_.compare_exchange_weak(state, next, std::memory_order_acq_rel, std::memory_order_relaxed))
+        {
+            return allowed;
+        }
+    }
+}
+
+uint64_t HttpRateLimiter::refill(uint64_t state, uint64_t now_ms) const
+{
+    auto last_ms = stateTime(state);
+    if (now_ms <= last_ms)
+    {
+        // another thread refilled with a later clock reading
+        return state;
+    }
+
+    // an empty bucket is full after fill_time_ms_, longer gaps add nothing and could overflow
+    auto tokens = std::min(now_ms - last_ms, fill_time_ms_) * rate_ * kTokenUnit / 1000;
+    if (tokens == 0)
+    {
+        // keep the old refill time, so the fraction of a unit is not lost
+        return state;
+    }
+    return packState(now_ms, std::min(capacity_, stateTokens(state) + tokens));
+}
+
+uint64_t HttpRateLimiter::hashKey(const void* data, std::size_t size)
+{
+    // fnv-1a followed by a splitmix64 finalizer, the low bits pick the shard
+    auto bytes = static_cast<const unsigned char*>(data);
+    uint64_t hash = 14695981039346656037ULL;
+    for (std::size_t i = 0; i < size; ++i)
+    {
+        hash ^= bytes[i];
+        hash *= 1099511628211ULL;
+    }
+    hash ^= hash >> 30;
+    hash *= 0xbf58476d1ce4e5b9ULL;
+    hash ^= hash >> 27;
+    hash *= 0x94d049bb133111ebULL;
+    hash ^= hash >> 31;
+    return hash;
+}
+
+}  // namespace server
+}  // namespace http
@@ -0,0 +1,85 @@
+/**
+ * @brief Http rate limiter Define
+ * @file http_rate_limiter.h
+ * @copyright Licensed under the Apache License, Version 2.0
+ */
+
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace http
+{
+namespace server
+{
+
+/**
+ * @brief per client token bucket rate limiter with a fixed memory footprint
+ * @note the table is split into cache line sized shards of 4 slots, a client key hashes to one shard
+ * and is only searched there. When a shard is full the slot with the oldest refill time is taken over,
+ * so a flood of new keys can only reset other clients' buckets to full, it never grows the table. A request
+ * losing the takeover race twice is denied, so churn never lets a client through uncharged.
+ * Buckets are updated with a CAS on one 64-bit word, so the limit is approximate under races.
+ */
+class HttpRateLimiter
+{
+public:
+    /**
+     * @param [in] rate: tokens refilled per second
+     * @param [in] burst: bucket capacity, 0 means same as rate
+     * @param [in] table_size: slot count, rounded up to a power of two shard count
+     */
+    HttpRateLimiter(uint32_t rate, uint32_t burst, uint32_t table_size);
+    ~HttpRateLimiter() = default;
+
+    HttpRateLimiter(const HttpRateLimiter&) = delete;
+    HttpRateLimiter& operator=(const HttpRateLimiter&) = delete;
+
+    /**
+     * @brief take one token from the client bucket, threadsafe, lock free
+     * @return false if the client is over its rate
+     */
+    bool allow(uint64_t key_hash);
+
+    /**
+     * @brief same as allow(uint64_t) at the given time, used by tests
+     */
+    bool allow(uint64_t key_hash, std::chrono::steady_clock::time_point now);
+
+    /**
+     * @brief hash client key bytes, such as an ip address or an api key
+     */
+    static uint64_t hashKey(const void* data, std::size_t size);
+
+private:
+    struct Slot
+    {
+        std::atomic<uint64_t> key_{0};    // key hash, 0 means empty
+        std::atomic<uint64_t> state_{0};  // high 40 bits: last refill time in ms, low 24 bits: tokens in 1/64
+    };
+
+    static const std::size_t kSlotsPerShard = 4;
+    static const std::size_t kShardAlignment = 64;
+
+    struct Shard
+    {
+        Slot slots_[kSlotsPerShard];
+    };
+
+    uint64_t refill(uint64_t state, uint64_t now_ms) const;
+
+private:
+    const uint64_t rate_;
+    const uint64_t capacity_;  // burst in 1/64 tokens
+    const uint64_t fill_time_ms_;  // time to refill an empty bucket
+    const std::chrono::steady_clock::time_point epoch_;
+    std::size_t shard_mask_;
+    std::unique_ptr<char[]> storage_;
+    Shard* shards_;
+};
+
+}  // namespace server
+}  // namespace http
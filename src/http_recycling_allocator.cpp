@@ -0,0 +1,105 @@
+#include <new>
+#include "http_recycling_allocator.h"
+
+namespace http
+{
+namespace server
+{
+namespace
+{
+const std::size_t kMinBlockShift = 6;            // 64 bytes
+const std::size_t kClassCount = 8;               // up to 8KB
+const std::size_t kMaxBlockSize = std::size_t(1) << (kMinBlockShift + kClassCount - 1);
+const std::size_t kMaxCachedBytes = 512 * 1024;  // per class and thread
+
+struct FreeBlock
+{
+    FreeBlock* next_;
+};
+
+// trivially destructible, so still usable by objects freed later during thread exit
+thread_local FreeBlock* t_heads[kClassCount] = {};
+thread_local std::size_t t_counts[kClassCount] = {};
+thread_local bool t_closed = false;
+
+struct ThreadCacheCleaner
+{
+    ~ThreadCacheCleaner()
+    {
+        t_closed = true;
+        for (auto& head : t_heads)
+        {
+            while (head != nullptr)
+            {
+                auto block = head;
+                head = head->next_;
+                ::operator delete(block);
+            }
+        }
+    }
+};
+
+void registerThreadCacheCleaner()
+{
+    thread_local ThreadCacheCleaner cleaner;
+    (void)cleaner;
+}
+
+std::size_t classOf(std::size_t size)
+{
+    std::size_t index = 0;
+    while ((std::size_t(1) << (kMinBlockShift + index)) < size)
+    {
+        ++index;
+    }
+    return index;
+}
+}  // namespace
+
+void* HttpRecyclingPool::allocate(std::size_t size)
+{
+    if (size > kMaxBlockSize)
+    {
+        return ::operator new(size);
+    }
+
+    auto index = classOf(size);
+    auto block = t_heads[index];
+    if (block != nullptr)
+    {
+        t_heads[index] = block->next_;
+        --t_counts[index];
+        return block;
+    }
+    return ::operator new(std::size_t(1) << (kMinBlockShift + index));
+}
+
+void HttpRecyclingPool::deallocate(void* pointer, std::size_t size)
+{
+    if (pointer == nullptr)
+    {
+        return;
+    }
+
+    if (size > kMaxBlockSize)
+    {
+        ::operator delete(pointer);
+        return;
+    }
+
+    auto index = classOf(size);
+    if (t_closed || t_counts[index] * (std::size_t(1) << (kMinBlockShift + index)) >= kMaxCachedBytes)
+    {
+        ::operator delete(pointer);
+        return;
+    }
+
+    registerThreadCacheCleaner();
+    auto block = static_cast<FreeBlock*>(pointer);
+    block->next_ = t_heads[index];
+    t_heads[index] = block;
+    ++t_counts[index];
+}
+
+}  // namespace server
+}  // namespace http
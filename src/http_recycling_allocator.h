@@ -0,0 +1,106 @@
+/**
+ * @brief Http recycling allocator Define
+ * @file http_recycling_allocator.h
+ * @copyright Licensed under the Apache License, Version 2.0
+ */
+
+#pragma once
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+
+namespace http
+{
+namespace server
+{
+
+/**
+ * @brief per thread free lists of power of two blocks from 64 bytes to 8KB
+ * @note a freed block goes to the free list of the freeing thread, so blocks migrate between threads
+ * with the objects. Each free list keeps at most 512KB, the rest and larger blocks go back to the heap.
+ */
+class HttpRecyclingPool
+{
+public:
+    static void* allocate(std::size_t size);
+    static void deallocate(void* pointer, std::size_t size);
+};
+
+/**
+ * @brief stateless std allocator on top of HttpRecyclingPool, used for sessions and handler memory
+ */
+template <typename T>
+class HttpRecyclingAllocator
+{
+public:
+    using value_type = T;
+
+    HttpRecyclingAllocator() noexcept = default;
+
+    template <typename U>
+    HttpRecyclingAllocator(const HttpRecyclingAllocator<U>&) noexcept
+    {
+    }
+
+    T* allocate(std::size_t n)
+    {
+        static_assert(alignof(T) <= alignof(std::max_align_t), "over-aligned type is not supported");
+        return static_cast<T*>(HttpRecyclingPool::allocate(n * sizeof(T)));
+    }
+
+    void deallocate(T* pointer, std::size_t n) noexcept
+    {
+        HttpRecyclingPool::deallocate(pointer, n * sizeof(T));
+    }
+
+    template <typename U>
+    bool operator==(const HttpRecyclingAllocator<U>&) const noexcept
+    {
+        return true;
+    }
+
+    template <typename U>
+    bool operator!=(const HttpRecyclingAllocator<U>&) const noexcept
+    {
+        return false;
+    }
+};
+
+/**
+ * @brief completion handler wrapper which associates HttpRecyclingAllocator with the handler,
+ * asio operation state and beast composed operation state are then allocated from the pool.
+ */
+template <typename Handler>
+class HttpAllocHandler
+{
+public:
+    using allocator_type = HttpRecyclingAllocator<Handler>;
+
+    explicit HttpAllocHandler(Handler&& handler)
+        : handler_(std::move(handler))
+    {
+    }
+
+    allocator_type get_allocator() const noexcept
+    {
+        return allocator_type();
+    }
+
+    template <typename... Args>
+    void operator()(Args&&... args)
+    {
+        handler_(std::forward<Args>(args)...);
+    }
+
+private:
+    Handler handler_;
+};
+
+template <typename Handler>
+HttpAllocHandler<typename std::decay<Handler>::type> makeAllocHandler(Handler&& handler)
+{
+    return HttpAllocHandler<typename std::decay<Handler>::type>(std::forward<Handler>(handler));
+}
+
+}  // namespace server
+}  // namespace http
@@ -8,6 +8,11 @@ namespace server
 HttpRequest::HttpRequest(uint64_t session_id, uint64_t request_id)
     : session_id_(session_id)
     , request_id_(request_id)
+    , segments_()
+    , headers_(true)
+    , params_(false)
+    , deadline_(std::chrono::time_point<std::chrono::steady_clock>::max())
+    , cancelled_()
 {
 }
 
@@ -30,12 +35,12 @@ uint64_t HttpRequest::requestId()
     return request_id_;
 }
 
-const std::map<std::string, std::string>& HttpRequest::headers()
+const HttpFields& HttpRequest::headers()
 {
     return headers_;
 }
 
-const std::map<std::string, std::string>& HttpRequest::params()
+const HttpFields& HttpRequest::params()
 {
     return params_;
 }
@@ -45,7 +50,7 @@ const std::string& HttpRequest::body()
     return body_;
 }
 
-const std::list<std::string>& HttpRequest::segments()
+const HttpSegments& HttpRequest::segments()
 {
     return segments_;
 }
@@ -54,5 +59,15 @@ const std::chrono::time_point<std::chrono::steady_clock>& HttpRequest::startTime
 {
     return request_start_time_;
 }
+
+const std::chrono::time_point<std::chrono::steady_clock>& HttpRequest::deadline()
+{
+    return deadline_;
+}
+
+bool HttpRequest::isCancelled()
+{
+    return cancelled_ && cancelled_->load(std::memory_order_relaxed);
+}
 }  // namespace server
 }  // namespace http
\ No newline at end of file
@@ -1,4 +1,7 @@
 #include <cassert>
+#include <stdexcept>
+#include "http_event_stream.h"
+#include "http_response_cache.h"
 #include "http_session.h"
 #include <httpserver/detail/http_response.h>
 
@@ -6,8 +9,22 @@ namespace http
 {
 namespace server
 {
-HttpResponseWriter::HttpResponseWriter(const std::shared_ptr<HttpSession>& session)
+HttpResponseWriter::HttpResponseWriter(const std::shared_ptr<HttpSession>& session, uint64_t request_id)
     : session_(session)
+    , request_id_(request_id)
+    , handler_()
+    , flight_()
+{
+}
+
+HttpResponseWriter::HttpResponseWriter(const std::shared_ptr<HttpSession>& session,
+                                       uint64_t request_id,
+                                       const std::shared_ptr<APIHandler>& handler,
+                                       const std::shared_ptr<HttpResponseFlight>& flight)
+    : session_(session)
+    , request_id_(request_id)
+    , handler_(handler)
+    , flight_(flight)
 {
 }
 
@@ -19,7 +36,21 @@ HttpResponseWriter::~HttpResponseWriter()
 void HttpResponseWriter::send(HttpResponse&& rsp)
 {
     assert(session_);
-    return session_->writeResponse(std::move(rsp));
+    if (flight_)
+    {
+        return flight_->complete(std::move(rsp));
+    }
+    return session_->writeResponse(request_id_, std::move(rsp));
+}
+
+HttpEventStream HttpResponseWriter::startEventStream()
+{
+    assert(session_);
+    if (flight_)
+    {
+        return HttpEventStream();
+    }
+    return HttpEventStream(session_->startEventStream(request_id_));
 }
 
 HttpResponse::HttpResponse(StatusType status, std::string&& body, std::string&& content_type)
@@ -30,7 +61,60 @@ HttpResponse::HttpResponse(StatusType status, std::string&& body, std::string&&
     , compression_level_(CompressionLevel::BestSpeed)
     , body_(std::move(body))
     , headers_()
+    , header_block_()
+    , shared_body_()
+{
+}
+
+HttpResponse::HttpResponse(const HttpResponseTemplate& response_template, std::string&& body)
+    : force_gzip_(false)
+    , force_disable_keep_alive_(false)
+    , status_(response_template.status_)
+    , content_type_()
+    , compression_level_(CompressionLevel::BestSpeed)
+    , body_(std::move(body))
+    , headers_()
+    , header_block_(response_template.header_block_)
+    , shared_body_()
+{
+}
+
+HttpResponseTemplate::HttpResponseTemplate(StatusType status,
+                                           const std::string& content_type,
+                                           const std::map<std::string, std::string>& headers)
+    : status_(status)
+    , header_block_()
+{
+    auto header_block = std::make_shared<std::string>();
+    auto code = static_cast<unsigned int>(status);
+    auto reason = beast::http::obsolete_reason(beast::http::int_to_status(code));
+    header_block->append("HTTP/1.1 ").append(std::to_string(code)).append(" ");
+    header_block->append(reason.data(), reason.size()).append("\r\n");
+
+    auto append_header = [&header_block](const std::string& name, const std::string& value)
+    {
+        if (name.find_first_of("\r\n") != std::string::npos || value.find_first_of("\r\n") != std::string::npos)
+        {
+            throw std::runtime_error("http response template header contains CR or LF: " + name);
+        }
+        header_block->append(name).append(": ").append(value).append("\r\n");
+    };
+
+    append_header("Content-Type", content_type);
+    for (const auto& header : headers)
+    {
+        append_header(header.first, header.second);
+    }
+    header_block_ = std::move(header_block);
+}
+
+HttpResponseTemplate::~HttpResponseTemplate()
+{
+}
+
+StatusType HttpResponseTemplate::status() const
 {
+    return status_;
 }
 
 HttpResponse::~HttpResponse()
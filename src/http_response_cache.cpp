@@ -0,0 +1,400 @@
+#include <algorithm>
+#include <exception>
+#include <functional>
+#include <spdlog/fmt/bundled/core.h>
+#include <boost/algorithm/string/predicate.hpp>
+#include "httpserver/detail/http_log.h"
+#include "http_response_cache.h"
+#include "http_shared_body.h"
+
+namespace http
+{
+namespace server
+{
+namespace
+{
+const uint64_t kMaxCacheTime = 100ULL * 365 * 24 * 3600;  // larger times would overflow steady_clock::duration
+
+// heuristically cacheable status codes of RFC 9110
+bool isStorableStatus(unsigned int status)
+{
+    switch (status)
+    {
+        case 200:
+        case 203:
+        case 204:
+        case 300:
+        case 301:
+        case 308:
+        case 404:
+        case 405:
+        case 410:
+        case 414:
+        case 501:
+            return true;
+        default:
+            return false;
+    }
+}
+
+HttpStringView trimSpace(HttpStringView value)
+{
+    auto begin = value.begin();
+    auto end = value.end();
+    while (begin != end && (*begin == ' ' || *begin == '\t'))
+    {
+        ++begin;
+    }
+    while (end != begin && (*(end - 1) == ' ' || *(end - 1) == '\t'))
+    {
+        --end;
+    }
+    return HttpStringView(begin, static_cast<std::size_t>(end - begin));
+}
+
+// the opaque tag without the weak indicator, for the weak comparison
+HttpStringView opaqueTag(HttpStringView etag)
+{
+    if (etag.size() >= 2 && etag[0] == 'W' && etag[1] == '/')
+    {
+        return HttpStringView(etag.data() + 2, etag.size() - 2);
+    }
+    return etag;
+}
+}  // namespace
+
+HttpResponseFlight::HttpResponseFlight(std::shared_ptr<HttpResponseCache> cache,
+                                       std::string key,
+                                       std::size_t shard_index)
+    : cache_(std::move(cache))
+    , key_(std::move(key))
+    , shard_index_(shard_index)
+    , done_(false)
+    , waiters_()
+{
+}
+
+HttpResponseFlight::~HttpResponseFlight()
+{
+    // the handler dropped its writer without answering, the parked requests shouldn't wait for their deadline
+    complete(HttpResponse(StatusType::Service_Temporary_Unavailable, "", "text/plain"));
+}
+
+void HttpResponseFlight::complete(HttpResponse&& rsp)
+{
+    cache_->finishFlight(*this, std::move(rsp));
+}
+
+HttpResponseCache::HttpResponseCache(std::shared_ptr<APIHandler> handler,
+                                     const HttpCacheOptions& opts,
+                                     HttpStatisticsInternal& statistics)
+    : handler_(std::move(handler))
+    , opts_(opts)
+    , statistics_(statistics)
+    , ttl_(std::chrono::seconds(std::min(opts.ttl_, kMaxCacheTime)))
+    , stale_ttl_(ttl_ + std::chrono::seconds(std::min(opts.stale_while_revalidate_, kMaxCacheTime)))
+    , shard_max_entry_num_(0)
+    , shards_()
+{
+    auto shard_num = std::max<uint32_t>(opts_.shard_num_, 1);
+    shard_max_entry_num_ = (opts_.max_entry_num_ + shard_num - 1) / shard_num;
+    for (uint32_t i = 0; i < shard_num; ++i)
+    {
+        shards_.emplace_back(new Shard());
+    }
+}
+
+HttpResponseCache::~HttpResponseCache()
+{
+}
+
+void HttpResponseCache::handle(HttpRequest&& request, HttpResponseWriter&& response_writer) noexcept
+{
+    auto method = request.method();
+    if (method != MethodType::GET && method != MethodType::HEAD)
+    {
+        return handler_->handle(std::move(request), std::move(response_writer));
+    }
+
+    std::string key;
+    std::string if_none_match;
+    try
+    {
+        key = makeKey(request);
+        auto iter = request.headers().find("If-None-Match");
+        if (iter != request.headers().end())
+        {
+            if_none_match = iter->second.toString();
+        }
+    }
+    catch (const std::exception& e)
+    {
+        LOG_LOGGER_ERROR(fmt::format("response cache key fail: {}", e.what()));
+        return handler_->handle(std::move(request), std::move(response_writer));
+    }
+
+    auto shard_index = std::hash<std::string>()(key) % shards_.size();
+    auto& shard = *shards_[shard_index];
+    auto now = std::chrono::steady_clock::now();
+    std::shared_ptr<const Stored> stored;
+    std::shared_ptr<HttpResponseFlight> flight;
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex_);
+        auto iter = shard.entries_.find(key);
+        if (iter != shard.entries_.end())
+        {
+            if (now - iter->second.stored_->stored_time_ < stale_ttl_)
+            {
+                stored = iter->second.stored_;
+                shard.lru_.splice(shard.lru_.begin(), shard.lru_, iter->second.lru_iter_);
+            }
+            else
+            {
+                shard.lru_.erase(iter->second.lru_iter_);
+                shard.entries_.erase(iter);
+            }
+        }
+
+        auto flight_iter = shard.flights_.find(key);
+        if (!stored && flight_iter != shard.flights_.end())
+        {
+            flight_iter->second->waiters_.push_back({std::move(response_writer), std::move(if_none_match)});
+            ++statistics_.coalesced_request_cnt_;
+            return;
+        }
+
+        // a stale response is refreshed by one handler call, it's served until the new one is stored
+        if (!stored || (now - stored->stored_time_ >= ttl_ && flight_iter == shard.flights_.end()))
+        {
+            flight = std::make_shared<HttpResponseFlight>(shared_from_this(), key, shard_index);
+            shard.flights_.emplace(key, flight.get());
+            if (!stored)
+            {
+                flight->waiters_.push_back({response_writer, if_none_match});
+            }
+        }
+    }
+
+    if (stored)
+    {
+        ++statistics_.cache_hit_cnt_;
+        respond(*stored, if_none_match, response_writer);
+    }
+    else
+    {
+        ++statistics_.cache_miss_cnt_;
+    }
+
+    if (flight)
+    {
+        handler_->handle(std::move(request),
+                         HttpResponseWriter(response_writer.session_,
+                                            response_writer.request_id_,
+                                            response_writer.handler_,
+                                            flight));
+    }
+}
+
+std::string HttpResponseCache::makeKey(HttpRequest& request) const
+{
+    std::string key;
+    auto append = [&key](HttpStringView part)
+    {
+        key.append(std::to_string(part.size())).push_back(':');
+        key.append(part.data(), part.size());
+    };
+
+    key.append(std::to_string(static_cast<int>(request.method())));
+    for (const auto& segment : request.segments())
+    {
+        key.push_back('/');
+        append(segment);
+    }
+
+    // the fields are sorted by name with one value per name, so the parameter order doesn't matter
+    key.push_back('?');
+    for (const auto& param : request.params())
+    {
+        append(param.first);
+        append(param.second);
+    }
+
+    const auto& headers = request.headers();
+    for (const auto& name : opts_.vary_headers_)
+    {
+        key.push_back('|');
+        auto iter = headers.find(name);
+        if (iter == headers.end())
+        {
+            key.push_back('-');
+            continue;
+        }
+        append(iter->second);
+    }
+    return key;
+}
+
+bool HttpResponseCache::matchETag(HttpStringView if_none_match, const std::string& etag)
+{
+    auto target = opaqueTag(etag);
+    auto begin = if_none_match.begin();
+    for (;;)
+    {
+        auto end = std::find(begin, if_none_match.end(), ',');
+        auto tag = trimSpace(HttpStringView(begin, static_cast<std::size_t>(end - begin)));
+        if (tag == "*" || (!tag.empty() && opaqueTag(tag) == target))
+        {
+            return true;
+        }
+        if (end == if_none_match.end())
+        {
+            return false;
+        }
+        begin = end + 1;
+    }
+}
+
+void HttpResponseCache::finishFlight(HttpResponseFlight& flight, HttpResponse&& rsp)
+{
+    std::shared_ptr<const Stored> stored;
+    try
+    {
+        stored = makeStored(std::move(rsp));
+    }
+    catch (const std::exception& e)
+    {
+        LOG_LOGGER_ERROR(fmt::format("response cache store fail: {}", e.what()));
+        return;
+    }
+
+    auto& shard = *shards_[flight.shard_index_];
+    std::vector<HttpResponseFlight::Waiter> waiters;
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex_);
+        if (flight.done_)
+        {
+            return;
+        }
+        flight.done_ = true;
+        shard.flights_.erase(flight.key_);
+        waiters.swap(flight.waiters_);
+        if (!stored->etag_.empty())
+        {
+            store(shard, flight.key_, stored);
+        }
+    }
+
+    // the lock isn't held while the responses are copied
+    for (auto& waiter : waiters)
+    {
+        respond(*stored, waiter.if_none_match_, waiter.response_writer_);
+    }
+}
+
+std::shared_ptr<const HttpResponseCache::Stored> HttpResponseCache::makeStored(HttpResponse&& rsp) const
+{
+    auto stored = std::make_shared<Stored>(Stored{std::move(rsp), "", std::chrono::steady_clock::now()});
+    auto& response = stored->response_;
+    std::string value;
+    auto storable = stale_ttl_ != std::chrono::steady_clock::duration::zero() && shard_max_entry_num_ != 0 &&
+                    isStorableStatus(static_cast<unsigned int>(response.status_)) &&
+                    response.body_.size() <= opts_.max_body_size_ && !findHeader(response, "Set-Cookie", value) &&
+                    !(findHeader(response, "Cache-Control", value) &&
+                      (boost::icontains(value, "no-store") || boost::icontains(value, "private")));
+    if (storable)
+    {
+        if (findHeader(response, "ETag", value))
+        {
+            stored->etag_ = value;
+        }
+        else
+        {
+            stored->etag_ = fmt::format("W/\"{:016x}\"", std::hash<std::string>()(response.body_));
+            response.header("ETag", stored->etag_);
+        }
+
+        // tell downstream caches the response depends on the same headers as the key
+        if (!opts_.vary_headers_.empty() && !findHeader(response, "Vary", value))
+        {
+            std::string vary;
+            for (const auto& name : opts_.vary_headers_)
+            {
+                vary.append(vary.empty() ? "" : ", ").append(name);
+            }
+            response.header("Vary", vary);
+        }
+    }
+
+    // the copies answering the requests share the body, and its gzipped form once a session made it
+    response.shared_body_ = std::make_shared<HttpSharedBody>(std::move(response.body_), response.compression_level_);
+    response.body_.clear();
+    return stored;
+}
+
+bool HttpResponseCache::findHeader(const HttpResponse& rsp, HttpStringView name, std::string& value)
+{
+    for (const auto& header : rsp.headers_)
+    {
+        if (name.iequals(header.first))
+        {
+            value = header.second;
+            return true;
+        }
+    }
+    if (!rsp.header_block_)
+    {
+        return false;
+    }
+
+    // the header block of a template, the status line is skipped as it has no colon before its CRLF
+    const auto& block = *rsp.header_block_;
+    std::size_t line_begin = 0;
+    while (line_begin < block.size())
+    {
+        auto line_end = block.find("\r\n", line_begin);
+        line_end = line_end == std::string::npos ? block.size() : line_end;
+        auto colon = block.find(':', line_begin);
+        if (colon < line_end && name.iequals(HttpStringView(block.data() + line_begin, colon - line_begin)))
+        {
+            value = trimSpace(HttpStringView(block.data() + colon + 1, line_end - colon - 1)).toString();
+            return true;
+        }
+        line_begin = line_end + 2;
+    }
+    return false;
+}
+
+void HttpResponseCache::store(Shard& shard, const std::string& key, const std::shared_ptr<const Stored>& stored)
+{
+    auto iter = shard.entries_.find(key);
+    if (iter != shard.entries_.end())
+    {
+        iter->second.stored_ = stored;
+        shard.lru_.splice(shard.lru_.begin(), shard.lru_, iter->second.lru_iter_);
+        return;
+    }
+
+    shard.lru_.push_front(key);
+    shard.entries_.emplace(key, Entry{stored, shard.lru_.begin()});
+    while (shard.entries_.size() > shard_max_entry_num_)
+    {
+        shard.entries_.erase(shard.lru_.back());
+        shard.lru_.pop_back();
+    }
+}
+
+void HttpResponseCache::respond(const Stored& stored,
+                                const std::string& if_none_match,
+                                HttpResponseWriter& response_writer)
+{
+    if (!stored.etag_.empty() && !if_none_match.empty() && matchETag(if_none_match, stored.etag_))
+    {
+        HttpResponse rsp(StatusType::Not_Modified, "", "");
+        rsp.header("ETag", stored.etag_);
+        return response_writer.send(std::move(rsp));
+    }
+    response_writer.send(HttpResponse(stored.response_));
+}
+
+}  // namespace server
+}  // namespace http
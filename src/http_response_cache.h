@@ -0,0 +1,129 @@
+/**
+ * @brief Http response cache Define
+ * @file http_response_cache.h
+ * @copyright Licensed under the Apache License, Version 2.0
+ */
+
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <httpserver/http_server.h>
+#include "http_statistics_internal.h"
+
+namespace http
+{
+namespace server
+{
+class HttpResponseCache;
+
+/**
+ * @brief one handler call whose response answers every request parked on its key
+ * @note the HttpResponseWriter given to the handler holds it, if the last copy of the writer is dropped without
+ * send() the parked requests get a 503
+ */
+struct HttpResponseFlight
+{
+    struct Waiter
+    {
+        HttpResponseWriter response_writer_;
+        std::string if_none_match_;
+    };
+
+    HttpResponseFlight(std::shared_ptr<HttpResponseCache> cache, std::string key, std::size_t shard_index);
+    ~HttpResponseFlight();
+
+    /**
+     * @brief take the response of the handler, threadsafe, later calls are ignored
+     */
+    void complete(HttpResponse&& rsp);
+
+    std::shared_ptr<HttpResponseCache> cache_;  // the route may be removed while the handler runs
+    const std::string key_;
+    const std::size_t shard_index_;
+    bool done_;  // guarded by the shard lock like waiters_
+    std::vector<Waiter> waiters_;
+};
+
+/**
+ * @brief in-memory response cache in front of the APIHandler of a route
+ * @note GET and HEAD requests are keyed by method, path, parameters sorted by name and the values of
+ * HttpCacheOptions::vary_headers_, other methods go to the handler directly. Concurrent misses of a key are
+ * parked on one handler call, they get copies of its response sharing one body, gzipped at most once. With
+ * ttl_ and stale_while_revalidate_ 0 nothing is stored, only the requests in flight are coalesced. A 200, 203, 204, 300, 301, 308, 404, 405, 410, 414 or 501 response is stored unless
+ * it carries Set-Cookie or "Cache-Control: no-store" or "private", it gets a weak ETag of its body unless it has
+ * one, so a matching If-None-Match is answered with 304. The handler should answer unconditionally.
+ */
+class HttpResponseCache final : public APIHandler, public std::enable_shared_from_this<HttpResponseCache>
+{
+public:
+    /**
+     * @note make it with std::make_shared, the handler calls of the misses hold it
+     */
+    HttpResponseCache(std::shared_ptr<APIHandler> handler,
+                      const HttpCacheOptions& opts,
+                      HttpStatisticsInternal& statistics);
+    ~HttpResponseCache();
+
+    HttpResponseCache(const HttpResponseCache&) = delete;
+    HttpResponseCache& operator=(const HttpResponseCache&) = delete;
+
+    void handle(HttpRequest&& request, HttpResponseWriter&& response_writer) noexcept override;
+
+    /**
+     * @brief return the key of the request, the parts are length prefixed so they can't run into each other
+     */
+    std::string makeKey(HttpRequest& request) const;
+
+    /**
+     * @brief return whether the If-None-Match list names the etag, weak comparison
+     */
+    static bool matchETag(HttpStringView if_none_match, const std::string& etag);
+
+private:
+    friend struct HttpResponseFlight;
+
+    struct Stored
+    {
+        HttpResponse response_;
+        std::string etag_;  // empty for a response which isn't stored
+        std::chrono::steady_clock::time_point stored_time_;
+    };
+
+    struct Entry
+    {
+        std::shared_ptr<const Stored> stored_;
+        std::list<std::string>::iterator lru_iter_;
+    };
+
+    struct Shard
+    {
+        std::mutex mutex_;
+        std::unordered_map<std::string, Entry> entries_;
+        std::list<std::string> lru_;  // keys of entries_, most recently used first
+        std::unordered_map<std::string, HttpResponseFlight*> flights_;  // a flight erases itself once done
+    };
+
+    void finishFlight(HttpResponseFlight& flight, HttpResponse&& rsp);
+    std::shared_ptr<const Stored> makeStored(HttpResponse&& rsp) const;
+    static bool findHeader(const HttpResponse& rsp, HttpStringView name, std::string& value);
+    void store(Shard& shard, const std::string& key, const std::shared_ptr<const Stored>& stored);
+    static void respond(const Stored& stored, const std::string& if_none_match, HttpResponseWriter& response_writer);
+
+private:
+    std::shared_ptr<APIHandler> handler_;
+    const HttpCacheOptions opts_;
+    HttpStatisticsInternal& statistics_;
+    const std::chrono::steady_clock::duration ttl_;
+    const std::chrono::steady_clock::duration stale_ttl_;  // ttl_ plus stale_while_revalidate_
+    std::size_t shard_max_entry_num_;
+    std::vector<std::unique_ptr<Shard>> shards_;
+};
+
+}  // namespace server
+}  // namespace http
@@ -0,0 +1,76 @@
+#include <stdexcept>
+#include <httpserver/detail/http_route_update.h>
+#include "http_coroutine_adapter.h"
+
+namespace http
+{
+namespace server
+{
+HttpRouteUpdate::HttpRouteUpdate()
+    : clear_(false)
+    , changes_()
+{
+}
+
+HttpRouteUpdate::~HttpRouteUpdate()
+{
+}
+
+HttpRouteUpdate& HttpRouteUpdate::add(const std::string& path, std::shared_ptr<APIHandler> handler)
+{
+    if (!handler)
+    {
+        throw std::runtime_error("handler should be not empty");
+    }
+    changes_.push_back(Change{path, std::move(handler), nullptr, false, HttpCacheOptions()});
+    return *this;
+}
+
+HttpRouteUpdate& HttpRouteUpdate::add(const std::string& path,
+                                      std::shared_ptr<APIHandler> handler,
+                                      const HttpCacheOptions& cache_opts)
+{
+    if (!handler)
+    {
+        throw std::runtime_error("handler should be not empty");
+    }
+    changes_.push_back(Change{path, std::move(handler), nullptr, true, cache_opts});
+    return *this;
+}
+
+HttpRouteUpdate& HttpRouteUpdate::add(const std::string& path, std::shared_ptr<WebSocketHandler> handler)
+{
+    if (!handler)
+    {
+        throw std::runtime_error("handler should be not empty");
+    }
+    changes_.push_back(Change{path, nullptr, std::move(handler), false, HttpCacheOptions()});
+    return *this;
+}
+
+#if defined(HTTP_SERVER_COROUTINE)
+HttpRouteUpdate& HttpRouteUpdate::add(const std::string& path, std::shared_ptr<CoroutineHandler> handler)
+{
+    if (!handler)
+    {
+        throw std::runtime_error("handler should be not empty");
+    }
+    return add(path, std::make_shared<HttpCoroutineAdapter>(std::move(handler)));
+}
+#endif
+
+HttpRouteUpdate& HttpRouteUpdate::remove(const std::string& path)
+{
+    changes_.push_back(Change{path, nullptr, nullptr, false, HttpCacheOptions()});
+    return *this;
+}
+
+HttpRouteUpdate& HttpRouteUpdate::clear()
+{
+    clear_ = true;
+    changes_.clear();
+    return *this;
+}
+
+}  // namespace server
+}  // namespace http
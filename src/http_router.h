@@ -8,6 +8,7 @@
 #include <string>
 #include <unordered_map>
 #include "http_common.h"
+#include "httpserver/detail/http_log.h"
 
 namespace http
 {
@@ -117,7 +118,7 @@ public:
         next_node->data_ = data;
     };
 
-    T* search(urls::segments_view segments)
+    T* search(urls::segments_view segments) const
     {
         if (segments.size() == 0)
         {
@@ -153,7 +154,7 @@ public:
         }
     }
 
-    T* search(beast::string_view path)
+    T* search(beast::string_view path) const
     {
         if (path.size() == 0)
         {
@@ -0,0 +1,91 @@
+#include <algorithm>
+#include <stdexcept>
+#include "http_routes.h"
+
+namespace http
+{
+namespace server
+{
+HttpRouteTable::HttpRouteTable(Routes routes)
+    : routes_(std::move(routes))
+    , router_()
+    , websocket_router_()
+{
+    for (const auto& route : routes_)
+    {
+        if (route.second.handler_)
+        {
+            router_.insert(route.first, &route.second);
+        }
+        if (route.second.websocket_handler_)
+        {
+            websocket_router_.insert(route.first, &route.second);
+        }
+    }
+}
+
+HttpRoutes::Reader::Reader(HttpEpochDomain& domain, const std::atomic<const HttpRouteTable*>& table)
+    : guard_(domain)
+    , table_(table.load(std::memory_order_seq_cst))
+{
+}
+
+HttpRoutes::HttpRoutes(HttpEpochDomain& domain)
+    : domain_(domain)
+    , update_mutex_()
+    , table_(new HttpRouteTable(HttpRouteTable::Routes()))
+{
+}
+
+HttpRoutes::~HttpRoutes()
+{
+    delete table_.load();
+}
+
+HttpRoutes::Reader HttpRoutes::read() const
+{
+    return Reader(domain_, table_);
+}
+
+void HttpRoutes::update(const std::function<void(HttpRouteTable::Routes&)>& edit)
+{
+    std::lock_guard<std::mutex> lock(update_mutex_);
+    auto routes = table_.load()->routes_;
+    edit(routes);
+    std::unique_ptr<const HttpRouteTable> table(new HttpRouteTable(std::move(routes)));
+
+    std::shared_ptr<const HttpRouteTable> retired(table_.exchange(table.release(), std::memory_order_seq_cst));
+    domain_.retire(std::move(retired));
+    domain_.reclaim();
+}
+
+std::string HttpRoutes::normalizePath(const std::string& path)
+{
+    if (path.empty() || path[0] != '/')
+    {
+        throw std::runtime_error("path should start with '/'");
+    }
+
+    if (path.find("..") != std::string::npos)
+    {
+        throw std::runtime_error("path is invalid");
+    }
+
+    // the encoded segments up to the first empty one, as HttpRouter matches them
+    std::string key;
+    std::size_t begin = 1;
+    while (begin < path.size())
+    {
+        auto end = std::min(path.find('/', begin), path.size());
+        if (end == begin)
+        {
+            break;
+        }
+        key.append(path, begin - 1, end - begin + 1);
+        begin = end + 1;
+    }
+    return key.empty() ? "/" : key;
+}
+
+}  // namespace server
+}  // namespace http
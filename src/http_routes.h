@@ -0,0 +1,107 @@
+/**
+ * @brief Http route table Define
+ * @file http_routes.h
+ * @copyright Licensed under the Apache License, Version 2.0
+ */
+
+#pragma once
+#include <atomic>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <httpserver/http_server.h>
+#include "http_epoch.h"
+#include "http_router.h"
+
+namespace http
+{
+namespace server
+{
+
+/**
+ * @brief immutable routes of a listener, a new table is built for every update
+ */
+struct HttpRouteTable
+{
+    struct Route
+    {
+        std::shared_ptr<APIHandler> handler_;
+        std::shared_ptr<WebSocketHandler> websocket_handler_;
+    };
+    using Routes = std::map<std::string, Route>;  // by path as returned by HttpRoutes::normalizePath()
+
+    /**
+     * @brief build the routers of the routes, throw std::runtime_error if a path is invalid
+     */
+    explicit HttpRouteTable(Routes routes);
+
+    HttpRouteTable(const HttpRouteTable&) = delete;
+    HttpRouteTable& operator=(const HttpRouteTable&) = delete;
+
+    const Routes routes_;
+    HttpRouter<const Route> router_;  // routes with a handler_
+    HttpRouter<const Route> websocket_router_;  // routes with a websocket_handler_
+};
+
+/**
+ * @brief the current route table of a listener, read by the io threads without locks
+ * @note an update copies the routes, edits the copy and publishes the table built from it through an atomic
+ * pointer. The table being replaced is retired to the epoch domain, it's freed with the handlers only it refers
+ * to once every io thread which was reading it has left its read section.
+ */
+class HttpRoutes
+{
+public:
+    /**
+     * @brief the table current when the reader was made, valid as long as the reader lives
+     */
+    class Reader
+    {
+    public:
+        Reader(HttpEpochDomain& domain, const std::atomic<const HttpRouteTable*>& table);
+
+        const HttpRouteTable* operator->() const
+        {
+            return table_;
+        }
+
+    private:
+        HttpEpochDomain::Guard guard_;
+        const HttpRouteTable* table_;
+    };
+
+    explicit HttpRoutes(HttpEpochDomain& domain);
+    ~HttpRoutes();
+
+    HttpRoutes(const HttpRoutes&) = delete;
+    HttpRoutes& operator=(const HttpRoutes&) = delete;
+
+    /**
+     * @brief read the current table, threadsafe, lock free
+     * @note keep the reader on the stack of the callback, an io thread holding it across callbacks delays
+     * the reclamation of every retired table
+     */
+    Reader read() const;
+
+    /**
+     * @brief copy the routes, edit the copy and publish it, threadsafe, updates are serialized
+     * @note nothing is published if edit or a path throws
+     */
+    void update(const std::function<void(HttpRouteTable::Routes&)>& edit);
+
+    /**
+     * @brief return the route key of a handler path, "/test/" and "/test" are the same key
+     * @throw std::runtime_error if the path doesn't start with '/' or contains ".."
+     */
+    static std::string normalizePath(const std::string& path);
+
+private:
+    HttpEpochDomain& domain_;
+    std::mutex update_mutex_;
+    std::atomic<const HttpRouteTable*> table_;
+};
+
+}  // namespace server
+}  // namespace http
@@ -11,6 +11,16 @@ APIHandler::~APIHandler()
 {
 }
 
+WebSocketHandler::~WebSocketHandler()
+{
+}
+
+#if defined(HTTP_SERVER_COROUTINE)
+CoroutineHandler::~CoroutineHandler()
+{
+}
+#endif
+
 HttpServer::HttpServer(HttpServerOptions opts)
     : server_impl_(std::make_shared<HttpServerImpl>(std::move(opts)))
 {
@@ -32,10 +42,81 @@ void HttpServer::stop()
     return server_impl_->stop();
 }
 
+bool HttpServer::drain(uint64_t time_out)
+{
+    assert(server_impl_);
+    return server_impl_->drain(time_out);
+}
+
+uint32_t HttpServer::addListener(HttpServerOptions opts)
+{
+    assert(server_impl_);
+    return server_impl_->addListener(std::move(opts));
+}
+
 void HttpServer::registerHandler(const std::string& path, APIHandler* handler)
 {
     assert(server_impl_);
-    return server_impl_->registerHandler(path, handler);
+    return server_impl_->registerHandler(0, path, handler);
+}
+
+void HttpServer::registerHandler(uint32_t listener_id, const std::string& path, APIHandler* handler)
+{
+    assert(server_impl_);
+    return server_impl_->registerHandler(listener_id, path, handler);
+}
+
+void HttpServer::registerHandler(const std::string& path, APIHandler* handler, const HttpCacheOptions& cache_opts)
+{
+    assert(server_impl_);
+    return server_impl_->registerHandler(0, path, handler, cache_opts);
+}
+
+void HttpServer::registerHandler(uint32_t listener_id,
+                                 const std::string& path,
+                                 APIHandler* handler,
+                                 const HttpCacheOptions& cache_opts)
+{
+    assert(server_impl_);
+    return server_impl_->registerHandler(listener_id, path, handler, cache_opts);
+}
+
+void HttpServer::registerHandler(const std::string& path, WebSocketHandler* handler)
+{
+    assert(server_impl_);
+    return server_impl_->registerHandler(0, path, handler);
+}
+
+void HttpServer::registerHandler(uint32_t listener_id, const std::string& path, WebSocketHandler* handler)
+{
+    assert(server_impl_);
+    return server_impl_->registerHandler(listener_id, path, handler);
+}
+
+#if defined(HTTP_SERVER_COROUTINE)
+void HttpServer::registerHandler(const std::string& path, CoroutineHandler* handler)
+{
+    assert(server_impl_);
+    return server_impl_->registerHandler(0, path, handler);
+}
+
+void HttpServer::registerHandler(uint32_t listener_id, const std::string& path, CoroutineHandler* handler)
+{
+    assert(server_impl_);
+    return server_impl_->registerHandler(listener_id, path, handler);
+}
+#endif
+
+void HttpServer::updateRoutes(const HttpRouteUpdate& update)
+{
+    assert(server_impl_);
+    return server_impl_->updateRoutes(0, update);
+}
+
+void HttpServer::updateRoutes(uint32_t listener_id, const HttpRouteUpdate& update)
+{
+    assert(server_impl_);
+    return server_impl_->updateRoutes(listener_id, update);
 }
 
 HttpStatistics HttpServer::getHttpStatistics()
@@ -2,25 +2,99 @@
 #include <stdexcept>
 #include "httpserver/detail/http_log.h"
 #include "http_server_impl.h"
+#include "http_canned_response.h"
+#include "http_coroutine_adapter.h"
+#include "http_response_cache.h"
 #include "http_session.h"
 
 namespace http
 {
 namespace server
 {
+namespace
+{
+const uint32_t kAdaptiveInitialLimit = 100;   // adaptive limiter start point
+const uint32_t kAdaptiveMaxLimit = 10000;     // adaptive limiter upper bound when max_working_handler_num_ is 0
+const std::chrono::milliseconds kWheelTick(100);  // session timeout granularity
+const std::chrono::milliseconds kDrainPollInterval(10);  // drain() session count check interval
+}  // namespace
+
+HttpServerImpl::ListenerContext::ListenerContext(HttpServerOptions opts,
+                                                 HttpStatisticsInternal& statistics,
+                                                 HttpConcurrencyLimiter& concurrency_limiter,
+                                                 HttpEpochDomain& epoch_domain)
+    : opts_(std::move(opts))
+    , routes_(epoch_domain)
+    , rate_limiter_(opts_.rate_limit_qps_,
+                    opts_.rate_limit_burst_,
+                    opts_.rate_limit_qps_ != 0 ? opts_.rate_limit_table_size_ : 0)
+    , tls_context_()
+    , session_pool_(std::make_shared<HttpSessionPool>(routes_,
+                                                      opts_,
+                                                      statistics,
+                                                      concurrency_limiter,
+                                                      rate_limiter_))
+    , sockets_()
+{
+}
 
 HttpServerImpl::HttpServerImpl(HttpServerOptions opts)
     : opts_(std::move(opts))
-    , router_()
+    , epoch_domain_()
+    , concurrency_limiter_(kAdaptiveInitialLimit,
+                           1,
+                           opts_.max_working_handler_num_ != 0 ? opts_.max_working_handler_num_ : kAdaptiveMaxLimit)
+    , timing_wheels_()
+    , next_wheel_index_(0)
     , io_context_(opts_.thread_num_)
-    , acceptor_(boost::asio::make_strand(io_context_))
+    , wheel_timers_()
+    , uring_services_()
+    , listeners_()
     , io_thread_pool_()
 {
+    listeners_.emplace_back(new ListenerContext(opts_, http_statistics_, concurrency_limiter_, epoch_domain_));
+
+    // sessions are spread over the wheels, so timer updates from different io threads rarely share a lock
+    for (uint32_t i = 0; i < std::max<uint32_t>(opts_.thread_num_, 1); ++i)
+    {
+        timing_wheels_.emplace_back(new HttpTimingWheel(kWheelTick));
+        wheel_timers_.emplace_back(new net::steady_timer(io_context_));
+    }
+
+    // TLS connections always use the reactor, the plaintext ones of the same server still get io_uring
+    if (opts_.io_backend_ == IoBackend::IoUring)
+    {
+        if (HttpUringService::supported())
+        {
+            // as many rings as io threads, the connections are sharded over them round-robin. A ring isn't bound to a
+            // thread, any io thread submits to and reaps it under its lock, so the threads only contend per shard
+            auto ring_num = static_cast<uint32_t>(timing_wheels_.size());
+            auto buffer_num = (opts_.io_uring_buffer_num_ + ring_num - 1) / ring_num;
+            for (uint32_t i = 0; i < ring_num; ++i)
+            {
+                uring_services_.push_back(
+                    std::make_shared<HttpUringService>(io_context_, buffer_num, opts_.io_uring_buffer_size_));
+            }
+        }
+        else
+        {
+            LOG_LOGGER_WARN("io_uring is not supported by the kernel or the build, use epoll");
+        }
+    }
     io_context_.stop();
 }
 
 HttpServerImpl::~HttpServerImpl()
 {
+    for (auto& context : listeners_)
+    {
+        context->session_pool_->clear();
+    }
+    // the pending handlers own sessions, they go before the io_context
+    for (auto& service : uring_services_)
+    {
+        service->shutdown();
+    }
     LOG_LOGGER_INFO("HttpServerImpl destroyed");
 }
 
@@ -31,66 +105,36 @@ void HttpServerImpl::run()
         throw std::runtime_error("thread count should > 0");
     }
 
-    if (opts_.max_request_size_ == 0)
-    {
-        throw std::runtime_error("max request should > 0");
-    }
-
-    if (opts_.addr_.empty())
-    {
-        throw std::runtime_error("addr is empty");
-    }
-
-    HttpSession::s_id.store(0);  // reset global session id
-    resetAllHttpStatistics();    // reset all http statics
+    HttpSession::s_id.store(0);     // reset global session id
+    resetAllHttpStatistics();       // reset all http statics
+    concurrency_limiter_.reset();   // reset adaptive limit
 
     io_context_.restart();
-    auto endpoint = tcp::endpoint{net::ip::make_address(opts_.addr_), opts_.port_};
-    beast::error_code ec;
-    acceptor_.open(endpoint.protocol(), ec);
-    if (ec)
+    for (auto& context : listeners_)
     {
-        throw std::runtime_error(ec.message());
+        openListener(*context);
     }
 
-    // address reuse
-    acceptor_.set_option(net::socket_base::reuse_address(true), ec);
-    if (ec)
+    for (auto& context : listeners_)
     {
-        throw std::runtime_error(ec.message());
+        for (auto& listener : context->sockets_)
+        {
+            // several accepts wait on the socket, one wakeup of the reactor completes as many as are pending
+            for (uint32_t i = 0; i < std::max<uint32_t>(context->opts_.accept_num_, 1); ++i)
+            {
+                doAccept(context.get(), listener.get());
+            }
+        }
     }
-
-    acceptor_.set_option(net::socket_base::linger(false, 1), ec);
-    if (ec)
+    for (auto& service : uring_services_)
     {
-        throw std::runtime_error(ec.message());
+        service->start();
     }
-
-    // bind to the server address
-    acceptor_.bind(endpoint, ec);
-    if (ec)
+    for (std::size_t i = 0; i < wheel_timers_.size(); ++i)
     {
-        throw std::runtime_error(ec.message());
+        doTick(i);
     }
 
-    // start listening for connections
-    acceptor_.listen(1024, ec);
-    if (ec)
-    {
-        throw std::runtime_error(ec.message());
-    }
-
-    LOG_LOGGER_INFO(fmt::format("start listen on: {}, thread_num: {}, read_time_out: {}s, write_time_out: {}s, auto_gzip: {}, max_request_size: {}KB auto_decode_url_parameters: {}",
-                                endpoint.address().to_string() + ":" + std::to_string(endpoint.port()),
-                                opts_.thread_num_,
-                                opts_.read_time_out_,
-                                opts_.write_time_out_,
-                                opts_.auto_gzip_,
-                                opts_.max_request_size_ / 1024,
-                                opts_.auto_decode_url_parameters_));
-
-    doAccept();
-
     for (auto i = 0; i < opts_.thread_num_ - 1; ++i)
     {
         io_thread_pool_.emplace_back([this] { this->io_context_.run(); });
@@ -116,40 +160,329 @@ void HttpServerImpl::stop()
         io_thread_pool_.clear();
     }
 
-    if (acceptor_.is_open())
+    // drop the pending ticks, run() starts new ones
+    for (auto& timer : wheel_timers_)
     {
-        beast::error_code ec;
-        acceptor_.close();
-        if (ec)
+        timer->cancel();
+    }
+
+    for (auto& service : uring_services_)
+    {
+        service->stop();
+    }
+
+    // the io threads are joined, so the listeners are closed off their strands
+    for (auto& context : listeners_)
+    {
+        for (auto& listener : context->sockets_)
         {
-            throw std::runtime_error(ec.message());
+            listener->close();
         }
     }
 
     LOG_LOGGER_INFO("HttpServerImpl end stop");
 }
 
-void HttpServerImpl::registerHandler(const std::string& path, APIHandler* handler)
+bool HttpServerImpl::drain(uint64_t time_out)
 {
-    router_.insert(path, handler);
+    LOG_LOGGER_INFO(fmt::format("HttpServerImpl begin drain, time_out: {}s", time_out));
+    http_statistics_.draining_.store(true);
+
+    // refuse new connections, the pending accepts complete with operation_aborted
+    auto self = shared_from_this();
+    for (auto& context : listeners_)
+    {
+        for (auto& listener : context->sockets_)
+        {
+            auto listener_ptr = listener.get();
+            net::post(listener->get_executor(), [self, listener_ptr]() { listener_ptr->close(); });
+        }
+    }
+
+    // idle keep-alive sessions always have an armed idle timer, expiring it closes them
+    for (auto& wheel : timing_wheels_)
+    {
+        wheel->expire(HttpTimerKind::Idle);
+    }
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(time_out);
+    while (http_statistics_.session_cnt_.load() != 0 && std::chrono::steady_clock::now() < deadline)
+    {
+        std::this_thread::sleep_for(kDrainPollInterval);
+    }
+
+    auto remaining_session_cnt = http_statistics_.session_cnt_.load();
+    LOG_LOGGER_INFO(fmt::format("HttpServerImpl end drain, remaining session: {}", remaining_session_cnt));
+    stop();
+    return remaining_session_cnt == 0;
+}
+
+uint32_t HttpServerImpl::addListener(HttpServerOptions opts)
+{
+    // the io threads, io backend and load shedding are shared, so the listener runs with the ones of the server
+    opts.thread_num_ = opts_.thread_num_;
+    opts.io_backend_ = opts_.io_backend_;
+    opts.io_uring_buffer_num_ = opts_.io_uring_buffer_num_;
+    opts.io_uring_buffer_size_ = opts_.io_uring_buffer_size_;
+    opts.max_session_num_ = opts_.max_session_num_;
+    opts.max_working_handler_num_ = opts_.max_working_handler_num_;
+    opts.adaptive_concurrency_limit_ = opts_.adaptive_concurrency_limit_;
+    listeners_.emplace_back(new ListenerContext(std::move(opts), http_statistics_, concurrency_limiter_, epoch_domain_));
+    return static_cast<uint32_t>(listeners_.size() - 1);
+}
+
+void HttpServerImpl::registerHandler(uint32_t listener_id, const std::string& path, APIHandler* handler)
+{
+    // the user keeps the handler alive, the routes only refer to it
+    updateRoutes(listener_id, HttpRouteUpdate().add(path, std::shared_ptr<APIHandler>(handler, [](APIHandler*) {})));
+}
+
+void HttpServerImpl::registerHandler(uint32_t listener_id,
+                                     const std::string& path,
+                                     APIHandler* handler,
+                                     const HttpCacheOptions& cache_opts)
+{
+    updateRoutes(listener_id,
+                 HttpRouteUpdate().add(path, std::shared_ptr<APIHandler>(handler, [](APIHandler*) {}), cache_opts));
+}
+
+void HttpServerImpl::registerHandler(uint32_t listener_id, const std::string& path, WebSocketHandler* handler)
+{
+    updateRoutes(listener_id,
+                 HttpRouteUpdate().add(path, std::shared_ptr<WebSocketHandler>(handler, [](WebSocketHandler*) {})));
 }
 
-void HttpServerImpl::doAccept()
+#if defined(HTTP_SERVER_COROUTINE)
+void HttpServerImpl::registerHandler(uint32_t listener_id, const std::string& path, CoroutineHandler* handler)
 {
-    acceptor_.async_accept(net::make_strand(io_context_),
-                           beast::bind_front_handler(&HttpServerImpl::onAccept, shared_from_this()));
+    updateRoutes(listener_id,
+                 HttpRouteUpdate().add(path, std::shared_ptr<CoroutineHandler>(handler, [](CoroutineHandler*) {})));
 }
+#endif
 
-void HttpServerImpl::onAccept(beast::error_code ec, tcp::socket socket)
+void HttpServerImpl::updateRoutes(uint32_t listener_id, const HttpRouteUpdate& update)
 {
+    listenerContext(listener_id).routes_.update(
+        [this, &update](HttpRouteTable::Routes& routes)
+        {
+            if (update.clear_)
+            {
+                routes.clear();
+            }
+
+            for (const auto& change : update.changes_)
+            {
+                auto path = HttpRoutes::normalizePath(change.path_);
+                if (!change.handler_ && !change.websocket_handler_)
+                {
+                    routes.erase(path);
+                    continue;
+                }
+
+                auto& route = routes[path];
+                if (change.websocket_handler_)
+                {
+                    route.websocket_handler_ = change.websocket_handler_;
+                }
+                else if (change.cached_)
+                {
+                    // a new cache per update, the responses stored for the replaced handler don't carry over
+                    route.handler_ = std::make_shared<HttpResponseCache>(change.handler_,
+                                                                          change.cache_opts_,
+                                                                          http_statistics_);
+                }
+                else
+                {
+                    route.handler_ = change.handler_;
+                }
+            }
+        });
+}
+
+HttpServerImpl::ListenerContext& HttpServerImpl::listenerContext(uint32_t listener_id)
+{
+    if (listener_id >= listeners_.size())
+    {
+        throw std::runtime_error(fmt::format("listener {} is not added", listener_id));
+    }
+    return *listeners_[listener_id];
+}
+
+void HttpServerImpl::openListener(ListenerContext& context)
+{
+    const auto& opts = context.opts_;
+    if (opts.max_request_size_ == 0)
+    {
+        throw std::runtime_error("max request should > 0");
+    }
+
+    if (opts.listen_backlog_ <= 0)
+    {
+        throw std::runtime_error("listen backlog should > 0");
+    }
+
+    if (opts.addr_.empty() && opts.listen_addresses_.empty() && opts.listen_fd_ < 0)
+    {
+        throw std::runtime_error("addr is empty");
+    }
+
+    for (const auto& proxy : opts.rate_limit_trusted_proxies_)
+    {
+        beast::error_code ec;
+        net::ip::make_address(proxy, ec);
+        if (ec)
+        {
+            throw std::runtime_error(fmt::format("rate limit trusted proxy {} is invalid", proxy));
+        }
+    }
+
+    if (!opts.tls_cert_file_.empty())
+    {
+        // the certificate is loaded once, its session cache and ticket keys are shared by all connections
+        context.tls_context_.reset(new HttpTlsContext(opts));
+    }
+
+    context.sockets_.clear();
+    if (opts.listen_fd_ >= 0)
+    {
+        context.sockets_.emplace_back(new HttpListener(io_context_, opts.listen_fd_));
+    }
+    else if (opts.listen_addresses_.empty())
+    {
+        auto host = opts.addr_.find(':') != std::string::npos ? "[" + opts.addr_ + "]" : opts.addr_;
+        context.sockets_.emplace_back(new HttpListener(io_context_, host + ":" + std::to_string(opts.port_)));
+    }
+    for (const auto& address : opts.listen_addresses_)
+    {
+        context.sockets_.emplace_back(new HttpListener(io_context_, address));
+    }
+
+    std::string listener_names;
+    for (auto& listener : context.sockets_)
+    {
+        listener->open(opts.listen_backlog_, opts.defer_accept_time_out_);
+        listener_names += (listener_names.empty() ? "" : ", ") + listener->name();
+    }
+
+    LOG_LOGGER_INFO(fmt::format("start listen on: {}, thread_num: {}, io_backend: {}, read_time_out: {}s, write_time_out: {}s, handle_time_out: {}s, keep_alive_time_out: {}s, max_keep_alive_requests: {}, auto_gzip: {}, max_request_size: {}KB auto_decode_url_parameters: {}, max_session_num: {}, max_working_handler_num: {}, adaptive_concurrency_limit: {}, rate_limit_qps: {}, enable_http2: {}, tls: {}, listen_backlog: {}, accept_num: {}, accept_batch_size: {}, defer_accept_time_out: {}s",
+                                listener_names,
+                                opts.thread_num_,
+                                uring_services_.empty() ? "epoll" : "io_uring",
+                                opts.read_time_out_,
+                                opts.write_time_out_,
+                                opts.handle_time_out_,
+                                opts.keep_alive_time_out_,
+                                opts.max_keep_alive_requests_,
+                                opts.auto_gzip_,
+                                opts.max_request_size_ / 1024,
+                                opts.auto_decode_url_parameters_,
+                                opts.max_session_num_,
+                                opts.max_working_handler_num_,
+                                opts.adaptive_concurrency_limit_,
+                                opts.rate_limit_qps_,
+                                opts.enable_http2_,
+                                context.tls_context_ != nullptr,
+                                opts.listen_backlog_,
+                                opts.accept_num_,
+                                opts.accept_batch_size_,
+                                opts.defer_accept_time_out_));
+}
+
+void HttpServerImpl::doAccept(ListenerContext* context, HttpListener* listener)
+{
+    listener->asyncAccept(io_context_,
+                          beast::bind_front_handler(&HttpServerImpl::onAccept, shared_from_this(), context, listener));
+}
+
+void HttpServerImpl::onAccept(ListenerContext* context, HttpListener* listener, beast::error_code ec, tcp::socket socket)
+{
+    if (ec == net::error::operation_aborted || !listener->isOpen())
+    {
+        // closed by drain() or stop()
+        return;
+    }
+
     if (!ec)
     {
-        // create the session and run it
-        std::make_shared<HttpSession>(std::move(socket), router_, opts_, http_statistics_)->run();
+        startSession(*context, std::move(socket));
+
+        // the connections queued meanwhile are taken now instead of one wakeup each
+        for (uint32_t i = 1; i < context->opts_.accept_batch_size_; ++i)
+        {
+            auto pending_socket = listener->accept(io_context_, ec);
+            if (ec)
+            {
+                break;
+            }
+            startSession(*context, std::move(pending_socket));
+        }
     }
 
     // accept another connection
-    doAccept();
+    doAccept(context, listener);
+}
+
+void HttpServerImpl::startSession(ListenerContext& context, tcp::socket&& socket)
+{
+    if (opts_.max_session_num_ != 0 && http_statistics_.session_cnt_.load() >= opts_.max_session_num_)
+    {
+        // shed the connection before any session state is created
+        ++http_statistics_.rejected_session_cnt_;
+        rejectSession(context, socket);
+        return;
+    }
+
+    // take a pooled session or create one, and run it
+    // the io_uring ring shard goes with the wheel of the same index, both are picked round-robin
+    auto index = next_wheel_index_.fetch_add(1, std::memory_order_relaxed) % timing_wheels_.size();
+    context.session_pool_
+        ->acquire(std::move(socket),
+                  *timing_wheels_[index],
+                  uring_services_.empty() ? nullptr : uring_services_[index].get(),
+                  context.tls_context_.get())
+        ->run();
+}
+
+void HttpServerImpl::rejectSession(ListenerContext& context, tcp::socket& socket)
+{
+    // a fresh socket send buffer always has room for the canned response, so a single
+    // non-blocking write is enough and the reactor is never involved.
+    // a TLS client can't read it before a handshake, which would cost more than the session, so it is only closed
+    beast::error_code ec;
+    if (!context.tls_context_)
+    {
+        socket.non_blocking(true, ec);
+        socket.write_some(HttpCannedResponse::serviceUnavailable(false), ec);
+        if (ec)
+        {
+            LOG_LOGGER_TRACE(fmt::format("reject session write fail: {}", ec.message()));
+        }
+    }
+    socket.shutdown(tcp::socket::shutdown_send, ec);
+    socket.close(ec);
+}
+
+void HttpServerImpl::doTick(std::size_t index)
+{
+    wheel_timers_[index]->expires_after(kWheelTick);
+    wheel_timers_[index]->async_wait(beast::bind_front_handler(&HttpServerImpl::onTick, shared_from_this(), index));
+}
+
+void HttpServerImpl::onTick(std::size_t index, beast::error_code ec)
+{
+    if (ec)
+    {
+        // cancelled by stop()
+        return;
+    }
+
+    timing_wheels_[index]->advance(std::chrono::steady_clock::now());
+    if (index == 0)
+    {
+        // the route tables retired while an io thread was reading are freed once it moved on
+        epoch_domain_.reclaim();
+    }
+    doTick(index);
 }
 
 void HttpServerImpl::resetAllHttpStatistics()
@@ -162,7 +495,24 @@ void HttpServerImpl::resetAllHttpStatistics()
     http_statistics_.write_timeout_cnt_.store(0);
     http_statistics_.write_fail_cnt_.store(0);
     http_statistics_.write_success_cnt_.store(0);
+    http_statistics_.handle_timeout_cnt_.store(0);
     http_statistics_.working_handler_cnt_.store(0);
+    http_statistics_.rejected_session_cnt_.store(0);
+    http_statistics_.rejected_request_cnt_.store(0);
+    http_statistics_.rate_limited_cnt_.store(0);
+    http_statistics_.session_pool_hit_cnt_.store(0);
+    http_statistics_.session_pool_miss_cnt_.store(0);
+    http_statistics_.websocket_session_cnt_.store(0);
+    http_statistics_.websocket_slow_consumer_cnt_.store(0);
+    http_statistics_.event_stream_cnt_.store(0);
+    http_statistics_.tls_handshake_cnt_.store(0);
+    http_statistics_.tls_resumed_cnt_.store(0);
+    http_statistics_.tls_handshake_fail_cnt_.store(0);
+    http_statistics_.ktls_cnt_.store(0);
+    http_statistics_.cache_hit_cnt_.store(0);
+    http_statistics_.cache_miss_cnt_.store(0);
+    http_statistics_.coalesced_request_cnt_.store(0);
+    http_statistics_.draining_.store(false);
 }
 
 HttpStatistics HttpServerImpl::getHttpStatistics()
@@ -176,7 +526,26 @@ HttpStatistics HttpServerImpl::getHttpStatistics()
     statics.write_timeout_cnt_ = http_statistics_.write_timeout_cnt_.load();
     statics.write_success_cnt_ = http_statistics_.write_success_cnt_.load();
     statics.write_fail_cnt_ = http_statistics_.write_fail_cnt_.load();
+    statics.handle_timeout_cnt_ = http_statistics_.handle_timeout_cnt_.load();
     statics.session_cnt_ = http_statistics_.session_cnt_.load();
+    statics.rejected_session_cnt_ = http_statistics_.rejected_session_cnt_.load();
+    statics.rejected_request_cnt_ = http_statistics_.rejected_request_cnt_.load();
+    statics.rate_limited_cnt_ = http_statistics_.rate_limited_cnt_.load();
+    statics.draining_ = http_statistics_.draining_.load();
+    statics.session_pool_hit_cnt_ = http_statistics_.session_pool_hit_cnt_.load();
+    statics.session_pool_miss_cnt_ = http_statistics_.session_pool_miss_cnt_.load();
+    statics.websocket_session_cnt_ = http_statistics_.websocket_session_cnt_.load();
+    statics.websocket_slow_consumer_cnt_ = http_statistics_.websocket_slow_consumer_cnt_.load();
+    statics.event_stream_cnt_ = http_statistics_.event_stream_cnt_.load();
+    statics.tls_handshake_cnt_ = http_statistics_.tls_handshake_cnt_.load();
+    statics.tls_resumed_cnt_ = http_statistics_.tls_resumed_cnt_.load();
+    statics.tls_handshake_fail_cnt_ = http_statistics_.tls_handshake_fail_cnt_.load();
+    statics.ktls_cnt_ = http_statistics_.ktls_cnt_.load();
+    statics.cache_hit_cnt_ = http_statistics_.cache_hit_cnt_.load();
+    statics.cache_miss_cnt_ = http_statistics_.cache_miss_cnt_.load();
+    statics.coalesced_request_cnt_ = http_statistics_.coalesced_request_cnt_.load();
+    statics.concurrency_limit_ =
+        opts_.adaptive_concurrency_limit_ ? concurrency_limiter_.limit() : opts_.max_working_handler_num_;
     return statics;
 }
 
@@ -5,13 +5,22 @@
  */
 
 #pragma once
+#include <atomic>
 #include <memory>
 #include <thread>
 #include <vector>
 #include <httpserver/http_server.h>
 #include "http_common.h"
-#include "http_router.h"
+#include "http_concurrency_limiter.h"
+#include "http_epoch.h"
+#include "http_listener.h"
+#include "http_rate_limiter.h"
+#include "http_routes.h"
+#include "http_session_pool.h"
 #include "http_statistics_internal.h"
+#include "http_timing_wheel.h"
+#include "http_tls.h"
+#include "http_uring.h"
 
 namespace http
 {
@@ -26,22 +35,63 @@ public:
 
     void run();
     void stop();
+    bool drain(uint64_t time_out);
 
     HttpStatistics getHttpStatistics();
 
-    void registerHandler(const std::string& path, APIHandler* handler);
+    uint32_t addListener(HttpServerOptions opts);
+
+    void registerHandler(uint32_t listener_id, const std::string& path, APIHandler* handler);
+    void registerHandler(uint32_t listener_id,
+                         const std::string& path,
+                         APIHandler* handler,
+                         const HttpCacheOptions& cache_opts);
+    void registerHandler(uint32_t listener_id, const std::string& path, WebSocketHandler* handler);
+#if defined(HTTP_SERVER_COROUTINE)
+    void registerHandler(uint32_t listener_id, const std::string& path, CoroutineHandler* handler);
+#endif
+    void updateRoutes(uint32_t listener_id, const HttpRouteUpdate& update);
 
 private:
-    void doAccept();
-    void onAccept(beast::error_code ec, tcp::socket socket);
+    /**
+     * @brief the options, handlers and per client state of one listener, shared by its sockets
+     */
+    struct ListenerContext
+    {
+        ListenerContext(HttpServerOptions opts,
+                        HttpStatisticsInternal& statistics,
+                        HttpConcurrencyLimiter& concurrency_limiter,
+                        HttpEpochDomain& epoch_domain);
+
+        HttpServerOptions opts_;  // the server wide fields are the ones of the server
+        HttpRoutes routes_;
+        HttpRateLimiter rate_limiter_;
+        std::unique_ptr<HttpTlsContext> tls_context_;  // nullptr for plaintext, made by run()
+        std::shared_ptr<HttpSessionPool> session_pool_;  // sessions refer to opts_ and routes_
+        std::vector<std::unique_ptr<HttpListener>> sockets_;  // made by run()
+    };
+
+    ListenerContext& listenerContext(uint32_t listener_id);
+    void openListener(ListenerContext& context);
+    void doAccept(ListenerContext* context, HttpListener* listener);
+    void onAccept(ListenerContext* context, HttpListener* listener, beast::error_code ec, tcp::socket socket);
+    void startSession(ListenerContext& context, tcp::socket&& socket);
+    void rejectSession(ListenerContext& context, tcp::socket& socket);
+    void doTick(std::size_t index);
+    void onTick(std::size_t index, beast::error_code ec);
     void resetAllHttpStatistics();
 
 private:
     HttpStatisticsInternal http_statistics_;
-    HttpServerOptions opts_;
-    HttpRouter<APIHandler> router_;
+    HttpServerOptions opts_;  // also the options of the first listener
+    HttpEpochDomain epoch_domain_;  // retired route tables, outlives the listeners
+    HttpConcurrencyLimiter concurrency_limiter_;
+    std::vector<std::unique_ptr<HttpTimingWheel>> timing_wheels_;  // as many as io threads, sharded round-robin, outlive the sessions
+    std::atomic<std::size_t> next_wheel_index_;  // shared by the listener strands
     boost::asio::io_context io_context_;
-    boost::asio::ip::tcp::acceptor acceptor_;
+    std::vector<std::unique_ptr<net::steady_timer>> wheel_timers_;  // drive timing_wheels_
+    std::vector<std::shared_ptr<HttpUringService>> uring_services_;  // as many as io threads, sharded round-robin like the wheels, empty on the epoll reactor
+    std::vector<std::unique_ptr<ListenerContext>> listeners_;  // by listener id, pooled sockets need io_context_, so declared after it
     std::vector<std::thread> io_thread_pool_;
 };
 
@@ -1,5 +1,12 @@
+#include <array>
 #include <cassert>
+#include <vector>
 #include "http_session.h"
+#include "http_arena.h"
+#include "http_canned_response.h"
+#include "http_date.h"
+#include "http_recycling_allocator.h"
+#include "http_shared_body.h"
 #include "httpserver/detail/http_types.h"
 #include "httpserver/detail/http_log.h"
 
@@ -7,72 +14,540 @@ namespace http
 {
 namespace server
 {
+namespace
+{
+const uint64_t kIdleRecheckTimeOut = 3600;  // idle timer period without keep_alive_time_out_, uint:seconds
+const std::size_t kHeaderLimit = 8192;  // default header limit of the beast parser, the fast path keeps it
+const std::size_t kFastReadSize = 65536;  // read size of the fast path, as beast reads
+const char kSwitchingProtocols[] = "HTTP/1.1 101 Switching Protocols\r\nConnection: Upgrade\r\nUpgrade: h2c\r\n\r\n";
+const char kEventStreamHeader[] =
+    "HTTP/1.1 200 OK\r\nContent-Type: text/event-stream\r\nCache-Control: no-cache\r\nConnection: close\r\n";
+const char kEventStreamComment[] = ":\n\n";  // ignored by the client, keeps the connection busy for proxies
+
+bool isConnectionHeader(const std::string& name)
+{
+    return boost::iequals(name, "Connection") || boost::iequals(name, "Keep-Alive") ||
+           boost::iequals(name, "Proxy-Connection") || boost::iequals(name, "Transfer-Encoding") ||
+           boost::iequals(name, "Upgrade");
+}
+}  // namespace
+
 std::atomic<std::uint64_t> HttpSession::s_id{0};
 
 HttpSession::HttpSession(tcp::socket&& socket,
-                         HttpRouter<APIHandler>& router,
+                         HttpRoutes& routes,
                          const HttpServerOptions& opts,
-                         HttpStatisticsInternal& statistics)
+                         HttpStatisticsInternal& statistics,
+                         HttpConcurrencyLimiter& concurrency_limiter,
+                         HttpRateLimiter& rate_limiter,
+                         HttpTimingWheel& timing_wheel,
+                         HttpUringService* uring_service,
+                         HttpTlsContext* tls_context)
     : id_(++s_id)
     , current_request_id_(0)
     , statistics_(statistics)
+    , concurrency_limiter_(concurrency_limiter)
+    , rate_limiter_(rate_limiter)
+    , client_key_hash_(0)
+    , trusted_proxy_(false)
+    , timing_wheel_(&timing_wheel)
+    , timer_node_()
+    , timer_generation_(0)
+    , timed_out_(false)
+    , finished_(false)
+    , handler_in_flight_(false)
+    , response_pending_(false)
+    , request_cancelled_()
+    , handler_start_time_()
     , opts_(opts)
-    , router_(router)
-    , stream_(std::move(socket))
+    , routes_(routes)
+    , stream_(std::move(socket), uring_service, tls_context)
     , buffer_(opts.max_request_size_)
+    , parser_()
     , request_()
+    , fast_path_(false)
+    , fast_request_()
+    , fast_request_size_(0)
     , response_()
+    , shared_response_()
+    , shared_body_()
+    , template_header_()
+    , template_body_()
+    , h2_()
+    , h2_handlers_()
+    , h2_timer_generation_(0)
+    , h2_write_buffer_()
+    , h2_writing_(false)
+    , ws_()
+    , ws_handler_()
+    , ws_queue_()
+    , ws_queue_size_(0)
+    , ws_writing_(false)
+    , ws_closing_(false)
+    , ws_ping_pending_(false)
+    , event_stream_()
+    , event_stream_buffer_()
+    , event_stream_writing_(false)
+{
+    onConnect();
+}
+
+HttpSession::~HttpSession()
+{
+    finish();
+    LOG_LOGGER_TRACE(fmt::format("session[{}] destroy", id_));
+}
+
+void HttpSession::finish()
+{
+    if (finished_)
+    {
+        return;
+    }
+
+    finished_ = true;
+    --statistics_.session_cnt_;
+    if (handler_in_flight_)
+    {
+        // the handler dropped the response writer without sending a response
+        handler_in_flight_ = false;
+        --statistics_.working_handler_cnt_;
+    }
+    for (auto& handler : h2_handlers_)
+    {
+        handler.second.cancelled_->store(true, std::memory_order_relaxed);
+        if (handler.second.timer_node_)
+        {
+            timing_wheel_->cancel(*handler.second.timer_node_);
+        }
+        --statistics_.working_handler_cnt_;
+    }
+    h2_handlers_.clear();
+    if (ws_handler_ != nullptr)
+    {
+        // the server is stopped, the pending read was dropped without onClose()
+        ws_handler_ = nullptr;
+        --statistics_.websocket_session_cnt_;
+    }
+    endEventStream();
+    doClose();
+
+    // a pooled session must not keep the shared payloads alive
+    shared_body_.reset();
+    ws_queue_.clear();
+    ws_queue_size_ = 0;
+}
+
+void HttpSession::reset(tcp::socket&& socket,
+                        HttpTimingWheel& timing_wheel,
+                        HttpUringService* uring_service,
+                        HttpTlsContext* tls_context)
+{
+    id_ = ++s_id;
+    current_request_id_ = 0;
+    client_key_hash_ = 0;
+    trusted_proxy_ = false;
+    timing_wheel_ = &timing_wheel;
+    timed_out_ = false;
+    finished_ = false;
+    response_pending_ = false;
+    request_cancelled_.reset();
+
+    // the socket brings its own strand, the timers of the stream are unused since timeouts come from the wheel
+    stream_.reset(std::move(socket), uring_service, tls_context);
+    buffer_.clear();
+    parser_.reset();
+    request_ = {};
+    fast_path_ = false;
+    fast_request_size_ = 0;
+    response_ = {};
+    template_body_.clear();
+    h2_.reset();
+    h2_handlers_.clear();
+    h2_write_buffer_.clear();
+    h2_writing_ = false;
+    ws_.reset();
+    ws_writing_ = false;
+    ws_closing_ = false;
+    ws_ping_pending_ = false;
+    event_stream_buffer_.clear();
+    event_stream_writing_ = false;
+    onConnect();
+}
+
+void HttpSession::trimBuffer(std::size_t max_capacity)
+{
+    if (buffer_.capacity() > max_capacity)
+    {
+        buffer_.clear();
+        buffer_.shrink_to_fit();
+    }
+}
+
+void HttpSession::onConnect()
 {
     ++statistics_.session_cnt_;
     beast::error_code ec;
-    auto remote_endpoint = stream_.socket().remote_endpoint(ec);
+    auto remote_endpoint = stream_.remoteEndpoint(ec);
     if (!ec)
     {
+        if (remote_endpoint.address().is_v4())
+        {
+            auto bytes = remote_endpoint.address().to_v4().to_bytes();
+            client_key_hash_ = HttpRateLimiter::hashKey(bytes.data(), bytes.size());
+        }
+        else
+        {
+            auto bytes = remote_endpoint.address().to_v6().to_bytes();
+            client_key_hash_ = HttpRateLimiter::hashKey(bytes.data(), bytes.size());
+        }
+        trusted_proxy_ = isTrustedProxy(remote_endpoint.address());
+
         LOG_LOGGER_TRACE(fmt::format("session[{}] create, remote: {}",
                                      id_,
                                      remote_endpoint.address().to_string() + ":" +
                                          std::to_string(remote_endpoint.port())));
     }
+    else
+    {
+        // a Unix socket peer has no ip, such clients share one rate limit key
+        LOG_LOGGER_TRACE(fmt::format("session[{}] create, remote: local", id_));
+    }
 }
 
-HttpSession::~HttpSession()
+bool HttpSession::isTrustedProxy(const net::ip::address& address) const
 {
-    --statistics_.session_cnt_;
-    doClose();
-    LOG_LOGGER_TRACE(fmt::format("session[{}] destroy", id_));
+    if (opts_.rate_limit_qps_ == 0 || opts_.rate_limit_key_header_.empty())
+    {
+        return false;
+    }
+
+    // a dual stack listener sees ipv4 peers as mapped ipv6 addresses
+    auto peer = address;
+    if (peer.is_v6() && peer.to_v6().is_v4_mapped())
+    {
+        peer = net::ip::make_address_v4(net::ip::v4_mapped, peer.to_v6());
+    }
+    for (const auto& proxy : opts_.rate_limit_trusted_proxies_)
+    {
+        beast::error_code ec;
+        if (net::ip::make_address(proxy, ec) == peer && !ec)
+        {
+            return true;
+        }
+    }
+    return false;
 }
 
 void HttpSession::run()
 {
+    timing_wheel_->attach(timer_node_, std::weak_ptr<HttpTimerTarget>(shared_from_this()));
+
     // We need to be executing within a strand to perform async operations
     // on the I/O objects in this session.
-    net::dispatch(stream_.get_executor(), beast::bind_front_handler(&HttpSession::doRead, shared_from_this()));
+    net::dispatch(stream_.get_executor(),
+                  makeAllocHandler(beast::bind_front_handler(
+                      stream_.tls() != nullptr ? &HttpSession::doHandshake : &HttpSession::doRead,
+                      shared_from_this())));
+}
+
+void HttpSession::doHandshake()
+{
+    // the handshake is bounded like the read of a request
+    armTimer(HttpTimerKind::Read, opts_.read_time_out_);
+    stream_.asyncHandshake(
+        makeAllocHandler(beast::bind_front_handler(&HttpSession::onHandshake, shared_from_this())));
+}
+
+void HttpSession::onHandshake(beast::error_code ec)
+{
+    if (timed_out_)
+    {
+        // the timer cancelled the handshake
+        ec = beast::error::timeout;
+    }
+
+    if (ec)
+    {
+        ++statistics_.tls_handshake_fail_cnt_;
+        LOG_LOGGER_TRACE(fmt::format("close session[{}], tls handshake fail: {}", id_, ec.message()));
+        return doClose();
+    }
+
+    ++statistics_.tls_handshake_cnt_;
+    if (stream_.tls()->resumed())
+    {
+        ++statistics_.tls_resumed_cnt_;
+    }
+    if (stream_.tls()->kernelOffload())
+    {
+        ++statistics_.ktls_cnt_;
+    }
+    doRead();
 }
 
 void HttpSession::doRead()
 {
     ++current_request_id_;
-    if (opts_.read_time_out_ != 0)
+    if (current_request_id_ > 1 && buffer_.size() == 0)
     {
-        // set read timeout
-        stream_.expires_after(std::chrono::seconds(opts_.read_time_out_));
+        // keep-alive connection without pipelined data, wait for the next request under the idle timeout.
+        // the idle timer is armed even without keep_alive_time_out_, drain() finds idle sessions by it
+        armTimer(HttpTimerKind::Idle,
+                 opts_.keep_alive_time_out_ != 0 ? opts_.keep_alive_time_out_ : kIdleRecheckTimeOut);
+        if (statistics_.draining_.load())
+        {
+            // drain() started after the last response was prepared, it may have missed this timer
+            LOG_LOGGER_TRACE(fmt::format("close idle session[{}]: draining", id_));
+            return doClose();
+        }
+        stream_.asyncWaitRead(makeAllocHandler(beast::bind_front_handler(&HttpSession::onIdle, shared_from_this())));
+        return;
     }
-    else
+
+    doReadHeader();
+}
+
+void HttpSession::onIdle(beast::error_code ec)
+{
+    if (timed_out_)
     {
-        // never timeout
-        stream_.expires_never();
+        LOG_LOGGER_TRACE(fmt::format("close idle session[{}]: {}",
+                                     id_,
+                                     statistics_.draining_.load() ? "draining" : "keep alive timeout"));
+        return doClose();
+    }
+    else if (ec)
+    {
+        LOG_LOGGER_TRACE(fmt::format("close idle session[{}]: {}", id_, ec.message()));
+        return doClose();
+    }
+
+    doReadHeader();
+}
+
+void HttpSession::doReadHeader()
+{
+    armTimer(HttpTimerKind::Read, opts_.read_time_out_);
+    if (opts_.enable_http2_ && current_request_id_ == 1)
+    {
+        // a HTTP/2 client with prior knowledge starts with the connection preface
+        return doReadPreface();
+    }
+    doParseHeader();
+}
+
+void HttpSession::doReadPreface()
+{
+    auto data = buffer_.data();
+    auto match = Http2Connection::matchPreface(static_cast<const char*>(data.data()), data.size());
+    if (match && data.size() >= Http2Connection::kPrefaceSize)
+    {
+        LOG_LOGGER_TRACE(fmt::format("session[{}] http2 with prior knowledge", id_));
+        cancelTimer();
+        h2_.reset(new Http2Connection(opts_.http2_max_concurrent_streams_, opts_.max_request_size_));
+        return onH2Data();
+    }
+    if (!match)
+    {
+        return doParseHeader();
+    }
+
+    stream_.async_read_some(buffer_.prepare(beast::read_size(buffer_, kFastReadSize)),
+                            makeAllocHandler(beast::bind_front_handler(&HttpSession::onReadPreface, shared_from_this())));
+}
+
+void HttpSession::onReadPreface(beast::error_code ec, std::size_t bytes_transferred)
+{
+    if (!ec && !timed_out_)
+    {
+        buffer_.commit(bytes_transferred);
+        return doReadPreface();
+    }
+
+    if (ec == net::error::eof)
+    {
+        ec = buffer_.size() == 0 ? beast::http::error::end_of_stream : beast::http::error::partial_message;
+    }
+    onRead(ec, bytes_transferred);
+}
+
+void HttpSession::doParseHeader()
+{
+    if (opts_.fast_request_parser_)
+    {
+        fast_path_ = true;
+        return doFastRead();
+    }
+    doBeastReadHeader();
+}
+
+void HttpSession::doBeastReadHeader()
+{
+    fast_path_ = false;
+    fast_request_size_ = 0;
+
+    // a parser can only be used for one message, so construct a new one for each request
+    parser_.emplace();
+    parser_->body_limit(opts_.max_request_size_);
+
+    // read the request header first, the client rate is checked before the body is read
+    beast::http::async_read_header(stream_,
+                                   buffer_,
+                                   *parser_,
+                                   makeAllocHandler(beast::bind_front_handler(&HttpSession::onReadHeader,
+                                                                              shared_from_this())));
+}
+
+void HttpSession::onReadHeader(beast::error_code ec, std::size_t bytes_transferred)
+{
+    if (ec)
+    {
+        return onRead(ec, bytes_transferred);
+    }
+
+    if (!allowRequest())
+    {
+        ++statistics_.rate_limited_cnt_;
+        LOG_LOGGER_TRACE(fmt::format("session[{}], request_id: {}, rejected: rate limited", id_, current_request_id_));
+
+        // the body is left unread, so the connection can only be kept if there is none
+        auto keep_alive = keepAlive(parser_->get().keep_alive() && parser_->get().version() == 11 && parser_->is_done());
+        return doWriteCanned(HttpCannedResponse::tooManyRequests(keep_alive), keep_alive);
     }
 
-    // read a request
+    if (parser_->is_done())
+    {
+        // no body
+        return onRead(ec, bytes_transferred);
+    }
+
+    // read the body
     beast::http::async_read(stream_,
                             buffer_,
-                            request_,
-                            beast::bind_front_handler(&HttpSession::onRead, shared_from_this()));
+                            *parser_,
+                            makeAllocHandler(beast::bind_front_handler(&HttpSession::onRead, shared_from_this())));
+}
+
+void HttpSession::doFastRead()
+{
+    if (fast_request_size_ != 0 && buffer_.size() < fast_request_size_)
+    {
+        // the header is parsed, wait for the rest of the body
+        return doFastReadSome();
+    }
+
+    // parsed again once the body is read, reading may have moved the buffered bytes
+    auto data = buffer_.data();
+    auto result = HttpFastParser::parse(static_cast<const char*>(data.data()), data.size(), fast_request_);
+    if (result == HttpFastParser::Result::Incomplete && buffer_.size() < kHeaderLimit)
+    {
+        return doFastReadSome();
+    }
+
+    uint64_t content_length = 0;
+    if (result != HttpFastParser::Result::Complete || fast_request_.header_size_ > kHeaderLimit ||
+        !HttpFastParser::contentLength(fast_request_, content_length) ||
+        content_length > opts_.max_request_size_ ||
+        fast_request_.header_size_ + content_length > buffer_.max_size())
+    {
+        // the beast parser takes over from the bytes already read, and accepts or rejects the request
+        return doBeastReadHeader();
+    }
+
+    if (fast_request_size_ == 0)
+    {
+        fast_request_size_ = fast_request_.header_size_ + static_cast<std::size_t>(content_length);
+        if (!allowRequest())
+        {
+            ++statistics_.rate_limited_cnt_;
+            LOG_LOGGER_TRACE(fmt::format("session[{}], request_id: {}, rejected: rate limited", id_, current_request_id_));
+
+            // the body is left unread, so the connection can only be kept if there is none
+            auto keep_alive =
+                keepAlive(HttpFastParser::keepAlive(fast_request_) && fast_request_.version_ == 11 && content_length == 0);
+            buffer_.consume(fast_request_.header_size_);
+            fast_request_size_ = 0;
+            return doWriteCanned(HttpCannedResponse::tooManyRequests(keep_alive), keep_alive);
+        }
+
+        if (buffer_.size() < fast_request_size_)
+        {
+            return doFastReadSome();
+        }
+    }
+
+    onFastRequest(content_length);
+}
+
+void HttpSession::doFastReadSome()
+{
+    // at least the rest of the body in one read, within the buffer limit checked by doFastRead()
+    auto size = beast::read_size(buffer_, kFastReadSize);
+    if (fast_request_size_ > buffer_.size())
+    {
+        size = std::max(size, fast_request_size_ - buffer_.size());
+    }
+    size = std::min(size, buffer_.max_size() - buffer_.size());
+    stream_.async_read_some(buffer_.prepare(size),
+                            makeAllocHandler(beast::bind_front_handler(&HttpSession::onFastRead, shared_from_this())));
+}
+
+void HttpSession::onFastRead(beast::error_code ec, std::size_t bytes_transferred)
+{
+    if (!ec && !timed_out_)
+    {
+        buffer_.commit(bytes_transferred);
+        return doFastRead();
+    }
+
+    if (ec == net::error::eof)
+    {
+        // same as the beast parser: eof between requests is a normal close
+        ec = buffer_.size() == 0 ? beast::http::error::end_of_stream : beast::http::error::partial_message;
+    }
+    onRead(ec, bytes_transferred);
+}
+
+void HttpSession::onFastRequest(uint64_t content_length)
+{
+    LOG_LOGGER_TRACE(fmt::format("session[{}] request_id: {}, read success", id_, current_request_id_));
+    ++statistics_.read_success_cnt_;
+    cancelTimer();
+
+    // the rest of the session reads the request line, keep-alive and Accept-Encoding from request_,
+    // fillRequest() takes the headers and the body from the views
+    request_ = {};
+    request_.method_string(boost::string_view(fast_request_.method_.data(), fast_request_.method_.size()));
+    request_.target(boost::string_view(fast_request_.target_.data(), fast_request_.target_.size()));
+    request_.version(fast_request_.version_);
+    request_.keep_alive(HttpFastParser::keepAlive(fast_request_));
+    for (const auto& header : fast_request_.headers_)
+    {
+        if (header.name_.iequals("Accept-Encoding"))
+        {
+            request_.set(beast::http::field::accept_encoding,
+                         boost::string_view(header.value_.data(), header.value_.size()));
+            break;
+        }
+    }
+
+    processRequest();
+
+    // the handler got copies, the next request starts after this one
+    buffer_.consume(fast_request_.header_size_ + static_cast<std::size_t>(content_length));
+    fast_request_size_ = 0;
 }
 
 void HttpSession::onRead(beast::error_code ec, std::size_t bytes_transferred)
 {
     boost::ignore_unused(bytes_transferred);
+    if (timed_out_)
+    {
+        // the timer cancelled the read
+        ec = beast::error::timeout;
+    }
+
     if (ec == beast::http::error::end_of_stream)
     {
         // remote exit, normal close
@@ -97,33 +572,140 @@ void HttpSession::onRead(beast::error_code ec, std::size_t bytes_transferred)
     {
         LOG_LOGGER_TRACE(fmt::format("session[{}] request_id: {}, read success", id_, current_request_id_));
         ++statistics_.read_success_cnt_;
+        cancelTimer();
+        request_ = parser_->release();
         processRequest();
     }
 }
 
 void HttpSession::doWrite()
 {
-    if (opts_.write_time_out_ != 0)
+    armTimer(HttpTimerKind::Write, opts_.write_time_out_);
+    beast::http::async_write(stream_,
+                             response_,
+                             makeAllocHandler(beast::bind_front_handler(&HttpSession::onWrite,
+                                                                        shared_from_this(),
+                                                                        response_.keep_alive())));
+}
+
+void HttpSession::doWriteCanned(net::const_buffer canned_response, bool keep_alive)
+{
+    armTimer(HttpTimerKind::Write, opts_.write_time_out_);
+    net::async_write(stream_,
+                     canned_response,
+                     makeAllocHandler(beast::bind_front_handler(&HttpSession::onWrite, shared_from_this(), keep_alive)));
+}
+
+void HttpSession::armTimer(HttpTimerKind kind, uint64_t time_out)
+{
+    ++timer_generation_;
+    if (time_out == 0)
     {
-        // set write timeout
-        stream_.expires_after(std::chrono::seconds(opts_.write_time_out_));
+        // never timeout
+        timing_wheel_->cancel(timer_node_);
+        return;
     }
-    else
+    timing_wheel_->arm(timer_node_, std::chrono::seconds(time_out), kind, timer_generation_);
+}
+
+void HttpSession::cancelTimer()
+{
+    ++timer_generation_;
+    timing_wheel_->cancel(timer_node_);
+}
+
+void HttpSession::onTimerExpired(HttpTimerKind kind, uint64_t generation)
+{
+    // called on the wheel driver thread, the session state belongs to the strand
+    net::post(stream_.get_executor(),
+              makeAllocHandler(beast::bind_front_handler(&HttpSession::onTimeout, shared_from_this(), kind, generation)));
+}
+
+void HttpSession::onTimeout(HttpTimerKind kind, uint64_t generation)
+{
+    if (kind == HttpTimerKind::Handle && h2_)
     {
-        // never timeout
-        stream_.expires_never();
+        // the deadline of a stream, the session timer isn't armed for handlers on HTTP/2
+        return onH2HandleTimeout(generation);
     }
 
-    beast::http::async_write(stream_,
-                             response_,
-                             beast::bind_front_handler(&HttpSession::onWrite,
-                                                       shared_from_this(),
-                                                       response_.keep_alive()));
+    if (generation != timer_generation_)
+    {
+        // the timer was re-armed or cancelled after it expired
+        return;
+    }
+
+    if (kind == HttpTimerKind::Idle && event_stream_)
+    {
+        // the stream has its own keep-alive interval
+        return onEventStreamIdle();
+    }
+
+    if (kind == HttpTimerKind::Idle && opts_.keep_alive_time_out_ == 0 && !statistics_.draining_.load())
+    {
+        // no keep-alive timeout, keep waiting
+        return armTimer(HttpTimerKind::Idle, kIdleRecheckTimeOut);
+    }
+
+    if (kind == HttpTimerKind::Idle && h2_)
+    {
+        return onH2Idle();
+    }
+
+    if (kind == HttpTimerKind::Idle && ws_handler_ != nullptr)
+    {
+        return onWebSocketIdle();
+    }
+
+    if (kind == HttpTimerKind::Handle)
+    {
+        // no socket operation is pending while the handler works
+        return onHandleTimeout();
+    }
+
+    // abort the pending operation, its completion handler reports the timeout
+    LOG_LOGGER_TRACE(fmt::format("session[{}] request_id: {}, timer {} expired", id_, current_request_id_, static_cast<int>(kind)));
+    timed_out_ = true;
+    stream_.cancel();
+}
+
+void HttpSession::onHandleTimeout()
+{
+    if (!response_pending_)
+    {
+        return;
+    }
+
+    ++statistics_.handle_timeout_cnt_;
+    LOG_LOGGER_ERROR(fmt::format("session[{}] request_id: {}, handle fail: timeout", id_, current_request_id_));
+
+    // the handler may still send, its response is dropped since the request is no longer pending
+    response_pending_ = false;
+    request_cancelled_->store(true, std::memory_order_relaxed);
+    finishHandler();
+    request_.body().clear();
+
+    // the request was read whole, so the connection can carry the next one, a late send() has a stale request id
+    auto keep_alive = keepAlive(request_.keep_alive() && request_.version() == 11);
+    doWriteCanned(HttpCannedResponse::serviceUnavailable(keep_alive), keep_alive);
+}
+
+bool HttpSession::keepAlive(bool request_keep_alive)
+{
+    return request_keep_alive && !statistics_.draining_.load(std::memory_order_relaxed) &&
+           (opts_.max_keep_alive_requests_ == 0 || current_request_id_ < opts_.max_keep_alive_requests_);
 }
 
 void HttpSession::onWrite(bool keep_alive, beast::error_code ec, std::size_t bytes_transferred)
 {
     boost::ignore_unused(bytes_transferred);
+    shared_body_.reset();
+    if (timed_out_)
+    {
+        // the timer cancelled the write
+        ec = beast::error::timeout;
+    }
+    cancelTimer();
 
     if (ec == beast::error::timeout)
     {
@@ -152,6 +734,7 @@ void HttpSession::onWrite(bool keep_alive, beast::error_code ec, std::size_t byt
 
     response_.clear();
     response_.body().clear();
+    template_body_.clear();
     ++statistics_.write_success_cnt_;
     LOG_LOGGER_TRACE(fmt::format("session[{}] request_id: {}, onWrite success", id_, current_request_id_));
 
@@ -161,7 +744,17 @@ void HttpSession::onWrite(bool keep_alive, beast::error_code ec, std::size_t byt
 
 void HttpSession::doClose()
 {
-    if (stream_.socket().is_open())
+    cancelTimer();
+    if (response_pending_ && request_cancelled_)
+    {
+        // finish() closes here too, so a handler outliving the session or the server sees it as well
+        request_cancelled_->store(true, std::memory_order_relaxed);
+    }
+    for (auto& handler : h2_handlers_)
+    {
+        handler.second.cancelled_->store(true, std::memory_order_relaxed);
+    }
+    if (stream_.isOpen())
     {
         stream_.close();
         LOG_LOGGER_TRACE(fmt::format("session[{}] closed", id_));
@@ -170,6 +763,24 @@ void HttpSession::doClose()
 
 void HttpSession::processRequest()
 {
+    if (opts_.enable_http2_ && !fast_path_ && upgradeH2())
+    {
+        // the request is answered on stream 1
+        return;
+    }
+
+    if (isOverloaded())
+    {
+        // shed load before routing, the canned response needs no allocation
+        ++statistics_.rejected_request_cnt_;
+        LOG_LOGGER_TRACE(fmt::format("session[{}], request_id: {}, rejected: overloaded", id_, current_request_id_));
+        auto keep_alive = keepAlive(request_.keep_alive() && request_.version() == 11);
+        request_.body().clear();
+        return doWriteCanned(HttpCannedResponse::serviceUnavailable(keep_alive), keep_alive);
+    }
+
+    response_pending_ = true;
+
     // parse uri
     boost::system::result<boost::url_view> r;
     std::string origin_target;
@@ -189,7 +800,7 @@ void HttpSession::processRequest()
     {
         ++statistics_.handle_request_cnt_;
         HttpResponse rsp(StatusType::Bad_Request, "url invalid", "text/plain");
-        writeResponse(std::move(rsp));
+        writeResponse(current_request_id_, std::move(rsp));
         LOG_LOGGER_ERROR(fmt::format("session[{}], request_id: {}, parse url fail: {}",
                                      id_,
                                      current_request_id_,
@@ -200,14 +811,27 @@ void HttpSession::processRequest()
 
     auto url = r.value();
     auto segments = url.segments();
-    auto handler = router_.search(segments);
-    if (handler == nullptr)
+
+    // the table stays alive until the reader is dropped, after handle() returns, the writer holds the handler
+    auto routes = routes_.read();
+    if (beast::websocket::is_upgrade(request_))
+    {
+        auto websocket_route = routes->websocket_router_.search(segments);
+        if (websocket_route != nullptr)
+        {
+            return upgradeWebSocket(websocket_route->websocket_handler_, url);
+        }
+    }
+
+    auto route = routes->router_.search(segments);
+    auto handler = route != nullptr ? route->handler_.get() : nullptr;
+    if (handler == nullptr)
     {
         // handler not found
         LOG_LOGGER_ERROR(fmt::format("session[{}], request_id: {}, handler not found", id_, current_request_id_));
         ++statistics_.handle_request_cnt_;
         HttpResponse rsp(StatusType::Bad_Request, "current url not support", "text/plain");
-        writeResponse(std::move(rsp));
+        writeResponse(current_request_id_, std::move(rsp));
         request_.body().clear();
         return;
     }
@@ -223,69 +847,264 @@ void HttpSession::processRequest()
         LOG_LOGGER_ERROR(fmt::format("session[{}], request_id: {}, method not support", id_, current_request_id_));
         ++statistics_.handle_request_cnt_;
         HttpResponse rsp(StatusType::Bad_Request, "current method not support", "text/plain");
-        writeResponse(std::move(rsp));
+        writeResponse(current_request_id_, std::move(rsp));
         request_.body().clear();
         return;
     }
 
     request.method_ = static_cast<MethodType>(request_.method());
 
+    if (fast_path_)
+    {
+        auto body = static_cast<const char*>(buffer_.data().data()) + fast_request_.header_size_;
+        fillRequest(request,
+                    fast_request_,
+                    HttpStringView(body, fast_request_size_ - fast_request_.header_size_),
+                    url,
+                    opts_.auto_decode_url_parameters_);
+    }
+    else
+    {
+        fillRequest(request, request_, url, opts_.auto_decode_url_parameters_);
+    }
+
+    // the deadline covers the handler, the write has its own timeout
+    request_cancelled_ = std::make_shared<std::atomic<bool>>(false);
+    request.cancelled_ = request_cancelled_;
+    if (opts_.handle_time_out_ != 0)
+    {
+        request.deadline_ = request.request_start_time_ + std::chrono::seconds(opts_.handle_time_out_);
+    }
+    armTimer(HttpTimerKind::Handle, opts_.handle_time_out_);
+
+    // in-flight until the handler sends the response, see finishHandler()
+    handler_in_flight_ = true;
+    handler_start_time_ = request.request_start_time_;
+    ++statistics_.working_handler_cnt_;
+    handler->handle(std::move(request), HttpResponseWriter(shared_from_this(), current_request_id_, route->handler_));
+    ++statistics_.handle_request_cnt_;
+}
+
+void HttpSession::fillRequest(HttpRequest& request,
+                              beast::http::request<beast::http::dynamic_body>& raw_request,
+                              const urls::url_view& url,
+                              bool auto_decode_url_parameters)
+{
+    // headers, segments and parameters are copied into one arena, sized so that a single block usually fits them.
+    // the target counts twice: segments and parameters, then the values decoded when read
+    auto header_cnt = static_cast<std::size_t>(std::distance(raw_request.begin(), raw_request.end()));
+    std::size_t arena_size = 2 * raw_request.target().size();
+    for (auto iter = raw_request.begin(); iter != raw_request.end(); ++iter)
+    {
+        arena_size += iter->name_string().size() + iter->value().size() + 2;  // with the NULs
+    }
+    auto arena = std::allocate_shared<HttpArena>(HttpRecyclingAllocator<HttpArena>(), arena_size);
+
+    // set http header
+    request.headers_.reset(arena, header_cnt);
+    for (auto iter = raw_request.begin(); iter != raw_request.end(); ++iter)
+    {
+        request.headers_.add(iter->name_string().data(),
+                             iter->name_string().size(),
+                             iter->value().data(),
+                             iter->value().size());
+    }
+    request.headers_.finish();
+
+    fillUrl(request, arena, url, auto_decode_url_parameters);
+
+    // set http body
+    if (raw_request.body().size() > 0)
+    {
+        request.body_ = beast::buffers_to_string(raw_request.body().data());
+        raw_request.body().clear();
+    }
+}
+
+void HttpSession::fillRequest(HttpRequest& request,
+                              const HttpFastParser::Request& raw_request,
+                              HttpStringView body,
+                              const urls::url_view& url,
+                              bool auto_decode_url_parameters)
+{
+    std::size_t arena_size = 2 * raw_request.target_.size();
+    for (const auto& header : raw_request.headers_)
+    {
+        arena_size += header.name_.size() + header.value_.size() + 2;  // with the NULs
+    }
+    auto arena = std::allocate_shared<HttpArena>(HttpRecyclingAllocator<HttpArena>(), arena_size);
+
     // set http header
-    for (auto iter = request_.begin(); iter != request_.end(); iter++)
+    request.headers_.reset(arena, raw_request.headers_.size());
+    for (const auto& header : raw_request.headers_)
+    {
+        request.headers_.add(header.name_.data(), header.name_.size(), header.value_.data(), header.value_.size());
+    }
+    request.headers_.finish();
+
+    fillUrl(request, arena, url, auto_decode_url_parameters);
+
+    // set http body
+    if (!body.empty())
+    {
+        request.body_.assign(body.data(), body.size());
+    }
+}
+
+void HttpSession::fillRequest(HttpRequest& request,
+                              Http2Connection::Request& raw_request,
+                              const urls::url_view& url,
+                              bool auto_decode_url_parameters)
+{
+    std::size_t arena_size = 2 * raw_request.target_.size();
+    for (const auto& header : raw_request.headers_)
     {
-        request.headers_[iter->name_string()] = iter->value();
+        arena_size += header.name_.size() + header.value_.size() + 2;  // with the NULs
     }
+    auto arena = std::allocate_shared<HttpArena>(HttpRecyclingAllocator<HttpArena>(), arena_size);
 
+    // set http header, the names are lowercase in HTTP/2
+    request.headers_.reset(arena, raw_request.headers_.size());
+    for (const auto& header : raw_request.headers_)
+    {
+        request.headers_.add(header.name_.data(), header.name_.size(), header.value_.data(), header.value_.size());
+    }
+    request.headers_.finish();
+
+    fillUrl(request, arena, url, auto_decode_url_parameters);
+
+    // set http body
+    request.body_ = std::move(raw_request.body_);
+}
+
+void HttpSession::fillUrl(HttpRequest& request,
+                          const std::shared_ptr<HttpArena>& arena,
+                          const urls::url_view& url,
+                          bool auto_decode_url_parameters)
+{
     // set http path segments
+    auto segments = url.segments();
+    request.segments_.reset(arena, static_cast<std::size_t>(segments.size()));
     for (auto s : segments)
     {
-        request.segments_.push_back(s);
+        request.segments_.add(s.data(), s.size());
+    }
+
+    // set http parameters, decoded values are decoded when the handler reads them
+    request.params_.reset(arena, 0);
+    if (url.has_query())
+    {
+        auto query = url.encoded_query();
+        request.params_.addQuery(query.data(), query.size(), auto_decode_url_parameters);
+    }
+    request.params_.finish();
+}
+
+bool HttpSession::allowRequest()
+{
+    if (opts_.rate_limit_qps_ == 0)
+    {
+        return true;
     }
 
-    // set http parameters
-    if (opts_.auto_decode_url_parameters_)
+    // the key header is only trusted from a proxy, a client could change it to get a fresh limit
+    auto key_hash = client_key_hash_;
+    if (trusted_proxy_ && fast_path_)
     {
-        for (auto p : url.params())
+        for (const auto& header : fast_request_.headers_)
         {
-            request.params_[p.key] = p.value;
+            if (header.name_.iequals(opts_.rate_limit_key_header_))
+            {
+                key_hash = HttpRateLimiter::hashKey(header.value_.data(), header.value_.size());
+                break;
+            }
         }
     }
-    else
+    else if (trusted_proxy_)
     {
-        for (auto p : url.encoded_params())
+        const auto& header = parser_->get();
+        auto iter = header.find(opts_.rate_limit_key_header_);
+        if (iter != header.end())
         {
-            request.params_[std::string(p.key)] = std::string(p.value);
+            key_hash = HttpRateLimiter::hashKey(iter->value().data(), iter->value().size());
         }
     }
+    return rate_limiter_.allow(key_hash);
+}
 
-    // set http body
-    if (request_.body().size() > 0)
+bool HttpSession::isOverloaded()
+{
+    uint64_t limit = opts_.adaptive_concurrency_limit_ ? concurrency_limiter_.limit() : opts_.max_working_handler_num_;
+    return limit != 0 && statistics_.working_handler_cnt_.load() >= limit;
+}
+
+void HttpSession::finishHandler()
+{
+    if (!handler_in_flight_)
     {
-        auto& body = request_.body();
-        request.body_ = beast::buffers_to_string(request_.body().data());
-        request_.body().clear();
+        return;
     }
 
-    ++statistics_.working_handler_cnt_;
-    handler->handle(std::move(request), HttpResponseWriter(shared_from_this()));
-    --statistics_.working_handler_cnt_;
-    ++statistics_.handle_request_cnt_;
+    handler_in_flight_ = false;
+    auto in_flight = statistics_.working_handler_cnt_--;
+    if (opts_.adaptive_concurrency_limit_)
+    {
+        auto latency = std::chrono::steady_clock::now() - handler_start_time_;
+        concurrency_limiter_.onSample(std::chrono::duration_cast<std::chrono::microseconds>(latency), in_flight);
+    }
 }
 
-void HttpSession::writeResponse(HttpResponse&& rsp)
+void HttpSession::writeResponse(uint64_t request_id, HttpResponse&& rsp)
 {
-    // common header
-    if (rsp.force_disable_keep_alive_)
+    // async handlers send from their own threads, the session state belongs to the strand
+    auto self = shared_from_this();
+    net::dispatch(stream_.get_executor(),
+                  makeAllocHandler([self, request_id, rsp = std::move(rsp)]() mutable
+                                   { self->doWriteResponse(request_id, std::move(rsp)); }));
+}
+
+void HttpSession::doWriteResponse(uint64_t request_id, HttpResponse&& rsp)
+{
+    if (h2_)
     {
-        response_.keep_alive(false);
+        return doH2WriteResponse(request_id, std::move(rsp));
     }
-    else
+
+    if (request_id != current_request_id_ || !response_pending_)
+    {
+        LOG_LOGGER_TRACE(fmt::format("session[{}] request_id: {}, drop response: request cancelled", id_, request_id));
+        return;
+    }
+
+    response_pending_ = false;
+    finishHandler();
+
+    auto keep_alive = !rsp.force_disable_keep_alive_ && keepAlive(request_.keep_alive());
+
+    std::shared_ptr<const std::string> shared_body;
+    auto gzip = prepareBody(rsp,
+                            boost::icontains(request_[beast::http::field::accept_encoding], "gzip") ||
+                                boost::icontains(request_[beast::http::field::accept_encoding], "*"),
+                            request_.method() == beast::http::verb::head,
+                            shared_body);
+
+    if (rsp.header_block_)
     {
-        response_.keep_alive(request_.keep_alive());
+        return doWriteTemplate(std::move(rsp), keep_alive, gzip, std::move(shared_body));
     }
 
+    // common header, a HTTP/1.1 response only says keep-alive when the client is HTTP/1.0 and closes otherwise
+    response_.keep_alive(keep_alive);
+    if (keep_alive && request_.version() < 11)
+    {
+        response_.set(beast::http::field::connection, "keep-alive");
+    }
     response_.result(static_cast<unsigned int>(rsp.status_));
-    response_.set(beast::http::field::content_type, rsp.content_type_);
+    response_.set(beast::http::field::date, HttpDate::now());
+    if (!rsp.content_type_.empty())
+    {
+        response_.set(beast::http::field::content_type, rsp.content_type_);
+    }
 
     // user set header
     for (auto& p : rsp.headers_)
@@ -293,35 +1112,1003 @@ void HttpSession::writeResponse(HttpResponse&& rsp)
         response_.set(p.first, p.second);
     }
 
-    if (rsp.force_gzip_)
+    if (gzip)
     {
-        // force gzip
         response_.set(beast::http::field::content_encoding, "gzip");
-        rsp.body_ = compressData(rsp.compression_level_, rsp.body_);
     }
-    else
+
+    if (shared_body)
+    {
+        // the body is written from the shared buffer instead of being copied into response_
+        shared_response_.base() = std::move(response_.base());
+        shared_response_.body() = beast::span<const char>(shared_body->data(), shared_body->size());
+        shared_response_.prepare_payload();
+        shared_body_ = std::move(shared_body);
+        armTimer(HttpTimerKind::Write, opts_.write_time_out_);
+        beast::http::async_write(
+            stream_,
+            shared_response_,
+            makeAllocHandler(beast::bind_front_handler(&HttpSession::onWrite, shared_from_this(), keep_alive)));
+        return;
+    }
+
+    if (rsp.body_.size() > 0)
+    {
+        beast::ostream(response_.body()) << std::move(rsp.body_);
+    }
+
+    // an empty body still needs "Content-Length: 0", otherwise a keep-alive client waits for the connection close
+    response_.prepare_payload();
+
+    doWrite();
+}
+
+void HttpSession::doWriteTemplate(HttpResponse&& rsp,
+                                  bool keep_alive,
+                                  bool gzip,
+                                  std::shared_ptr<const std::string>&& shared_body)
+{
+    // the template block is copied into a buffer which keeps its capacity across the requests of the session
+    template_header_.assign(*rsp.header_block_);
+    for (auto& p : rsp.headers_)
     {
-        // body > 500 bytes, protocol gzip
-        if (rsp.body_.size() > 500 && opts_.auto_gzip_ &&
-            (boost::icontains(request_[beast::http::field::accept_encoding], "gzip") ||
-             boost::icontains(request_[beast::http::field::accept_encoding], "*")))
+        // the block is written as is, a header split by CR or LF is dropped as the template constructor rejects it
+        if (p.first.find_first_of("\r\n") != std::string::npos || p.second.find_first_of("\r\n") != std::string::npos)
         {
-            response_.set(beast::http::field::content_encoding, "gzip");
-            rsp.body_ = compressData(rsp.compression_level_, rsp.body_);
+            LOG_LOGGER_ERROR(fmt::format("session[{}], request_id: {}, drop response header containing CR or LF: {}",
+                                         id_,
+                                         current_request_id_,
+                                         p.first));
+            continue;
         }
+        template_header_.append(p.first).append(": ").append(p.second).append("\r\n");
     }
+    if (gzip)
+    {
+        template_header_.append("Content-Encoding: gzip\r\n");
+    }
+    template_header_.append("Date: ").append(HttpDate::now()).append("\r\n");
 
-    if (rsp.body_.size() > 0)
+    // responses which never have a body have no Content-Length either
+    auto status = static_cast<unsigned int>(rsp.status_);
+    net::const_buffer body;
+    if (status >= 200 && status != 204 && status != 304)
     {
-        // http header method doesn't require body
-        if (request_.method() != beast::http::verb::head)
+        if (shared_body)
+        {
+            shared_body_ = std::move(shared_body);
+            body = net::buffer(*shared_body_);
+        }
+        else
         {
-            beast::ostream(response_.body()) << std::move(rsp.body_);
+            template_body_ = std::move(rsp.body_);
+            body = net::buffer(template_body_);
         }
-        response_.prepare_payload();
+        template_header_.append("Content-Length: ").append(std::to_string(body.size())).append("\r\n");
+    }
+    // the same connection header as the beast path
+    if (!keep_alive)
+    {
+        template_header_.append("Connection: close\r\n");
     }
+    else if (request_.version() < 11)
+    {
+        template_header_.append("Connection: keep-alive\r\n");
+    }
+    template_header_.append("\r\n");
 
-    doWrite();
+    armTimer(HttpTimerKind::Write, opts_.write_time_out_);
+    std::array<net::const_buffer, 2> buffers{{net::buffer(template_header_), body}};
+    net::async_write(stream_,
+                     buffers,
+                     makeAllocHandler(beast::bind_front_handler(&HttpSession::onWrite, shared_from_this(), keep_alive)));
+}
+
+bool HttpSession::upgradeH2()
+{
+    auto settings = request_.find("HTTP2-Settings");
+    if (request_.version() != 11 || settings == request_.end() ||
+        !beast::http::token_list(request_[beast::http::field::upgrade]).exists("h2c"))
+    {
+        return false;
+    }
+
+    // the request becomes stream 1, with the fields HTTP/2 has no place for left out
+    Http2Connection::Request raw_request;
+    raw_request.method_.assign(request_.method_string().data(), request_.method_string().size());
+    raw_request.target_.assign(request_.target().data(), request_.target().size());
+    for (auto iter = request_.begin(); iter != request_.end(); ++iter)
+    {
+        std::string name(iter->name_string().data(), iter->name_string().size());
+        if (isConnectionHeader(name) || boost::iequals(name, "HTTP2-Settings"))
+        {
+            continue;
+        }
+        boost::to_lower(name);
+        raw_request.headers_.push_back(
+            HttpHpackDecoder::Field{std::move(name), std::string(iter->value().data(), iter->value().size())});
+    }
+    raw_request.body_ = beast::buffers_to_string(request_.body().data());
+
+    h2_.reset(new Http2Connection(opts_.http2_max_concurrent_streams_, opts_.max_request_size_));
+    if (!h2_->upgrade(std::string(settings->value().data(), settings->value().size()), std::move(raw_request)))
+    {
+        h2_.reset();
+        return false;
+    }
+    request_.body().clear();
+    LOG_LOGGER_TRACE(fmt::format("session[{}] request_id: {}, upgrade to http2", id_, current_request_id_));
+
+    // the frames follow the 101 response in the same write
+    h2_write_buffer_.assign(kSwitchingProtocols, sizeof(kSwitchingProtocols) - 1);
+    onH2Data();
+    return true;
+}
+
+void HttpSession::doH2Read()
+{
+    auto size = beast::read_size(buffer_, kFastReadSize);
+    if (size == 0)
+    {
+        // a frame larger than max_request_size_
+        ++statistics_.read_fail_cnt_;
+        LOG_LOGGER_TRACE(fmt::format("close invalid session[{}], http2 read fail: buffer full", id_));
+        return doClose();
+    }
+    stream_.async_read_some(buffer_.prepare(size),
+                            makeAllocHandler(beast::bind_front_handler(&HttpSession::onH2Read, shared_from_this())));
+}
+
+void HttpSession::onH2Read(beast::error_code ec, std::size_t bytes_transferred)
+{
+    if (!ec && !timed_out_)
+    {
+        buffer_.commit(bytes_transferred);
+        return onH2Data();
+    }
+
+    if (timed_out_ || !stream_.isOpen())
+    {
+        // the write timed out or the connection is closed after GOAWAY, the read was aborted with it
+        return doClose();
+    }
+    if (ec != net::error::eof)
+    {
+        ++statistics_.read_fail_cnt_;
+        LOG_LOGGER_TRACE(fmt::format("close invalid session[{}], http2 read fail: {}", id_, ec.message()));
+    }
+    doClose();
+}
+
+void HttpSession::onH2Data()
+{
+    auto data = buffer_.data();
+    buffer_.consume(h2_->receive(static_cast<const char*>(data.data()), data.size()));
+
+    Http2Connection::Request raw_request;
+    while (h2_->popRequest(raw_request))
+    {
+        processH2Request(raw_request);
+    }
+
+    // streams reset by the client, their handlers can stop early
+    uint32_t stream_id = 0;
+    while (h2_->popReset(stream_id))
+    {
+        auto iter = h2_handlers_.find(stream_id);
+        if (iter != h2_handlers_.end())
+        {
+            iter->second.cancelled_->store(true, std::memory_order_relaxed);
+        }
+    }
+
+    if (h2_->failed())
+    {
+        ++statistics_.read_fail_cnt_;
+        LOG_LOGGER_TRACE(fmt::format("close invalid session[{}], http2 protocol error", id_));
+    }
+
+    // after GOAWAY or an error the connection is closed once the output is written
+    doH2Write();
+    if (!h2_->closed() && stream_.isOpen())
+    {
+        doH2Read();
+    }
+}
+
+void HttpSession::processH2Request(Http2Connection::Request& raw_request)
+{
+    auto stream_id = raw_request.stream_id_;
+    LOG_LOGGER_TRACE(fmt::format("session[{}] stream_id: {}, read success", id_, stream_id));
+    ++statistics_.read_success_cnt_;
+
+    auto head = raw_request.method_ == "HEAD";
+    auto accept_gzip = false;
+    for (const auto& header : raw_request.headers_)
+    {
+        if (header.name_ == "accept-encoding")
+        {
+            accept_gzip = boost::icontains(header.value_, "gzip") || boost::icontains(header.value_, "*");
+            break;
+        }
+    }
+
+    if (!allowH2Request(raw_request))
+    {
+        ++statistics_.rate_limited_cnt_;
+        LOG_LOGGER_TRACE(fmt::format("session[{}], stream_id: {}, rejected: rate limited", id_, stream_id));
+        HttpResponse rsp(StatusType::Too_Many_Requests, "", "text/plain");
+        rsp.header("Retry-After", "1");
+        return respondH2(stream_id, std::move(rsp), head, false);
+    }
+
+    if (isOverloaded())
+    {
+        ++statistics_.rejected_request_cnt_;
+        LOG_LOGGER_TRACE(fmt::format("session[{}], stream_id: {}, rejected: overloaded", id_, stream_id));
+        HttpResponse rsp(StatusType::Service_Temporary_Unavailable, "", "text/plain");
+        rsp.header("Retry-After", "1");
+        return respondH2(stream_id, std::move(rsp), head, false);
+    }
+
+    // parse uri
+    auto method = beast::http::string_to_verb(raw_request.method_);
+    if (method == beast::http::verb::get && raw_request.target_.find('|') != std::string::npos)
+    {
+        // replace '|' with '%7C' to avoid parse error
+        boost::replace_all(raw_request.target_, "|", "%7C");
+    }
+    auto r = urls::parse_origin_form(raw_request.target_);
+    if (r.has_error())
+    {
+        ++statistics_.handle_request_cnt_;
+        LOG_LOGGER_ERROR(fmt::format("session[{}], stream_id: {}, parse url fail: {}", id_, stream_id, r.error().message()));
+        return respondH2(stream_id, HttpResponse(StatusType::Bad_Request, "url invalid", "text/plain"), head, false);
+    }
+
+    auto url = r.value();
+    auto segments = url.segments();
+    auto routes = routes_.read();
+    auto route = routes->router_.search(segments);
+    auto handler = route != nullptr ? route->handler_.get() : nullptr;
+    if (handler == nullptr)
+    {
+        LOG_LOGGER_ERROR(fmt::format("session[{}], stream_id: {}, handler not found", id_, stream_id));
+        ++statistics_.handle_request_cnt_;
+        return respondH2(stream_id,
+                         HttpResponse(StatusType::Bad_Request, "current url not support", "text/plain"),
+                         head,
+                         false);
+    }
+
+    if (method == beast::http::verb::unknown || method > beast::http::verb::put)
+    {
+        LOG_LOGGER_ERROR(fmt::format("session[{}], stream_id: {}, method not support", id_, stream_id));
+        ++statistics_.handle_request_cnt_;
+        return respondH2(stream_id,
+                         HttpResponse(StatusType::Bad_Request, "current method not support", "text/plain"),
+                         head,
+                         false);
+    }
+
+    // the stream id is the request id, the writer sends on the stream
+    auto request = HttpRequest(id_, stream_id);
+    request.request_start_time_ = std::chrono::steady_clock::now();
+    request.method_ = static_cast<MethodType>(method);
+    fillRequest(request, raw_request, url, opts_.auto_decode_url_parameters_);
+
+    // each stream has its own handle timer, the stream is answered with a 503 when it expires
+    auto cancelled = std::make_shared<std::atomic<bool>>(false);
+    request.cancelled_ = cancelled;
+    auto& h2_handler = h2_handlers_[stream_id];
+    h2_handler = H2Handler{cancelled, request.request_start_time_, head, accept_gzip, nullptr, 0};
+    if (opts_.handle_time_out_ != 0)
+    {
+        request.deadline_ = request.request_start_time_ + std::chrono::seconds(opts_.handle_time_out_);
+        h2_handler.timer_node_.reset(new HttpTimerNode());
+        h2_handler.timer_generation_ = (++h2_timer_generation_ << 32) | stream_id;
+        timing_wheel_->attach(*h2_handler.timer_node_, std::weak_ptr<HttpTimerTarget>(shared_from_this()));
+        timing_wheel_->arm(*h2_handler.timer_node_,
+                           std::chrono::seconds(opts_.handle_time_out_),
+                           HttpTimerKind::Handle,
+                           h2_handler.timer_generation_);
+    }
+    ++statistics_.working_handler_cnt_;
+    handler->handle(std::move(request), HttpResponseWriter(shared_from_this(), stream_id, route->handler_));
+    ++statistics_.handle_request_cnt_;
+}
+
+bool HttpSession::allowH2Request(const Http2Connection::Request& raw_request)
+{
+    if (opts_.rate_limit_qps_ == 0)
+    {
+        return true;
+    }
+
+    auto key_hash = client_key_hash_;
+    if (trusted_proxy_)
+    {
+        for (const auto& header : raw_request.headers_)
+        {
+            if (boost::iequals(header.name_, opts_.rate_limit_key_header_))
+            {
+                key_hash = HttpRateLimiter::hashKey(header.value_.data(), header.value_.size());
+                break;
+            }
+        }
+    }
+    return rate_limiter_.allow(key_hash);
+}
+
+void HttpSession::onH2HandleTimeout(uint64_t generation)
+{
+    auto stream_id = static_cast<uint32_t>(generation);
+    auto iter = h2_handlers_.find(stream_id);
+    if (iter == h2_handlers_.end() || iter->second.timer_generation_ != generation)
+    {
+        // the handler answered after the timer expired
+        return;
+    }
+
+    ++statistics_.handle_timeout_cnt_;
+    LOG_LOGGER_ERROR(fmt::format("session[{}] stream_id: {}, handle fail: timeout", id_, stream_id));
+
+    // the handler may still send, its response is dropped since the stream is no longer pending
+    auto handler = std::move(iter->second);
+    h2_handlers_.erase(iter);
+    handler.cancelled_->store(true, std::memory_order_relaxed);
+    finishH2Handler(handler);
+    if (!stream_.isOpen())
+    {
+        return;
+    }
+
+    // the response ends the stream, which frees its concurrency slot
+    HttpResponse rsp(StatusType::Service_Temporary_Unavailable, "", "text/plain");
+    rsp.header("Retry-After", "1");
+    respondH2(stream_id, std::move(rsp), handler.head_, false);
+}
+
+void HttpSession::finishH2Handler(H2Handler& handler)
+{
+    if (handler.timer_node_)
+    {
+        timing_wheel_->cancel(*handler.timer_node_);
+    }
+
+    auto in_flight = statistics_.working_handler_cnt_--;
+    if (opts_.adaptive_concurrency_limit_)
+    {
+        auto latency = std::chrono::steady_clock::now() - handler.start_time_;
+        concurrency_limiter_.onSample(std::chrono::duration_cast<std::chrono::microseconds>(latency), in_flight);
+    }
+}
+
+void HttpSession::doH2WriteResponse(uint64_t request_id, HttpResponse&& rsp)
+{
+    auto iter = h2_handlers_.find(static_cast<uint32_t>(request_id));
+    if (iter == h2_handlers_.end())
+    {
+        LOG_LOGGER_TRACE(fmt::format("session[{}] stream_id: {}, drop response: already sent", id_, request_id));
+        return;
+    }
+
+    auto handler = std::move(iter->second);
+    h2_handlers_.erase(iter);
+    finishH2Handler(handler);
+
+    if (handler.cancelled_->load(std::memory_order_relaxed) || !stream_.isOpen())
+    {
+        LOG_LOGGER_TRACE(fmt::format("session[{}] stream_id: {}, drop response: request cancelled", id_, request_id));
+        return;
+    }
+    respondH2(static_cast<uint32_t>(request_id), std::move(rsp), handler.head_, handler.accept_gzip_);
+}
+
+void HttpSession::respondH2(uint32_t stream_id, HttpResponse&& rsp, bool head, bool accept_gzip)
+{
+    if (rsp.force_disable_keep_alive_)
+    {
+        // no new streams, the connection closes after the open ones
+        h2_->goAway();
+    }
+
+    std::shared_ptr<const std::string> shared_body;
+    auto gzip = prepareBody(rsp, accept_gzip, head, shared_body);
+
+    std::vector<std::pair<std::string, std::string>> fields;
+    if (rsp.header_block_)
+    {
+        // the fields of the template, after its status line, h2 field names must be lowercase (RFC 9113 8.2)
+        const auto& block = *rsp.header_block_;
+        auto line_begin = block.find("\r\n");
+        while (line_begin != std::string::npos && line_begin + 2 < block.size())
+        {
+            line_begin += 2;
+            auto line_end = block.find("\r\n", line_begin);
+            auto colon = block.find(':', line_begin);
+            if (line_end == std::string::npos || colon == std::string::npos || colon > line_end)
+            {
+                break;
+            }
+            auto value_begin = block.find_first_not_of(' ', colon + 1);
+            value_begin = value_begin == std::string::npos || value_begin > line_end ? line_end : value_begin;
+            auto name = block.substr(line_begin, colon - line_begin);
+            if (!isConnectionHeader(name))
+            {
+                boost::to_lower(name);
+                fields.emplace_back(std::move(name), block.substr(value_begin, line_end - value_begin));
+            }
+            line_begin = line_end;
+        }
+    }
+    else if (!rsp.content_type_.empty())
+    {
+        fields.emplace_back("content-type", rsp.content_type_);
+    }
+
+    // user set header, without the HTTP/1.1 connection headers
+    for (auto& p : rsp.headers_)
+    {
+        if (!isConnectionHeader(p.first))
+        {
+            fields.emplace_back(boost::to_lower_copy(p.first), p.second);
+        }
+    }
+    if (gzip)
+    {
+        fields.emplace_back("content-encoding", "gzip");
+    }
+    fields.emplace_back("date", HttpDate::now());
+
+    auto status = static_cast<unsigned int>(rsp.status_);
+    if (status >= 200 && status != 204 && status != 304)
+    {
+        fields.emplace_back("content-length", std::to_string(shared_body ? shared_body->size() : rsp.body_.size()));
+    }
+
+    auto responded = shared_body ? h2_->respond(stream_id, status, fields, shared_body)
+                                 : h2_->respond(stream_id, status, fields, std::move(rsp.body_));
+    if (responded)
+    {
+        ++statistics_.write_success_cnt_;
+    }
+    doH2Write();
+}
+
+void HttpSession::doH2Write()
+{
+    if (h2_writing_ || !stream_.isOpen())
+    {
+        return;
+    }
+
+    h2_->takeOutput(h2_write_buffer_);
+    if (h2_write_buffer_.empty())
+    {
+        if (h2_->closed())
+        {
+            LOG_LOGGER_TRACE(fmt::format("session[{}] http2 connection finished", id_));
+            return doClose();
+        }
+        return updateH2Timer();
+    }
+
+    h2_writing_ = true;
+    armTimer(HttpTimerKind::Write, opts_.write_time_out_);
+    net::async_write(stream_,
+                     net::buffer(h2_write_buffer_),
+                     makeAllocHandler(beast::bind_front_handler(&HttpSession::onH2Write, shared_from_this())));
+}
+
+void HttpSession::onH2Write(beast::error_code ec, std::size_t bytes_transferred)
+{
+    boost::ignore_unused(bytes_transferred);
+    h2_writing_ = false;
+    h2_write_buffer_.clear();
+    if (timed_out_)
+    {
+        // the timer cancelled the write
+        ec = beast::error::timeout;
+    }
+
+    if (ec == beast::error::timeout)
+    {
+        ++statistics_.write_timeout_cnt_;
+        LOG_LOGGER_ERROR(fmt::format("close invalid session[{}], http2 write fail: timeout", id_));
+        return doClose();
+    }
+    else if (ec)
+    {
+        ++statistics_.write_fail_cnt_;
+        LOG_LOGGER_ERROR(fmt::format("close invalid session[{}], http2 write fail: {}", id_, ec.message()));
+        return doClose();
+    }
+
+    // responses queued while writing
+    doH2Write();
+}
+
+void HttpSession::updateH2Timer()
+{
+    if (h2_->streamCount() != 0 || !h2_handlers_.empty())
+    {
+        // streams have no read timeout, the write timer covers the responses
+        return cancelTimer();
+    }
+
+    armTimer(HttpTimerKind::Idle, opts_.keep_alive_time_out_ != 0 ? opts_.keep_alive_time_out_ : kIdleRecheckTimeOut);
+    if (statistics_.draining_.load())
+    {
+        // drain() started while streams were open, it may have missed this timer
+        onH2Idle();
+    }
+}
+
+void HttpSession::onH2Idle()
+{
+    LOG_LOGGER_TRACE(fmt::format("close idle http2 session[{}]: {}",
+                                 id_,
+                                 statistics_.draining_.load() ? "draining" : "keep alive timeout"));
+
+    // the client learns that no stream was processed before the connection closes
+    h2_->goAway();
+    doH2Write();
+}
+
+void HttpSession::upgradeWebSocket(const std::shared_ptr<WebSocketHandler>& handler, const urls::url_view& url)
+{
+    response_pending_ = false;
+    if (statistics_.draining_.load())
+    {
+        LOG_LOGGER_TRACE(fmt::format("session[{}], request_id: {}, rejected upgrade: draining", id_, current_request_id_));
+        return doWriteCanned(HttpCannedResponse::serviceUnavailable(false), false);
+    }
+
+    // onOpen() gets the upgrade request once the handshake response is written
+    auto request = HttpRequest(id_, current_request_id_);
+    request.request_start_time_ = std::chrono::steady_clock::now();
+    request.method_ = static_cast<MethodType>(request_.method());
+    fillRequest(request, request_, url, opts_.auto_decode_url_parameters_);
+
+    // messages are written whole, so a shared payload goes to the socket as it is
+    ws_.emplace(stream_);
+    ws_->auto_fragment(false);
+    ws_->read_message_max(opts_.max_request_size_);
+    ws_->set_option(beast::websocket::stream_base::decorator(
+        [](beast::websocket::response_type& response) { response.erase(beast::http::field::server); }));
+    ws_->control_callback([this](beast::websocket::frame_type, beast::string_view) { ws_ping_pending_ = false; });
+
+    armTimer(HttpTimerKind::Write, opts_.write_time_out_);
+    auto self = shared_from_this();
+    ws_->async_accept(request_,
+                      makeAllocHandler([self, handler, request = std::move(request)](beast::error_code ec) mutable
+                                       { self->onWebSocketAccept(handler, std::move(request), ec); }));
+}
+
+void HttpSession::onWebSocketAccept(const std::shared_ptr<WebSocketHandler>& handler,
+                                    HttpRequest&& request,
+                                    beast::error_code ec)
+{
+    if (timed_out_)
+    {
+        // the timer cancelled the write
+        ec = beast::error::timeout;
+    }
+    cancelTimer();
+
+    if (ec == beast::error::timeout)
+    {
+        ++statistics_.write_timeout_cnt_;
+        LOG_LOGGER_ERROR(fmt::format("close invalid session[{}], websocket handshake fail: timeout", id_));
+        return doClose();
+    }
+    else if (ec)
+    {
+        // beast answered a malformed upgrade request with a 400
+        ++statistics_.write_fail_cnt_;
+        LOG_LOGGER_TRACE(fmt::format("close invalid session[{}], websocket handshake fail: {}", id_, ec.message()));
+        return doClose();
+    }
+
+    LOG_LOGGER_TRACE(fmt::format("session[{}] request_id: {}, upgrade to websocket", id_, current_request_id_));
+    ++statistics_.write_success_cnt_;
+    ++statistics_.websocket_session_cnt_;
+    ++statistics_.handle_request_cnt_;
+    ws_handler_ = handler;
+
+    // clients wait for the handshake response, nothing after the upgrade request is expected
+    request_ = {};
+    buffer_.consume(buffer_.size());
+
+    handler->onOpen(WebSocketConnection(shared_from_this(), id_), std::move(request));
+    doWebSocketWrite();
+    doWebSocketRead();
+}
+
+void HttpSession::doWebSocketRead()
+{
+    ws_->async_read(buffer_,
+                    makeAllocHandler(beast::bind_front_handler(&HttpSession::onWebSocketRead, shared_from_this())));
+}
+
+void HttpSession::onWebSocketRead(beast::error_code ec, std::size_t bytes_transferred)
+{
+    boost::ignore_unused(bytes_transferred);
+    if (ec)
+    {
+        if (ec != beast::websocket::error::closed && !timed_out_ && stream_.isOpen())
+        {
+            ++statistics_.read_fail_cnt_;
+        }
+        LOG_LOGGER_TRACE(fmt::format("close websocket session[{}]: {}", id_, ec.message()));
+
+        // every pending operation ends with the connection, so this is the last callback of the handler
+        auto handler = ws_handler_;
+        ws_handler_ = nullptr;
+        --statistics_.websocket_session_cnt_;
+        handler->onClose(WebSocketConnection(shared_from_this(), id_));
+        return doClose();
+    }
+
+    ++statistics_.read_success_cnt_;
+    ws_ping_pending_ = false;
+    WebSocketMessage message(beast::buffers_to_string(buffer_.data()), !ws_->got_text());
+    buffer_.consume(buffer_.size());
+    ws_handler_->onMessage(WebSocketConnection(shared_from_this(), id_), std::move(message));
+    doWebSocketRead();
+}
+
+void HttpSession::sendWebSocket(const WebSocketMessage& message)
+{
+    // like writeResponse(), the queue belongs to the strand, only the payload reference is copied
+    auto self = shared_from_this();
+    net::dispatch(stream_.get_executor(),
+                  makeAllocHandler([self, message]() { self->doWebSocketSend(message); }));
+}
+
+void HttpSession::closeWebSocket()
+{
+    net::dispatch(stream_.get_executor(),
+                  makeAllocHandler(beast::bind_front_handler(&HttpSession::doWebSocketClose, shared_from_this())));
+}
+
+void HttpSession::doWebSocketSend(const WebSocketMessage& message)
+{
+    if (ws_handler_ == nullptr || ws_closing_ || !stream_.isOpen())
+    {
+        return;
+    }
+
+    ws_queue_size_ += message.payload_->size();
+    ws_queue_.push_back(message);
+    if (opts_.websocket_max_queue_size_ != 0 && ws_queue_size_ > opts_.websocket_max_queue_size_)
+    {
+        // the client reads slower than messages are sent, dropping it keeps the memory bounded
+        ++statistics_.websocket_slow_consumer_cnt_;
+        LOG_LOGGER_TRACE(fmt::format("close slow websocket session[{}]: {} bytes queued", id_, ws_queue_size_));
+        return doClose();
+    }
+    doWebSocketWrite();
+}
+
+void HttpSession::doWebSocketClose()
+{
+    if (ws_handler_ == nullptr || ws_closing_)
+    {
+        return;
+    }
+
+    ws_closing_ = true;
+    doWebSocketWrite();
+}
+
+void HttpSession::doWebSocketWrite()
+{
+    if (ws_writing_ || !stream_.isOpen())
+    {
+        return;
+    }
+
+    if (ws_queue_.empty() && ws_closing_)
+    {
+        // the close frame follows the queued messages, the read completes once the client answers it
+        ws_writing_ = true;
+        armTimer(HttpTimerKind::Write, opts_.write_time_out_);
+        ws_->async_close(beast::websocket::close_code::going_away,
+                         makeAllocHandler(beast::bind_front_handler(&HttpSession::onWebSocketClose, shared_from_this())));
+        return;
+    }
+
+    if (ws_queue_.empty())
+    {
+        // the idle timer pings the client, the same as keep-alive it is armed even without keep_alive_time_out_
+        armTimer(HttpTimerKind::Idle,
+                 opts_.keep_alive_time_out_ != 0 ? opts_.keep_alive_time_out_ : kIdleRecheckTimeOut);
+        if (statistics_.draining_.load())
+        {
+            // drain() started while writing, it may have missed this timer
+            onWebSocketIdle();
+        }
+        return;
+    }
+
+    ws_writing_ = true;
+    armTimer(HttpTimerKind::Write, opts_.write_time_out_);
+    const auto& message = ws_queue_.front();
+    ws_->binary(message.binary_);
+    ws_->async_write(net::buffer(*message.payload_),
+                     makeAllocHandler(beast::bind_front_handler(&HttpSession::onWebSocketWrite, shared_from_this())));
+}
+
+void HttpSession::onWebSocketWrite(beast::error_code ec, std::size_t bytes_transferred)
+{
+    boost::ignore_unused(bytes_transferred);
+    ws_writing_ = false;
+    if (timed_out_)
+    {
+        // the timer cancelled the write
+        ec = beast::error::timeout;
+    }
+
+    if (ec == beast::error::timeout)
+    {
+        ++statistics_.write_timeout_cnt_;
+        LOG_LOGGER_ERROR(fmt::format("close invalid session[{}], websocket write fail: timeout", id_));
+        return doClose();
+    }
+    else if (ec && stream_.isOpen())
+    {
+        ++statistics_.write_fail_cnt_;
+        LOG_LOGGER_ERROR(fmt::format("close invalid session[{}], websocket write fail: {}", id_, ec.message()));
+        return doClose();
+    }
+    else if (ec)
+    {
+        // closed as a slow consumer or by the read side
+        return;
+    }
+
+    ++statistics_.write_success_cnt_;
+    ws_queue_size_ -= ws_queue_.front().payload_->size();
+    ws_queue_.pop_front();
+    doWebSocketWrite();
+}
+
+void HttpSession::onWebSocketClose(beast::error_code ec)
+{
+    // the pending read reports the end of the connection
+    LOG_LOGGER_TRACE(fmt::format("session[{}] websocket close handshake: {}", id_, ec ? ec.message() : "done"));
+}
+
+void HttpSession::onWebSocketIdle()
+{
+    if (statistics_.draining_.load())
+    {
+        LOG_LOGGER_TRACE(fmt::format("close websocket session[{}]: draining", id_));
+        return doWebSocketClose();
+    }
+
+    if (ws_ping_pending_)
+    {
+        // nothing, not even the pong, arrived for a whole idle period
+        ++statistics_.read_timeout_cnt_;
+        LOG_LOGGER_TRACE(fmt::format("close websocket session[{}]: ping timeout", id_));
+        timed_out_ = true;
+        return doClose();
+    }
+
+    ws_ping_pending_ = true;
+    auto self = shared_from_this();
+    ws_->async_ping({}, makeAllocHandler([self](beast::error_code) {}));
+    armTimer(HttpTimerKind::Idle, opts_.keep_alive_time_out_ != 0 ? opts_.keep_alive_time_out_ : kIdleRecheckTimeOut);
+}
+
+HttpStream::executor_type HttpSession::executor()
+{
+    return stream_.get_executor();
+}
+
+std::shared_ptr<HttpEventStreamState> HttpSession::startEventStream(uint64_t request_id)
+{
+    // events sent before the stream starts wait in the state, the flush they post runs after the start
+    auto self = shared_from_this();
+    auto state = std::make_shared<HttpEventStreamState>(self, opts_.event_stream_max_queue_size_);
+    net::dispatch(stream_.get_executor(),
+                  makeAllocHandler([self, request_id, state]() { self->doStartEventStream(request_id, state); }));
+    return state;
+}
+
+void HttpSession::flushEventStream()
+{
+    // posted even on the strand, so the events sent by the running handler are written together
+    net::post(stream_.get_executor(),
+              makeAllocHandler(beast::bind_front_handler(&HttpSession::doEventStreamWrite, shared_from_this())));
+}
+
+void HttpSession::doStartEventStream(uint64_t request_id, const std::shared_ptr<HttpEventStreamState>& state)
+{
+    if (h2_ || request_id != current_request_id_ || !response_pending_)
+    {
+        {
+            std::lock_guard<std::mutex> lock(state->mutex_);
+            state->closed_ = true;
+            state->pending_.clear();
+        }
+        if (h2_)
+        {
+            // the body of a stream is sent whole, it can't be streamed
+            LOG_LOGGER_ERROR(fmt::format("session[{}] stream_id: {}, event stream needs HTTP/1.1", id_, request_id));
+            doH2WriteResponse(request_id,
+                              HttpResponse(StatusType::Internal_Server_Error, "event stream not support", "text/plain"));
+        }
+        return;
+    }
+
+    LOG_LOGGER_TRACE(fmt::format("session[{}] request_id: {}, start event stream", id_, current_request_id_));
+    response_pending_ = false;
+    finishHandler();
+    request_.body().clear();
+    ++statistics_.event_stream_cnt_;
+    event_stream_ = state;
+
+    // the body ends with the connection, the header goes out with the events sent so far
+    event_stream_buffer_.assign(kEventStreamHeader).append("Date: ").append(HttpDate::now()).append("\r\n\r\n");
+    stream_.asyncWaitRead(
+        makeAllocHandler(beast::bind_front_handler(&HttpSession::onEventStreamReadable, shared_from_this())));
+    doEventStreamWrite();
+}
+
+void HttpSession::doEventStreamWrite()
+{
+    if (!event_stream_ || event_stream_writing_)
+    {
+        // the write in flight takes the pending events when it completes
+        return;
+    }
+
+    bool closed = false;
+    bool dropped = false;
+    {
+        std::lock_guard<std::mutex> lock(event_stream_->mutex_);
+        event_stream_buffer_.append(event_stream_->pending_);
+        event_stream_->pending_.clear();
+        event_stream_->flush_posted_ = false;
+        closed = event_stream_->closed_;
+        dropped = event_stream_->dropped_;
+    }
+
+    if (dropped)
+    {
+        ++statistics_.write_fail_cnt_;
+        LOG_LOGGER_TRACE(fmt::format("close slow event stream session[{}], request_id: {}", id_, current_request_id_));
+        return endEventStream();
+    }
+
+    if (event_stream_buffer_.empty())
+    {
+        if (closed)
+        {
+            ++statistics_.write_success_cnt_;
+            return endEventStream();
+        }
+
+        armTimer(HttpTimerKind::Idle,
+                 opts_.event_stream_keep_alive_time_out_ != 0 ? opts_.event_stream_keep_alive_time_out_
+                                                              : kIdleRecheckTimeOut);
+        if (statistics_.draining_.load())
+        {
+            // drain() started while writing, it may have missed this timer
+            onEventStreamIdle();
+        }
+        return;
+    }
+
+    event_stream_writing_ = true;
+    armTimer(HttpTimerKind::Write, opts_.write_time_out_);
+    net::async_write(stream_,
+                     net::buffer(event_stream_buffer_),
+                     makeAllocHandler(beast::bind_front_handler(&HttpSession::onEventStreamWrite, shared_from_this())));
+}
+
+void HttpSession::onEventStreamWrite(beast::error_code ec, std::size_t bytes_transferred)
+{
+    boost::ignore_unused(bytes_transferred);
+    event_stream_writing_ = false;
+    if (timed_out_)
+    {
+        // the timer cancelled the write
+        ec = beast::error::timeout;
+    }
+
+    if (ec == beast::error::timeout)
+    {
+        ++statistics_.write_timeout_cnt_;
+        LOG_LOGGER_ERROR(fmt::format("close invalid session[{}], event stream write fail: timeout", id_));
+        return endEventStream();
+    }
+    else if (ec && stream_.isOpen())
+    {
+        ++statistics_.write_fail_cnt_;
+        LOG_LOGGER_ERROR(fmt::format("close invalid session[{}], event stream write fail: {}", id_, ec.message()));
+        return endEventStream();
+    }
+    else if (ec)
+    {
+        // the client closed the connection
+        return endEventStream();
+    }
+
+    event_stream_buffer_.clear();
+    doEventStreamWrite();
+}
+
+void HttpSession::onEventStreamReadable(beast::error_code ec)
+{
+    // the client sends nothing on an event stream, so readable means it closed the connection
+    LOG_LOGGER_TRACE(fmt::format("session[{}] event stream closed by the client: {}", id_, ec ? ec.message() : "eof"));
+    endEventStream();
+}
+
+void HttpSession::onEventStreamIdle()
+{
+    if (statistics_.draining_.load())
+    {
+        // the client reconnects to another server
+        LOG_LOGGER_TRACE(fmt::format("close event stream session[{}]: draining", id_));
+        return endEventStream();
+    }
+
+    if (opts_.event_stream_keep_alive_time_out_ == 0)
+    {
+        return armTimer(HttpTimerKind::Idle, kIdleRecheckTimeOut);
+    }
+
+    event_stream_buffer_.append(kEventStreamComment);
+    doEventStreamWrite();
+}
+
+void HttpSession::endEventStream()
+{
+    if (!event_stream_)
+    {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(event_stream_->mutex_);
+        event_stream_->closed_ = true;
+        event_stream_->pending_.clear();
+    }
+    event_stream_.reset();
+    --statistics_.event_stream_cnt_;
+    doClose();
+}
+
+// leave the body to write in rsp.body_, or in shared_body if other responses share it, return whether it's gzipped
+bool HttpSession::prepareBody(HttpResponse& rsp, bool accept_gzip, bool head, std::shared_ptr<const std::string>& shared_body)
+{
+    // force gzip, or body > 500 bytes and protocol gzip
+    auto size = rsp.shared_body_ ? rsp.shared_body_->body().size() : rsp.body_.size();
+    auto gzip = rsp.force_gzip_ || (size > 500 && opts_.auto_gzip_ && accept_gzip);
+
+    // http header method doesn't require body
+    if (head)
+    {
+        rsp.body_.clear();
+    }
+    else if (rsp.shared_body_)
+    {
+        // compressed once for all the responses sharing the body, each writes from the same buffer
+        const auto& body = gzip ? rsp.shared_body_->gzipBody() : rsp.shared_body_->body();
+        shared_body = std::shared_ptr<const std::string>(rsp.shared_body_, &body);
+    }
+    else if (gzip)
+    {
+        rsp.body_ = compressData(rsp.compression_level_, rsp.body_);
+    }
+    rsp.shared_body_.reset();
+    return gzip;
 }
 
 std::string HttpSession::compressData(CompressionLevel compression_level, const std::string& uncompressed_data)
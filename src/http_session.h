@@ -6,49 +6,251 @@
 
 #pragma once
 #include <chrono>
+#include <deque>
 #include <memory>
 #include <atomic>
+#include <string>
+#include <unordered_map>
 #include <httpserver/http_server.h>
+#include "http2_connection.h"
 #include "http_common.h"
-#include "http_router.h"
+#include "http_concurrency_limiter.h"
+#include "http_event_stream.h"
+#include "http_fast_parser.h"
+#include "http_rate_limiter.h"
+#include "http_routes.h"
 #include "http_statistics_internal.h"
+#include "http_stream.h"
+#include "http_timing_wheel.h"
 
 namespace http
 {
 namespace server
 {
 
-class HttpSession : public std::enable_shared_from_this<HttpSession>
+class HttpSession : public std::enable_shared_from_this<HttpSession>, public HttpTimerTarget
 {
 public:
     explicit HttpSession(tcp::socket&& socket,
-                         HttpRouter<APIHandler>& router_,
+                         HttpRoutes& routes,
                          const HttpServerOptions& opts,
-                         HttpStatisticsInternal& statistics);
+                         HttpStatisticsInternal& statistics,
+                         HttpConcurrencyLimiter& concurrency_limiter,
+                         HttpRateLimiter& rate_limiter,
+                         HttpTimingWheel& timing_wheel,
+                         HttpUringService* uring_service = nullptr,
+                         HttpTlsContext* tls_context = nullptr);
     ~HttpSession();
     void run();
-    void writeResponse(HttpResponse&& rsp);
+
+    /**
+     * @brief close the connection and settle the statistics, the destructor does it if not called before
+     */
+    void finish();
+
+    /**
+     * @brief bind a finished session to a new connection, the read buffer keeps its capacity
+     */
+    void reset(tcp::socket&& socket,
+               HttpTimingWheel& timing_wheel,
+               HttpUringService* uring_service = nullptr,
+               HttpTlsContext* tls_context = nullptr);
+
+    /**
+     * @brief free the read buffer if its capacity is over max_capacity
+     */
+    void trimBuffer(std::size_t max_capacity);
+
+    void writeResponse(uint64_t request_id, HttpResponse&& rsp);
+
+    /**
+     * @brief return the strand of the connection, handlers resumed on it don't race the session
+     */
+    HttpStream::executor_type executor();
+
+    /**
+     * @brief answer the request with an event stream, threadsafe
+     * @return the state of the stream, closed if the request can't be answered
+     */
+    std::shared_ptr<HttpEventStreamState> startEventStream(uint64_t request_id);
+
+    /**
+     * @brief write the pending events of the stream, threadsafe
+     */
+    void flushEventStream();
+
+    /**
+     * @brief queue a message on the upgraded connection, threadsafe
+     */
+    void sendWebSocket(const WebSocketMessage& message);
+
+    /**
+     * @brief close the upgraded connection once the queued messages are written, threadsafe
+     */
+    void closeWebSocket();
+
+    void onTimerExpired(HttpTimerKind kind, uint64_t generation) override;
     static std::atomic<std::uint64_t> s_id;  // global session id generator
 
+    /**
+     * @brief copy headers, path segments, parameters and body of the parsed request, the body of raw_request is cleared
+     */
+    static void fillRequest(HttpRequest& request,
+                            beast::http::request<beast::http::dynamic_body>& raw_request,
+                            const urls::url_view& url,
+                            bool auto_decode_url_parameters);
+
+    /**
+     * @brief copy headers, path segments, parameters and body of a request parsed by HttpFastParser
+     */
+    static void fillRequest(HttpRequest& request,
+                            const HttpFastParser::Request& raw_request,
+                            HttpStringView body,
+                            const urls::url_view& url,
+                            bool auto_decode_url_parameters);
+
+    /**
+     * @brief copy headers, path segments and parameters of a HTTP/2 request, the body is moved
+     */
+    static void fillRequest(HttpRequest& request,
+                            Http2Connection::Request& raw_request,
+                            const urls::url_view& url,
+                            bool auto_decode_url_parameters);
+
+    /**
+     * @brief gzip the data at the compression level
+     */
+    static std::string compressData(CompressionLevel compression_level, const std::string& uncompressed_data);
+
 private:
+    struct H2Handler;
+
+    void onConnect();
+    bool isTrustedProxy(const net::ip::address& address) const;
+    void doHandshake();
+    void onHandshake(beast::error_code ec);
     void doRead();
+    void onIdle(beast::error_code ec);
+    void doReadHeader();
+    void doReadPreface();
+    void onReadPreface(beast::error_code ec, std::size_t bytes_transferred);
+    void doParseHeader();
+    void doBeastReadHeader();
+    void onReadHeader(beast::error_code ec, std::size_t bytes_transferred);
+    void doFastRead();
+    void doFastReadSome();
+    void onFastRead(beast::error_code ec, std::size_t bytes_transferred);
+    void onFastRequest(uint64_t content_length);
     void onRead(beast::error_code ec, std::size_t bytes_transferred);
     void doWrite();
+    void doWriteCanned(net::const_buffer canned_response, bool keep_alive);
+    void armTimer(HttpTimerKind kind, uint64_t time_out);
+    void cancelTimer();
+    void onTimeout(HttpTimerKind kind, uint64_t generation);
+    void onHandleTimeout();
+    bool keepAlive(bool request_keep_alive);
     void onWrite(bool keep_alive, beast::error_code ec, std::size_t bytes_transferred);
     void doClose();
     void processRequest();
-    std::string compressData(CompressionLevel compression_level, const std::string& uncompressed_data);
+    static void fillUrl(HttpRequest& request,
+                        const std::shared_ptr<HttpArena>& arena,
+                        const urls::url_view& url,
+                        bool auto_decode_url_parameters);
+    bool isOverloaded();
+    bool allowRequest();
+    void finishHandler();
+    void doWriteResponse(uint64_t request_id, HttpResponse&& rsp);
+    void doWriteTemplate(HttpResponse&& rsp, bool keep_alive, bool gzip, std::shared_ptr<const std::string>&& shared_body);
+    bool prepareBody(HttpResponse& rsp, bool accept_gzip, bool head, std::shared_ptr<const std::string>& shared_body);
+    bool upgradeH2();
+    void doH2Read();
+    void onH2Read(beast::error_code ec, std::size_t bytes_transferred);
+    void onH2Data();
+    void processH2Request(Http2Connection::Request& raw_request);
+    bool allowH2Request(const Http2Connection::Request& raw_request);
+    void onH2HandleTimeout(uint64_t generation);
+    void finishH2Handler(H2Handler& handler);
+    void doH2WriteResponse(uint64_t request_id, HttpResponse&& rsp);
+    void respondH2(uint32_t stream_id, HttpResponse&& rsp, bool head, bool accept_gzip);
+    void doH2Write();
+    void onH2Write(beast::error_code ec, std::size_t bytes_transferred);
+    void updateH2Timer();
+    void onH2Idle();
+    void upgradeWebSocket(const std::shared_ptr<WebSocketHandler>& handler, const urls::url_view& url);
+    void onWebSocketAccept(const std::shared_ptr<WebSocketHandler>& handler,
+                           HttpRequest&& request,
+                           beast::error_code ec);
+    void doWebSocketRead();
+    void onWebSocketRead(beast::error_code ec, std::size_t bytes_transferred);
+    void doWebSocketSend(const WebSocketMessage& message);
+    void doWebSocketClose();
+    void doWebSocketWrite();
+    void onWebSocketWrite(beast::error_code ec, std::size_t bytes_transferred);
+    void onWebSocketClose(beast::error_code ec);
+    void onWebSocketIdle();
+    void doStartEventStream(uint64_t request_id, const std::shared_ptr<HttpEventStreamState>& state);
+    void doEventStreamWrite();
+    void onEventStreamWrite(beast::error_code ec, std::size_t bytes_transferred);
+    void onEventStreamReadable(beast::error_code ec);
+    void onEventStreamIdle();
+    void endEventStream();
 
 private:
+    struct H2Handler
+    {
+        std::shared_ptr<std::atomic<bool>> cancelled_;  // shared with the HttpRequest
+        std::chrono::time_point<std::chrono::steady_clock> start_time_;
+        bool head_;
+        bool accept_gzip_;
+        std::unique_ptr<HttpTimerNode> timer_node_;  // handle deadline of the stream, nullptr without handle_time_out_
+        uint64_t timer_generation_;  // the stream id in the low 32 bits, see onH2HandleTimeout()
+    };
+
     uint64_t id_;
     uint64_t current_request_id_;
     HttpStatisticsInternal& statistics_;
+    HttpConcurrencyLimiter& concurrency_limiter_;
+    HttpRateLimiter& rate_limiter_;
+    uint64_t client_key_hash_;
+    bool trusted_proxy_;  // the peer is one of rate_limit_trusted_proxies_, its rate_limit_key_header_ names the client
+    HttpTimingWheel* timing_wheel_;
+    HttpTimerNode timer_node_;
+    uint64_t timer_generation_;
+    bool timed_out_;
+    bool finished_;
+    bool handler_in_flight_;
+    bool response_pending_;  // the current request hasn't been answered yet
+    std::shared_ptr<std::atomic<bool>> request_cancelled_;  // shared with the HttpRequest of the current handler
+    std::chrono::time_point<std::chrono::steady_clock> handler_start_time_;
     const HttpServerOptions& opts_;
-    HttpRouter<APIHandler>& router_;
-    beast::tcp_stream stream_;
+    HttpRoutes& routes_;
+    HttpStream stream_;
     beast::flat_buffer buffer_;
-    beast::http::request<beast::http::dynamic_body> request_;
+    boost::optional<beast::http::request_parser<beast::http::dynamic_body>> parser_;
+    beast::http::request<beast::http::dynamic_body> request_;  // only the request line, keep-alive and Accept-Encoding of a fast parsed request
+    bool fast_path_;  // the current request is parsed by HttpFastParser
+    HttpFastParser::Request fast_request_;  // views into buffer_
+    std::size_t fast_request_size_;  // header and body size of the fast request being read, 0 until its header is parsed
     beast::http::response<beast::http::dynamic_body> response_;
+    beast::http::response<beast::http::span_body<const char>> shared_response_;  // response_ with a body shared by other responses
+    std::shared_ptr<const std::string> shared_body_;  // body of shared_response_ or after template_header_, held while it's written
+    std::string template_header_;  // serialized header of a response created from a HttpResponseTemplate
+    std::string template_body_;
+    std::unique_ptr<Http2Connection> h2_;  // set once the connection speaks HTTP/2, requests are then streams
+    std::unordered_map<uint32_t, H2Handler> h2_handlers_;  // streams whose handler hasn't sent the response
+    uint64_t h2_timer_generation_;  // never reset, a timer of the previous connection stays stale
+    std::string h2_write_buffer_;  // frames being written
+    bool h2_writing_;
+    boost::optional<beast::websocket::stream<HttpStream&>> ws_;  // set once the connection is upgraded to WebSocket
+    std::shared_ptr<WebSocketHandler> ws_handler_;  // held for the connection, nullptr before the upgrade and after onClose()
+    std::deque<WebSocketMessage> ws_queue_;  // messages to write, the front one is being written
+    std::size_t ws_queue_size_;  // payload bytes of ws_queue_
+    bool ws_writing_;  // a message or the close frame is being written
+    bool ws_closing_;  // the close handshake starts once ws_queue_ is written
+    bool ws_ping_pending_;  // a ping was sent at the last idle timeout and nothing was received since
+    std::shared_ptr<HttpEventStreamState> event_stream_;  // set while the connection carries an event stream
+    std::string event_stream_buffer_;  // events being written
+    bool event_stream_writing_;
 };
 
 }  // namespace server
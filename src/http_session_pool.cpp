@@ -0,0 +1,126 @@
+#include <new>
+#include "http_session_pool.h"
+#include "http_recycling_allocator.h"
+#include "http_session.h"
+
+namespace http
+{
+namespace server
+{
+
+HttpSessionPool::HttpSessionPool(HttpRoutes& routes,
+                                 const HttpServerOptions& opts,
+                                 HttpStatisticsInternal& statistics,
+                                 HttpConcurrencyLimiter& concurrency_limiter,
+                                 HttpRateLimiter& rate_limiter)
+    : routes_(routes)
+    , opts_(opts)
+    , statistics_(statistics)
+    , concurrency_limiter_(concurrency_limiter)
+    , rate_limiter_(rate_limiter)
+    , mutex_()
+    , closed_(false)
+    , free_sessions_()
+{
+}
+
+HttpSessionPool::~HttpSessionPool()
+{
+    clear();
+}
+
+std::shared_ptr<HttpSession> HttpSessionPool::acquire(tcp::socket&& socket,
+                                                      HttpTimingWheel& timing_wheel,
+                                                      HttpUringService* uring_service,
+                                                      HttpTlsContext* tls_context)
+{
+    SessionOwner session;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!free_sessions_.empty())
+        {
+            session = std::move(free_sessions_.back());
+            free_sessions_.pop_back();
+        }
+    }
+
+    if (session)
+    {
+        ++statistics_.session_pool_hit_cnt_;
+        session->reset(std::move(socket), timing_wheel, uring_service, tls_context);
+    }
+    else
+    {
+        ++statistics_.session_pool_miss_cnt_;
+
+        // the session itself comes from the recycling pool as its handler memory does
+        HttpRecyclingAllocator<HttpSession> allocator;
+        auto memory = allocator.allocate(1);
+        try
+        {
+            session.reset(new (memory) HttpSession(std::move(socket),
+                                                   routes_,
+                                                   opts_,
+                                                   statistics_,
+                                                   concurrency_limiter_,
+                                                   rate_limiter_,
+                                                   timing_wheel,
+                                                   uring_service,
+                                                   tls_context));
+        }
+        catch (...)
+        {
+            allocator.deallocate(memory, 1);
+            throw;
+        }
+    }
+
+    // the session comes back through release() instead of being deleted, the control block is recycled too
+    auto pool = shared_from_this();
+    return std::shared_ptr<HttpSession>(
+        session.release(),
+        [pool](HttpSession* released) { pool->release(released); },
+        HttpRecyclingAllocator<HttpSession>());
+}
+
+std::size_t HttpSessionPool::size()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return free_sessions_.size();
+}
+
+void HttpSessionPool::clear()
+{
+    std::vector<SessionOwner> sessions;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        closed_ = true;
+        sessions.swap(free_sessions_);
+    }
+}
+
+void HttpSessionPool::release(HttpSession* session)
+{
+    SessionOwner owner(session);
+    owner->finish();
+    if (opts_.session_pool_size_ == 0)
+    {
+        return;
+    }
+
+    owner->trimBuffer(opts_.session_pool_buffer_size_);
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!closed_ && free_sessions_.size() < opts_.session_pool_size_)
+    {
+        free_sessions_.push_back(std::move(owner));
+    }
+}
+
+void HttpSessionPool::SessionDeleter::operator()(HttpSession* session) const noexcept
+{
+    session->~HttpSession();
+    HttpRecyclingAllocator<HttpSession>().deallocate(session, 1);
+}
+
+}  // namespace server
+}  // namespace http
@@ -0,0 +1,92 @@
+/**
+ * @brief Http session pool Define
+ * @file http_session_pool.h
+ * @copyright Licensed under the Apache License, Version 2.0
+ */
+
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <httpserver/http_server.h>
+#include "http_common.h"
+#include "http_concurrency_limiter.h"
+#include "http_rate_limiter.h"
+#include "http_routes.h"
+#include "http_statistics_internal.h"
+#include "http_timing_wheel.h"
+
+namespace http
+{
+namespace server
+{
+
+class HttpSession;
+class HttpUringService;
+class HttpTlsContext;
+
+/**
+ * @brief keeps the sessions of closed connections for reuse by new connections
+ * @note a session goes back to the pool when its last reference is dropped, on any thread, so the free
+ * list is shared and locked, it is only taken by the accept path. A pooled session keeps its read buffer
+ * up to the configured capacity, everything bound to the old connection is reset on reuse.
+ */
+class HttpSessionPool : public std::enable_shared_from_this<HttpSessionPool>
+{
+public:
+    HttpSessionPool(HttpRoutes& routes,
+                    const HttpServerOptions& opts,
+                    HttpStatisticsInternal& statistics,
+                    HttpConcurrencyLimiter& concurrency_limiter,
+                    HttpRateLimiter& rate_limiter);
+    ~HttpSessionPool();
+
+    HttpSessionPool(const HttpSessionPool&) = delete;
+    HttpSessionPool& operator=(const HttpSessionPool&) = delete;
+
+    /**
+     * @brief bind a pooled session to the connection, or create one if the pool is empty, threadsafe
+     * @param uring_service the io_uring transport of the connection, nullptr for the epoll reactor
+     * @param tls_context the TLS context of the connection, nullptr for plaintext
+     */
+    std::shared_ptr<HttpSession> acquire(tcp::socket&& socket,
+                                         HttpTimingWheel& timing_wheel,
+                                         HttpUringService* uring_service = nullptr,
+                                         HttpTlsContext* tls_context = nullptr);
+
+    /**
+     * @brief pooled session count, threadsafe
+     */
+    std::size_t size();
+
+    /**
+     * @brief destroy the pooled sessions, must be called before the io_context of their sockets is destroyed
+     */
+    void clear();
+
+private:
+    /**
+     * @brief destroy a session and give its memory back to HttpRecyclingPool
+     */
+    struct SessionDeleter
+    {
+        void operator()(HttpSession* session) const noexcept;
+    };
+    using SessionOwner = std::unique_ptr<HttpSession, SessionDeleter>;
+
+    void release(HttpSession* session);
+
+private:
+    HttpRoutes& routes_;
+    const HttpServerOptions& opts_;
+    HttpStatisticsInternal& statistics_;
+    HttpConcurrencyLimiter& concurrency_limiter_;
+    HttpRateLimiter& rate_limiter_;
+    std::mutex mutex_;
+    bool closed_;  // clear() was called, released sessions are deleted
+    std::vector<SessionOwner> free_sessions_;
+};
+
+}  // namespace server
+}  // namespace http
@@ -0,0 +1,32 @@
+#include "http_shared_body.h"
+#include "http_session.h"
+
+namespace http
+{
+namespace server
+{
+HttpSharedBody::HttpSharedBody(std::string&& body, CompressionLevel compression_level)
+    : body_(std::move(body))
+    , compression_level_(compression_level)
+    , gzip_once_()
+    , gzip_body_()
+{
+}
+
+HttpSharedBody::~HttpSharedBody()
+{
+}
+
+const std::string& HttpSharedBody::body() const
+{
+    return body_;
+}
+
+const std::string& HttpSharedBody::gzipBody()
+{
+    std::call_once(gzip_once_, [this]() { gzip_body_ = HttpSession::compressData(compression_level_, body_); });
+    return gzip_body_;
+}
+
+}  // namespace server
+}  // namespace http
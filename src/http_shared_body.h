@@ -0,0 +1,46 @@
+/**
+ * @brief Http shared response body Define
+ * @file http_shared_body.h
+ * @copyright Licensed under the Apache License, Version 2.0
+ */
+
+#pragma once
+#include <mutex>
+#include <string>
+#include <httpserver/detail/http_types.h>
+
+namespace http
+{
+namespace server
+{
+
+/**
+ * @brief body of a response answering many requests, such as the ones coalesced on one handler call
+ * @note the copies of the response refer to it, so the body is held once and gzipped at most once, by the first
+ * session whose client accepts gzip, the others write the same compressed bytes
+ */
+class HttpSharedBody
+{
+public:
+    HttpSharedBody(std::string&& body, CompressionLevel compression_level);
+    ~HttpSharedBody();
+
+    HttpSharedBody(const HttpSharedBody&) = delete;
+    HttpSharedBody& operator=(const HttpSharedBody&) = delete;
+
+    const std::string& body() const;
+
+    /**
+     * @brief return the gzipped body, threadsafe, it's compressed on the first call
+     */
+    const std::string& gzipBody();
+
+private:
+    const std::string body_;
+    const CompressionLevel compression_level_;
+    std::once_flag gzip_once_;
+    std::string gzip_body_;
+};
+
+}  // namespace server
+}  // namespace http
@@ -20,8 +20,25 @@ struct HttpStatisticsInternal
     std::atomic<std::uint64_t> write_timeout_cnt_{0};
     std::atomic<std::uint64_t> write_success_cnt_{0};
     std::atomic<std::uint64_t> write_fail_cnt_{0};
+    std::atomic<std::uint64_t> handle_timeout_cnt_{0};
     std::atomic<std::uint64_t> handle_request_cnt_{0};
     std::atomic<std::uint64_t> working_handler_cnt_{0};
+    std::atomic<std::uint64_t> rejected_session_cnt_{0};
+    std::atomic<std::uint64_t> rejected_request_cnt_{0};
+    std::atomic<std::uint64_t> rate_limited_cnt_{0};
+    std::atomic<std::uint64_t> session_pool_hit_cnt_{0};
+    std::atomic<std::uint64_t> session_pool_miss_cnt_{0};
+    std::atomic<std::uint32_t> websocket_session_cnt_{0};
+    std::atomic<std::uint64_t> websocket_slow_consumer_cnt_{0};
+    std::atomic<std::uint32_t> event_stream_cnt_{0};
+    std::atomic<std::uint64_t> tls_handshake_cnt_{0};
+    std::atomic<std::uint64_t> tls_resumed_cnt_{0};
+    std::atomic<std::uint64_t> tls_handshake_fail_cnt_{0};
+    std::atomic<std::uint64_t> ktls_cnt_{0};
+    std::atomic<std::uint64_t> cache_hit_cnt_{0};
+    std::atomic<std::uint64_t> cache_miss_cnt_{0};
+    std::atomic<std::uint64_t> coalesced_request_cnt_{0};
+    std::atomic<bool> draining_{false};  // sessions stop keeping connections alive
 };
 
 }  // namespace server
@@ -0,0 +1,135 @@
+#include <sys/socket.h>
+#include <unistd.h>
+#include "http_stream.h"
+
+namespace http
+{
+namespace server
+{
+
+constexpr std::size_t HttpStream::kTlsRecordSize;
+
+HttpStream::HttpStream(tcp::socket&& socket, HttpUringService* uring_service, HttpTlsContext* tls_context)
+    : tcp_(socket.get_executor())
+    , fd_(-1)
+    , uring_()
+    , tls_()
+    , tls_write_buffer_()
+{
+    open(std::move(socket), uring_service, tls_context);
+}
+
+HttpStream::~HttpStream()
+{
+    close();
+}
+
+void HttpStream::reset(tcp::socket&& socket, HttpUringService* uring_service, HttpTlsContext* tls_context)
+{
+    close();
+    open(std::move(socket), uring_service, tls_context);
+}
+
+void HttpStream::open(tcp::socket&& socket, HttpUringService* uring_service, HttpTlsContext* tls_context)
+{
+    if (tls_context != nullptr)
+    {
+        // OpenSSL never blocks on the socket, it asks to wait for readiness instead
+        tcp_.socket() = std::move(socket);
+        beast::error_code ec;
+        tcp_.socket().non_blocking(true, ec);
+        tls_.reset(new HttpTlsConnection(*tls_context, tcp_.socket().native_handle()));
+        return;
+    }
+
+    if (uring_service == nullptr)
+    {
+        tcp_.socket() = std::move(socket);
+        return;
+    }
+
+    // the socket object keeps the executor, the descriptor leaves the reactor
+    tcp_.socket() = tcp::socket(socket.get_executor());
+    beast::error_code ec;
+    fd_ = socket.release(ec);
+    if (ec)
+    {
+        fd_ = -1;
+        return;
+    }
+    uring_ = uring_service->open(fd_, tcp_.get_executor());
+}
+
+tcp::endpoint HttpStream::remoteEndpoint(beast::error_code& ec)
+{
+    // asked directly, the socket object may be a Unix connection of HttpListener whose address isn't an ip
+    tcp::endpoint endpoint;
+    auto size = static_cast<socklen_t>(endpoint.capacity());
+    auto fd = uring_ ? fd_ : tcp_.socket().native_handle();
+    if (getpeername(fd, endpoint.data(), &size) != 0)
+    {
+        ec.assign(errno, boost::system::system_category());
+        return tcp::endpoint();
+    }
+    if (endpoint.data()->sa_family != AF_INET && endpoint.data()->sa_family != AF_INET6)
+    {
+        ec = net::error::address_family_not_supported;
+        return tcp::endpoint();
+    }
+    endpoint.resize(size);
+    ec = {};
+    return endpoint;
+}
+
+bool HttpStream::isOpen() const
+{
+    return uring_ ? fd_ >= 0 : tcp_.socket().is_open();
+}
+
+void HttpStream::cancel()
+{
+    if (uring_)
+    {
+        return uring_->cancel();
+    }
+
+    beast::error_code ec;
+    tcp_.socket().cancel(ec);
+}
+
+void HttpStream::close()
+{
+    if (!uring_)
+    {
+        if (tls_ && tcp_.socket().is_open())
+        {
+            tls_->shutdown();
+        }
+        tls_.reset();
+        beast::error_code ec;
+        tcp_.socket().close(ec);
+        return;
+    }
+
+    // the kernel holds its own reference to the socket, so pending operations are cancelled first
+    uring_->close();
+    uring_.reset();
+    ::close(fd_);
+    fd_ = -1;
+}
+
+void teardown(beast::role_type role, HttpStream& stream, beast::error_code& ec)
+{
+    // the close frames are exchanged, nothing useful can follow
+    boost::ignore_unused(role);
+    stream.close();
+    ec = {};
+}
+
+void beast_close_socket(HttpStream& stream)
+{
+    stream.close();
+}
+
+}  // namespace server
+}  // namespace http
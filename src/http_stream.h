@@ -0,0 +1,360 @@
+/**
+ * @brief Http connection stream Define
+ * @file http_stream.h
+ * @copyright Licensed under the Apache License, Version 2.0
+ */
+
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <utility>
+#include <sys/uio.h>
+#include "http_common.h"
+#include "http_tls.h"
+#include "http_uring.h"
+
+namespace http
+{
+namespace server
+{
+
+/**
+ * @brief the connection of a session, a beast::tcp_stream on the epoll reactor of Asio or a socket of the
+ * io_uring transport, chosen when the connection is bound, optionally with TLS
+ * @note all are asynchronous streams for the beast and Asio algorithms, in io_uring mode the socket is
+ * released from Asio so the reactor never watches it. In TLS mode OpenSSL reads and writes the non-blocking
+ * socket itself, or the kernel does with kTLS, and the reactor only reports readiness, so no record is
+ * copied through an Asio buffer. TLS connections always use the reactor.
+ */
+class HttpStream
+{
+public:
+    using executor_type = beast::tcp_stream::executor_type;
+
+    /**
+     * @brief take the connection, uring_service is nullptr for the epoll reactor, tls_context is nullptr for
+     * plaintext
+     */
+    HttpStream(tcp::socket&& socket, HttpUringService* uring_service, HttpTlsContext* tls_context = nullptr);
+    ~HttpStream();
+
+    HttpStream(const HttpStream&) = delete;
+    HttpStream& operator=(const HttpStream&) = delete;
+
+    executor_type get_executor() noexcept
+    {
+        return tcp_.get_executor();
+    }
+
+    /**
+     * @brief take a new connection, the old one must be closed
+     */
+    void reset(tcp::socket&& socket, HttpUringService* uring_service, HttpTlsContext* tls_context = nullptr);
+
+    /**
+     * @brief return the TLS state, nullptr for a plaintext connection
+     */
+    const HttpTlsConnection* tls() const
+    {
+        return tls_.get();
+    }
+
+    /**
+     * @brief run the server side of the TLS handshake, the handler takes a beast::error_code
+     */
+    template <class HandshakeHandler>
+    void asyncHandshake(HandshakeHandler&& handler)
+    {
+        using Adapter = WaitAdapter<typename std::decay<HandshakeHandler>::type>;
+        TlsOp<Adapter>{this, TlsOpKind::Handshake, nullptr, 0, Adapter{std::forward<HandshakeHandler>(handler)}}
+            .start();
+    }
+
+    tcp::endpoint remoteEndpoint(beast::error_code& ec);
+    bool isOpen() const;
+
+    /**
+     * @brief abort the pending operations, their handlers get net::error::operation_aborted
+     */
+    void cancel();
+    void close();
+
+    template <class MutableBufferSequence, class ReadHandler>
+    BOOST_BEAST_ASYNC_RESULT2(ReadHandler)
+    async_read_some(const MutableBufferSequence& buffers, ReadHandler&& handler)
+    {
+        if (tls_)
+        {
+            return net::async_initiate<ReadHandler, void(beast::error_code, std::size_t)>(
+                InitiateTlsRead{this}, handler, buffers);
+        }
+        if (!uring_)
+        {
+            return tcp_.async_read_some(buffers, std::forward<ReadHandler>(handler));
+        }
+        return net::async_initiate<ReadHandler, void(beast::error_code, std::size_t)>(
+            InitiateRead{uring_.get()}, handler, buffers);
+    }
+
+    template <class ConstBufferSequence, class WriteHandler>
+    BOOST_BEAST_ASYNC_RESULT2(WriteHandler)
+    async_write_some(const ConstBufferSequence& buffers, WriteHandler&& handler)
+    {
+        if (tls_)
+        {
+            return net::async_initiate<WriteHandler, void(beast::error_code, std::size_t)>(
+                InitiateTlsWrite{this}, handler, buffers);
+        }
+        if (!uring_)
+        {
+            return tcp_.async_write_some(buffers, std::forward<WriteHandler>(handler));
+        }
+        return net::async_initiate<WriteHandler, void(beast::error_code, std::size_t)>(
+            InitiateWrite{uring_.get()}, handler, buffers);
+    }
+
+    /**
+     * @brief wait until the connection is readable, the handler takes a beast::error_code
+     */
+    template <class WaitHandler>
+    void asyncWaitRead(WaitHandler&& handler)
+    {
+        if (tls_ && tls_->pending())
+        {
+            // decrypted data is buffered by OpenSSL, the socket may never turn readable for it
+            net::post(tcp_.get_executor(),
+                      beast::bind_front_handler(std::forward<WaitHandler>(handler), beast::error_code()));
+            return;
+        }
+        if (!uring_)
+        {
+            return tcp_.socket().async_wait(net::socket_base::wait_read, std::forward<WaitHandler>(handler));
+        }
+        uring_->waitRead(HttpUringCompletion::create(WaitAdapter<typename std::decay<WaitHandler>::type>{
+            std::forward<WaitHandler>(handler)}));
+    }
+
+private:
+    static constexpr std::size_t kTlsRecordSize = 16384;  // max plaintext of a TLS record
+
+    enum class TlsOpKind
+    {
+        Handshake,
+        Read,
+        Write,
+    };
+
+    /**
+     * @brief a TLS operation retried on socket readiness, the handler takes (beast::error_code, std::size_t)
+     */
+    template <class Handler>
+    struct TlsOp
+    {
+        using allocator_type = net::associated_allocator_t<Handler>;
+
+        HttpStream* stream_;
+        TlsOpKind kind_;
+        const void* data_;
+        std::size_t size_;
+        Handler handler_;
+
+        allocator_type get_allocator() const noexcept
+        {
+            return net::get_associated_allocator(handler_);
+        }
+
+        void start()
+        {
+            step(false);
+        }
+
+        // the socket is ready or the wait was cancelled
+        void operator()(beast::error_code ec)
+        {
+            if (ec)
+            {
+                return handler_(ec, 0);
+            }
+            step(true);
+        }
+
+        void step(bool continuation)
+        {
+            beast::error_code ec;
+            std::size_t bytes_transferred = 0;
+            auto want = HttpTlsWant::Nothing;
+            switch (kind_)
+            {
+                case TlsOpKind::Handshake:
+                    want = stream_->tls_->handshake(ec);
+                    break;
+                case TlsOpKind::Read:
+                    want = size_ == 0 ? HttpTlsWant::Nothing
+                                      : stream_->tls_->read(const_cast<void*>(data_), size_, bytes_transferred, ec);
+                    break;
+                case TlsOpKind::Write:
+                    want = size_ == 0 ? HttpTlsWant::Nothing
+                                      : stream_->tls_->write(data_, size_, bytes_transferred, ec);
+                    break;
+            }
+
+            auto& socket = stream_->tcp_.socket();
+            if (want == HttpTlsWant::Read)
+            {
+                return socket.async_wait(net::socket_base::wait_read, std::move(*this));
+            }
+            if (want == HttpTlsWant::Write)
+            {
+                return socket.async_wait(net::socket_base::wait_write, std::move(*this));
+            }
+            if (continuation)
+            {
+                return handler_(ec, bytes_transferred);
+            }
+            // never complete inside the initiating call
+            net::post(socket.get_executor(), beast::bind_front_handler(std::move(handler_), ec, bytes_transferred));
+        }
+    };
+
+    struct InitiateTlsRead
+    {
+        HttpStream* stream_;
+
+        template <class ReadHandler, class MutableBufferSequence>
+        void operator()(ReadHandler&& handler, const MutableBufferSequence& buffers) const
+        {
+            net::mutable_buffer buffer;
+            for (auto it = net::buffer_sequence_begin(buffers); it != net::buffer_sequence_end(buffers); ++it)
+            {
+                buffer = net::mutable_buffer(*it);
+                if (buffer.size() != 0)
+                {
+                    break;
+                }
+            }
+            using Handler = typename std::decay<ReadHandler>::type;
+            TlsOp<Handler>{stream_, TlsOpKind::Read, buffer.data(), buffer.size(), std::forward<ReadHandler>(handler)}
+                .start();
+        }
+    };
+
+    struct InitiateTlsWrite
+    {
+        HttpStream* stream_;
+
+        template <class WriteHandler, class ConstBufferSequence>
+        void operator()(WriteHandler&& handler, const ConstBufferSequence& buffers) const
+        {
+            net::const_buffer buffer;
+            for (auto it = net::buffer_sequence_begin(buffers); it != net::buffer_sequence_end(buffers); ++it)
+            {
+                buffer = net::const_buffer(*it);
+                if (buffer.size() != 0)
+                {
+                    break;
+                }
+            }
+
+            // small buffers, such as a header followed by the body, go out in one record instead of one each
+            auto total_size = net::buffer_size(buffers);
+            if (buffer.size() < total_size && buffer.size() < kTlsRecordSize)
+            {
+                auto& coalesced = stream_->tls_write_buffer_;
+                coalesced.resize(std::min<std::size_t>(total_size, kTlsRecordSize));
+                net::buffer_copy(net::buffer(&coalesced[0], coalesced.size()), buffers);
+                buffer = net::buffer(coalesced);
+            }
+            using Handler = typename std::decay<WriteHandler>::type;
+            TlsOp<Handler>{stream_, TlsOpKind::Write, buffer.data(), buffer.size(), std::forward<WriteHandler>(handler)}
+                .start();
+        }
+    };
+
+    struct InitiateRead
+    {
+        HttpUringSocket* socket_;
+
+        template <class ReadHandler, class MutableBufferSequence>
+        void operator()(ReadHandler&& handler, const MutableBufferSequence& buffers) const
+        {
+            // like a socket, read into the first buffer which isn't empty
+            net::mutable_buffer buffer;
+            for (auto it = net::buffer_sequence_begin(buffers); it != net::buffer_sequence_end(buffers); ++it)
+            {
+                buffer = net::mutable_buffer(*it);
+                if (buffer.size() != 0)
+                {
+                    break;
+                }
+            }
+            socket_->read(buffer, HttpUringCompletion::create(std::forward<ReadHandler>(handler)));
+        }
+    };
+
+    struct InitiateWrite
+    {
+        HttpUringSocket* socket_;
+
+        template <class WriteHandler, class ConstBufferSequence>
+        void operator()(WriteHandler&& handler, const ConstBufferSequence& buffers) const
+        {
+            iovec iovecs[HttpUringSocket::kMaxIovecs];
+            std::size_t iovec_cnt = 0;
+            for (auto it = net::buffer_sequence_begin(buffers);
+                 it != net::buffer_sequence_end(buffers) && iovec_cnt < HttpUringSocket::kMaxIovecs;
+                 ++it)
+            {
+                net::const_buffer buffer(*it);
+                if (buffer.size() != 0)
+                {
+                    iovecs[iovec_cnt].iov_base = const_cast<void*>(buffer.data());
+                    iovecs[iovec_cnt].iov_len = buffer.size();
+                    ++iovec_cnt;
+                }
+            }
+            socket_->write(iovecs, iovec_cnt, HttpUringCompletion::create(std::forward<WriteHandler>(handler)));
+        }
+    };
+
+    template <class WaitHandler>
+    struct WaitAdapter
+    {
+        WaitHandler handler_;
+
+        void operator()(beast::error_code ec, std::size_t /*size*/)
+        {
+            handler_(ec);
+        }
+    };
+
+    void open(tcp::socket&& socket, HttpUringService* uring_service, HttpTlsContext* tls_context);
+
+    beast::tcp_stream tcp_;  // in io_uring mode only its executor is used
+    int fd_;  // the connection owned in io_uring mode, -1 otherwise
+    std::shared_ptr<HttpUringSocket> uring_;
+    std::unique_ptr<HttpTlsConnection> tls_;  // set in TLS mode
+    std::string tls_write_buffer_;  // small buffers of a write coalesced into one record
+};
+
+/**
+ * @brief close the connection at the end of the WebSocket close handshake, found by beast::websocket::stream
+ * through argument dependent lookup
+ */
+void teardown(beast::role_type role, HttpStream& stream, beast::error_code& ec);
+
+template <class TeardownHandler>
+void async_teardown(beast::role_type role, HttpStream& stream, TeardownHandler&& handler)
+{
+    beast::error_code ec;
+    teardown(role, stream, ec);
+    net::post(stream.get_executor(), beast::bind_front_handler(std::forward<TeardownHandler>(handler), ec));
+}
+
+/**
+ * @brief close the connection when a timeout of beast::websocket::stream expires
+ */
+void beast_close_socket(HttpStream& stream);
+
+}  // namespace server
+}  // namespace http
@@ -0,0 +1,217 @@
+#include <algorithm>
+#include "http_timing_wheel.h"
+
+namespace http
+{
+namespace server
+{
+
+HttpTimingWheel::HttpTimingWheel(std::chrono::milliseconds tick)
+    : tick_(std::max(tick, std::chrono::milliseconds(1)))
+    , epoch_(std::chrono::steady_clock::now())
+    , current_tick_(0)
+    , size_(0)
+{
+    // each slot head is an empty circular list
+    for (auto& level : slots_)
+    {
+        for (auto& head : level)
+        {
+            head.prev_ = &head;
+            head.next_ = &head;
+        }
+    }
+}
+
+HttpTimingWheel::~HttpTimingWheel()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& level : slots_)
+    {
+        for (auto& head : level)
+        {
+            while (head.next_ != &head)
+            {
+                unlink(*head.next_);
+            }
+        }
+    }
+}
+
+void HttpTimingWheel::attach(HttpTimerNode& node, const std::weak_ptr<HttpTimerTarget>& target)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    node.target_ = target;
+}
+
+void HttpTimingWheel::arm(HttpTimerNode& node,
+                          std::chrono::milliseconds time_out,
+                          HttpTimerKind kind,
+                          uint64_t generation)
+{
+    // round up and add one tick, the current tick is partly over
+    auto ticks = static_cast<uint64_t>((time_out.count() + tick_.count() - 1) / tick_.count()) + 1;
+    auto now_tick = tickOf(std::chrono::steady_clock::now());
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (node.prev_ != nullptr)
+    {
+        unlink(node);
+    }
+    node.expire_tick_ = std::max(now_tick, current_tick_) + ticks;
+    node.kind_ = kind;
+    node.generation_ = generation;
+    link(node);
+}
+
+void HttpTimingWheel::cancel(HttpTimerNode& node)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (node.prev_ != nullptr)
+    {
+        unlink(node);
+    }
+}
+
+void HttpTimingWheel::advance(std::chrono::steady_clock::time_point now)
+{
+    auto now_tick = tickOf(now);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        while (current_tick_ < now_tick)
+        {
+            ++current_tick_;
+
+            // a level wrapped, move the timers of the next level slot down
+            for (uint64_t level = 1; level < kLevelCount; ++level)
+            {
+                if ((current_tick_ & ((1ULL << (kSlotBits * level)) - 1)) != 0)
+                {
+                    break;
+                }
+                cascade(level);
+            }
+
+            auto& head = slots_[0][current_tick_ & kSlotMask];
+            while (head.next_ != &head)
+            {
+                auto& node = *head.next_;
+                unlink(node);
+
+                // an owner being destroyed can't be locked, its destructor is waiting to cancel the node
+                auto target = node.target_.lock();
+                if (target)
+                {
+                    expired_.push_back(Expired{std::move(target), node.kind_, node.generation_});
+                }
+            }
+        }
+    }
+
+    // only advance() callers touch expired_, the owner calls it from one driver at a time
+    for (auto& expired : expired_)
+    {
+        expired.target_->onTimerExpired(expired.kind_, expired.generation_);
+    }
+    expired_.clear();
+}
+
+void HttpTimingWheel::expire(HttpTimerKind kind)
+{
+    // not on the advance() path, so it can't share expired_
+    std::vector<Expired> expired;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto& level : slots_)
+        {
+            for (auto& head : level)
+            {
+                auto node = head.next_;
+                while (node != &head)
+                {
+                    auto next = node->next_;
+                    if (node->kind_ == kind)
+                    {
+                        unlink(*node);
+                        auto target = node->target_.lock();
+                        if (target)
+                        {
+                            expired.push_back(Expired{std::move(target), node->kind_, node->generation_});
+                        }
+                    }
+                    node = next;
+                }
+            }
+        }
+    }
+
+    for (auto& item : expired)
+    {
+        item.target_->onTimerExpired(item.kind_, item.generation_);
+    }
+}
+
+std::size_t HttpTimingWheel::size()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return size_;
+}
+
+uint64_t HttpTimingWheel::tickOf(std::chrono::steady_clock::time_point time) const
+{
+    if (time <= epoch_)
+    {
+        return 0;
+    }
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(time - epoch_).count() /
+                                 tick_.count());
+}
+
+void HttpTimingWheel::link(HttpTimerNode& node)
+{
+    const auto max_delta = (1ULL << (kSlotBits * kLevelCount)) - 1;
+    auto expire_tick = std::max(node.expire_tick_, current_tick_);
+    if (expire_tick - current_tick_ > max_delta)
+    {
+        expire_tick = current_tick_ + max_delta;
+    }
+    node.expire_tick_ = expire_tick;
+
+    // the lowest level whose range still covers the delta
+    auto delta = expire_tick - current_tick_;
+    uint64_t level = 0;
+    while (level + 1 < kLevelCount && delta >= (1ULL << (kSlotBits * (level + 1))))
+    {
+        ++level;
+    }
+
+    auto& head = slots_[level][(expire_tick >> (kSlotBits * level)) & kSlotMask];
+    node.prev_ = head.prev_;
+    node.next_ = &head;
+    head.prev_->next_ = &node;
+    head.prev_ = &node;
+    ++size_;
+}
+
+void HttpTimingWheel::unlink(HttpTimerNode& node)
+{
+    node.prev_->next_ = node.next_;
+    node.next_->prev_ = node.prev_;
+    node.prev_ = nullptr;
+    node.next_ = nullptr;
+    --size_;
+}
+
+void HttpTimingWheel::cascade(uint64_t level)
+{
+    auto& head = slots_[level][(current_tick_ >> (kSlotBits * level)) & kSlotMask];
+    while (head.next_ != &head)
+    {
+        auto& node = *head.next_;
+        unlink(node);
+        link(node);
+    }
+}
+
+}  // namespace server
+}  // namespace http
@@ -0,0 +1,146 @@
+/**
+ * @brief Http timing wheel Define
+ * @file http_timing_wheel.h
+ * @copyright Licensed under the Apache License, Version 2.0
+ */
+
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace http
+{
+namespace server
+{
+
+/**
+ * @brief session deadline kinds tracked by the timing wheel
+ */
+enum class HttpTimerKind
+{
+    Read = 0,    ///< reading the request header and body
+    Write = 1,   ///< writing the response
+    Idle = 2,    ///< keep-alive connection waiting for the next request
+    Handle = 3,  ///< handler producing the response
+};
+
+/**
+ * @brief object notified when its timer node expires
+ */
+class HttpTimerTarget
+{
+public:
+    virtual ~HttpTimerTarget() = default;
+
+    /**
+     * @brief called on the wheel driver thread outside the wheel lock,
+     * the implementation should hand the timeout over to its own executor.
+     * @param [in] kind: kind passed to HttpTimingWheel::arm()
+     * @param [in] generation: generation passed to HttpTimingWheel::arm(), used to detect stale expiry
+     */
+    virtual void onTimerExpired(HttpTimerKind kind, uint64_t generation) = 0;
+};
+
+/**
+ * @brief intrusive timer node, embedded in its owner so arm and cancel never allocate
+ */
+class HttpTimerNode
+{
+public:
+    HttpTimerNode() = default;
+    ~HttpTimerNode() = default;
+
+    HttpTimerNode(const HttpTimerNode&) = delete;
+    HttpTimerNode& operator=(const HttpTimerNode&) = delete;
+
+private:
+    friend class HttpTimingWheel;
+
+    HttpTimerNode* prev_{nullptr};  // nullptr means not linked
+    HttpTimerNode* next_{nullptr};
+    uint64_t expire_tick_{0};
+    uint64_t generation_{0};
+    HttpTimerKind kind_{HttpTimerKind::Read};
+    std::weak_ptr<HttpTimerTarget> target_;
+};
+
+/**
+ * @brief hierarchical timing wheel with O(1) arm and cancel
+ * @note 4 levels of 64 slots, level 0 slots are one tick wide and each higher level is 64 times
+ * coarser, timers are moved down a level when the lower level wraps. With the 100ms server tick
+ * the wheel covers about 19 days, longer timeouts are clamped. The wheel is only a data structure,
+ * whoever owns it calls advance() about once per tick.
+ */
+class HttpTimingWheel
+{
+public:
+    explicit HttpTimingWheel(std::chrono::milliseconds tick);
+    ~HttpTimingWheel();
+
+    HttpTimingWheel(const HttpTimingWheel&) = delete;
+    HttpTimingWheel& operator=(const HttpTimingWheel&) = delete;
+
+    /**
+     * @brief bind the node to its target, must be called before the node is armed, threadsafe
+     */
+    void attach(HttpTimerNode& node, const std::weak_ptr<HttpTimerTarget>& target);
+
+    /**
+     * @brief arm or re-arm the node, it never fires before time_out has elapsed, threadsafe
+     */
+    void arm(HttpTimerNode& node, std::chrono::milliseconds time_out, HttpTimerKind kind, uint64_t generation);
+
+    /**
+     * @brief unlink the node if it is armed, threadsafe
+     */
+    void cancel(HttpTimerNode& node);
+
+    /**
+     * @brief fire all nodes expired at now, threadsafe
+     */
+    void advance(std::chrono::steady_clock::time_point now);
+
+    /**
+     * @brief fire all armed nodes of the kind at once, threadsafe
+     */
+    void expire(HttpTimerKind kind);
+
+    /**
+     * @brief armed node count, threadsafe
+     */
+    std::size_t size();
+
+private:
+    static const uint64_t kSlotBits = 6;
+    static const uint64_t kSlotCount = 1ULL << kSlotBits;
+    static const uint64_t kSlotMask = kSlotCount - 1;
+    static const uint64_t kLevelCount = 4;
+
+    struct Expired
+    {
+        std::shared_ptr<HttpTimerTarget> target_;
+        HttpTimerKind kind_;
+        uint64_t generation_;
+    };
+
+    uint64_t tickOf(std::chrono::steady_clock::time_point time) const;
+    void link(HttpTimerNode& node);
+    void unlink(HttpTimerNode& node);
+    void cascade(uint64_t level);
+
+private:
+    const std::chrono::milliseconds tick_;
+    const std::chrono::steady_clock::time_point epoch_;
+    std::mutex mutex_;
+    uint64_t current_tick_;
+    std::size_t size_;
+    HttpTimerNode slots_[kLevelCount][kSlotCount];  // list heads
+    std::vector<Expired> expired_;                  // reused by advance()
+};
+
+}  // namespace server
+}  // namespace http
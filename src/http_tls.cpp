@@ -0,0 +1,351 @@
+#include <cerrno>
+#include <stdexcept>
+#include "http_tls.h"
+
+#ifdef HTTP_SERVER_TLS
+#include <cstdio>
+#include <memory>
+#include <openssl/ec.h>
+#include <openssl/err.h>
+#include <openssl/evp.h>
+#include <openssl/pem.h>
+#include <openssl/ssl.h>
+#include <openssl/x509.h>
+#include <boost/asio/ssl/error.hpp>
+#endif
+
+namespace http
+{
+namespace server
+{
+
+#ifdef HTTP_SERVER_TLS
+namespace
+{
+const unsigned char kSessionIdContext[] = "httpserver";
+
+std::string lastError(const std::string& what)
+{
+    char buffer[256] = {0};
+    ERR_error_string_n(ERR_get_error(), buffer, sizeof(buffer));
+    ERR_clear_error();
+    return what + ": " + buffer;
+}
+
+int selectAlpn(SSL* /*ssl*/,
+               const unsigned char** out,
+               unsigned char* out_size,
+               const unsigned char* in,
+               unsigned int in_size,
+               void* arg)
+{
+    // the HTTP/2 preface is detected after the handshake as for cleartext connections
+    static const unsigned char kH2[] = "\x02h2\x08http/1.1";
+    static const unsigned char kHttp11[] = "\x08http/1.1";
+    auto enable_http2 = *static_cast<const bool*>(arg);
+    auto protocols = enable_http2 ? kH2 : kHttp11;
+    auto protocols_size = enable_http2 ? sizeof(kH2) - 1 : sizeof(kHttp11) - 1;
+    unsigned char* selected = nullptr;
+    if (SSL_select_next_proto(&selected, out_size, protocols, protocols_size, in, in_size) != OPENSSL_NPN_NEGOTIATED)
+    {
+        return SSL_TLSEXT_ERR_NOACK;
+    }
+    *out = selected;
+    return SSL_TLSEXT_ERR_OK;
+}
+}  // namespace
+
+HttpTlsContext::HttpTlsContext(const HttpServerOptions& opts)
+    : ctx_(SSL_CTX_new(TLS_server_method()))
+    , enable_http2_(opts.enable_http2_)
+{
+    if (ctx_ == nullptr)
+    {
+        throw std::runtime_error(lastError("create tls context fail"));
+    }
+
+    if (SSL_CTX_use_certificate_chain_file(ctx_, opts.tls_cert_file_.c_str()) != 1 ||
+        SSL_CTX_use_PrivateKey_file(ctx_, opts.tls_key_file_.c_str(), SSL_FILETYPE_PEM) != 1 ||
+        SSL_CTX_check_private_key(ctx_) != 1)
+    {
+        auto error = lastError("load tls certificate fail");
+        SSL_CTX_free(ctx_);
+        throw std::runtime_error(error);
+    }
+
+    SSL_CTX_set_min_proto_version(ctx_, TLS1_2_VERSION);
+    uint64_t options = SSL_OP_NO_COMPRESSION | SSL_OP_NO_RENEGOTIATION | SSL_OP_CIPHER_SERVER_PREFERENCE;
+#ifdef SSL_OP_IGNORE_UNEXPECTED_EOF
+    // most clients close without close_notify, which is a clean end of a HTTP connection
+    options |= SSL_OP_IGNORE_UNEXPECTED_EOF;
+#endif
+#ifdef SSL_OP_ENABLE_KTLS
+    if (opts.enable_ktls_)
+    {
+        options |= SSL_OP_ENABLE_KTLS;
+    }
+#endif
+    if (!opts.tls_session_tickets_)
+    {
+        options |= SSL_OP_NO_TICKET;
+    }
+    SSL_CTX_set_options(ctx_, options);
+
+    // writes take what fits in a record, and the buffers of idle keep-alive connections are freed
+    SSL_CTX_set_mode(ctx_, SSL_MODE_ENABLE_PARTIAL_WRITE | SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER | SSL_MODE_RELEASE_BUFFERS);
+
+    // one TLS 1.3 ticket per handshake is enough for a client reconnecting
+    SSL_CTX_set_num_tickets(ctx_, opts.tls_session_tickets_ ? 1 : 0);
+    SSL_CTX_set_timeout(ctx_, static_cast<long>(opts.tls_session_time_out_));
+    SSL_CTX_set_session_id_context(ctx_, kSessionIdContext, sizeof(kSessionIdContext) - 1);
+    if (opts.tls_session_cache_size_ != 0)
+    {
+        SSL_CTX_set_session_cache_mode(ctx_, SSL_SESS_CACHE_SERVER);
+        SSL_CTX_sess_set_cache_size(ctx_, opts.tls_session_cache_size_);
+    }
+    else
+    {
+        SSL_CTX_set_session_cache_mode(ctx_, SSL_SESS_CACHE_OFF);
+    }
+    SSL_CTX_set_alpn_select_cb(ctx_, selectAlpn, &enable_http2_);
+}
+
+HttpTlsContext::~HttpTlsContext()
+{
+    SSL_CTX_free(ctx_);
+}
+
+bool HttpTlsContext::supported()
+{
+    return true;
+}
+
+void HttpTlsContext::writeSelfSigned(const std::string& cert_file,
+                                     const std::string& key_file,
+                                     const std::string& common_name)
+{
+    std::unique_ptr<EVP_PKEY_CTX, decltype(&EVP_PKEY_CTX_free)> key_ctx(EVP_PKEY_CTX_new_id(EVP_PKEY_EC, nullptr),
+                                                                        EVP_PKEY_CTX_free);
+    EVP_PKEY* raw_key = nullptr;
+    if (!key_ctx || EVP_PKEY_keygen_init(key_ctx.get()) != 1 ||
+        EVP_PKEY_CTX_set_ec_paramgen_curve_nid(key_ctx.get(), NID_X9_62_prime256v1) != 1 ||
+        EVP_PKEY_keygen(key_ctx.get(), &raw_key) != 1)
+    {
+        throw std::runtime_error(lastError("generate tls key fail"));
+    }
+    std::unique_ptr<EVP_PKEY, decltype(&EVP_PKEY_free)> key(raw_key, EVP_PKEY_free);
+
+    std::unique_ptr<X509, decltype(&X509_free)> cert(X509_new(), X509_free);
+    auto name = cert ? X509_get_subject_name(cert.get()) : nullptr;
+    if (!cert || X509_set_version(cert.get(), 2) != 1 || ASN1_INTEGER_set(X509_get_serialNumber(cert.get()), 1) != 1 ||
+        X509_gmtime_adj(X509_getm_notBefore(cert.get()), 0) == nullptr ||
+        X509_gmtime_adj(X509_getm_notAfter(cert.get()), 365L * 24 * 3600) == nullptr ||
+        X509_set_pubkey(cert.get(), key.get()) != 1 ||
+        X509_NAME_add_entry_by_txt(name,
+                                   "CN",
+                                   MBSTRING_ASC,
+                                   reinterpret_cast<const unsigned char*>(common_name.c_str()),
+                                   -1,
+                                   -1,
+                                   0) != 1 ||
+        X509_set_issuer_name(cert.get(), name) != 1 || X509_sign(cert.get(), key.get(), EVP_sha256()) == 0)
+    {
+        throw std::runtime_error(lastError("generate tls certificate fail"));
+    }
+
+    std::unique_ptr<FILE, decltype(&fclose)> cert_out(fopen(cert_file.c_str(), "w"), fclose);
+    std::unique_ptr<FILE, decltype(&fclose)> key_out(fopen(key_file.c_str(), "w"), fclose);
+    if (!cert_out || !key_out || PEM_write_X509(cert_out.get(), cert.get()) != 1 ||
+        PEM_write_PrivateKey(key_out.get(), key.get(), nullptr, nullptr, 0, nullptr, nullptr) != 1)
+    {
+        throw std::runtime_error("write tls certificate fail: " + cert_file + ", " + key_file);
+    }
+}
+
+HttpTlsConnection::HttpTlsConnection(HttpTlsContext& context, int fd)
+    : ssl_(SSL_new(context.ctx_))
+    , failed_(false)
+{
+    if (ssl_ == nullptr || SSL_set_fd(ssl_, fd) != 1)
+    {
+        // reported by the handshake
+        failed_ = true;
+        return;
+    }
+    SSL_set_accept_state(ssl_);
+}
+
+HttpTlsConnection::~HttpTlsConnection()
+{
+    SSL_free(ssl_);
+}
+
+HttpTlsWant HttpTlsConnection::handshake(beast::error_code& ec)
+{
+    if (failed_)
+    {
+        ec = net::error::no_memory;
+        return HttpTlsWant::Nothing;
+    }
+    return result(SSL_do_handshake(ssl_), ec);
+}
+
+HttpTlsWant HttpTlsConnection::read(void* data, std::size_t size, std::size_t& bytes_transferred, beast::error_code& ec)
+{
+    bytes_transferred = 0;
+    return result(SSL_read_ex(ssl_, data, size, &bytes_transferred), ec);
+}
+
+HttpTlsWant HttpTlsConnection::write(const void* data,
+                                     std::size_t size,
+                                     std::size_t& bytes_transferred,
+                                     beast::error_code& ec)
+{
+    bytes_transferred = 0;
+    return result(SSL_write_ex(ssl_, data, size, &bytes_transferred), ec);
+}
+
+bool HttpTlsConnection::pending() const
+{
+    return SSL_has_pending(ssl_) == 1;
+}
+
+void HttpTlsConnection::shutdown()
+{
+    if (!failed_ && SSL_is_init_finished(ssl_))
+    {
+        // a non-blocking socket never waits here, close_notify is dropped if the send buffer is full
+        SSL_shutdown(ssl_);
+    }
+    ERR_clear_error();
+}
+
+bool HttpTlsConnection::resumed() const
+{
+    return SSL_session_reused(ssl_) == 1;
+}
+
+bool HttpTlsConnection::kernelOffload() const
+{
+    return BIO_get_ktls_send(SSL_get_wbio(ssl_)) == 1;
+}
+
+HttpTlsWant HttpTlsConnection::result(int ret, beast::error_code& ec)
+{
+    ec = {};
+    if (ret == 1)
+    {
+        return HttpTlsWant::Nothing;
+    }
+
+    auto error = SSL_get_error(ssl_, ret);
+    switch (error)
+    {
+        case SSL_ERROR_WANT_READ:
+            return HttpTlsWant::Read;
+        case SSL_ERROR_WANT_WRITE:
+            return HttpTlsWant::Write;
+        case SSL_ERROR_ZERO_RETURN:
+            // close_notify, or a plain close with SSL_OP_IGNORE_UNEXPECTED_EOF
+            ec = net::error::eof;
+            break;
+        case SSL_ERROR_SYSCALL:
+            failed_ = true;
+            ec = errno != 0 ? beast::error_code(errno, boost::system::system_category()) : net::error::eof;
+            break;
+        default:
+            failed_ = true;
+            ec = beast::error_code(static_cast<int>(ERR_get_error()), net::error::get_ssl_category());
+            break;
+    }
+    ERR_clear_error();
+    return HttpTlsWant::Nothing;
+}
+#else
+HttpTlsContext::HttpTlsContext(const HttpServerOptions& opts)
+    : ctx_(nullptr)
+    , enable_http2_(opts.enable_http2_)
+{
+    throw std::runtime_error("tls is not supported by the build");
+}
+
+HttpTlsContext::~HttpTlsContext()
+{
+}
+
+bool HttpTlsContext::supported()
+{
+    return false;
+}
+
+void HttpTlsContext::writeSelfSigned(const std::string& /*cert_file*/,
+                                     const std::string& /*key_file*/,
+                                     const std::string& /*common_name*/)
+{
+    throw std::runtime_error("tls is not supported by the build");
+}
+
+HttpTlsConnection::HttpTlsConnection(HttpTlsContext& /*context*/, int /*fd*/)
+    : ssl_(nullptr)
+    , failed_(true)
+{
+}
+
+HttpTlsConnection::~HttpTlsConnection()
+{
+}
+
+HttpTlsWant HttpTlsConnection::handshake(beast::error_code& ec)
+{
+    ec = net::error::operation_not_supported;
+    return HttpTlsWant::Nothing;
+}
+
+HttpTlsWant HttpTlsConnection::read(void* /*data*/,
+                                    std::size_t /*size*/,
+                                    std::size_t& bytes_transferred,
+                                    beast::error_code& ec)
+{
+    bytes_transferred = 0;
+    ec = net::error::operation_not_supported;
+    return HttpTlsWant::Nothing;
+}
+
+HttpTlsWant HttpTlsConnection::write(const void* /*data*/,
+                                     std::size_t /*size*/,
+                                     std::size_t& bytes_transferred,
+                                     beast::error_code& ec)
+{
+    bytes_transferred = 0;
+    ec = net::error::operation_not_supported;
+    return HttpTlsWant::Nothing;
+}
+
+bool HttpTlsConnection::pending() const
+{
+    return false;
+}
+
+void HttpTlsConnection::shutdown()
+{
+}
+
+bool HttpTlsConnection::resumed() const
+{
+    return false;
+}
+
+bool HttpTlsConnection::kernelOffload() const
+{
+    return false;
+}
+
+HttpTlsWant HttpTlsConnection::result(int /*ret*/, beast::error_code& ec)
+{
+    ec = net::error::operation_not_supported;
+    return HttpTlsWant::Nothing;
+}
+#endif
+
+}  // namespace server
+}  // namespace http
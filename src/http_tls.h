@@ -0,0 +1,114 @@
+/**
+ * @brief Http TLS Define
+ * @file http_tls.h
+ * @copyright Licensed under the Apache License, Version 2.0
+ */
+
+#pragma once
+#include <cstddef>
+#include <string>
+#include <httpserver/detail/http_types.h>
+#include "http_common.h"
+
+// forward declaration of the OpenSSL types, so only http_tls.cpp includes OpenSSL
+typedef struct ssl_ctx_st SSL_CTX;
+typedef struct ssl_st SSL;
+
+namespace http
+{
+namespace server
+{
+
+/**
+ * @brief what a non-blocking TLS operation waits for before it is retried
+ */
+enum class HttpTlsWant
+{
+    Nothing,  ///< done, or failed with the error code set
+    Read,  ///< retry once the socket is readable
+    Write,  ///< retry once the socket is writable
+};
+
+/**
+ * @brief the certificate, session cache and ticket keys shared by all TLS connections of the server
+ * @note OpenSSL locks the session cache internally, so one context serves every io thread. Records of a
+ * connection are encrypted by the kernel (kTLS) when enable_ktls_ is set and both the kernel and OpenSSL
+ * support the negotiated cipher, OpenSSL does the crypto otherwise.
+ */
+class HttpTlsContext
+{
+public:
+    /**
+     * @throw std::runtime_error if the certificate or key can't be loaded, or the build has no TLS
+     */
+    explicit HttpTlsContext(const HttpServerOptions& opts);
+    ~HttpTlsContext();
+
+    HttpTlsContext(const HttpTlsContext&) = delete;
+    HttpTlsContext& operator=(const HttpTlsContext&) = delete;
+
+    /**
+     * @brief return whether the build has TLS
+     */
+    static bool supported();
+
+    /**
+     * @brief write a self-signed P-256 certificate for common_name and its key as PEM, for tests and benchmarks
+     * @throw std::runtime_error if the files can't be written, or the build has no TLS
+     */
+    static void writeSelfSigned(const std::string& cert_file, const std::string& key_file, const std::string& common_name);
+
+private:
+    friend class HttpTlsConnection;
+
+    SSL_CTX* ctx_;
+    bool enable_http2_;  // "h2" is selected by ALPN
+};
+
+/**
+ * @brief the TLS state of one connection on a non-blocking socket, the socket stays owned by the caller
+ * @note every operation returns at once, the caller waits for the readiness HttpTlsWant names and calls it
+ * again with the same arguments
+ */
+class HttpTlsConnection
+{
+public:
+    HttpTlsConnection(HttpTlsContext& context, int fd);
+    ~HttpTlsConnection();
+
+    HttpTlsConnection(const HttpTlsConnection&) = delete;
+    HttpTlsConnection& operator=(const HttpTlsConnection&) = delete;
+
+    HttpTlsWant handshake(beast::error_code& ec);
+    HttpTlsWant read(void* data, std::size_t size, std::size_t& bytes_transferred, beast::error_code& ec);
+    HttpTlsWant write(const void* data, std::size_t size, std::size_t& bytes_transferred, beast::error_code& ec);
+
+    /**
+     * @brief return whether decrypted data is buffered, a readiness wait would miss it
+     */
+    bool pending() const;
+
+    /**
+     * @brief send close_notify if nothing failed, without waiting for the reply of the peer
+     */
+    void shutdown();
+
+    /**
+     * @brief return whether the handshake resumed a session
+     */
+    bool resumed() const;
+
+    /**
+     * @brief return whether the kernel encrypts the records the connection sends
+     */
+    bool kernelOffload() const;
+
+private:
+    HttpTlsWant result(int ret, beast::error_code& ec);
+
+    SSL* ssl_;
+    bool failed_;  // a fatal error occurred, OpenSSL forbids shutdown afterwards
+};
+
+}  // namespace server
+}  // namespace http
@@ -0,0 +1,1270 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include "httpserver/detail/http_log.h"
+#include "http_uring.h"
+
+#ifdef HTTP_SERVER_IO_URING
+#include <linux/io_uring.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace http
+{
+namespace server
+{
+namespace
+{
+const unsigned kRingEntries = 4096;         // submission queue size, the completion queue is 4 times larger
+const uint32_t kMaxBufferCount = 32768;     // limit of a provided buffer ring
+const std::size_t kMaxQueuedChunks = 8;     // received buffers a socket holds before its recv is paused
+const uint16_t kBufferGroup = 0;
+#ifdef HTTP_SERVER_IO_URING
+const uint32_t kCqeFlagMore = IORING_CQE_F_MORE;  // a multishot request stays armed
+const uint32_t kCqeBufferShift = IORING_CQE_BUFFER_SHIFT;  // the selected buffer id is in the upper flag bits
+#else
+const uint32_t kCqeFlagMore = 2;
+const uint32_t kCqeBufferShift = 16;
+#endif
+
+uint32_t roundUpPowerOfTwo(uint32_t value)
+{
+    uint32_t result = 1;
+    while (result < value)
+    {
+        result <<= 1;
+    }
+    return result;
+}
+
+beast::error_code toErrorCode(int result)
+{
+    return beast::error_code(-result, boost::system::system_category());
+}
+}  // namespace
+
+struct HttpUringSocket::WriteState
+{
+    msghdr msg_;
+    iovec iovecs_[kMaxIovecs];
+};
+
+constexpr std::size_t HttpUringSocket::kMaxIovecs;
+
+#ifdef HTTP_SERVER_IO_URING
+namespace
+{
+int ioUringSetup(unsigned entries, io_uring_params* params)
+{
+    return static_cast<int>(syscall(__NR_io_uring_setup, entries, params));
+}
+
+int ioUringEnter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags)
+{
+    return static_cast<int>(syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0));
+}
+
+int ioUringRegister(int fd, unsigned opcode, void* arg, unsigned arg_cnt)
+{
+    return static_cast<int>(syscall(__NR_io_uring_register, fd, opcode, arg, arg_cnt));
+}
+}  // namespace
+
+/**
+ * @brief the mapped submission, completion and provided buffer rings, the raw syscall interface of liburing
+ */
+struct HttpUringService::Ring
+{
+    Ring(unsigned entries, uint32_t buffer_cnt)
+    {
+        io_uring_params params;
+        std::memset(&params, 0, sizeof(params));
+        params.flags = IORING_SETUP_CQSIZE;
+        params.cq_entries = entries * 4;
+        fd_ = ioUringSetup(entries, &params);
+        if (fd_ < 0)
+        {
+            throw std::runtime_error(std::string("io_uring_setup fail: ") + std::strerror(errno));
+        }
+
+        try
+        {
+            map(params);
+            registerBuffers(buffer_cnt);
+            event_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+            if (event_fd_ < 0 || ioUringRegister(fd_, IORING_REGISTER_EVENTFD, &event_fd_, 1) < 0)
+            {
+                throw std::runtime_error(std::string("io_uring eventfd fail: ") + std::strerror(errno));
+            }
+        }
+        catch (...)
+        {
+            if (event_fd_ >= 0)
+            {
+                close(event_fd_);
+            }
+            release();
+            throw;
+        }
+    }
+
+    ~Ring()
+    {
+        release();
+    }
+
+    void map(const io_uring_params& params)
+    {
+        sq_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cq_size_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        if (params.features & IORING_FEAT_SINGLE_MMAP)
+        {
+            sq_size_ = cq_size_ = std::max(sq_size_, cq_size_);
+        }
+
+        sq_ptr_ = mmap(nullptr, sq_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQ_RING);
+        if (sq_ptr_ == MAP_FAILED)
+        {
+            throw std::runtime_error(std::string("io_uring mmap fail: ") + std::strerror(errno));
+        }
+
+        cq_ptr_ = sq_ptr_;
+        if (!(params.features & IORING_FEAT_SINGLE_MMAP))
+        {
+            cq_ptr_ = mmap(nullptr, cq_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_CQ_RING);
+            if (cq_ptr_ == MAP_FAILED)
+            {
+                throw std::runtime_error(std::string("io_uring mmap fail: ") + std::strerror(errno));
+            }
+        }
+
+        sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+        auto sqes = mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQES);
+        if (sqes == MAP_FAILED)
+        {
+            throw std::runtime_error(std::string("io_uring mmap fail: ") + std::strerror(errno));
+        }
+        sqes_ = static_cast<io_uring_sqe*>(sqes);
+
+        auto sq = static_cast<char*>(sq_ptr_);
+        sq_head_ = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+        sq_tail_ = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        sq_flags_ = reinterpret_cast<unsigned*>(sq + params.sq_off.flags);
+        sq_array_ = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+        sq_mask_ = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        sq_entries_ = params.sq_entries;
+
+        auto cq = static_cast<char*>(cq_ptr_);
+        cq_head_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        cq_tail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+        cq_mask_ = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        cqes_ = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+    }
+
+    void registerBuffers(uint32_t buffer_cnt)
+    {
+        buf_ring_size_ = buffer_cnt * sizeof(io_uring_buf);
+        auto buf_ring = mmap(nullptr, buf_ring_size_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (buf_ring == MAP_FAILED)
+        {
+            throw std::runtime_error(std::string("io_uring buffer ring mmap fail: ") + std::strerror(errno));
+        }
+        buf_ring_ = static_cast<io_uring_buf*>(buf_ring);
+        buf_mask_ = buffer_cnt - 1;
+
+        io_uring_buf_reg reg;
+        std::memset(&reg, 0, sizeof(reg));
+        reg.ring_addr = reinterpret_cast<uint64_t>(buf_ring_);
+        reg.ring_entries = buffer_cnt;
+        reg.bgid = kBufferGroup;
+        if (ioUringRegister(fd_, IORING_REGISTER_PBUF_RING, &reg, 1) < 0)
+        {
+            throw std::runtime_error(std::string("io_uring buffer ring register fail: ") + std::strerror(errno));
+        }
+    }
+
+    void release()
+    {
+        if (fd_ >= 0)
+        {
+            close(fd_);
+            fd_ = -1;
+        }
+        if (buf_ring_ != nullptr)
+        {
+            munmap(buf_ring_, buf_ring_size_);
+            buf_ring_ = nullptr;
+        }
+        if (sqes_ != nullptr)
+        {
+            munmap(sqes_, sqes_size_);
+            sqes_ = nullptr;
+        }
+        if (cq_ptr_ != MAP_FAILED && cq_ptr_ != sq_ptr_)
+        {
+            munmap(cq_ptr_, cq_size_);
+        }
+        cq_ptr_ = MAP_FAILED;
+        if (sq_ptr_ != MAP_FAILED)
+        {
+            munmap(sq_ptr_, sq_size_);
+            sq_ptr_ = MAP_FAILED;
+        }
+    }
+
+    /**
+     * @brief the next free submission entry, zeroed, nullptr when the queue stays full
+     */
+    io_uring_sqe* nextSqe()
+    {
+        if (sq_local_tail_ - __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE) >= sq_entries_)
+        {
+            submit();
+            if (sq_local_tail_ - __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE) >= sq_entries_)
+            {
+                return nullptr;
+            }
+        }
+
+        auto index = sq_local_tail_ & sq_mask_;
+        auto sqe = &sqes_[index];
+        std::memset(sqe, 0, sizeof(*sqe));
+        sq_array_[index] = index;
+        ++sq_local_tail_;
+        ++pending_cnt_;
+        return sqe;
+    }
+
+    bool prepareRecv(uint64_t user_data, int fd)
+    {
+        auto sqe = nextSqe();
+        if (sqe == nullptr)
+        {
+            return false;
+        }
+        sqe->opcode = IORING_OP_RECV;
+        sqe->fd = fd;
+        sqe->flags = IOSQE_BUFFER_SELECT;
+        sqe->ioprio = IORING_RECV_MULTISHOT;
+        sqe->buf_group = kBufferGroup;
+        sqe->user_data = user_data;
+        return true;
+    }
+
+    bool prepareRead(uint64_t user_data, int fd, void* data, std::size_t size)
+    {
+        auto sqe = nextSqe();
+        if (sqe == nullptr)
+        {
+            return false;
+        }
+        sqe->opcode = IORING_OP_RECV;
+        sqe->fd = fd;
+        sqe->addr = reinterpret_cast<uint64_t>(data);
+        sqe->len = static_cast<uint32_t>(std::min<std::size_t>(size, UINT32_MAX));
+        sqe->user_data = user_data;
+        return true;
+    }
+
+    bool preparePoll(uint64_t user_data, int fd)
+    {
+        auto sqe = nextSqe();
+        if (sqe == nullptr)
+        {
+            return false;
+        }
+        sqe->opcode = IORING_OP_POLL_ADD;
+        sqe->fd = fd;
+        sqe->poll32_events = POLLIN;
+        sqe->user_data = user_data;
+        return true;
+    }
+
+    bool prepareSendmsg(uint64_t user_data, int fd, const void* msg)
+    {
+        auto sqe = nextSqe();
+        if (sqe == nullptr)
+        {
+            return false;
+        }
+        sqe->opcode = IORING_OP_SENDMSG;
+        sqe->fd = fd;
+        sqe->addr = reinterpret_cast<uint64_t>(msg);
+        sqe->len = 1;
+        sqe->msg_flags = MSG_NOSIGNAL;
+        sqe->user_data = user_data;
+        return true;
+    }
+
+    bool prepareCancel(uint64_t target_user_data)
+    {
+        auto sqe = nextSqe();
+        if (sqe == nullptr)
+        {
+            return false;
+        }
+        sqe->opcode = IORING_OP_ASYNC_CANCEL;
+        sqe->fd = -1;
+        sqe->addr = target_user_data;
+        sqe->user_data = 0;
+        return true;
+    }
+
+    bool prepareCancelAll()
+    {
+        auto sqe = nextSqe();
+        if (sqe == nullptr)
+        {
+            return false;
+        }
+        sqe->opcode = IORING_OP_ASYNC_CANCEL;
+        sqe->fd = -1;
+        sqe->cancel_flags = IORING_ASYNC_CANCEL_ANY;
+        sqe->user_data = 0;
+        return true;
+    }
+
+    /**
+     * @brief hand the prepared entries to the kernel, the ones it can't take now stay queued for the next call
+     */
+    void submit()
+    {
+        __atomic_store_n(sq_tail_, sq_local_tail_, __ATOMIC_RELEASE);
+        while (pending_cnt_ > 0)
+        {
+            auto result = ioUringEnter(fd_, pending_cnt_, 0, 0);
+            if (result > 0)
+            {
+                pending_cnt_ -= static_cast<unsigned>(result);
+                continue;
+            }
+            if (result < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if (result < 0 && errno != EAGAIN && errno != EBUSY)
+            {
+                LOG_LOGGER_ERROR(fmt::format("io_uring_enter fail: {}", std::strerror(errno)));
+            }
+            break;
+        }
+    }
+
+    /**
+     * @brief block until a completion is ready, false on failure
+     */
+    bool waitCompletion()
+    {
+        auto result = ioUringEnter(fd_, 0, 1, IORING_ENTER_GETEVENTS);
+        return result >= 0 || errno == EINTR;
+    }
+
+    /**
+     * @brief flush completions the kernel kept back when the completion queue was full
+     * @return whether there were any
+     */
+    bool flushOverflow()
+    {
+        if (!(__atomic_load_n(sq_flags_, __ATOMIC_ACQUIRE) & IORING_SQ_CQ_OVERFLOW))
+        {
+            return false;
+        }
+        ioUringEnter(fd_, 0, 0, IORING_ENTER_GETEVENTS);
+        return true;
+    }
+
+    void provideBuffer(uint16_t buffer_id, char* data, uint32_t size)
+    {
+        auto& buf = buf_ring_[buf_local_tail_ & buf_mask_];
+        buf.addr = reinterpret_cast<uint64_t>(data);
+        buf.len = size;
+        buf.bid = buffer_id;
+        ++buf_local_tail_;
+    }
+
+    void publishBuffers()
+    {
+        // the tail shares its place with the reserved field of the first entry
+        __atomic_store_n(&buf_ring_[0].resv, buf_local_tail_, __ATOMIC_RELEASE);
+    }
+
+    /**
+     * @brief call function(user_data, result, flags) for each completion, only one thread reaps
+     */
+    template <class Function>
+    void reap(Function&& function)
+    {
+        auto head = *cq_head_;
+        for (;;)
+        {
+            auto tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+            if (head == tail)
+            {
+                break;
+            }
+
+            while (head != tail)
+            {
+                const auto& cqe = cqes_[head & cq_mask_];
+                auto user_data = cqe.user_data;
+                auto result = cqe.res;
+                auto flags = cqe.flags;
+                __atomic_store_n(cq_head_, ++head, __ATOMIC_RELEASE);
+                function(user_data, result, flags);
+            }
+        }
+    }
+
+    int fd_{-1};
+    int event_fd_{-1};  // owned by the event descriptor of the service
+    void* sq_ptr_{MAP_FAILED};
+    std::size_t sq_size_{0};
+    void* cq_ptr_{MAP_FAILED};
+    std::size_t cq_size_{0};
+    io_uring_sqe* sqes_{nullptr};
+    std::size_t sqes_size_{0};
+    unsigned* sq_head_{nullptr};
+    unsigned* sq_tail_{nullptr};
+    unsigned* sq_flags_{nullptr};
+    unsigned* sq_array_{nullptr};
+    unsigned sq_mask_{0};
+    unsigned sq_entries_{0};
+    unsigned sq_local_tail_{0};
+    unsigned pending_cnt_{0};  // prepared entries the kernel hasn't taken yet
+    unsigned* cq_head_{nullptr};
+    unsigned* cq_tail_{nullptr};
+    unsigned cq_mask_{0};
+    io_uring_cqe* cqes_{nullptr};
+    io_uring_buf* buf_ring_{nullptr};
+    std::size_t buf_ring_size_{0};
+    uint32_t buf_mask_{0};
+    uint16_t buf_local_tail_{0};
+};
+
+bool HttpUringService::supported()
+{
+    static const bool kSupported = [] {
+        // single issuer rings and multishot recv came with the same kernel release, 6.0, the flag is only a probe
+        // since the rings of the server are submitted to by whichever io thread runs the handler
+        io_uring_params params;
+        std::memset(&params, 0, sizeof(params));
+        params.flags = IORING_SETUP_SINGLE_ISSUER;
+        auto fd = ioUringSetup(2, &params);
+        if (fd < 0)
+        {
+            return false;
+        }
+        close(fd);
+
+        try
+        {
+            Ring ring(2, 1);
+            close(ring.event_fd_);
+            return true;
+        }
+        catch (const std::exception&)
+        {
+            return false;
+        }
+    }();
+    return kSupported;
+}
+#else
+struct HttpUringService::Ring
+{
+    Ring(unsigned, uint32_t)
+    {
+        throw std::runtime_error("io_uring is not supported by this build");
+    }
+
+    bool prepareRecv(uint64_t, int)
+    {
+        return false;
+    }
+
+    bool prepareRead(uint64_t, int, void*, std::size_t)
+    {
+        return false;
+    }
+
+    bool preparePoll(uint64_t, int)
+    {
+        return false;
+    }
+
+    bool prepareSendmsg(uint64_t, int, const void*)
+    {
+        return false;
+    }
+
+    bool prepareCancelAll()
+    {
+        return false;
+    }
+
+    bool waitCompletion()
+    {
+        return false;
+    }
+
+    bool prepareCancel(uint64_t)
+    {
+        return false;
+    }
+
+    void submit()
+    {
+    }
+
+    bool flushOverflow()
+    {
+        return false;
+    }
+
+    void provideBuffer(uint16_t, char*, uint32_t)
+    {
+    }
+
+    void publishBuffers()
+    {
+    }
+
+    template <class Function>
+    void reap(Function&&)
+    {
+    }
+
+    int event_fd_{-1};
+};
+
+bool HttpUringService::supported()
+{
+    return false;
+}
+#endif
+
+HttpUringSocket::HttpUringSocket(std::shared_ptr<HttpUringService> service,
+                                 int fd,
+                                 beast::tcp_stream::executor_type executor)
+    : service_(std::move(service))
+    , fd_(fd)
+    , executor_(std::move(executor))
+    , mutex_()
+    , chunks_()
+    , read_error_()
+    , recv_armed_(false)
+    , recv_cancelled_(false)
+    , direct_armed_(false)
+    , direct_read_(false)
+    , closed_(false)
+    , read_buffer_()
+    , read_completion_(nullptr)
+    , wait_completion_(nullptr)
+    , write_completion_(nullptr)
+    , write_state_()
+    , registry_index_(0)
+    , inflight_cnt_(0)
+    , self_()
+{
+}
+
+HttpUringSocket::~HttpUringSocket()
+{
+    // nothing is in flight here, the completions left are from a closed ring
+    for (auto completion : {read_completion_, wait_completion_, write_completion_})
+    {
+        if (completion != nullptr)
+        {
+            completion->destroy();
+        }
+    }
+    for (const auto& chunk : chunks_)
+    {
+        service_->returnBuffer(chunk.buffer_id_);
+    }
+    service_->unregisterSocket(this);
+}
+
+void HttpUringSocket::read(net::mutable_buffer buffer, HttpUringCompletion* completion)
+{
+    HttpUringCompletion* done = nullptr;
+    beast::error_code ec;
+    std::size_t size = 0;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (closed_)
+        {
+            done = completion;
+            ec = net::error::bad_descriptor;
+        }
+        else if (!chunks_.empty())
+        {
+            done = completion;
+            size = consume(buffer);
+        }
+        else if (read_error_)
+        {
+            done = completion;
+            ec = read_error_;
+        }
+        else if (buffer.size() == 0)
+        {
+            done = completion;
+        }
+        else
+        {
+            read_buffer_ = buffer;
+            read_completion_ = completion;
+        }
+        armRecv();
+    }
+
+    if (done != nullptr)
+    {
+        done->complete(executor_, ec, size);
+    }
+}
+
+void HttpUringSocket::write(const iovec* iovecs, std::size_t iovec_cnt, HttpUringCompletion* completion)
+{
+    beast::error_code ec;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (closed_)
+        {
+            ec = net::error::bad_descriptor;
+        }
+        else if (iovec_cnt != 0)
+        {
+            if (!write_state_)
+            {
+                write_state_.reset(new WriteState());
+            }
+
+            iovec_cnt = std::min(iovec_cnt, kMaxIovecs);
+            std::memcpy(write_state_->iovecs_, iovecs, iovec_cnt * sizeof(iovec));
+            std::memset(&write_state_->msg_, 0, sizeof(write_state_->msg_));
+            write_state_->msg_.msg_iov = write_state_->iovecs_;
+            write_state_->msg_.msg_iovlen = iovec_cnt;
+            if (service_->submitSend(*this, &write_state_->msg_))
+            {
+                write_completion_ = completion;
+                submitted();
+                return;
+            }
+            ec = net::error::no_buffer_space;
+        }
+    }
+    completion->complete(executor_, ec, 0);
+}
+
+void HttpUringSocket::waitRead(HttpUringCompletion* completion)
+{
+    beast::error_code ec;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!closed_ && chunks_.empty() && !read_error_)
+        {
+            wait_completion_ = completion;
+            armRecv();
+            return;
+        }
+
+        if (closed_)
+        {
+            ec = net::error::bad_descriptor;
+        }
+    }
+    completion->complete(executor_, ec, 0);
+}
+
+void HttpUringSocket::cancel()
+{
+    HttpUringCompletion* read_completion = nullptr;
+    HttpUringCompletion* wait_completion = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (direct_armed_)
+        {
+            // a direct recv writes into the buffer of the read, the read completes with the recv
+            service_->submitCancel(*this, direct_read_ ? HttpUringService::OpKind::Read : HttpUringService::OpKind::Poll);
+        }
+        if (!direct_armed_ || !direct_read_)
+        {
+            std::swap(read_completion, read_completion_);
+        }
+        std::swap(wait_completion, wait_completion_);
+        if (write_completion_ != nullptr)
+        {
+            // the send completes with ECANCELED, or with its result if the kernel already finished it
+            service_->submitCancel(*this, HttpUringService::OpKind::Send);
+        }
+    }
+
+    if (read_completion != nullptr)
+    {
+        read_completion->complete(executor_, net::error::operation_aborted, 0);
+    }
+    if (wait_completion != nullptr)
+    {
+        wait_completion->complete(executor_, net::error::operation_aborted, 0);
+    }
+}
+
+void HttpUringSocket::close()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (closed_)
+        {
+            return;
+        }
+
+        closed_ = true;
+        if (recv_armed_ && !recv_cancelled_)
+        {
+            recv_cancelled_ = true;
+            service_->submitCancel(*this, HttpUringService::OpKind::Recv);
+        }
+        for (const auto& chunk : chunks_)
+        {
+            service_->returnBuffer(chunk.buffer_id_);
+        }
+        chunks_.clear();
+    }
+    cancel();
+}
+
+void HttpUringSocket::armRecv()
+{
+    if (recv_armed_ || direct_armed_ || closed_ || read_error_ || chunks_.size() >= kMaxQueuedChunks)
+    {
+        return;
+    }
+
+    if (service_->submitRecv(*this))
+    {
+        recv_armed_ = true;
+        submitted();
+    }
+}
+
+void HttpUringSocket::armDirect()
+{
+    if (recv_armed_ || direct_armed_ || closed_ || read_error_)
+    {
+        return;
+    }
+
+    if (read_completion_ != nullptr)
+    {
+        direct_read_ = true;
+        direct_armed_ = service_->submitRead(*this, read_buffer_);
+    }
+    else if (wait_completion_ != nullptr)
+    {
+        direct_read_ = false;
+        direct_armed_ = service_->submitPoll(*this);
+    }
+
+    if (direct_armed_)
+    {
+        submitted();
+    }
+}
+
+void HttpUringSocket::onRecv(int result, uint32_t flags)
+{
+    std::shared_ptr<HttpUringSocket> keep_alive;
+    HttpUringCompletion* read_completion = nullptr;
+    HttpUringCompletion* wait_completion = nullptr;
+    beast::error_code ec;
+    std::size_t size = 0;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!(flags & kCqeFlagMore))
+        {
+            recv_armed_ = false;
+            recv_cancelled_ = false;
+            finished(keep_alive);
+        }
+
+        if (result > 0)
+        {
+            auto buffer_id = static_cast<uint16_t>(flags >> kCqeBufferShift);
+            if (closed_)
+            {
+                service_->returnBuffer(buffer_id);
+            }
+            else
+            {
+                chunks_.push_back(Chunk{buffer_id, 0, static_cast<uint32_t>(result)});
+                if (read_completion_ != nullptr)
+                {
+                    size = consume(read_buffer_);
+                    std::swap(read_completion, read_completion_);
+                }
+                std::swap(wait_completion, wait_completion_);
+
+                // a connection that doesn't read stops receiving instead of taking every buffer
+                if (recv_armed_ && !recv_cancelled_ && chunks_.size() >= kMaxQueuedChunks)
+                {
+                    recv_cancelled_ = true;
+                    service_->submitCancel(*this, HttpUringService::OpKind::Recv);
+                }
+            }
+        }
+        else if (result == -ENOBUFS)
+        {
+            // the ring is empty, the buffers come back as other connections read
+            armDirect();
+        }
+        else if (result != -ECANCELED && !read_error_)
+        {
+            read_error_ = result == 0 ? beast::error_code(net::error::eof) : toErrorCode(result);
+            if (read_completion_ != nullptr && chunks_.empty())
+            {
+                ec = read_error_;
+                std::swap(read_completion, read_completion_);
+            }
+            std::swap(wait_completion, wait_completion_);
+        }
+
+        // the kernel may end a multishot recv at any time, it is armed again while someone waits
+        if (read_completion_ != nullptr || wait_completion_ != nullptr)
+        {
+            armRecv();
+        }
+    }
+
+    if (read_completion != nullptr)
+    {
+        read_completion->complete(executor_, ec, size);
+    }
+    if (wait_completion != nullptr)
+    {
+        wait_completion->complete(executor_, beast::error_code(), 0);
+    }
+}
+
+void HttpUringSocket::onDirect(bool read, int result)
+{
+    std::shared_ptr<HttpUringSocket> keep_alive;
+    HttpUringCompletion* read_completion = nullptr;
+    HttpUringCompletion* wait_completion = nullptr;
+    beast::error_code ec;
+    std::size_t size = 0;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        direct_armed_ = false;
+        finished(keep_alive);
+        if (read)
+        {
+            std::swap(read_completion, read_completion_);
+            if (result > 0)
+            {
+                size = static_cast<std::size_t>(result);
+            }
+            else if (result == -ECANCELED)
+            {
+                ec = net::error::operation_aborted;
+            }
+            else
+            {
+                read_error_ = result == 0 ? beast::error_code(net::error::eof) : toErrorCode(result);
+                ec = read_error_;
+            }
+        }
+        else if (result != -ECANCELED)
+        {
+            std::swap(wait_completion, wait_completion_);
+        }
+
+        if (read_completion_ != nullptr || wait_completion_ != nullptr)
+        {
+            armRecv();
+        }
+    }
+
+    if (read_completion != nullptr)
+    {
+        read_completion->complete(executor_, ec, size);
+    }
+    if (wait_completion != nullptr)
+    {
+        wait_completion->complete(executor_, beast::error_code(), 0);
+    }
+}
+
+void HttpUringSocket::onSend(int result)
+{
+    std::shared_ptr<HttpUringSocket> keep_alive;
+    HttpUringCompletion* completion = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::swap(completion, write_completion_);
+        finished(keep_alive);
+    }
+
+    if (completion == nullptr)
+    {
+        return;
+    }
+
+    if (result >= 0)
+    {
+        completion->complete(executor_, beast::error_code(), static_cast<std::size_t>(result));
+    }
+    else
+    {
+        completion->complete(executor_,
+                             result == -ECANCELED ? beast::error_code(net::error::operation_aborted)
+                                                  : toErrorCode(result),
+                             0);
+    }
+}
+
+std::size_t HttpUringSocket::consume(net::mutable_buffer buffer)
+{
+    auto out = static_cast<char*>(buffer.data());
+    std::size_t size = 0;
+    while (!chunks_.empty() && size < buffer.size())
+    {
+        auto& chunk = chunks_.front();
+        auto cnt = std::min<std::size_t>(chunk.size_, buffer.size() - size);
+        std::memcpy(out + size, service_->bufferData(chunk.buffer_id_) + chunk.offset_, cnt);
+        size += cnt;
+        chunk.offset_ += static_cast<uint32_t>(cnt);
+        chunk.size_ -= static_cast<uint32_t>(cnt);
+        if (chunk.size_ == 0)
+        {
+            service_->returnBuffer(chunk.buffer_id_);
+            chunks_.pop_front();
+        }
+    }
+    return size;
+}
+
+void HttpUringSocket::submitted()
+{
+    if (inflight_cnt_++ == 0)
+    {
+        self_ = shared_from_this();
+    }
+}
+
+void HttpUringSocket::finished(std::shared_ptr<HttpUringSocket>& keep_alive)
+{
+    // the last reference may be dropped by the caller, after the lock is released
+    if (inflight_cnt_ != 0 && --inflight_cnt_ == 0)
+    {
+        keep_alive.swap(self_);
+    }
+}
+
+std::shared_ptr<HttpUringSocket> HttpUringSocket::abandon(std::vector<HttpUringCompletion*>& completions)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto completion : {&read_completion_, &wait_completion_, &write_completion_})
+    {
+        if (*completion != nullptr)
+        {
+            completions.push_back(*completion);
+            *completion = nullptr;
+        }
+    }
+    chunks_.clear();
+    closed_ = true;
+    recv_armed_ = false;
+    direct_armed_ = false;
+    inflight_cnt_ = 0;
+    return std::move(self_);
+}
+
+HttpUringService::HttpUringService(net::io_context& io_context, uint32_t buffer_cnt, uint32_t buffer_size)
+    : io_context_(io_context)
+    , mutex_()
+    , ring_()
+    , buffer_cnt_(roundUpPowerOfTwo(std::min(std::max<uint32_t>(buffer_cnt, 1), kMaxBufferCount)))
+    , buffer_size_(std::max<uint32_t>(buffer_size, 1))
+    , buffers_()
+    , event_descriptor_(io_context)
+    , event_count_(0)
+    , closed_(false)
+    , flush_posted_(false)
+    , inflight_cnt_(0)
+    , sockets_()
+{
+    ring_.reset(new Ring(kRingEntries, buffer_cnt_));
+    event_descriptor_.assign(ring_->event_fd_);
+
+    buffers_.reset(new char[static_cast<std::size_t>(buffer_cnt_) * buffer_size_]);
+    for (uint32_t i = 0; i < buffer_cnt_; ++i)
+    {
+        ring_->provideBuffer(static_cast<uint16_t>(i), buffers_.get() + static_cast<std::size_t>(i) * buffer_size_,
+                             buffer_size_);
+    }
+    ring_->publishBuffers();
+}
+
+HttpUringService::~HttpUringService()
+{
+    shutdown();
+}
+
+void HttpUringService::start()
+{
+    doReap();
+}
+
+void HttpUringService::stop()
+{
+    beast::error_code ec;
+    event_descriptor_.cancel(ec);
+}
+
+void HttpUringService::shutdown()
+{
+    std::vector<HttpUringSocket*> sockets;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (closed_)
+        {
+            return;
+        }
+
+        // the kernel may still write into the buffers of pending reads, so the ring is drained before it closes
+        closed_ = true;
+        if (ring_->prepareCancelAll())
+        {
+            ring_->submit();
+        }
+    }
+    while (inflight_cnt_.load() != 0 && ring_->waitCompletion())
+    {
+        reap();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ring_.reset();
+        sockets = sockets_;
+    }
+
+    // nothing is destroyed until every socket has given up its state, the handlers own sessions and sockets
+    std::vector<HttpUringCompletion*> completions;
+    std::vector<std::shared_ptr<HttpUringSocket>> keep_alive;
+    for (auto socket : sockets)
+    {
+        keep_alive.push_back(socket->abandon(completions));
+    }
+
+    beast::error_code ec;
+    event_descriptor_.close(ec);
+    for (auto completion : completions)
+    {
+        completion->destroy();
+    }
+}
+
+std::shared_ptr<HttpUringSocket> HttpUringService::open(int fd, const beast::tcp_stream::executor_type& executor)
+{
+    auto socket = std::allocate_shared<HttpUringSocket>(HttpRecyclingAllocator<HttpUringSocket>(),
+                                                        shared_from_this(),
+                                                        fd,
+                                                        executor);
+    registerSocket(socket.get());
+    return socket;
+}
+
+void HttpUringService::doReap()
+{
+    event_descriptor_.async_read_some(net::buffer(&event_count_, sizeof(event_count_)),
+                                      beast::bind_front_handler(&HttpUringService::onReap, shared_from_this()));
+}
+
+void HttpUringService::onReap(beast::error_code ec, std::size_t /*bytes_transferred*/)
+{
+    if (ec)
+    {
+        if (ec != net::error::operation_aborted)
+        {
+            LOG_LOGGER_ERROR(fmt::format("io_uring eventfd read fail: {}", ec.message()));
+        }
+        return;
+    }
+
+    reap();
+    doReap();
+}
+
+void HttpUringService::reap()
+{
+    auto dispatch = [this](uint64_t user_data, int result, uint32_t flags) {
+        if (user_data == 0)
+        {
+            return;  // cancel requests
+        }
+
+        if (!(flags & kCqeFlagMore))
+        {
+            --inflight_cnt_;
+        }
+
+        auto socket = reinterpret_cast<HttpUringSocket*>(user_data & ~uint64_t(7));
+        switch (static_cast<OpKind>(user_data & 7))
+        {
+            case OpKind::Recv:
+                socket->onRecv(result, flags);
+                break;
+            case OpKind::Send:
+                socket->onSend(result);
+                break;
+            case OpKind::Read:
+                socket->onDirect(true, result);
+                break;
+            case OpKind::Poll:
+                socket->onDirect(false, result);
+                break;
+        }
+    };
+
+    // the ring is only closed by shutdown() once the io threads are stopped
+    do
+    {
+        ring_->reap(dispatch);
+        std::lock_guard<std::mutex> lock(mutex_);
+        ring_->submit();
+    } while (ring_->flushOverflow());
+}
+
+bool HttpUringService::submitRecv(HttpUringSocket& socket)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (closed_ || !ring_->prepareRecv(reinterpret_cast<uint64_t>(&socket) | static_cast<uint64_t>(OpKind::Recv),
+                                       socket.fd_))
+    {
+        return false;
+    }
+    ++inflight_cnt_;
+    postFlush();
+    return true;
+}
+
+bool HttpUringService::submitRead(HttpUringSocket& socket, net::mutable_buffer buffer)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (closed_ || !ring_->prepareRead(reinterpret_cast<uint64_t>(&socket) | static_cast<uint64_t>(OpKind::Read),
+                                       socket.fd_,
+                                       buffer.data(),
+                                       buffer.size()))
+    {
+        return false;
+    }
+    ++inflight_cnt_;
+    postFlush();
+    return true;
+}
+
+bool HttpUringService::submitPoll(HttpUringSocket& socket)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (closed_ ||
+        !ring_->preparePoll(reinterpret_cast<uint64_t>(&socket) | static_cast<uint64_t>(OpKind::Poll), socket.fd_))
+    {
+        return false;
+    }
+    ++inflight_cnt_;
+    postFlush();
+    return true;
+}
+
+bool HttpUringService::submitSend(HttpUringSocket& socket, const void* msghdr)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (closed_ || !ring_->prepareSendmsg(reinterpret_cast<uint64_t>(&socket) | static_cast<uint64_t>(OpKind::Send),
+                                          socket.fd_,
+                                          msghdr))
+    {
+        return false;
+    }
+    ++inflight_cnt_;
+    postFlush();
+    return true;
+}
+
+bool HttpUringService::submitCancel(HttpUringSocket& socket, OpKind kind)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (closed_ || !ring_->prepareCancel(reinterpret_cast<uint64_t>(&socket) | static_cast<uint64_t>(kind)))
+    {
+        return false;
+    }
+    postFlush();
+    return true;
+}
+
+void HttpUringService::postFlush()
+{
+    // the entries prepared by the handlers of one loop iteration go to the kernel with a single io_uring_enter
+    if (!flush_posted_)
+    {
+        flush_posted_ = true;
+        net::post(io_context_, beast::bind_front_handler(&HttpUringService::flush, shared_from_this()));
+    }
+}
+
+void HttpUringService::flush()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    flush_posted_ = false;
+    if (!closed_)
+    {
+        ring_->submit();
+    }
+}
+
+void HttpUringService::returnBuffer(uint16_t buffer_id)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (closed_)
+    {
+        return;
+    }
+    ring_->provideBuffer(buffer_id, buffers_.get() + static_cast<std::size_t>(buffer_id) * buffer_size_, buffer_size_);
+    ring_->publishBuffers();
+}
+
+const char* HttpUringService::bufferData(uint16_t buffer_id) const
+{
+    return buffers_.get() + static_cast<std::size_t>(buffer_id) * buffer_size_;
+}
+
+void HttpUringService::registerSocket(HttpUringSocket* socket)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    socket->registry_index_ = sockets_.size();
+    sockets_.push_back(socket);
+}
+
+void HttpUringService::unregisterSocket(HttpUringSocket* socket)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto index = socket->registry_index_;
+    if (index < sockets_.size() && sockets_[index] == socket)
+    {
+        sockets_[index] = sockets_.back();
+        sockets_[index]->registry_index_ = index;
+        sockets_.pop_back();
+    }
+}
+
+}  // namespace server
+}  // namespace http
@@ -0,0 +1,266 @@
+/**
+ * @brief Http io_uring transport Define
+ * @file http_uring.h
+ * @copyright Licensed under the Apache License, Version 2.0
+ */
+
+#pragma once
+#include <cstddef>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "http_common.h"
+#include "http_recycling_allocator.h"
+
+struct iovec;
+
+namespace http
+{
+namespace server
+{
+
+class HttpUringService;
+
+/**
+ * @brief type-erased completion handler of an io_uring operation, memory comes from HttpRecyclingPool
+ */
+class HttpUringCompletion
+{
+public:
+    /**
+     * @brief post the handler with the result to the executor and free this
+     */
+    virtual void complete(const beast::tcp_stream::executor_type& executor, beast::error_code ec, std::size_t size) = 0;
+
+    /**
+     * @brief free this without calling the handler
+     */
+    virtual void destroy() = 0;
+
+    template <class Handler>
+    static HttpUringCompletion* create(Handler&& handler);
+
+protected:
+    ~HttpUringCompletion() = default;
+};
+
+template <class Handler>
+class HttpUringCompletionImpl final : public HttpUringCompletion
+{
+public:
+    explicit HttpUringCompletionImpl(Handler&& handler)
+        : handler_(std::move(handler))
+    {
+    }
+
+    void complete(const beast::tcp_stream::executor_type& executor, beast::error_code ec, std::size_t size) override
+    {
+        // the memory is released before the handler runs, so it can start the next operation from the pool
+        auto handler = std::move(handler_);
+        destroy();
+        net::post(executor, beast::bind_front_handler(std::move(handler), ec, size));
+    }
+
+    void destroy() override
+    {
+        this->~HttpUringCompletionImpl();
+        HttpRecyclingPool::deallocate(this, sizeof(HttpUringCompletionImpl));
+    }
+
+private:
+    Handler handler_;
+};
+
+template <class Handler>
+HttpUringCompletion* HttpUringCompletion::create(Handler&& handler)
+{
+    using Impl = HttpUringCompletionImpl<typename std::decay<Handler>::type>;
+    auto memory = HttpRecyclingPool::allocate(sizeof(Impl));
+    return new (memory) Impl(std::move(handler));
+}
+
+/**
+ * @brief one connection on the io_uring transport
+ * @note a multishot recv stays armed while the connection is open, received data waits in buffers of the
+ * provided buffer ring until the session reads it, so an idle connection holds no receive buffer. When the
+ * ring runs out of buffers a pending read receives straight into its own buffer instead, so one connection
+ * never waits for others to return buffers. Operations are started from the session strand and completed by
+ * the service on any io thread, the state is locked.
+ */
+class HttpUringSocket : public std::enable_shared_from_this<HttpUringSocket>
+{
+public:
+    HttpUringSocket(std::shared_ptr<HttpUringService> service, int fd, beast::tcp_stream::executor_type executor);
+    ~HttpUringSocket();
+
+    HttpUringSocket(const HttpUringSocket&) = delete;
+    HttpUringSocket& operator=(const HttpUringSocket&) = delete;
+
+    static constexpr std::size_t kMaxIovecs = 16;  ///< buffers sent by one write()
+
+    /**
+     * @brief read into buffer, complete with the byte count, or net::error::eof
+     */
+    void read(net::mutable_buffer buffer, HttpUringCompletion* completion);
+
+    /**
+     * @brief send at most kMaxIovecs buffers with one sendmsg, complete with the byte count sent
+     */
+    void write(const iovec* iovecs, std::size_t iovec_cnt, HttpUringCompletion* completion);
+
+    /**
+     * @brief complete when data, eof or an error is ready to be read
+     */
+    void waitRead(HttpUringCompletion* completion);
+
+    /**
+     * @brief complete the pending operations with net::error::operation_aborted
+     */
+    void cancel();
+
+    /**
+     * @brief cancel everything and stop receiving, the fd is closed by its owner afterwards
+     */
+    void close();
+
+private:
+    friend class HttpUringService;
+
+    struct Chunk
+    {
+        uint16_t buffer_id_;
+        uint32_t offset_;
+        uint32_t size_;
+    };
+
+    struct WriteState;
+
+    void armRecv();
+    void armDirect();
+    void onRecv(int result, uint32_t flags);
+    void onDirect(bool read, int result);
+    void onSend(int result);
+    std::size_t consume(net::mutable_buffer buffer);
+    void submitted();
+    void finished(std::shared_ptr<HttpUringSocket>& keep_alive);
+    std::shared_ptr<HttpUringSocket> abandon(std::vector<HttpUringCompletion*>& completions);
+
+    std::shared_ptr<HttpUringService> service_;
+    int fd_;
+    beast::tcp_stream::executor_type executor_;
+    std::mutex mutex_;
+    std::deque<Chunk> chunks_;  // received data in ring buffers, in order
+    beast::error_code read_error_;  // eof or the error ending the stream, reported once the chunks are read
+    bool recv_armed_;
+    bool recv_cancelled_;  // the armed recv is being cancelled, too much data is queued
+    bool direct_armed_;  // a single recv into read_buffer_, or a poll, replaces the multishot recv
+    bool direct_read_;  // the direct operation is a recv
+    bool closed_;
+    net::mutable_buffer read_buffer_;
+    HttpUringCompletion* read_completion_;
+    HttpUringCompletion* wait_completion_;
+    HttpUringCompletion* write_completion_;
+    std::unique_ptr<WriteState> write_state_;  // msghdr and iovecs of the pending sendmsg
+    std::size_t registry_index_;  // position in HttpUringService::sockets_
+    std::size_t inflight_cnt_;  // submitted operations whose last completion hasn't arrived
+    std::shared_ptr<HttpUringSocket> self_;  // keeps the socket alive while the kernel may still complete to it
+};
+
+/**
+ * @brief one io_uring ring and its provided buffer ring, shared by the connections bound to it
+ * @note the server creates as many as io threads and shards the connections over them round-robin like the
+ * timing wheels. A ring isn't bound to a thread, every io thread runs the shared io_context, so any of them may
+ * submit, flush or reap, and the ring is locked.
+ * Completions are reaped on the io_context when the eventfd registered with the ring is readable, and
+ * handlers are posted to the executor of their connection. Submissions only queue an entry, a flush posted to
+ * the io_context enters the kernel once for everything queued meanwhile, and reaping submits what its
+ * handlers queued. Without kernel support the server keeps the epoll reactor of Asio, see supported().
+ */
+class HttpUringService : public std::enable_shared_from_this<HttpUringService>
+{
+public:
+    /**
+     * @brief whether io_uring is built in and the kernel has multishot recv and provided buffer rings
+     */
+    static bool supported();
+
+    /**
+     * @brief create the rings, throw std::runtime_error on failure
+     */
+    HttpUringService(net::io_context& io_context, uint32_t buffer_cnt, uint32_t buffer_size);
+    ~HttpUringService();
+
+    HttpUringService(const HttpUringService&) = delete;
+    HttpUringService& operator=(const HttpUringService&) = delete;
+
+    /**
+     * @brief start reaping completions on the io_context
+     */
+    void start();
+
+    /**
+     * @brief stop reaping completions, start() resumes
+     */
+    void stop();
+
+    /**
+     * @brief cancel everything in flight, close the ring and drop the handlers of pending operations, called
+     * once the io threads are stopped
+     */
+    void shutdown();
+
+    /**
+     * @brief bind a connected socket to the transport
+     */
+    std::shared_ptr<HttpUringSocket> open(int fd, const beast::tcp_stream::executor_type& executor);
+
+private:
+    friend class HttpUringSocket;
+
+    enum class OpKind : uint64_t
+    {
+        Recv = 1,
+        Send = 2,
+        Read = 3,
+        Poll = 4,
+    };
+
+    void doReap();
+    void onReap(beast::error_code ec, std::size_t bytes_transferred);
+    void reap();
+
+    // take mutex_ and queue the entry for the next flush, false when the ring is closed or full
+    bool submitRecv(HttpUringSocket& socket);
+    bool submitRead(HttpUringSocket& socket, net::mutable_buffer buffer);
+    bool submitPoll(HttpUringSocket& socket);
+    bool submitSend(HttpUringSocket& socket, const void* msghdr);
+    bool submitCancel(HttpUringSocket& socket, OpKind kind);
+    void postFlush();  // with mutex_ held
+    void flush();
+    void returnBuffer(uint16_t buffer_id);
+    const char* bufferData(uint16_t buffer_id) const;
+
+    void registerSocket(HttpUringSocket* socket);
+    void unregisterSocket(HttpUringSocket* socket);
+
+    struct Ring;
+
+    net::io_context& io_context_;
+    std::mutex mutex_;
+    std::unique_ptr<Ring> ring_;
+    uint32_t buffer_cnt_;
+    uint32_t buffer_size_;
+    std::unique_ptr<char[]> buffers_;
+    net::posix::stream_descriptor event_descriptor_;
+    uint64_t event_count_;
+    bool closed_;
+    bool flush_posted_;  // a flush is posted and hasn't run yet
+    std::atomic<std::size_t> inflight_cnt_;  // submitted operations whose last completion hasn't arrived
+    std::vector<HttpUringSocket*> sockets_;  // open sockets, to drop pending handlers on shutdown()
+};
+
+}  // namespace server
+}  // namespace http
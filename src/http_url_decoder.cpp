@@ -0,0 +1,150 @@
+#include <cstdint>
+#include <cstring>
+#include "http_url_decoder.h"
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define HTTP_URL_DECODER_X86 1
+#include <immintrin.h>
+#endif
+
+namespace http
+{
+namespace server
+{
+namespace
+{
+using FindFunction = const char* (*)(const char* p, const char* end);
+
+inline bool isSpecial(char c)
+{
+    return c == '%' || c == '&' || c == '=' || c == '+';
+}
+
+const char* findScalar(const char* p, const char* end)
+{
+    while (p != end && !isSpecial(*p))
+    {
+        ++p;
+    }
+    return p;
+}
+
+#ifdef HTTP_URL_DECODER_X86
+// SSE2 is part of x86-64, no runtime check is needed
+const char* findSse2(const char* p, const char* end)
+{
+    const auto percent = _mm_set1_epi8('%');
+    const auto ampersand = _mm_set1_epi8('&');
+    const auto equal = _mm_set1_epi8('=');
+    const auto plus = _mm_set1_epi8('+');
+    while (end - p >= 16)
+    {
+        auto chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        auto special = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, percent), _mm_cmpeq_epi8(chunk, ampersand)),
+                                    _mm_or_si128(_mm_cmpeq_epi8(chunk, equal), _mm_cmpeq_epi8(chunk, plus)));
+        auto mask = static_cast<uint32_t>(_mm_movemask_epi8(special));
+        if (mask != 0)
+        {
+            return p + __builtin_ctz(mask);
+        }
+        p += 16;
+    }
+    return findScalar(p, end);
+}
+
+__attribute__((target("avx2"))) const char* findAvx2(const char* p, const char* end)
+{
+    const auto percent = _mm256_set1_epi8('%');
+    const auto ampersand = _mm256_set1_epi8('&');
+    const auto equal = _mm256_set1_epi8('=');
+    const auto plus = _mm256_set1_epi8('+');
+    while (end - p >= 32)
+    {
+        auto chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        auto special =
+            _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(chunk, percent), _mm256_cmpeq_epi8(chunk, ampersand)),
+                            _mm256_or_si256(_mm256_cmpeq_epi8(chunk, equal), _mm256_cmpeq_epi8(chunk, plus)));
+        auto mask = static_cast<uint32_t>(_mm256_movemask_epi8(special));
+        if (mask != 0)
+        {
+            return p + __builtin_ctz(mask);
+        }
+        p += 32;
+    }
+    return findSse2(p, end);
+}
+#endif
+
+FindFunction detectFind()
+{
+#ifdef HTTP_URL_DECODER_X86
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") ? findAvx2 : findSse2;
+#else
+    return findScalar;
+#endif
+}
+
+const FindFunction kFind = detectFind();
+
+inline int hexValue(char c)
+{
+    if (c >= '0' && c <= '9')
+    {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f')
+    {
+        return c - 'a' + 10;
+    }
+    if (c >= 'A' && c <= 'F')
+    {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+}  // namespace
+
+const char* HttpUrlDecoder::find(const char* p, const char* end)
+{
+    return kFind(p, end);
+}
+
+std::size_t HttpUrlDecoder::decode(const char* data, std::size_t size, char* out)
+{
+    auto p = data;
+    auto end = data + size;
+    auto o = out;
+    while (p != end)
+    {
+        auto special = kFind(p, end);
+        std::memcpy(o, p, static_cast<std::size_t>(special - p));
+        o += special - p;
+        p = special;
+        if (p == end)
+        {
+            break;
+        }
+
+        int high = 0;
+        int low = 0;
+        if (*p == '%' && end - p >= 3 && (high = hexValue(p[1])) >= 0 && (low = hexValue(p[2])) >= 0)
+        {
+            *o++ = static_cast<char>(high * 16 + low);
+            p += 3;
+        }
+        else if (*p == '+')
+        {
+            *o++ = ' ';
+            ++p;
+        }
+        else
+        {
+            *o++ = *p++;
+        }
+    }
+    return static_cast<std::size_t>(o - out);
+}
+
+}  // namespace server
+}  // namespace http
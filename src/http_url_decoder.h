@@ -0,0 +1,36 @@
+/**
+ * @brief Http url decoder Define
+ * @file http_url_decoder.h
+ * @copyright Licensed under the Apache License, Version 2.0
+ */
+
+#pragma once
+#include <cstddef>
+
+namespace http
+{
+namespace server
+{
+
+/**
+ * @brief query string scanning and percent-decoding
+ * @note the bytes which need attention, '%', '&', '=' and '+', are searched 16 (SSE2) or 32 (AVX2) bytes at
+ * a time, the runs between them are copied with memcpy. AVX2 is chosen by the cpu features at runtime.
+ */
+class HttpUrlDecoder
+{
+public:
+    /**
+     * @brief return the first '%', '&', '=' or '+' in [p, end), or end
+     */
+    static const char* find(const char* p, const char* end);
+
+    /**
+     * @brief decode percent escapes, and '+' to space as in form encoding, into out which needs size bytes
+     * @return the decoded size, a '%' without two hex digits is copied unchanged
+     */
+    static std::size_t decode(const char* data, std::size_t size, char* out);
+};
+
+}  // namespace server
+}  // namespace http
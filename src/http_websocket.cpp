@@ -0,0 +1,114 @@
+#include "http_session.h"
+#include <httpserver/detail/http_websocket.h>
+
+namespace http
+{
+namespace server
+{
+WebSocketMessage::WebSocketMessage(std::string&& payload, bool binary)
+    : payload_(std::make_shared<const std::string>(std::move(payload)))
+    , binary_(binary)
+{
+}
+
+WebSocketMessage::~WebSocketMessage()
+{
+}
+
+const std::string& WebSocketMessage::payload() const
+{
+    return *payload_;
+}
+
+bool WebSocketMessage::binary() const
+{
+    return binary_;
+}
+
+WebSocketConnection::WebSocketConnection(const std::shared_ptr<HttpSession>& session, uint64_t session_id)
+    : session_(session)
+    , session_id_(session_id)
+{
+}
+
+WebSocketConnection::~WebSocketConnection()
+{
+}
+
+uint64_t WebSocketConnection::sessionId() const
+{
+    return session_id_;
+}
+
+void WebSocketConnection::send(const WebSocketMessage& message) const
+{
+    auto session = session_.lock();
+    if (session)
+    {
+        session->sendWebSocket(message);
+    }
+}
+
+void WebSocketConnection::close() const
+{
+    auto session = session_.lock();
+    if (session)
+    {
+        session->closeWebSocket();
+    }
+}
+
+bool WebSocketConnection::isOpen() const
+{
+    return !session_.expired();
+}
+
+WebSocketGroup::WebSocketGroup()
+    : mutex_()
+    , connections_()
+{
+}
+
+WebSocketGroup::~WebSocketGroup()
+{
+}
+
+void WebSocketGroup::add(const WebSocketConnection& connection)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    connections_.emplace(connection.sessionId(), connection);
+}
+
+void WebSocketGroup::remove(const WebSocketConnection& connection)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    connections_.erase(connection.sessionId());
+}
+
+std::size_t WebSocketGroup::size()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return connections_.size();
+}
+
+std::size_t WebSocketGroup::broadcast(const WebSocketMessage& message)
+{
+    // each send only posts a reference to the payload to the connection strand, so the lock is held briefly
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::size_t sent_cnt = 0;
+    for (auto iter = connections_.begin(); iter != connections_.end();)
+    {
+        if (!iter->second.isOpen())
+        {
+            iter = connections_.erase(iter);
+            continue;
+        }
+        iter->second.send(message);
+        ++sent_cnt;
+        ++iter;
+    }
+    return sent_cnt;
+}
+
+}  // namespace server
+}  // namespace http